@@ -0,0 +1,1738 @@
+// Benchmarks are run instead of the main loop, by passing '--bench <name> [args..]' on the command line
+
+using BenchmarkFunc = void( int argc, char** argv );
+
+struct Benchmark
+{
+    char const* name;
+    BenchmarkFunc* func;
+    char const* usage;
+};
+
+
+// Write a flat grid of gridSize x gridSize vertices as a .gltf plus an external .bin buffer
+bool WriteGridGltf( char const* gltfPath, char const* binName, int gridSize )
+{
+    sz vertexCount = (sz)gridSize * gridSize;
+    sz indexCount = (sz)(gridSize - 1) * (gridSize - 1) * 6;
+
+    sz positionsSize = vertexCount * SIZEOF(v3);
+    sz normalsSize = vertexCount * SIZEOF(v3);
+    sz uvsSize = vertexCount * SIZEOF(v2);
+    sz indicesSize = indexCount * SIZEOF(u32);
+    std::vector<u8> bin( positionsSize + normalsSize + uvsSize + indicesSize );
+
+    v3* positions = (v3*)bin.data();
+    v3* normals = (v3*)(bin.data() + positionsSize);
+    v2* uvs = (v2*)(bin.data() + positionsSize + normalsSize);
+    u32* indices = (u32*)(bin.data() + positionsSize + normalsSize + uvsSize);
+
+    for( int y = 0; y < gridSize; ++y )
+    {
+        for( int x = 0; x < gridSize; ++x )
+        {
+            sz i = (sz)y * gridSize + x;
+            f32 u = (f32)x / (gridSize - 1);
+            f32 v = (f32)y / (gridSize - 1);
+            positions[i] = { u - 0.5f, v - 0.5f, 0.05f * sinf( u * 20.f ) * cosf( v * 20.f ) };
+            normals[i] = V3Up;
+            uvs[i] = { u, v };
+        }
+    }
+    for( int y = 0; y < gridSize - 1; ++y )
+    {
+        for( int x = 0; x < gridSize - 1; ++x )
+        {
+            u32 i = (u32)(y * gridSize + x);
+            *indices++ = i;
+            *indices++ = i + 1;
+            *indices++ = i + gridSize + 1;
+            *indices++ = i;
+            *indices++ = i + gridSize + 1;
+            *indices++ = i + gridSize;
+        }
+    }
+
+    char binPath[256];
+    char const* lastSlash = strrchr( gltfPath, '/' );
+    snprintf( binPath, sizeof(binPath), "%.*s%s", lastSlash ? (int)(lastSlash - gltfPath + 1) : 0, gltfPath, binName );
+    if( !Platform::WriteEntireFile( binPath, bin.data(), (sz)bin.size() ) )
+        return false;
+
+    char json[2048];
+    int jsonLength = snprintf( json, sizeof(json),
+        "{ \"asset\": { \"version\": \"2.0\" },\n"
+        "  \"meshes\": [ { \"primitives\": [ { \"attributes\": { \"POSITION\": 0, \"NORMAL\": 1, \"TEXCOORD_0\": 2 }, \"indices\": 3 } ] } ],\n"
+        "  \"buffers\": [ { \"uri\": \"%s\", \"byteLength\": %lld } ],\n"
+        "  \"bufferViews\": [\n"
+        "    { \"buffer\": 0, \"byteOffset\": 0, \"byteLength\": %lld },\n"
+        "    { \"buffer\": 0, \"byteOffset\": %lld, \"byteLength\": %lld },\n"
+        "    { \"buffer\": 0, \"byteOffset\": %lld, \"byteLength\": %lld },\n"
+        "    { \"buffer\": 0, \"byteOffset\": %lld, \"byteLength\": %lld } ],\n"
+        "  \"accessors\": [\n"
+        "    { \"bufferView\": 0, \"componentType\": 5126, \"count\": %lld, \"type\": \"VEC3\" },\n"
+        "    { \"bufferView\": 1, \"componentType\": 5126, \"count\": %lld, \"type\": \"VEC3\" },\n"
+        "    { \"bufferView\": 2, \"componentType\": 5126, \"count\": %lld, \"type\": \"VEC2\" },\n"
+        "    { \"bufferView\": 3, \"componentType\": 5125, \"count\": %lld, \"type\": \"SCALAR\" } ] }\n",
+        binName, (long long)bin.size(),
+        (long long)positionsSize,
+        (long long)positionsSize, (long long)normalsSize,
+        (long long)(positionsSize + normalsSize), (long long)uvsSize,
+        (long long)(positionsSize + normalsSize + uvsSize), (long long)indicesSize,
+        (long long)vertexCount, (long long)vertexCount, (long long)vertexCount, (long long)indexCount );
+
+    return Platform::WriteEntireFile( gltfPath, json, jsonLength );
+}
+
+void BenchMeshLoading( int argc, char** argv )
+{
+    char const* sourcePath = argc > 0 ? argv[0] : nullptr;
+    int iterations = argc > 1 ? atoi( argv[1] ) : 10;
+
+    Platform::EnsureDirectoryExists( MeshCacheDir );
+    if( !sourcePath )
+    {
+        // 1M vertices, 2M triangles
+        sourcePath = "cache/bench_grid.gltf";
+        Log( "Generating test mesh '%s'..", sourcePath );
+        WriteGridGltf( sourcePath, "bench_grid.bin", 1024 );
+    }
+
+    char cookedPath[256];
+    GetCookedMeshPath( sourcePath, cookedPath, sizeof(cookedPath) );
+
+    MeshData meshData;
+    if( !LoadGltf( sourcePath, &meshData ) || !CookMesh( meshData, cookedPath ) )
+    {
+        Log( "ERROR :: Could not cook '%s'", sourcePath );
+        return;
+    }
+    sz vertexCount = meshData.desc.vertexCount;
+    sz indexCount = meshData.desc.indexCount;
+    meshData = {};
+
+    Mesh mesh;
+    f64 sourceMillis = 0;
+    for( int i = 0; i < iterations; ++i )
+    {
+        f64 start = Platform::CurrentTimeMillis();
+        MeshData data;
+        LoadGltf( sourcePath, &data );
+        UploadMesh( data, &mesh );
+        sourceMillis += Platform::CurrentTimeMillis() - start;
+
+        ReleaseMesh( &mesh );
+    }
+
+    f64 cookedMillis = 0;
+    for( int i = 0; i < iterations; ++i )
+    {
+        f64 start = Platform::CurrentTimeMillis();
+        LoadCookedMesh( cookedPath, &mesh );
+        cookedMillis += Platform::CurrentTimeMillis() - start;
+
+        ReleaseMesh( &mesh );
+    }
+
+    sourceMillis /= iterations;
+    cookedMillis /= iterations;
+    Log( "Mesh '%s': %lld vertices, %lld indices", sourcePath, (long long)vertexCount, (long long)indexCount );
+    Log( "  glTF source:  %8.2f ms / load", sourceMillis );
+    Log( "  cooked .mesh: %8.2f ms / load", cookedMillis );
+    Log( "  speedup:      %8.2fx", sourceMillis / cookedMillis );
+}
+
+// Write an uncompressed 32 bit TGA with some noisy gradient content
+bool WriteTestTGA( char const* path, u32 width, u32 height )
+{
+    std::vector<u8> data( 18 + (sz)width * height * 4 );
+    u8* header = data.data();
+    header[2] = 2;                  // Uncompressed truecolor
+    header[12] = width & 0xFF;
+    header[13] = (width >> 8) & 0xFF;
+    header[14] = height & 0xFF;
+    header[15] = (height >> 8) & 0xFF;
+    header[16] = 32;
+    header[17] = 0x20 | 8;          // Top-down, 8 bits of alpha
+
+    u32 seed = 12345;
+    u8* p = data.data() + 18;
+    for( u32 y = 0; y < height; ++y )
+    {
+        for( u32 x = 0; x < width; ++x )
+        {
+            seed = seed * 1664525u + 1013904223u;
+            u8 noise = (u8)(seed >> 24) & 0x1F;
+            *p++ = (u8)(x * 255 / width) ^ noise;
+            *p++ = (u8)(y * 255 / height) ^ noise;
+            *p++ = (u8)((x ^ y) & 0xFF);
+            *p++ = 255;
+        }
+    }
+
+    return Platform::WriteEntireFile( path, data.data(), (sz)data.size() );
+}
+
+// Measure throughput from a cooked file on disk to a fully resident texture, for a few different per-frame budgets
+void BenchTextureStreaming( int argc, char** argv )
+{
+    char const* sourcePath = argc > 0 ? argv[0] : nullptr;
+
+    Platform::EnsureDirectoryExists( TextureCacheDir );
+    if( !sourcePath )
+    {
+        sourcePath = "cache/bench_texture.tga";
+        Log( "Generating test texture '%s'..", sourcePath );
+        WriteTestTGA( sourcePath, 4096, 4096 );
+    }
+
+    char cookedPath[256];
+    GetCookedTexturePath( sourcePath, true, cookedPath, sizeof(cookedPath) );
+
+    std::vector<u8> pixels;
+    u32 width, height;
+    f64 start = Platform::CurrentTimeMillis();
+    if( !LoadTGA( sourcePath, &pixels, &width, &height ) || !CookTexture( pixels.data(), width, height, true, cookedPath ) )
+    {
+        Log( "ERROR :: Could not cook '%s'", sourcePath );
+        return;
+    }
+    Log( "Texture '%s': %u x %u, cooked in %.2f ms", sourcePath, width, height, Platform::CurrentTimeMillis() - start );
+    pixels = {};
+
+    u64 budgetsMB[] = { 4, 16, 64 };
+    for( u64 budgetMB : budgetsMB )
+    {
+        TextureStreamer streamer;
+        streamer.budgetPerFrame = budgetMB * 1024 * 1024;
+
+        Texture texture;
+        int frameCount = 0;
+        start = Platform::CurrentTimeMillis();
+
+        if( !LoadCookedTexture( cookedPath, &texture, &streamer ) )
+            return;
+
+        // Simulate frames which do nothing else than streaming
+        while( !streamer.pending.empty() )
+        {
+            WGPUCommandEncoderDescriptor encoderDesc = {};
+            encoderDesc.nextInChain                  = nullptr;
+            encoderDesc.label                        = "Texture streaming";
+            WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder( globalDevice, &encoderDesc );
+
+            StreamTextureUploads( &streamer, &globalStagingBelt, encoder );
+            FlushStagingBelt( &globalStagingBelt, encoder );
+
+            WGPUCommandBufferDescriptor cmdBufferDescriptor = {};
+            cmdBufferDescriptor.nextInChain                 = nullptr;
+            cmdBufferDescriptor.label                       = "Texture streaming";
+            WGPUCommandBuffer command = wgpuCommandEncoderFinish( encoder, &cmdBufferDescriptor );
+            wgpuQueueSubmit( globalQueue, 1, &command );
+            RecallStagingBelt( &globalStagingBelt );
+
+#ifdef WEBGPU_BACKEND_DAWN
+            wgpuCommandEncoderRelease( encoder );
+            wgpuCommandBufferRelease( command );
+#endif
+            frameCount++;
+        }
+        WaitForGPU();
+
+        f64 millis = Platform::CurrentTimeMillis() - start;
+        f64 totalMB = streamer.totalBytesUploaded / (1024.0 * 1024.0);
+        Log( "  budget %3llu MB/frame: %7.2f MB in %3d frames, %8.2f ms, %8.2f MB/s",
+             (unsigned long long)budgetMB, totalMB, frameCount, millis, totalMB * 1000.0 / millis );
+
+        ReleaseTexture( &texture );
+    }
+}
+
+// Largest per-channel difference of every mip against the CPU reference
+int CompareMipsWithReference( Texture const& texture, std::vector<u8> const* referenceMips )
+{
+    int maxError = 0;
+    std::vector<u8> mip;
+    for( u32 m = 0; m < texture.mipCount; ++m )
+    {
+        if( !ReadbackTexture( texture, m, &mip ) || mip.size() != referenceMips[m].size() )
+            return 255;
+        for( sz i = 0; i < (sz)mip.size(); ++i )
+            maxError = Max( maxError, Abs( (int)mip[i] - (int)referenceMips[m][i] ) );
+    }
+    return maxError;
+}
+
+using GenerateMipsFunc = bool( WGPUCommandEncoder, Texture const&, MipGenerator* );
+
+// Average wall time per full chain, for a batch of iterations recorded into a single submission
+f64 TimeMipGeneration( GenerateMipsFunc* func, Texture const& texture, int iterations )
+{
+    // Warm up, so pipeline creation isn't included
+    WGPUCommandEncoderDescriptor encoderDesc = {};
+    encoderDesc.nextInChain                  = nullptr;
+    encoderDesc.label                        = "Mip generation";
+    WGPUCommandBufferDescriptor cmdBufferDescriptor = {};
+    cmdBufferDescriptor.nextInChain                 = nullptr;
+    cmdBufferDescriptor.label                       = "Mip generation";
+
+    f64 start = 0;
+    for( int pass = 0; pass < 2; ++pass )
+    {
+        WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder( globalDevice, &encoderDesc );
+        for( int i = 0; i < (pass ? iterations : 1); ++i )
+            func( encoder, texture, &globalMipGenerator );
+
+        WGPUCommandBuffer command = wgpuCommandEncoderFinish( encoder, &cmdBufferDescriptor );
+        wgpuQueueSubmit( globalQueue, 1, &command );
+#ifdef WEBGPU_BACKEND_DAWN
+        wgpuCommandEncoderRelease( encoder );
+        wgpuCommandBufferRelease( command );
+#endif
+        WaitForGPU();
+
+        if( pass == 0 )
+            start = Platform::CurrentTimeMillis();
+    }
+
+    return (Platform::CurrentTimeMillis() - start) / iterations;
+}
+
+// Compare compute mip generation against one render pass per level, and verify both against the CPU reference
+void BenchMipGeneration( int argc, char** argv )
+{
+    int iterations = argc > 0 ? atoi( argv[0] ) : 20;
+    u32 sizes[] = { 1024, 2048, 4096 };
+    WGPUTextureFormat formats[] = { WGPUTextureFormat_RGBA8Unorm, WGPUTextureFormat_RGBA8UnormSrgb };
+
+    for( WGPUTextureFormat format : formats )
+    {
+        bool srgb = IsSRGBFormat( format );
+        for( u32 size : sizes )
+        {
+            // Non-power-of-two height to exercise odd sizes down the chain
+            u32 width = size;
+            u32 height = size * 3 / 4 + 1;
+
+            std::vector<u8> pixels( (sz)width * height * 4 );
+            u32 seed = size;
+            for( u8& p : pixels )
+            {
+                seed = seed * 1664525u + 1013904223u;
+                p = (u8)(seed >> 24);
+            }
+
+            Texture texture;
+            CreateTexture( &texture, "Mip generation test", width, height, 0, format,
+                           MipGenUsage | MipGenBlitUsage | WGPUTextureUsage_CopyDst | WGPUTextureUsage_CopySrc );
+
+            WGPUImageCopyTexture dst = {};
+            dst.texture = texture.texture;
+            dst.mipLevel = 0;
+            dst.origin = { 0, 0, 0 };
+            dst.aspect = WGPUTextureAspect_All;
+            WGPUTextureDataLayout layout = {};
+            layout.offset = 0;
+            layout.bytesPerRow = width * 4;
+            layout.rowsPerImage = height;
+            WGPUExtent3D extent = { width, height, 1 };
+            wgpuQueueWriteTexture( globalQueue, &dst, pixels.data(), pixels.size(), &layout, &extent );
+
+            std::vector<u8> referenceMips[MaxTextureMips];
+            GenerateMipsCPU( pixels.data(), width, height, texture.mipCount, srgb, referenceMips );
+
+            f64 blitMillis = TimeMipGeneration( GenerateMipsWithRenderPasses, texture, iterations );
+            int blitError = CompareMipsWithReference( texture, referenceMips );
+            f64 computeMillis = TimeMipGeneration( GenerateMips, texture, iterations );
+            int computeError = CompareMipsWithReference( texture, referenceMips );
+
+            Log( "%s %4u x %4u, %2u mips:", srgb ? "RGBA8UnormSrgb" : "RGBA8Unorm    ", width, height, texture.mipCount );
+            Log( "  render pass per level: %7.3f ms / chain (max error vs CPU %d)", blitMillis, blitError );
+            Log( "  compute, 2 per pass:   %7.3f ms / chain (max error vs CPU %d)", computeMillis, computeError );
+            Log( "  speedup:               %7.2fx", blitMillis / computeMillis );
+
+            ReleaseTexture( &texture );
+        }
+    }
+}
+
+// Per-frame uploads of increasing size, through wgpuQueueWriteBuffer and through the staging belt
+void BenchUploads( int argc, char** argv )
+{
+    u64 maxSize = argc > 0 ? (u64)atoll( argv[0] ) * 1024 * 1024 : 256ull * 1024 * 1024;
+    maxSize = Min<u64>( maxSize, 256ull * 1024 * 1024 );
+
+    std::vector<u8> data( maxSize );
+    for( sz i = 0; i < (sz)data.size(); ++i )
+        data[i] = (u8)i;
+
+    WGPUBufferDescriptor dstDesc = {};
+    dstDesc.nextInChain          = nullptr;
+    dstDesc.label                = "Upload target";
+    dstDesc.usage                = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage;
+    dstDesc.size                 = maxSize;
+    dstDesc.mappedAtCreation     = false;
+    WGPUBuffer dst = CreateGPUBuffer( &dstDesc );
+
+    WGPUCommandEncoderDescriptor encoderDesc = {};
+    encoderDesc.nextInChain                  = nullptr;
+    encoderDesc.label                        = "Upload";
+    WGPUCommandBufferDescriptor cmdBufferDescriptor = {};
+    cmdBufferDescriptor.nextInChain                 = nullptr;
+    cmdBufferDescriptor.label                       = "Upload";
+
+    StagingBelt belt;
+    for( u64 size = 1024; size <= maxSize; size *= 4 )
+    {
+        // Keep the total amount roughly constant, within reason
+        u64 frameCount64 = 1024ull * 1024 * 1024 / size;
+        Clamp<u64>( &frameCount64, 10, 500 );
+        int frameCount = (int)frameCount64;
+        f64 millis[2] = {};
+
+        for( int path = 0; path < 2; ++path )
+        {
+            bool useBelt = path == 1;
+            f64 start = 0;
+
+            // One extra frame to warm up (and let the belt allocate its chunks)
+            for( int frame = -1; frame < frameCount; ++frame )
+            {
+                if( frame == 0 )
+                {
+                    WaitForGPU();
+                    start = Platform::CurrentTimeMillis();
+                }
+
+                WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder( globalDevice, &encoderDesc );
+                if( useBelt )
+                {
+                    if( void* staging = StagingWrite( &belt, dst, 0, size ) )
+                        COPYP( data.data(), staging, size );
+                    FlushStagingBelt( &belt, encoder );
+                }
+                else
+                    wgpuQueueWriteBuffer( globalQueue, dst, 0, data.data(), size );
+
+                WGPUCommandBuffer command = wgpuCommandEncoderFinish( encoder, &cmdBufferDescriptor );
+                wgpuQueueSubmit( globalQueue, 1, &command );
+#ifdef WEBGPU_BACKEND_DAWN
+                wgpuCommandEncoderRelease( encoder );
+                wgpuCommandBufferRelease( command );
+#endif
+                if( useBelt )
+                    RecallStagingBelt( &belt );
+                else
+                    PollDevice( false );
+            }
+            WaitForGPU();
+            millis[path] = (Platform::CurrentTimeMillis() - start) / frameCount;
+        }
+
+        f64 mb = size / (1024.0 * 1024.0);
+        Log( "%10llu bytes/frame x %3d:  queue write %8.3f ms (%8.1f MB/s)  |  staging belt %8.3f ms (%8.1f MB/s)  |  %5.2fx",
+             (unsigned long long)size, frameCount, millis[0], mb * 1000.0 / millis[0], millis[1], mb * 1000.0 / millis[1],
+             millis[0] / millis[1] );
+    }
+
+    Log( "Staging belt peak size: %.1f MB", belt.totalSize / (1024.0 * 1024.0) );
+    ReleaseStagingBelt( &belt );
+    DestroyGPUBuffer( dst );
+}
+
+
+// CPU time spent encoding a pass with many draws, directly vs replaying a render bundle recorded once
+void BenchRenderBundles( int argc, char** argv )
+{
+    int maxDraws = argc > 0 ? atoi( argv[0] ) : 1000;
+    int frameCount = argc > 1 ? atoi( argv[1] ) : 100;
+
+    // Any program will do, as long as it has some bindings
+    Program* program = &starfieldProgram;
+    SetCurrentProgram( *program );
+    UpdateCurrentProgramInputs( 64, 64 );
+    // Passes get encoded directly here, so upload what the update wrote now
+    ApplyProgramFrameData( program, 0 );
+
+    // Keep the target tiny, so the GPU is never the bottleneck
+    WGPUTextureDescriptor targetDesc = {};
+    targetDesc.nextInChain           = nullptr;
+    targetDesc.label                 = "Bundle test target";
+    targetDesc.usage                 = WGPUTextureUsage_RenderAttachment;
+    targetDesc.dimension             = WGPUTextureDimension_2D;
+    targetDesc.size                  = { 64, 64, 1 };
+    targetDesc.format                = globalSwapChainFormat;
+    targetDesc.mipLevelCount         = 1;
+    targetDesc.sampleCount           = 1;
+    targetDesc.viewFormatCount       = 0;
+    targetDesc.viewFormats           = nullptr;
+    WGPUTexture target = CreateGPUTexture( &targetDesc );
+    WGPUTextureView targetView = wgpuTextureCreateView( target, nullptr );
+
+    WGPUCommandEncoderDescriptor encoderDesc = {};
+    encoderDesc.nextInChain                  = nullptr;
+    encoderDesc.label                        = "Bundle test";
+    WGPUCommandBufferDescriptor cmdBufferDescriptor = {};
+    cmdBufferDescriptor.nextInChain                 = nullptr;
+    cmdBufferDescriptor.label                       = "Bundle test";
+
+    WGPURenderPassColorAttachment colorAttachment = {};
+    colorAttachment.view                          = targetView;
+    colorAttachment.resolveTarget                 = nullptr;
+    colorAttachment.loadOp                        = WGPULoadOp_Clear;
+    colorAttachment.storeOp                       = WGPUStoreOp_Store;
+    colorAttachment.clearValue                    = ClearColor;
+
+    WGPURenderPassDescriptor passDesc = {};
+    passDesc.nextInChain              = nullptr;
+    passDesc.label                    = "Bundle test";
+    passDesc.colorAttachmentCount     = 1;
+    passDesc.colorAttachments         = &colorAttachment;
+    passDesc.depthStencilAttachment   = nullptr;
+    passDesc.timestampWriteCount      = 0;
+    passDesc.timestampWrites          = nullptr;
+
+    for( int drawCount = 1; drawCount <= maxDraws; drawCount *= 10 )
+    {
+        f64 millis[2] = {};
+        f64 recordMillis = 0;
+
+        for( int path = 0; path < 2; ++path )
+        {
+            bool useBundles = path == 1;
+            WGPURenderBundle bundle = nullptr;
+            WGPUBindGroup bundleBindGroup = nullptr;
+            u64 bundleKey = 0;
+
+            // One extra frame to warm up (and record the bundle)
+            for( int frame = -1; frame < frameCount; ++frame )
+            {
+                WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder( globalDevice, &encoderDesc );
+                FlushStagingBelt( &globalStagingBelt, encoder );
+
+                f64 start = Platform::CurrentTimeMillis();
+                WGPURenderPassEncoder pass = wgpuCommandEncoderBeginRenderPass( encoder, &passDesc );
+                if( useBundles )
+                {
+                    // Same check the runtime does every frame before replaying
+                    u64 key = ComputePassBundleKey( program, MainPass );
+                    if( !bundle || key != bundleKey )
+                    {
+                        f64 recordStart = Platform::CurrentTimeMillis();
+                        bundleBindGroup = CreateChannelBindGroup( program, MainPass );
+
+                        WGPURenderBundleEncoderDescriptor bundleEncoderDesc = {};
+                        bundleEncoderDesc.nextInChain                       = nullptr;
+                        bundleEncoderDesc.label                             = "Bundle test";
+                        bundleEncoderDesc.colorFormatsCount                 = 1;
+                        bundleEncoderDesc.colorFormats                      = &globalSwapChainFormat;
+                        bundleEncoderDesc.depthStencilFormat                = WGPUTextureFormat_Undefined;
+                        bundleEncoderDesc.sampleCount                       = 1;
+                        WGPURenderBundleEncoder bundleEncoder = wgpuDeviceCreateRenderBundleEncoder( globalDevice, &bundleEncoderDesc );
+                        for( int d = 0; d < drawCount; ++d )
+                            EncodePassDraws( bundleEncoder, program, MainPass, bundleBindGroup );
+
+                        WGPURenderBundleDescriptor bundleDesc = {};
+                        bundleDesc.nextInChain                = nullptr;
+                        bundleDesc.label                      = "Bundle test";
+                        bundle = wgpuRenderBundleEncoderFinish( bundleEncoder, &bundleDesc );
+#ifdef WEBGPU_BACKEND_DAWN
+                        wgpuRenderBundleEncoderRelease( bundleEncoder );
+#endif
+                        bundleKey = key;
+                        recordMillis = Platform::CurrentTimeMillis() - recordStart;
+                    }
+                    wgpuRenderPassEncoderExecuteBundles( pass, 1, &bundle );
+                }
+                else
+                {
+                    WGPUBindGroup bindGroup = CreateChannelBindGroup( program, MainPass );
+                    for( int d = 0; d < drawCount; ++d )
+                        EncodePassDraws( pass, program, MainPass, bindGroup );
+                    if( bindGroup )
+                        wgpuBindGroupRelease( bindGroup );
+                }
+                wgpuRenderPassEncoderEnd( pass );
+                WGPUCommandBuffer command = wgpuCommandEncoderFinish( encoder, &cmdBufferDescriptor );
+                if( frame >= 0 )
+                    millis[path] += Platform::CurrentTimeMillis() - start;
+
+                wgpuQueueSubmit( globalQueue, 1, &command );
+#ifdef WEBGPU_BACKEND_DAWN
+                wgpuRenderPassEncoderRelease( pass );
+                wgpuCommandEncoderRelease( encoder );
+                wgpuCommandBufferRelease( command );
+#endif
+                RecallStagingBelt( &globalStagingBelt );
+                EndResourceFrame();
+                WaitForGPU();
+            }
+            millis[path] /= frameCount;
+
+            DeferRelease( bundle );
+            DeferRelease( bundleBindGroup );
+        }
+
+        Log( "%7d draws:  direct %8.4f ms  |  bundle %8.4f ms (recorded once in %.4f ms)  |  %6.2fx",
+             drawCount, millis[0], millis[1], recordMillis, millis[0] / millis[1] );
+    }
+
+    wgpuTextureViewRelease( targetView );
+    DestroyGPUTexture( target );
+}
+
+
+// CPU frame time for a synthetic frame with many passes, as the number of encoding threads grows
+void BenchPassEncoding( int argc, char** argv )
+{
+    int passCount = argc > 0 ? atoi( argv[0] ) : 256;
+    int frameCount = argc > 1 ? atoi( argv[1] ) : 50;
+    int maxThreads = GetWorkerCount();
+
+    Program* program = &starfieldProgram;
+    SetCurrentProgram( *program );
+    UpdateCurrentProgramInputs( 64, 64 );
+    // Passes get encoded directly here, so upload what the update wrote now
+    ApplyProgramFrameData( program, 0 );
+
+    WGPUTextureDescriptor targetDesc = {};
+    targetDesc.nextInChain           = nullptr;
+    targetDesc.label                 = "Pass encoding test target";
+    targetDesc.usage                 = WGPUTextureUsage_RenderAttachment;
+    targetDesc.dimension             = WGPUTextureDimension_2D;
+    targetDesc.size                  = { 64, 64, 1 };
+    targetDesc.format                = globalSwapChainFormat;
+    targetDesc.mipLevelCount         = 1;
+    targetDesc.sampleCount           = 1;
+    targetDesc.viewFormatCount       = 0;
+    targetDesc.viewFormats           = nullptr;
+    WGPUTexture target = CreateGPUTexture( &targetDesc );
+    WGPUTextureView targetView = wgpuTextureCreateView( target, nullptr );
+
+    // Every pass draws the program's main pass into the same target
+    std::vector<PassEncodeJob> jobs( passCount );
+    std::vector<WGPUCommandBuffer> commands( passCount + 1 );
+    bool useRenderBundles = program->useRenderBundles;
+
+    WGPUCommandEncoderDescriptor encoderDesc = {};
+    encoderDesc.nextInChain                  = nullptr;
+    encoderDesc.label                        = "Pass encoding test";
+    WGPUCommandBufferDescriptor cmdBufferDescriptor = {};
+    cmdBufferDescriptor.nextInChain                 = nullptr;
+    cmdBufferDescriptor.label                       = "Pass encoding test";
+
+    Log( "%d passes per frame", passCount );
+    f64 baseMillis[2] = {};
+    for( int threadCount = 1; threadCount <= maxThreads; threadCount *= 2 )
+    {
+        f64 millis[2] = {};
+        for( int path = 0; path < 2; ++path )
+        {
+            program->useRenderBundles = path == 1;
+
+            // One extra frame to warm up
+            for( int frame = -1; frame < frameCount; ++frame )
+            {
+                f64 start = Platform::CurrentTimeMillis();
+
+                WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder( globalDevice, &encoderDesc );
+                FlushStagingBelt( &globalStagingBelt, encoder );
+                commands[0] = wgpuCommandEncoderFinish( encoder, &cmdBufferDescriptor );
+
+                for( PassEncodeJob& job : jobs )
+                    job = { MainPass, targetView, globalSwapChainFormat, ClearColor, "Pass encoding test", nullptr, nullptr };
+                EncodePassJobs( program, jobs.data(), passCount, threadCount );
+                for( int i = 0; i < passCount; ++i )
+                    commands[i + 1] = jobs[i].commands;
+
+                wgpuQueueSubmit( globalQueue, commands.size(), commands.data() );
+                if( frame >= 0 )
+                    millis[path] += Platform::CurrentTimeMillis() - start;
+
+#ifdef WEBGPU_BACKEND_DAWN
+                wgpuCommandEncoderRelease( encoder );
+                for( WGPUCommandBuffer command : commands )
+                    wgpuCommandBufferRelease( command );
+#endif
+                RecallStagingBelt( &globalStagingBelt );
+                EndResourceFrame();
+                WaitForGPU();
+            }
+            millis[path] /= frameCount;
+        }
+        if( threadCount == 1 )
+            COPY( millis, baseMillis );
+
+        Log( "%3d threads:  direct %8.3f ms (%5.2fx)  |  bundles %8.3f ms (%5.2fx)", threadCount,
+             millis[0], baseMillis[0] / millis[0], millis[1], baseMillis[1] / millis[1] );
+    }
+
+    program->useRenderBundles = useRenderBundles;
+    wgpuTextureViewRelease( targetView );
+    DestroyGPUTexture( target );
+}
+
+
+// GPU culling of increasingly many random instances vs the CPU reference, checking both agree on what's visible
+void BenchCulling( int argc, char** argv )
+{
+    u64 maxCount = argc > 0 ? (u64)atoll( argv[0] ) : 10000000;
+    maxCount = Min<u64>( maxCount, globalLimits.maxStorageBufferBindingSize / sizeof(aabb) );
+
+    std::vector<aabb> bounds( maxCount );
+    RandomStream random( 1234 );
+    for( aabb& b : bounds )
+    {
+        b.center = V3( random.GetFloat( -500, 500 ), random.GetFloat( -500, 500 ), random.GetFloat( -500, 500 ) );
+        b.halfSize = V3( random.GetFloat( 0.1f, 2.f ), random.GetFloat( 0.1f, 2.f ), random.GetFloat( 0.1f, 2.f ) );
+    }
+
+    m4 view = M4CameraLookAt( V3Zero, V3( 1.f, 0.f, 0.f ), V3Up );
+    m4 proj = M4Perspective( 16.f / 9.f, 60.f );
+
+    WGPUCommandEncoderDescriptor encoderDesc = {};
+    encoderDesc.nextInChain                  = nullptr;
+    encoderDesc.label                        = "Culling test";
+    WGPUCommandBufferDescriptor cmdBufferDescriptor = {};
+    cmdBufferDescriptor.nextInChain                 = nullptr;
+    cmdBufferDescriptor.label                       = "Culling test";
+
+    std::vector<u32> cpuVisible, gpuVisible;
+    for( u64 count = 10000; count <= maxCount; count *= 10 )
+    {
+        InstanceCulling culling = {};
+        culling.enabled = true;
+        SetInstanceBounds( &culling, bounds.data(), (u32)count );
+        SetCullingCamera( &culling, proj * view );
+        if( !culling.instanceCount )
+        {
+            Log( "ERROR :: Couldn't create culling buffers for %llu instances", (unsigned long long)count );
+            break;
+        }
+
+        u64 iterations64 = 100000000 / count;
+        Clamp<u64>( &iterations64, 5, 100 );
+        int iterations = (int)iterations64;
+
+        f64 start = Platform::CurrentTimeMillis();
+        for( int i = 0; i < iterations; ++i )
+            CullInstancesCPU( bounds.data(), (u32)count, culling.planes, &cpuVisible );
+        f64 cpuMillis = (Platform::CurrentTimeMillis() - start) / iterations;
+
+        // One extra frame to warm up (and upload the bounds)
+        f64 gpuMillis = 0;
+        for( int i = -1; i < iterations; ++i )
+        {
+            start = Platform::CurrentTimeMillis();
+
+            WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder( globalDevice, &encoderDesc );
+            WriteCullingParams( &culling, 36, culling.planes );
+            FlushStagingBelt( &globalStagingBelt, encoder );
+            EncodeInstanceCulling( encoder, &culling );
+            WGPUCommandBuffer command = wgpuCommandEncoderFinish( encoder, &cmdBufferDescriptor );
+            wgpuQueueSubmit( globalQueue, 1, &command );
+#ifdef WEBGPU_BACKEND_DAWN
+            wgpuCommandEncoderRelease( encoder );
+            wgpuCommandBufferRelease( command );
+#endif
+            RecallStagingBelt( &globalStagingBelt );
+            WaitForGPU();
+
+            if( i >= 0 )
+                gpuMillis += Platform::CurrentTimeMillis() - start;
+        }
+        gpuMillis /= iterations;
+
+        // Visible indices come out in whatever order workgroups finish, so sort them before comparing
+        DrawIndirectArgs args = {};
+        bool valid = ReadbackBuffer( GetResource( culling.argsBuffer ), 0, sizeof(args), &args );
+        gpuVisible.resize( args.instanceCount );
+        valid = valid && args.instanceCount <= count
+            && (!args.instanceCount || ReadbackBuffer( GetResource( culling.visibleBuffer ), 0,
+                                                       args.instanceCount * sizeof(u32), gpuVisible.data() ));
+        std::sort( gpuVisible.begin(), gpuVisible.end() );
+        valid = valid && gpuVisible == cpuVisible;
+
+        Log( "%9llu instances, %8llu visible:  CPU %8.3f ms  |  GPU %8.3f ms  |  %6.2fx  %s",
+             (unsigned long long)count, (unsigned long long)cpuVisible.size(), cpuMillis, gpuMillis,
+             cpuMillis / gpuMillis, valid ? "" : "MISMATCH" );
+        if( !valid )
+            Log( "ERROR :: GPU culling found %u visible instances, expected %llu",
+                 args.instanceCount, (unsigned long long)cpuVisible.size() );
+
+        ReleaseInstanceCulling( &culling );
+        EndResourceFrame();
+    }
+}
+
+// Boxes per nanosecond culled on the CPU: scalar IsInFrustum vs SIMD over SoA bounds, on one and several threads
+void BenchBatchCulling( int argc, char** argv )
+{
+    u32 count = argc > 0 ? (u32)atoll( argv[0] ) : 4 * 1024 * 1024;
+    int iterations = argc > 1 ? atoi( argv[1] ) : 20;
+    int maxThreads = GetWorkerCount();
+
+    std::vector<aabb> bounds( count );
+    RandomStream random( 1234 );
+    for( aabb& b : bounds )
+    {
+        b.center = V3( random.GetFloat( -500, 500 ), random.GetFloat( -500, 500 ), random.GetFloat( -500, 500 ) );
+        b.halfSize = V3( random.GetFloat( 0.1f, 2.f ), random.GetFloat( 0.1f, 2.f ), random.GetFloat( 0.1f, 2.f ) );
+    }
+    BoundsSoA soa;
+    SetBoundsSoA( &soa, bounds.data(), count );
+
+    m4 view = M4CameraLookAt( V3Zero, V3( 1.f, 0.f, 0.f ), V3Up );
+    m4 proj = M4Perspective( 16.f / 9.f, 60.f );
+    v4 planes[6];
+    FrustumPlanes( proj * view, planes );
+
+    std::vector<u32> reference, visible;
+    f64 start = Platform::CurrentTimeMillis();
+    for( int i = 0; i < iterations; ++i )
+        CullInstancesCPU( bounds.data(), count, planes, &reference );
+    f64 scalarNanos = (Platform::CurrentTimeMillis() - start) * 1000000.0 / iterations;
+    Log( "%u boxes, %zu visible, %d wide SIMD", count, reference.size(), SimdWidth );
+    Log( "scalar:              %8.3f ms  %7.3f boxes/ns", scalarNanos / 1000000.0, count / scalarNanos );
+
+    visible.resize( count );
+    start = Platform::CurrentTimeMillis();
+    u32 visibleCount = 0;
+    for( int i = 0; i < iterations; ++i )
+        visibleCount = CullBoundsSIMD( soa, planes, 0, count, visible.data() );
+    f64 simdNanos = (Platform::CurrentTimeMillis() - start) * 1000000.0 / iterations;
+    visible.resize( visibleCount );
+    Log( "SIMD:                %8.3f ms  %7.3f boxes/ns  %6.2fx  %s", simdNanos / 1000000.0, count / simdNanos,
+         scalarNanos / simdNanos, visible == reference ? "" : "MISMATCH" );
+
+    for( int threadCount = 1; threadCount <= maxThreads; threadCount *= 2 )
+    {
+        start = Platform::CurrentTimeMillis();
+        for( int i = 0; i < iterations; ++i )
+            CullBoundsParallel( soa, planes, &visible, threadCount );
+        f64 nanos = (Platform::CurrentTimeMillis() - start) * 1000000.0 / iterations;
+        Log( "SIMD, %3d threads:   %8.3f ms  %7.3f boxes/ns  %6.2fx  %s", threadCount, nanos / 1000000.0, count / nanos,
+             scalarNanos / nanos, visible == reference ? "" : "MISMATCH" );
+    }
+}
+
+// Per call cost of the core v4 / m4 / qn ops, over arrays of random inputs so nothing can be hoisted out of the loops.
+// Build with MATH_SCALAR to compare against the plain scalar code (the checksums should match closely)
+void BenchMath( int argc, char** argv )
+{
+    int iterations = argc > 0 ? atoi( argv[0] ) : 2000;
+    constexpr int Count = 1024;
+
+    RandomStream random( 1234 );
+    auto RandomV3 = [&random]( f32 range )
+    {
+        return V3( random.GetFloat( -range, range ), random.GetFloat( -range, range ), random.GetFloat( -range, range ) );
+    };
+    auto RandomAxis = [&]()
+    {
+        return Normalized( RandomV3( 1.f ) + V3( 0.f, 0.f, 0.01f ) );
+    };
+
+    std::vector<m4> matrices( Count ), matrixResults( Count );
+    std::vector<v4> vectors( Count ), vectorResults( Count );
+    std::vector<v3> points( Count ), targets( Count ), pointResults( Count );
+    std::vector<qn> quats( Count ), quatResults( Count );
+    for( int i = 0; i < Count; ++i )
+    {
+        matrices[i] = M4AxisAngle( RandomAxis(), random.GetFloat( 0, PI ) ) * M4Scale( V3( random.GetFloat( 0.5f, 2.f ), random.GetFloat( 0.5f, 2.f ), random.GetFloat( 0.5f, 2.f ) ) );
+        SetTranslation( matrices[i], RandomV3( 100.f ) );
+        points[i] = RandomV3( 100.f );
+        targets[i] = RandomV3( 100.f );
+        vectors[i] = V4( points[i], 1.f );
+        quats[i] = Qn( RandomAxis(), random.GetFloat( 0, PI ) );
+    }
+
+    f64 checksum = 0;
+    auto Time = [&]( char const* name, auto&& func, auto&& sum )
+    {
+        f64 start = Platform::CurrentTimeMillis();
+        for( int it = 0; it < iterations; ++it )
+            for( int i = 0; i < Count; ++i )
+                func( i );
+        f64 nanos = (Platform::CurrentTimeMillis() - start) * 1000000.0 / ((f64)iterations * Count);
+
+        f64 total = 0;
+        for( int i = 0; i < Count; ++i )
+            total += sum( i );
+        checksum += total;
+        Log( "  %-20s %8.2f ns    checksum %.6g", name, nanos, total );
+    };
+    auto SumM4 = [&]( int i ) { f64 t = 0; for( int e = 0; e < 16; ++e ) t += matrixResults[i].e[e / 4][e % 4]; return t; };
+    auto SumV4 = [&]( int i ) { return (f64)vectorResults[i].x + vectorResults[i].y + vectorResults[i].z + vectorResults[i].w; };
+    auto SumV3 = [&]( int i ) { return (f64)pointResults[i].x + pointResults[i].y + pointResults[i].z; };
+    auto SumQn = [&]( int i ) { return (f64)quatResults[i].x + quatResults[i].y + quatResults[i].z + quatResults[i].w; };
+
+#if MATH_SIMD
+    Log( "SSE math, %d calls per op", iterations * Count );
+#else
+    Log( "Scalar math, %d calls per op", iterations * Count );
+#endif
+    Time( "m4 * m4", [&]( int i ) { matrixResults[i] = matrices[i] * matrices[(i + 1) % Count]; }, SumM4 );
+    Time( "m4 * v4", [&]( int i ) { vectorResults[i] = matrices[i] * vectors[i]; }, SumV4 );
+    Time( "m4 * v3", [&]( int i ) { pointResults[i] = matrices[i] * points[i]; }, SumV3 );
+    Time( "Transposed", [&]( int i ) { matrixResults[i] = Transposed( matrices[i] ); }, SumM4 );
+    Time( "Inverse", [&]( int i ) { Inverse( matrices[i], &matrixResults[i] ); }, SumM4 );
+    Time( "M4CameraLookAt", [&]( int i ) { matrixResults[i] = M4CameraLookAt( points[i], targets[i], V3Up ); }, SumM4 );
+    Time( "qn * qn", [&]( int i ) { quatResults[i] = quats[i] * quats[(i + 1) % Count]; }, SumQn );
+    Time( "Slerp", [&]( int i ) { quatResults[i] = Slerp( quats[i], quats[(i + 1) % Count], (f32)i / Count ); }, SumQn );
+    Time( "ToM4", [&]( int i ) { matrixResults[i] = ToM4( quats[i] ); }, SumM4 );
+
+    // Sanity check the inverse, as it's the one with the least obvious code
+    f32 maxError = 0.f;
+    for( int i = 0; i < Count; ++i )
+    {
+        m4 identity = matrices[i] * Inverse( matrices[i] );
+        for( int e = 0; e < 16; ++e )
+            maxError = Max( maxError, Abs( identity.e[e / 4][e % 4] - M4Identity.e[e / 4][e % 4] ) );
+    }
+    Log( "checksum %.6g, max M * Inverse( M ) error %g %s", checksum, maxError, maxError > 1e-4f ? "MISMATCH" : "" );
+}
+
+// Largest stream the per-element matrix and v4 variants run with, as their inputs alone take 5 to 9 times the memory
+constexpr u64 TransformBenchMaxFullCount = 10000000;
+
+// Worst difference between a SIMD result and the scalar reference, relative to the magnitude of the reference
+template <typename Get>
+f32 MaxTransformError( u32 count, Get&& get )
+{
+    f32 maxError = 0.f;
+    for( u32 i = 0; i < count; ++i )
+    {
+        v4 expected, actual;
+        get( i, &expected, &actual );
+        v4 d = actual - expected;
+        f32 error = Max( Max( Abs( d.x ), Abs( d.y ) ), Max( Abs( d.z ), Abs( d.w ) ) );
+        f32 scale = 1.f + Max( Max( Abs( expected.x ), Abs( expected.y ) ), Max( Abs( expected.z ), Abs( expected.w ) ) );
+        maxError = Max( maxError, error / scale );
+    }
+    return maxError;
+}
+
+// Scalar m4 * v3 over AoS arrays against the SoA and AoSoA batch kernels, for streams of increasing size
+void BenchTransform( int argc, char** argv )
+{
+    u64 maxCount = argc > 0 ? (u64)atoll( argv[0] ) : 100000000;
+    // Elements to go through per measurement, so small streams get more iterations
+    u64 workPerRun = argc > 1 ? (u64)atoll( argv[1] ) : 100000000;
+    int maxThreads = GetWorkerCount();
+
+    RandomStream random( 1234 );
+    m4 m = M4AxisAngle( Normalized( V3( 1.f, 2.f, 3.f ) ), 0.7f ) * M4Scale( V3( 2.f, 0.5f, 1.5f ) );
+    SetTranslation( m, V3( 10.f, -20.f, 30.f ) );
+    m4 projView = M4Perspective( 16.f / 9.f, 60.f ) * M4CameraLookAt( V3( 0.f, -100.f, 50.f ), V3Zero, V3Up );
+
+    Log( "%d wide SIMD, up to %d threads", SimdWidth, maxThreads );
+    for( u64 count64 = 1000; count64 <= maxCount; count64 *= 10 )
+    {
+        u32 count = (u32)count64;
+        int iterations = (int)Max<u64>( 1, workPerRun / count64 );
+        auto NoCheck = []() { return 0.f; };
+        // Results are checked against the scalar reference after timing
+        auto Time = [iterations, count]( char const* name, f64 scalarNanos, auto&& func, auto&& check )
+        {
+            f64 start = Platform::CurrentTimeMillis();
+            for( int i = 0; i < iterations; ++i )
+                func();
+            f64 nanos = (Platform::CurrentTimeMillis() - start) * 1000000.0 / iterations;
+            f32 error = check();
+            Log( "  %-28s %9.3f ms  %7.3f elems/ns  %6.2fx  %s", name, nanos / 1000000.0, count / nanos,
+                 scalarNanos > 0 ? scalarNanos / nanos : 1.0, error > 1e-5f ? "MISMATCH" : "" );
+            return nanos;
+        };
+
+        std::vector<v3> points( count );
+        for( v3& p : points )
+            p = V3( random.GetFloat( -500, 500 ), random.GetFloat( -500, 500 ), random.GetFloat( -500, 500 ) );
+        Log( "%u elements, %d iterations", count, iterations );
+
+        std::vector<v3> reference( count );
+        f64 scalarNanos = Time( "scalar m4 * v3", 0, [&]()
+        {
+            for( u32 i = 0; i < count; ++i )
+                reference[i] = m * points[i];
+        }, NoCheck );
+
+        {
+            V3SoA in, out;
+            SetV3SoA( &in, points.data(), count );
+            ResizeV3SoA( &out, count );
+            auto Error = [&]()
+            {
+                return MaxTransformError( count, [&]( u32 i, v4* expected, v4* actual )
+                {
+                    *expected = V4( reference[i], 0.f );
+                    *actual = V4( GetV3SoA( out, i ), 0.f );
+                } );
+            };
+
+            Time( "SoA points", scalarNanos, [&]() { TransformSoA( m, 1.f, in, &out, 0, count ); }, Error );
+            for( int threadCount = 2; threadCount <= maxThreads; threadCount *= 2 )
+            {
+                char name[64];
+                snprintf( name, sizeof(name), "SoA points, %d threads", threadCount );
+                Time( name, scalarNanos, [&]() { TransformPointsSoA( m, in, &out, threadCount ); }, Error );
+            }
+        }
+
+        {
+            V3AoSoA in, out;
+            SetV3AoSoA( &in, points.data(), count );
+            auto Error = [&]()
+            {
+                return MaxTransformError( count, [&]( u32 i, v4* expected, v4* actual )
+                {
+                    *expected = V4( reference[i], 0.f );
+                    *actual = V4( GetV3AoSoA( out, i ), 0.f );
+                } );
+            };
+
+            Time( "AoSoA points", scalarNanos, [&]() { TransformPointsAoSoA( m, in, &out, 1 ); }, Error );
+            Time( "AoSoA points, all threads", scalarNanos, [&]() { TransformPointsAoSoA( m, in, &out, maxThreads ); }, Error );
+        }
+
+        if( count64 > TransformBenchMaxFullCount )
+            continue;
+
+        {
+            std::vector<m4> matrices( count );
+            for( m4& pm : matrices )
+            {
+                pm = M4AxisAngle( Normalized( V3( random.GetFloat( -1, 1 ), random.GetFloat( -1, 1 ), 1.f ) ), random.GetFloat( 0, PI ) );
+                SetTranslation( pm, V3( random.GetFloat( -10, 10 ), random.GetFloat( -10, 10 ), random.GetFloat( -10, 10 ) ) );
+            }
+            f64 perElementScalarNanos = Time( "scalar per-element m4 * v3", 0, [&]()
+            {
+                for( u32 i = 0; i < count; ++i )
+                    reference[i] = matrices[i] * points[i];
+            }, NoCheck );
+
+            AffineSoA affine;
+            SetAffineSoA( &affine, matrices.data(), count );
+            V3SoA in, out;
+            SetV3SoA( &in, points.data(), count );
+            auto Error = [&]()
+            {
+                return MaxTransformError( count, [&]( u32 i, v4* expected, v4* actual )
+                {
+                    *expected = V4( reference[i], 0.f );
+                    *actual = V4( GetV3SoA( out, i ), 0.f );
+                } );
+            };
+            Time( "SoA per-element", perElementScalarNanos, [&]() { TransformPointsSoA( affine, in, &out, 1 ); }, Error );
+            Time( "SoA per-element, all threads", perElementScalarNanos, [&]() { TransformPointsSoA( affine, in, &out, maxThreads ); }, Error );
+        }
+
+        {
+            std::vector<v4> points4( count ), reference4( count );
+            for( u32 i = 0; i < count; ++i )
+                points4[i] = V4( points[i], 1.f );
+            f64 v4ScalarNanos = Time( "scalar m4 * v4", 0, [&]()
+            {
+                for( u32 i = 0; i < count; ++i )
+                    reference4[i] = projView * points4[i];
+            }, NoCheck );
+
+            V4SoA in, out;
+            SetV4SoA( &in, points4.data(), count );
+            auto Error = [&]()
+            {
+                return MaxTransformError( count, [&]( u32 i, v4* expected, v4* actual )
+                {
+                    *expected = reference4[i];
+                    *actual = GetV4SoA( out, i );
+                } );
+            };
+            Time( "SoA v4", v4ScalarNanos, [&]() { TransformV4SoA( projView, in, &out, 1 ); }, Error );
+            Time( "SoA v4, all threads", v4ScalarNanos, [&]() { TransformV4SoA( projView, in, &out, maxThreads ); }, Error );
+        }
+    }
+}
+
+// World matrix updates of a big random hierarchy, with a varying share of nodes animated each frame
+void BenchHierarchy( int argc, char** argv )
+{
+    u32 nodeCount = argc > 0 ? (u32)atoll( argv[0] ) : 1000000;
+    int frameCount = argc > 1 ? atoi( argv[1] ) : 10;
+    int maxThreads = GetWorkerCount();
+    constexpr int MaxDepth = 16;
+
+    RandomStream random( 1234 );
+    auto RandomRotation = [&random]()
+    {
+        return Qn( Normalized( V3( random.GetFloat( -1, 1 ), random.GetFloat( -1, 1 ), 1.f ) ), random.GetFloat( 0, PI ) );
+    };
+
+    // Build in depth-first order, picking each parent among the ancestors of the last node so everything is appended
+    TransformHierarchy h;
+    std::vector<u32> path;
+    f64 start = Platform::CurrentTimeMillis();
+    for( u32 i = 0; i < nodeCount; ++i )
+    {
+        int depth = path.empty() ? -1 : random.GetInt( -1, (int)path.size() );
+        if( depth == (int)path.size() - 1 && depth + 1 >= MaxDepth )
+            depth--;
+        path.resize( depth + 1 );
+        u32 parent = depth < 0 ? TransformNoParent : path.back();
+        v3 position = V3( random.GetFloat( -10, 10 ), random.GetFloat( -10, 10 ), random.GetFloat( -10, 10 ) );
+        path.push_back( AddTransformNode( &h, parent, position, RandomRotation(), V3( 1.f, 1.f, 1.f ) ) );
+    }
+    Log( "Built %u nodes in %.3f ms", nodeCount, Platform::CurrentTimeMillis() - start );
+
+    for( int threadCount = 1; threadCount <= maxThreads; threadCount *= 2 )
+    {
+        for( u32 i = 0; i < nodeCount; ++i )
+            MarkTransformDirty( &h, i );
+        start = Platform::CurrentTimeMillis();
+        u32 updated = UpdateWorldTransforms( &h, threadCount );
+        Log( "Full update, %2d threads:  %8.3f ms  (%u nodes)", threadCount, Platform::CurrentTimeMillis() - start, updated );
+    }
+
+    f32 fractions[] = { 0.0001f, 0.001f, 0.01f, 0.1f, 1.f };
+    for( f32 fraction : fractions )
+    {
+        u32 changedCount = Max( 1u, (u32)(nodeCount * fraction) );
+        for( int threadCount = 1; threadCount <= maxThreads; threadCount *= 2 )
+        {
+            f64 totalMillis = 0;
+            u64 totalUpdated = 0;
+            for( int frame = 0; frame < frameCount; ++frame )
+            {
+                for( u32 c = 0; c < changedCount; ++c )
+                    SetLocalRotation( &h, (u32)(random.GetBigInt() % nodeCount), RandomRotation() );
+
+                start = Platform::CurrentTimeMillis();
+                totalUpdated += UpdateWorldTransforms( &h, threadCount );
+                totalMillis += Platform::CurrentTimeMillis() - start;
+            }
+            Log( "%7u changed, %2d threads:  %8.3f ms  (%llu nodes updated per frame)", changedCount, threadCount,
+                 totalMillis / frameCount, totalUpdated / frameCount );
+        }
+    }
+
+    // Everything should match a plain recompute of the whole hierarchy
+    std::vector<m4> incremental = h.worldMatrices;
+    for( u32 i = 0; i < nodeCount; ++i )
+        UpdateWorldTransform( &h, i );
+    f32 maxError = 0.f;
+    for( u32 i = 0; i < nodeCount; ++i )
+        for( int e = 0; e < 16; ++e )
+            maxError = Max( maxError, Abs( incremental[i].e[e / 4][e % 4] - h.worldMatrices[i].e[e / 4][e % 4] ) );
+    Log( "Max difference against a full recompute: %g %s", maxError, maxError > 0.f ? "MISMATCH" : "" );
+}
+
+// Trace a camera's worth of rays over a BVH, either one at a time or in packets of F's width
+template <typename F>
+f64 TraceBVHImage( BVH const& bvh, v3 eye, v3 target, int imageSize, std::vector<RayHit>* hits )
+{
+    constexpr int Width = SimdLanes<F>::width;
+    // Square-ish tiles of pixels per packet, so rays stay coherent
+    constexpr int TileWidth = Width == 4 ? 2 : 4;
+    constexpr int TileHeight = Width / TileWidth;
+
+    v3 forward = Normalized( target - eye );
+    v3 right = Normalized( Cross( forward, V3Up ) );
+    v3 up = Cross( right, forward );
+    f32 tanHalfFov = tanf( Radians( 60.f ) * 0.5f );
+    auto RayDir = [&]( int x, int y )
+    {
+        f32 px = ((x + 0.5f) / imageSize * 2.f - 1.f) * tanHalfFov;
+        f32 py = (1.f - (y + 0.5f) / imageSize * 2.f) * tanHalfFov;
+        return Normalized( forward + px * right + py * up );
+    };
+
+    hits->resize( (sz)imageSize * imageSize );
+    f64 start = Platform::CurrentTimeMillis();
+    for( int y = 0; y < imageSize; y += TileHeight )
+    {
+        for( int x = 0; x < imageSize; x += TileWidth )
+        {
+            RayPacket<F> packet;
+            for( int i = 0; i < Width; ++i )
+            {
+                v3 d = RayDir( x + i % TileWidth, y + i / TileWidth );
+                packet.ox[i] = eye.x;
+                packet.oy[i] = eye.y;
+                packet.oz[i] = eye.z;
+                packet.dx[i] = d.x;
+                packet.dy[i] = d.y;
+                packet.dz[i] = d.z;
+            }
+
+            RayHit packetHits[Width];
+            IntersectBVHPacket<F>( bvh, packet, packetHits );
+            for( int i = 0; i < Width; ++i )
+                (*hits)[(sz)(y + i / TileWidth) * imageSize + x + i % TileWidth] = packetHits[i];
+        }
+    }
+    return Platform::CurrentTimeMillis() - start;
+}
+
+// BVH build time and tracing speed with single rays and packets, over heightfield meshes of increasing size
+void BenchBVH( int argc, char** argv )
+{
+    u64 maxTris = argc > 0 ? (u64)atoll( argv[0] ) : 10000000;
+    int imageSize = argc > 1 ? atoi( argv[1] ) : 512;
+    imageSize = AlignUp( Max( imageSize, 4 ), 4 );
+    f64 rayCount = (f64)imageSize * imageSize;
+
+    for( u64 targetTris = 10000; targetTris <= maxTris; targetTris *= 10 )
+    {
+        std::vector<tri> tris;
+        MakeWavesHeightfield( (int)sqrt( targetTris / 2.0 ) + 1, &tris );
+
+        BVH bvh;
+        f64 start = Platform::CurrentTimeMillis();
+        BuildBVH( tris.data(), (u32)tris.size(), &bvh );
+        f64 buildMillis = Platform::CurrentTimeMillis() - start;
+
+        v3 eye = V3( 0.f, -0.9f, 0.5f );
+        v3 target = V3Zero;
+        v3 forward = Normalized( target - eye );
+        v3 right = Normalized( Cross( forward, V3Up ) );
+        v3 up = Cross( right, forward );
+        f32 tanHalfFov = tanf( Radians( 60.f ) * 0.5f );
+
+        std::vector<RayHit> singleHits( (sz)imageSize * imageSize );
+        start = Platform::CurrentTimeMillis();
+        for( int y = 0; y < imageSize; ++y )
+        {
+            for( int x = 0; x < imageSize; ++x )
+            {
+                f32 px = ((x + 0.5f) / imageSize * 2.f - 1.f) * tanHalfFov;
+                f32 py = (1.f - (y + 0.5f) / imageSize * 2.f) * tanHalfFov;
+                ray r = { eye, Normalized( forward + px * right + py * up ) };
+                IntersectBVH( bvh, r, &singleHits[(sz)y * imageSize + x] );
+            }
+        }
+        f64 singleMillis = Platform::CurrentTimeMillis() - start;
+
+        std::vector<RayHit> hits4, hits8;
+        f64 millis4 = TraceBVHImage<__m128>( bvh, eye, target, imageSize, &hits4 );
+#if SIMD_AVX2
+        f64 millis8 = TraceBVHImage<__m256>( bvh, eye, target, imageSize, &hits8 );
+#else
+        f64 millis8 = 0;
+#endif
+
+        // Different evaluation order can flip hits right on shared edges, so just count how many disagree
+        int mismatches4 = 0, mismatches8 = 0;
+        for( sz i = 0; i < (sz)singleHits.size(); ++i )
+        {
+            mismatches4 += hits4[i].triIndex != singleHits[i].triIndex;
+            if( !hits8.empty() )
+                mismatches8 += hits8[i].triIndex != singleHits[i].triIndex;
+        }
+
+        Log( "%9zu tris, %8zu nodes:  build %8.1f ms  |  single %7.2f Mrays/s  |  packet4 %7.2f Mrays/s (%d off)"
+             "  |  packet8 %7.2f Mrays/s (%d off)",
+             tris.size(), bvh.nodes.size(), buildMillis, rayCount / (singleMillis * 1000.0),
+             rayCount / (millis4 * 1000.0), mismatches4, millis8 ? rayCount / (millis8 * 1000.0) : 0.0, mismatches8 );
+    }
+}
+
+// GPU ray tracing throughput over heightfields of increasing size, with each node format
+void BenchRayTracing( int argc, char** argv )
+{
+    u64 maxTris = argc > 0 ? (u64)atoll( argv[0] ) : 10000000;
+    u32 imageSize = argc > 1 ? (u32)atoi( argv[1] ) : 1024;
+    int frameCount = argc > 2 ? atoi( argv[2] ) : 20;
+    f64 rayCount = (f64)imageSize * imageSize;
+
+    WGPUCommandEncoderDescriptor encoderDesc = {};
+    encoderDesc.nextInChain                  = nullptr;
+    encoderDesc.label                        = "Ray tracing test";
+    WGPUCommandBufferDescriptor cmdBufferDescriptor = {};
+    cmdBufferDescriptor.nextInChain                 = nullptr;
+    cmdBufferDescriptor.label                       = "Ray tracing test";
+
+    for( u64 targetTris = 10000; targetTris <= maxTris; targetTris *= 10 )
+    {
+        std::vector<tri> tris;
+        MakeWavesHeightfield( (int)sqrt( targetTris / 2.0 ) + 1, &tris );
+        BVH bvh;
+        BuildBVH( tris.data(), (u32)tris.size(), &bvh );
+
+        for( int f = 0; f < (int)GPUBVHFormat::Count; ++f )
+        {
+            GPUBVHFormat format = (GPUBVHFormat)f;
+            RayTracing tracing = {};
+            if( !ResizeRayTracingOutput( &tracing, imageSize, imageSize ) )
+                break;
+            SetRayTracedScene( &tracing, bvh, format );
+            SetRayTracingCamera( &tracing, V3( 0.f, -0.9f, 0.5f ), V3Zero, 60.f, 1.f );
+            if( !tracing.nodeCount )
+            {
+                Log( "ERROR :: Couldn't upload a BVH with %zu triangles", tris.size() );
+                ReleaseRayTracing( &tracing );
+                break;
+            }
+
+            // One extra frame to warm up (and upload the scene)
+            f64 start = 0;
+            for( int frame = -1; frame < frameCount; ++frame )
+            {
+                if( frame == 0 )
+                {
+                    WaitForGPU();
+                    start = Platform::CurrentTimeMillis();
+                }
+
+                WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder( globalDevice, &encoderDesc );
+                WriteRayTracingParams( &tracing, tracing.params );
+                FlushStagingBelt( &globalStagingBelt, encoder );
+                EncodeRayTracing( encoder, &tracing );
+                WGPUCommandBuffer command = wgpuCommandEncoderFinish( encoder, &cmdBufferDescriptor );
+                wgpuQueueSubmit( globalQueue, 1, &command );
+#ifdef WEBGPU_BACKEND_DAWN
+                wgpuCommandEncoderRelease( encoder );
+                wgpuCommandBufferRelease( command );
+#endif
+                RecallStagingBelt( &globalStagingBelt );
+            }
+            WaitForGPU();
+            f64 millis = (Platform::CurrentTimeMillis() - start) / frameCount;
+
+            u64 nodeSize = format == GPUBVHFormat::Quantized ? sizeof(GPUBVHNodeQuantized) : sizeof(BVHNode);
+            Log( "%9zu tris, %-9s nodes (%7.1f MB):  %8.3f ms/frame  %8.1f Mrays/s",
+                 tris.size(), GPUBVHFormatNames[f], bvh.nodes.size() * nodeSize / (1024.0 * 1024.0),
+                 millis, rayCount / (millis * 1000.0) );
+
+            ReleaseRayTracing( &tracing );
+            EndResourceFrame();
+        }
+    }
+}
+
+struct SpinJobData
+{
+    u32 iterations;
+    u32* results;
+};
+
+// Dependent integer ops the compiler can't fold away, as a stand-in for real work of a given length
+INLINE u32 SpinWork( u32 seed, u32 iterations )
+{
+    u32 x = seed | 1;
+    for( u32 i = 0; i < iterations; ++i )
+        x = NextRandom( &x ) + i;
+    return x;
+}
+
+void SpinJob( Job const& job )
+{
+    SpinJobData const* data = (SpinJobData const*)job.data;
+    data->results[job.begin] = SpinWork( (u32)job.begin, data->iterations );
+}
+
+void SetFlagJob( Job const& job )
+{
+    ((std::atomic<bool>*)job.data)->store( true, std::memory_order_release );
+}
+
+// Runs jobCount jobs of the given length in batches small enough to always fit a worker's queue,
+// and returns how long it took in ms
+f64 RunSpinJobs( int jobCount, u32 iterations, std::vector<Job>* jobs, std::vector<u32>* results )
+{
+    SpinJobData data = { iterations, results->data() };
+    jobs->resize( jobCount );
+    for( int i = 0; i < jobCount; ++i )
+        (*jobs)[i] = { SpinJob, &data, (sz)i, (sz)i + 1, nullptr };
+
+    constexpr int batchSize = (int)JobQueueCapacity / 2;
+    f64 start = Platform::CurrentTimeMillis();
+    for( int first = 0; first < jobCount; first += batchSize )
+    {
+        JobCounter counter = {};
+        SubmitJobs( jobs->data() + first, Min( batchSize, jobCount - first ), &counter );
+        WaitForCounter( &counter );
+    }
+    return Platform::CurrentTimeMillis() - start;
+}
+
+// Job throughput and scaling as workers are added, for tiny (~1us) jobs where scheduling overhead dominates
+// and for coarse (~1ms) ones where it shouldn't matter
+void BenchJobs( int argc, char** argv )
+{
+    int fineJobCount = argc > 0 ? atoi( argv[0] ) : 200000;
+    int maxWorkers = argc > 1 ? atoi( argv[1] ) : Platform::GetUsableCoreCount();
+    int coarseJobCount = 256;
+
+    // Calibrate the spin loop against the clock, on this thread alone
+    u32 calibrationIterations = 10000000;
+    f64 start = Platform::CurrentTimeMillis();
+    u32 sink = SpinWork( 1, calibrationIterations );
+    f64 nanosPerIteration = (Platform::CurrentTimeMillis() - start) * 1000000.0 / calibrationIterations;
+    u32 fineIterations = Max( 1u, (u32)(1000.0 / nanosPerIteration) );
+    u32 coarseIterations = Max( 1u, (u32)(1000000.0 / nanosPerIteration) );
+    Log( "Spin loop: %.2f ns per iteration (%u), %u iterations for 1us jobs", nanosPerIteration, sink & 1, fineIterations );
+
+    std::vector<u32> expectedFine( fineJobCount ), expectedCoarse( coarseJobCount );
+    for( int i = 0; i < fineJobCount; ++i )
+        expectedFine[i] = SpinWork( (u32)i, fineIterations );
+    for( int i = 0; i < coarseJobCount; ++i )
+        expectedCoarse[i] = SpinWork( (u32)i, coarseIterations );
+
+    std::vector<Job> jobs;
+    std::vector<u32> results( Max( fineJobCount, coarseJobCount ) );
+    f64 fineBaseMillis = 0, coarseBaseMillis = 0;
+    for( int workers = 1; workers <= maxWorkers; workers = workers < maxWorkers ? Min( workers * 2, maxWorkers ) : workers + 1 )
+    {
+        ShutdownJobSystem( &globalJobSystem );
+        InitJobSystem( &globalJobSystem, workers );
+
+        f64 fineMillis = RunSpinJobs( fineJobCount, fineIterations, &jobs, &results );
+        bool fineOk = memcmp( results.data(), expectedFine.data(), fineJobCount * sizeof(u32) ) == 0;
+        f64 coarseMillis = RunSpinJobs( coarseJobCount, coarseIterations, &jobs, &results );
+        bool coarseOk = memcmp( results.data(), expectedCoarse.data(), coarseJobCount * sizeof(u32) ) == 0;
+        if( workers == 1 )
+        {
+            fineBaseMillis = fineMillis;
+            coarseBaseMillis = coarseMillis;
+        }
+
+        // A continuation must only run after every job it depends on, and waiting on its own counter covers them all
+        std::atomic<bool> continued = false;
+        Job continuation = { SetFlagJob, &continued, 0, 0, nullptr };
+        JobCounter continuationCounter = {};
+        continuationCounter.pending = 1;
+        continuation.counter = &continuationCounter;
+        JobCounter counter = {};
+        counter.continuation = &continuation;
+        SubmitJobs( jobs.data(), coarseJobCount, &counter );
+        WaitForCounter( &continuationCounter );
+        bool continuationOk = continued.load( std::memory_order_acquire ) && counter.pending.load() == 0;
+
+        Log( "%3d workers:  1us jobs %7.2f Mjobs/s (%5.2fx)  |  1ms jobs %8.1f jobs/s (%5.2fx)  |  %s",
+             workers, fineJobCount / (fineMillis * 1000.0), fineBaseMillis / fineMillis,
+             coarseJobCount / (coarseMillis / 1000.0), coarseBaseMillis / coarseMillis,
+             fineOk && coarseOk && continuationOk ? "ok" : "WRONG RESULTS" );
+    }
+
+    ShutdownJobSystem( &globalJobSystem );
+    InitJobSystem( &globalJobSystem );
+}
+
+// Load every file through the given loader (or synchronously with none) and check what came back.
+// Returns how long it took in ms, or a negative number if anything was wrong
+f64 LoadBenchFiles( FileLoader* loader, std::vector<std::string> const& paths, std::vector<u64> const& checksums )
+{
+    int count = (int)paths.size();
+    FileLoad* loads = new FileLoad[count]();
+    bool valid = true;
+
+    f64 start = Platform::CurrentTimeMillis();
+    if( loader )
+    {
+        for( int i = 0; i < count; ++i )
+        {
+            loads[i].path = paths[i].c_str();
+            // Alternate priorities, just to exercise them
+            loads[i].priority = (FileLoadPriority)(i % (int)FileLoadPriority::Count);
+        }
+        SubmitFileLoads( loads, count, loader );
+        for( int i = 0; i < count; ++i )
+            valid = WaitForFileLoad( &loads[i], loader ) && valid;
+    }
+    else
+    {
+        for( int i = 0; i < count; ++i )
+            loads[i].contents = Platform::ReadEntireFile( paths[i].c_str(), &globalAlloc );
+    }
+    f64 millis = Platform::CurrentTimeMillis() - start;
+
+    for( int i = 0; i < count; ++i )
+    {
+        valid = valid && HashBytes64( loads[i].contents.data, loads[i].contents.length ) == checksums[i];
+        FREE( &globalAlloc, loads[i].contents.data );
+    }
+    delete[] loads;
+
+    return valid ? millis : -1.0;
+}
+
+// Many small files, then a few big ones, read synchronously, by blocking reads on a few threads and through the
+// completion port. Files are written right before, so this mostly measures reads from the OS file cache
+void BenchFileLoading( int argc, char** argv )
+{
+    int smallCount = argc > 0 ? atoi( argv[0] ) : 10000;
+    int bigCount = argc > 1 ? atoi( argv[1] ) : 2;
+    sz bigSize = (argc > 2 ? atoll( argv[2] ) : 1024) * 1024 * 1024;
+    char const* dir = "bench_files";
+    Platform::EnsureDirectoryExists( dir );
+
+    RandomStream random( 1234 );
+    std::vector<std::string> smallPaths, bigPaths;
+    std::vector<u64> smallChecksums, bigChecksums;
+    std::vector<u8> data( Max<sz>( bigSize, 16 * 1024 ) );
+    for( sz i = 0; i < data.size(); ++i )
+        data[i] = (u8)random.GetBigInt();
+
+    for( int i = 0; i < smallCount; ++i )
+    {
+        sz size = 1024 + (sz)random.GetInt( 0, 15 * 1024 );
+        u8 const* contents = data.data() + random.GetInt( 0, 1024 );
+        smallPaths.push_back( std::string( dir ) + "/small" + std::to_string( i ) + ".bin" );
+        smallChecksums.push_back( HashBytes64( contents, size ) );
+        Platform::WriteEntireFile( smallPaths.back().c_str(), contents, size );
+    }
+    for( int i = 0; i < bigCount; ++i )
+    {
+        // Rotate the data a bit so every file is different
+        std::rotate( data.begin(), data.begin() + 4096, data.end() );
+        bigPaths.push_back( std::string( dir ) + "/big" + std::to_string( i ) + ".bin" );
+        bigChecksums.push_back( HashBytes64( data.data(), bigSize ) );
+        Platform::WriteEntireFile( bigPaths.back().c_str(), data.data(), bigSize );
+    }
+    data = std::vector<u8>();
+
+    FileLoader threadLoader = {}, portLoader = {};
+    InitFileLoader( &threadLoader, FileLoaderMode::Threads );
+    InitFileLoader( &portLoader, FileLoaderMode::Auto );
+    struct Method
+    {
+        char const* name;
+        FileLoader* loader;
+    } methods[] =
+    {
+        { "synchronous", nullptr },
+        { "threads", &threadLoader },
+        { portLoader.port ? "completion port" : "threads (no port)", &portLoader },
+    };
+
+    for( Method const& method : methods )
+    {
+        f64 smallMillis = LoadBenchFiles( method.loader, smallPaths, smallChecksums );
+        f64 bigMillis = LoadBenchFiles( method.loader, bigPaths, bigChecksums );
+        Log( "%-17s:  %6d small files %8.1f ms (%8.0f files/s)  |  %d x %lld MB %8.1f ms (%7.1f MB/s)  |  %s",
+             method.name, smallCount, smallMillis, smallCount / (smallMillis / 1000.0), bigCount, bigSize / (1024 * 1024),
+             bigMillis, bigCount * (bigSize / (1024.0 * 1024.0)) / (bigMillis / 1000.0),
+             smallMillis >= 0 && bigMillis >= 0 ? "ok" : "WRONG RESULTS" );
+    }
+
+    ShutdownFileLoader( &threadLoader );
+    ShutdownFileLoader( &portLoader );
+    for( std::string const& path : smallPaths )
+        Platform::RemoveFile( path.c_str() );
+    for( std::string const& path : bigPaths )
+        Platform::RemoveFile( path.c_str() );
+}
+
+// What content hashing replaced, kept as the baseline
+u32 Fletchef32( const void* buffer, int len )
+{
+    const u8* data = (u8*)buffer;
+    u32 fletch1 = 0xFFFF;
+    u32 fletch2 = 0xFFFF;
+
+    while( data && len > 0 )
+    {
+        int l = (len <= 360) ? len : 360;
+        len -= l;
+        while( l > 0 )
+        {
+            fletch1 += *data++;
+            fletch2 += fletch1;
+            l--;
+        }
+        fletch1 = (fletch1 & 0xFFFF) + (fletch1 >> 16);
+        fletch2 = (fletch2 & 0xFFFF) + (fletch2 >> 16);
+    }
+    return (fletch2 << 16) | (fletch1 & 0xFFFF);
+}
+
+// Throughput of Fletchef32 and of content hashing (the portable code path, the SIMD one and streaming) from tiny keys
+// to big buffers, checking every path gives the same result
+void BenchHashing( int argc, char** argv )
+{
+    sz maxSize = (argc > 0 ? atoll( argv[0] ) : 1024) * 1024 * 1024;
+    // Each size is hashed over and over until this many bytes have gone through
+    constexpr sz BytesPerRun = 256 * 1024 * 1024;
+    constexpr sz StreamingPieceSize = 4096;
+
+    RandomStream random( 1234 );
+    std::vector<u8> data( Max<sz>( maxSize, 64 * 1024 + 16 ) );
+    for( sz i = 0; i < data.size(); ++i )
+        data[i] = (u8)random.GetBigInt();
+
+    // Compile time hashes have to match too
+    constexpr char const literal[] = "The quick brown fox jumps over the lazy dog, over and over and over again, until it really "
+                                     "gets tired of jumping over that stupid lazy dog";
+    constexpr Hash128 literalHash = HashString128( literal, sizeof(literal) - 1 );
+    bool literalOk = literalHash == HashBytes128( literal, sizeof(literal) - 1 ) && HashLiteral( "ab" ) == HashBytes64( "ab", 2 );
+#if SIMD_AVX2
+    Log( "AVX2 hashing. Compile time hashes %s", literalOk ? "ok" : "WRONG RESULTS" );
+#else
+    Log( "SSE2 hashing. Compile time hashes %s", literalOk ? "ok" : "WRONG RESULTS" );
+#endif
+
+    u64 sink = 0;
+    for( sz size = 16; size <= maxSize; size *= 4 )
+    {
+        sz iterations = Max<sz>( BytesPerRun / size, 1 );
+        // Small inputs move around a bit, so nothing can be hoisted out of the loop
+        auto Input = [&]( sz it ) { return data.data() + (size < 64 * 1024 ? (it * 64) & 0xFFFF : 0); };
+        auto Time = [&]( auto&& func )
+        {
+            f64 start = Platform::CurrentTimeMillis();
+            for( sz it = 0; it < iterations; ++it )
+                sink += func( Input( it ) );
+            f64 seconds = (Platform::CurrentTimeMillis() - start) / 1000.0;
+            return (f64)size * iterations / (seconds * 1024.0 * 1024.0 * 1024.0);
+        };
+        auto Stream = [&]( u8 const* p, sz pieceSize )
+        {
+            HashState state;
+            BeginHash( &state );
+            for( sz offset = 0; offset < size; offset += pieceSize )
+                UpdateHash( &state, p + offset, Min( pieceSize, size - offset ) );
+            return FinishHash( &state );
+        };
+
+        f64 fletcher = Time( [&]( u8 const* p ) { return (u64)Fletchef32( p, (int)size ); } );
+        f64 portable = Time( [&]( u8 const* p ) { return HashString128( (char const*)p, size ).lo; } );
+        f64 simd = Time( [&]( u8 const* p ) { return HashBytes128( p, size ).lo; } );
+        f64 streaming = Time( [&]( u8 const* p ) { return Stream( p, StreamingPieceSize ).lo; } );
+
+        Hash128 expected = HashBytes128( data.data(), size );
+        bool ok = HashString128( (char const*)data.data(), size ) == expected
+            && Stream( data.data(), StreamingPieceSize ) == expected
+            && Stream( data.data(), 1 + (sz)random.GetInt( 0, 1000 ) ) == expected;
+
+        char sizeText[32];
+        if( size >= 1024 * 1024 * 1024 )
+            snprintf( sizeText, sizeof(sizeText), "%lld GB", size / (1024 * 1024 * 1024) );
+        else if( size >= 1024 * 1024 )
+            snprintf( sizeText, sizeof(sizeText), "%lld MB", size / (1024 * 1024) );
+        else if( size >= 1024 )
+            snprintf( sizeText, sizeof(sizeText), "%lld KB", size / 1024 );
+        else
+            snprintf( sizeText, sizeof(sizeText), "%lld B", size );
+        Log( "%8s:  Fletchef32 %6.2f GB/s  |  portable %6.2f GB/s  |  SIMD %6.2f GB/s  |  streaming %6.2f GB/s  |  %s",
+             sizeText, fletcher, portable, simd, streaming, ok ? "ok" : "WRONG RESULTS" );
+    }
+    Log( "(sink %llx)", sink );
+}
+
+// Sustained recording rate of the clouds program at 1080p and 4K: rendering, YUV conversion, pipelined readback and
+// writing, with the output (the null device by default, so only the encoder itself is left out) keeping up or not
+void BenchVideoRecording( int argc, char** argv )
+{
+    u32 frameCount = argc > 0 ? (u32)atoi( argv[0] ) : 300;
+    char const* output = argc > 1 ? argv[1] : "NUL";
+    constexpr u32 sizes[][2] = { { 1920, 1080 }, { 3840, 2160 } };
+
+    Program* previousProgram = globalProgram;
+    SetCurrentProgram( cloudsProgram );
+
+    for( auto const& size : sizes )
+    {
+        u32 width = size[0], height = size[1];
+        VideoRecorder recorder = {};
+        if( !BeginVideoRecording( &recorder, output, width, height, 60 ) )
+            continue;
+        for( u32 i = 0; i < frameCount; ++i )
+        {
+            Platform::SetFixedAppTime( i * 1000.0 / 60 );
+            UpdateCurrentProgramInputs( (f32)width, (f32)height );
+            if( !RecordVideoFrame( &recorder ) )
+                break;
+        }
+        EndVideoRecording( &recorder );
+        Platform::SetFixedAppTime( -1 );
+
+        f64 seconds = recorder.elapsedMillis * 0.001;
+        u64 frames = recorder.framesWritten;
+        Log( "%4u x %4u:  %7.1f fps  |  %6.2f MB per frame (RGBA8 would be %6.2f MB)  |  %7.1f MB/s read back  |  %s",
+             width, height, frames / Max( seconds, 1e-9 ), recorder.frameSize / (1024.0 * 1024.0),
+             (f64)width * height * 4 / (1024.0 * 1024.0), frames * recorder.frameSize / (1024.0 * 1024.0) / Max( seconds, 1e-9 ),
+             frames == frameCount && !recorder.writeFailed ? "ok" : "DROPPED FRAMES" );
+    }
+
+    if( previousProgram )
+        SetCurrentProgram( *previousProgram );
+}
+
+// PNG sequence export of the clouds program at 1080p, with 1 encoder up to one per job system worker, and how busy
+// that keeps the CPU. Rendering is the same for all, so any difference comes down to compression keeping up or not
+void BenchImageSequence( int argc, char** argv )
+{
+    u32 frameCount = argc > 0 ? (u32)atoi( argv[0] ) : 120;
+    int maxEncoders = argc > 1 ? atoi( argv[1] ) : GetWorkerCount();
+    char const* prefix = argc > 2 ? argv[2] : "bench_frames/frame_";
+    constexpr u32 width = 1920, height = 1080;
+    int coreCount = Platform::GetUsableCoreCount();
+
+    Program* previousProgram = globalProgram;
+    SetCurrentProgram( cloudsProgram );
+
+    for( int encoders = 1; encoders <= maxEncoders; encoders = encoders < maxEncoders ? Min( encoders * 2, maxEncoders ) : encoders + 1 )
+    {
+        ImageSequenceExporter exporter = {};
+        if( !BeginImageSequence( &exporter, prefix, width, height, encoders ) )
+            break;
+        for( u32 i = 0; i < frameCount; ++i )
+        {
+            Platform::SetFixedAppTime( i * 1000.0 / 60 );
+            UpdateCurrentProgramInputs( (f32)width, (f32)height );
+            if( !ExportImageFrame( &exporter ) )
+                break;
+        }
+        EndImageSequence( &exporter );
+        Platform::SetFixedAppTime( -1 );
+
+        f64 seconds = Max( exporter.elapsedMillis * 0.001, 1e-9 );
+        u64 frames = exporter.framesWritten;
+        f64 coresBusy = exporter.cpuMillis / Max( exporter.elapsedMillis, 1e-9 );
+        Log( "%2d encoders:  %6.1f fps  |  %6.1f KB per frame  |  CPU %5.2f cores busy (%5.1f%% of %d)  |  %s",
+             encoders, frames / seconds, frames ? exporter.bytesWritten / 1024.0 / frames : 0.0, coresBusy,
+             100.0 * coresBusy / coreCount, coreCount, frames == frameCount && !exporter.writeFailed ? "ok" : "DROPPED FRAMES" );
+    }
+
+    if( previousProgram )
+        SetCurrentProgram( *previousProgram );
+}
+
+Benchmark globalBenchmarks[] =
+{
+    { "mesh", BenchMeshLoading, "[source.gltf] [iterations]" },
+    { "texture", BenchTextureStreaming, "[source.tga]" },
+    { "mipgen", BenchMipGeneration, "[iterations]" },
+    { "upload", BenchUploads, "[max MB per frame]" },
+    { "bundles", BenchRenderBundles, "[max draws] [frames]" },
+    { "passes", BenchPassEncoding, "[passes] [frames]" },
+    { "culling", BenchCulling, "[max instances]" },
+    { "batchcull", BenchBatchCulling, "[boxes] [iterations]" },
+    { "bvh", BenchBVH, "[max triangles] [image size]" },
+    { "raytrace", BenchRayTracing, "[max triangles] [image size] [frames]" },
+    { "math", BenchMath, "[iterations]" },
+    { "hierarchy", BenchHierarchy, "[nodes] [frames]" },
+    { "transform", BenchTransform, "[max elements] [elements per run]" },
+    { "jobs", BenchJobs, "[jobs] [max workers]" },
+    { "fileio", BenchFileLoading, "[small files] [big files] [big file MB]" },
+    { "hash", BenchHashing, "[max MB]" },
+    { "video", BenchVideoRecording, "[frames] [output]" },
+    { "images", BenchImageSequence, "[frames] [max encoders] [file prefix]" },
+};
+
+bool RunBenchmark( char const* name, int argc, char** argv )
+{
+    for( Benchmark const& b : globalBenchmarks )
+    {
+        if( strcmp( name, b.name ) == 0 )
+        {
+            Log( "Running benchmark '%s'..", b.name );
+            b.func( argc, argv );
+            return true;
+        }
+    }
+
+    Log( "Unknown benchmark '%s'. Available benchmarks are:", name );
+    for( Benchmark const& b : globalBenchmarks )
+        Log( "  %s %s", b.name, b.usage );
+    return false;
+}
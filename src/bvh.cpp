@@ -0,0 +1,457 @@
+
+// Node layout while building. Children are always allocated in pairs, so they only need the index of the first
+struct BVHBuildNode
+{
+    v3 min, max;
+    u32 left;                   // 0 for leaves (the root can never be a child)
+    u32 first, count;
+    u32 axis;
+};
+
+struct BVHBuilder
+{
+    std::vector<BVHBuildNode> nodes;
+    std::atomic<u32> nodeCount;
+    std::vector<v3> centroids;
+    std::vector<v3> triMins, triMaxs;
+    std::vector<u32> indices;
+    int parallelDepth;
+};
+
+INLINE f32 HalfArea( v3 const& min, v3 const& max )
+{
+    v3 e = max - min;
+    return e.x * e.y + e.y * e.z + e.z * e.x;
+}
+
+void BuildBVHNode( BVHBuilder* builder, u32 nodeIndex, int depth )
+{
+    BVHBuildNode& node = builder->nodes[nodeIndex];
+    u32* indices = builder->indices.data() + node.first;
+
+    v3 centroidMin = V3Inf, centroidMax = -V3Inf;
+    node.min = V3Inf;
+    node.max = -V3Inf;
+    for( u32 i = 0; i < node.count; ++i )
+    {
+        u32 t = indices[i];
+        node.min = Min( node.min, builder->triMins[t] );
+        node.max = Max( node.max, builder->triMaxs[t] );
+        centroidMin = Min( centroidMin, builder->centroids[t] );
+        centroidMax = Max( centroidMax, builder->centroids[t] );
+    }
+    node.left = 0;
+    if( node.count <= 1 )
+        return;
+
+    // Bin centroids along each axis and sweep the candidate planes between bins (only above BVHMaxSAHDepth, see below)
+    struct Bin
+    {
+        v3 min, max;
+        u32 count;
+    };
+    f32 bestCost = F32INF;
+    int bestAxis = -1, bestSplit = 0;
+    int sahAxes = depth < BVHMaxSAHDepth ? 3 : 0;
+    for( int axis = 0; axis < sahAxes; ++axis )
+    {
+        f32 extent = centroidMax.e[axis] - centroidMin.e[axis];
+        if( extent <= 0.f )
+            continue;
+
+        Bin bins[BVHBinCount];
+        for( Bin& b : bins )
+            b = { V3Inf, -V3Inf, 0 };
+
+        f32 scale = BVHBinCount / extent;
+        for( u32 i = 0; i < node.count; ++i )
+        {
+            u32 t = indices[i];
+            int b = Min( (int)((builder->centroids[t].e[axis] - centroidMin.e[axis]) * scale), BVHBinCount - 1 );
+            bins[b].min = Min( bins[b].min, builder->triMins[t] );
+            bins[b].max = Max( bins[b].max, builder->triMaxs[t] );
+            bins[b].count++;
+        }
+
+        f32 rightArea[BVHBinCount];
+        u32 rightCount[BVHBinCount];
+        v3 min = V3Inf, max = -V3Inf;
+        u32 count = 0;
+        for( int b = BVHBinCount - 1; b > 0; --b )
+        {
+            if( bins[b].count )
+            {
+                min = Min( min, bins[b].min );
+                max = Max( max, bins[b].max );
+            }
+            count += bins[b].count;
+            rightArea[b] = count ? HalfArea( min, max ) : 0.f;
+            rightCount[b] = count;
+        }
+
+        min = V3Inf;
+        max = -V3Inf;
+        count = 0;
+        for( int split = 1; split < BVHBinCount; ++split )
+        {
+            Bin const& b = bins[split - 1];
+            if( b.count )
+            {
+                min = Min( min, b.min );
+                max = Max( max, b.max );
+            }
+            count += b.count;
+            if( !count || !rightCount[split] )
+                continue;
+
+            f32 cost = count * HalfArea( min, max ) + rightCount[split] * rightArea[split];
+            if( cost < bestCost )
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = split;
+            }
+        }
+    }
+
+    // Stop once splitting doesn't pay off, as long as leaves stay small
+    f32 leafCost = node.count * HalfArea( node.min, node.max );
+    if( node.count <= BVHMaxLeafSize && (bestAxis < 0 || leafCost <= bestCost) )
+        return;
+
+    u32 leftCount;
+    if( bestAxis >= 0 )
+    {
+        f32 scale = BVHBinCount / (centroidMax.e[bestAxis] - centroidMin.e[bestAxis]);
+        f32 axisMin = centroidMin.e[bestAxis];
+        v3 const* centroids = builder->centroids.data();
+        u32* mid = std::partition( indices, indices + node.count, [=]( u32 t )
+        {
+            int b = Min( (int)((centroids[t].e[bestAxis] - axisMin) * scale), BVHBinCount - 1 );
+            return b < bestSplit;
+        } );
+        leftCount = (u32)(mid - indices);
+        node.axis = (u32)bestAxis;
+    }
+    else
+    {
+        // Too deep already, or all centroids in the same spot. Halve the node at the median along its widest axis,
+        // which bounds the depth of the rest of the subtree
+        v3 extent = centroidMax - centroidMin;
+        int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+        v3 const* centroids = builder->centroids.data();
+        leftCount = node.count / 2;
+        std::nth_element( indices, indices + leftCount, indices + node.count, [=]( u32 a, u32 b )
+        {
+            return centroids[a].e[axis] < centroids[b].e[axis];
+        } );
+        node.axis = (u32)axis;
+    }
+
+    u32 children = builder->nodeCount.fetch_add( 2 );
+    builder->nodes[children] = { {}, {}, 0, node.first, leftCount, 0 };
+    builder->nodes[children + 1] = { {}, {}, 0, node.first + leftCount, node.count - leftCount, 0 };
+    node.left = children;
+
+    if( depth < builder->parallelDepth && node.count >= BVHParallelBuildMinTris )
+    {
+        ParallelFor( 2, 1, [builder, children, depth]( sz begin, sz end )
+        {
+            for( sz i = begin; i < end; ++i )
+                BuildBVHNode( builder, children + (u32)i, depth + 1 );
+        } );
+    }
+    else
+    {
+        BuildBVHNode( builder, children, depth + 1 );
+        BuildBVHNode( builder, children + 1, depth + 1 );
+    }
+}
+
+// Lay out the build tree depth-first, with each left child right after its parent
+u32 FlattenBVHNode( BVHBuilder const& builder, u32 buildIndex, BVH* bvh )
+{
+    BVHBuildNode const& node = builder.nodes[buildIndex];
+    u32 index = (u32)bvh->nodes.size();
+    bvh->nodes.push_back( { node.min, node.first, node.max, (u16)node.count, 0 } );
+
+    if( node.left )
+    {
+        FlattenBVHNode( builder, node.left, bvh );
+        u32 right = FlattenBVHNode( builder, node.left + 1, bvh );
+
+        BVHNode& flat = bvh->nodes[index];
+        flat.rightOrFirst = right;
+        flat.count = 0;
+        flat.axis = (u16)node.axis;
+    }
+    return index;
+}
+
+void BuildBVH( tri const* tris, u32 triCount, BVH* bvh )
+{
+    *bvh = {};
+    if( !triCount )
+        return;
+
+    BVHBuilder builder;
+    builder.centroids.resize( triCount );
+    builder.triMins.resize( triCount );
+    builder.triMaxs.resize( triCount );
+    builder.indices.resize( triCount );
+    ParallelFor( triCount, 64 * 1024, [&]( sz begin, sz end )
+    {
+        for( sz i = begin; i < end; ++i )
+        {
+            tri const& t = tris[i];
+            builder.triMins[i] = Min( Min( t.v0, t.v1 ), t.v2 );
+            builder.triMaxs[i] = Max( Max( t.v0, t.v1 ), t.v2 );
+            builder.centroids[i] = (t.v0 + t.v1 + t.v2) / 3.f;
+            builder.indices[i] = (u32)i;
+        }
+    } );
+
+    // A binary tree with at least one triangle per leaf never has more than 2n - 1 nodes
+    builder.nodes.resize( 2 * (sz)triCount );
+    builder.nodes[0] = { {}, {}, 0, 0, triCount, 0 };
+    builder.nodeCount = 1;
+    builder.parallelDepth = 0;
+    for( int threads = GetWorkerCount(); threads > 1; threads >>= 1 )
+        builder.parallelDepth++;
+    BuildBVHNode( &builder, 0, 0 );
+
+    bvh->nodes.reserve( builder.nodeCount );
+    FlattenBVHNode( builder, 0, bvh );
+
+    bvh->tris.resize( triCount );
+    for( u32 i = 0; i < triCount; ++i )
+        bvh->tris[i] = tris[builder.indices[i]];
+    bvh->triIndices = std::move( builder.indices );
+}
+
+
+// Most nodes on any path from the root to a leaf, counting both ends.
+// Children always come after their parent, so a single forward pass sees every parent's depth before its children's
+u32 GetBVHDepth( BVH const& bvh )
+{
+    std::vector<u32> depths( bvh.nodes.size(), 0 );
+    u32 maxDepth = 0;
+    for( sz i = 0; i < (sz)bvh.nodes.size(); ++i )
+    {
+        BVHNode const& node = bvh.nodes[i];
+        u32 depth = depths[i] + 1;
+        maxDepth = Max( maxDepth, depth );
+        if( node.count == 0 )
+        {
+            depths[i + 1] = depth;
+            depths[node.rightOrFirst] = depth;
+        }
+    }
+    return maxDepth;
+}
+
+// Möller-Trumbore. Returns the distance along the ray and the barycentrics of the hit
+INLINE bool IntersectRayTri( v3 const& o, v3 const& d, tri const& tr, f32* t, f32* u, f32* v )
+{
+    v3 e1 = tr.v1 - tr.v0;
+    v3 e2 = tr.v2 - tr.v0;
+    v3 p = Cross( d, e2 );
+    f32 det = Dot( e1, p );
+    if( Abs( det ) < 1e-12f )
+        return false;
+
+    f32 invDet = 1.f / det;
+    v3 s = o - tr.v0;
+    *u = Dot( s, p ) * invDet;
+    if( *u < 0.f || *u > 1.f )
+        return false;
+
+    v3 q = Cross( s, e1 );
+    *v = Dot( d, q ) * invDet;
+    if( *v < 0.f || *u + *v > 1.f )
+        return false;
+
+    *t = Dot( e2, q ) * invDet;
+    return *t > 1e-6f;
+}
+
+// Distance to where the ray enters the box, or infinity when it misses it or only enters it after maxT
+INLINE f32 IntersectRayBox( v3 const& o, v3 const& invDir, BVHNode const& node, f32 maxT )
+{
+    v3 t0 = Hadamard( node.min - o, invDir );
+    v3 t1 = Hadamard( node.max - o, invDir );
+    v3 tNear = Min( t0, t1 );
+    v3 tFar = Max( t0, t1 );
+    f32 tEnter = Max( Max( tNear.x, tNear.y ), tNear.z );
+    f32 tExit = Min( Min( tFar.x, tFar.y ), tFar.z );
+    return tExit >= tEnter && tExit >= 0.f && tEnter < maxT ? tEnter : F32INF;
+}
+
+// Closest hit along the ray, if any closer than maxT. Good for picking
+bool IntersectBVH( BVH const& bvh, ray const& r, RayHit* hit, f32 maxT = F32MAX )
+{
+    hit->t = maxT;
+    hit->triIndex = BVHNoHit;
+    if( bvh.nodes.empty() )
+        return false;
+
+    v3 invDir = { 1.f / r.dir.x, 1.f / r.dir.y, 1.f / r.dir.z };
+    if( IntersectRayBox( r.p, invDir, bvh.nodes[0], hit->t ) == F32INF )
+        return false;
+
+    struct Entry
+    {
+        u32 node;
+        f32 t;
+    } stack[BVHMaxDepth];
+    int stackSize = 0;
+    u32 nodeIndex = 0;
+
+    while( true )
+    {
+        BVHNode const& node = bvh.nodes[nodeIndex];
+        if( node.count )
+        {
+            for( u32 i = node.rightOrFirst; i < node.rightOrFirst + node.count; ++i )
+            {
+                f32 t, u, v;
+                if( IntersectRayTri( r.p, r.dir, bvh.tris[i], &t, &u, &v ) && t < hit->t )
+                    *hit = { t, bvh.triIndices[i], u, v };
+            }
+        }
+        else
+        {
+            // Visit the nearest child first, and come back for the other one later if it's still worth it
+            u32 near = nodeIndex + 1, far = node.rightOrFirst;
+            f32 tNear = IntersectRayBox( r.p, invDir, bvh.nodes[near], hit->t );
+            f32 tFar = IntersectRayBox( r.p, invDir, bvh.nodes[far], hit->t );
+            if( tFar < tNear )
+            {
+                std::swap( near, far );
+                std::swap( tNear, tFar );
+            }
+            if( tNear != F32INF )
+            {
+                if( tFar != F32INF )
+                {
+                    ASSERT( stackSize < ARRAYCOUNT(stack), "BVH too deep" );
+                    stack[stackSize++] = { far, tFar };
+                }
+                nodeIndex = near;
+                continue;
+            }
+        }
+
+        // Pop until there's something that could still be closer than the current hit
+        while( stackSize && stack[stackSize - 1].t >= hit->t )
+            stackSize--;
+        if( !stackSize )
+            break;
+        nodeIndex = stack[--stackSize].node;
+    }
+
+    return hit->triIndex != BVHNoHit;
+}
+
+// Trace a whole packet through the tree at once, descending into any node at least one ray still hits.
+// Works best when the rays are coherent, since all rays pay for every node and triangle any of them visits
+template <typename F>
+void IntersectBVHPacket( BVH const& bvh, RayPacket<F> const& packet, RayHit* hits )
+{
+    constexpr int Width = RayPacket<F>::Width;
+
+    f32 hitT[Width];
+    for( int i = 0; i < Width; ++i )
+    {
+        hitT[i] = F32MAX;
+        hits[i] = { F32MAX, BVHNoHit, 0.f, 0.f };
+    }
+    if( bvh.nodes.empty() )
+        return;
+
+    F ox = SimdLoad<F>( packet.ox ), oy = SimdLoad<F>( packet.oy ), oz = SimdLoad<F>( packet.oz );
+    F dx = SimdLoad<F>( packet.dx ), dy = SimdLoad<F>( packet.dy ), dz = SimdLoad<F>( packet.dz );
+    F one = SimdSet<F>( 1.f ), zero = SimdSet<F>( 0.f );
+    F idx = SimdDiv( one, dx ), idy = SimdDiv( one, dy ), idz = SimdDiv( one, dz );
+    F detEpsilon = SimdSet<F>( 1e-12f ), tEpsilon = SimdSet<F>( 1e-6f );
+    f32 const* dirs[3] = { packet.dx, packet.dy, packet.dz };
+
+    u32 stack[BVHMaxDepth + 1];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while( stackSize )
+    {
+        BVHNode const& node = bvh.nodes[stack[--stackSize]];
+        F maxT = SimdLoad<F>( hitT );
+
+        F t0x = SimdMul( SimdSub( SimdSet<F>( node.min.x ), ox ), idx );
+        F t1x = SimdMul( SimdSub( SimdSet<F>( node.max.x ), ox ), idx );
+        F t0y = SimdMul( SimdSub( SimdSet<F>( node.min.y ), oy ), idy );
+        F t1y = SimdMul( SimdSub( SimdSet<F>( node.max.y ), oy ), idy );
+        F t0z = SimdMul( SimdSub( SimdSet<F>( node.min.z ), oz ), idz );
+        F t1z = SimdMul( SimdSub( SimdSet<F>( node.max.z ), oz ), idz );
+        F tEnter = SimdMax( SimdMax( SimdMin( t0x, t1x ), SimdMin( t0y, t1y ) ), SimdMin( t0z, t1z ) );
+        F tExit = SimdMin( SimdMin( SimdMax( t0x, t1x ), SimdMax( t0y, t1y ) ), SimdMax( t0z, t1z ) );
+        u32 active = SimdMaskGE( tExit, tEnter ) & SimdMaskGE( tExit, zero ) & SimdMaskLT( tEnter, maxT );
+        if( !active )
+            continue;
+
+        if( node.count )
+        {
+            for( u32 i = node.rightOrFirst; i < node.rightOrFirst + node.count; ++i )
+            {
+                tri const& tr = bvh.tris[i];
+                v3 e1 = tr.v1 - tr.v0;
+                v3 e2 = tr.v2 - tr.v0;
+                F e1x = SimdSet<F>( e1.x ), e1y = SimdSet<F>( e1.y ), e1z = SimdSet<F>( e1.z );
+                F e2x = SimdSet<F>( e2.x ), e2y = SimdSet<F>( e2.y ), e2z = SimdSet<F>( e2.z );
+
+                F px = SimdSub( SimdMul( dy, e2z ), SimdMul( dz, e2y ) );
+                F py = SimdSub( SimdMul( dz, e2x ), SimdMul( dx, e2z ) );
+                F pz = SimdSub( SimdMul( dx, e2y ), SimdMul( dy, e2x ) );
+                F det = SimdAdd( SimdAdd( SimdMul( e1x, px ), SimdMul( e1y, py ) ), SimdMul( e1z, pz ) );
+                F invDet = SimdDiv( one, det );
+
+                F sx = SimdSub( ox, SimdSet<F>( tr.v0.x ) );
+                F sy = SimdSub( oy, SimdSet<F>( tr.v0.y ) );
+                F sz = SimdSub( oz, SimdSet<F>( tr.v0.z ) );
+                F u = SimdMul( SimdAdd( SimdAdd( SimdMul( sx, px ), SimdMul( sy, py ) ), SimdMul( sz, pz ) ), invDet );
+
+                F qx = SimdSub( SimdMul( sy, e1z ), SimdMul( sz, e1y ) );
+                F qy = SimdSub( SimdMul( sz, e1x ), SimdMul( sx, e1z ) );
+                F qz = SimdSub( SimdMul( sx, e1y ), SimdMul( sy, e1x ) );
+                F v = SimdMul( SimdAdd( SimdAdd( SimdMul( dx, qx ), SimdMul( dy, qy ) ), SimdMul( dz, qz ) ), invDet );
+                F t = SimdMul( SimdAdd( SimdAdd( SimdMul( e2x, qx ), SimdMul( e2y, qy ) ), SimdMul( e2z, qz ) ), invDet );
+
+                u32 mask = active & SimdMaskGE( SimdAbs( det ), detEpsilon )
+                    & SimdMaskGE( u, zero ) & SimdMaskGE( v, zero ) & SimdMaskGE( one, SimdAdd( u, v ) )
+                    & SimdMaskLT( tEpsilon, t ) & SimdMaskLT( t, maxT );
+                if( !mask )
+                    continue;
+
+                f32 ts[Width], us[Width], vs[Width];
+                SimdStore( ts, t );
+                SimdStore( us, u );
+                SimdStore( vs, v );
+                for( ; mask; mask &= mask - 1 )
+                {
+                    u32 lane = FindFirstSetBit( mask );
+                    hitT[lane] = ts[lane];
+                    hits[lane] = { ts[lane], bvh.triIndices[i], us[lane], vs[lane] };
+                }
+                maxT = SimdLoad<F>( hitT );
+            }
+        }
+        else
+        {
+            // Order children by the direction of the first active ray along the split axis
+            ASSERT( stackSize + 2 <= ARRAYCOUNT(stack), "BVH too deep" );
+            u32 left = (u32)(&node - bvh.nodes.data()) + 1;
+            u32 right = node.rightOrFirst;
+            bool leftFirst = dirs[node.axis][FindFirstSetBit( active )] >= 0.f;
+            stack[stackSize++] = leftFirst ? right : left;
+            stack[stackSize++] = leftFirst ? left : right;
+        }
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+// Bounding volume hierarchy over triangles, for picking and CPU ray tracing.
+// Built top-down with a binned SAH, building both halves of big splits in parallel. The result is flattened depth-first
+// into a single array of 32 byte nodes: a node's left child immediately follows it, so only the right one needs an index
+// and most traversal steps just walk forward in memory. Triangles are reordered so each leaf covers a contiguous range.
+
+constexpr int BVHBinCount = 16;
+constexpr int BVHMaxLeafSize = 4;
+// Past this depth nodes are split in half at the median instead of by SAH. Degenerate inputs could otherwise make the
+// tree as deep as it has triangles, and halving bounds the rest of any path at 31 more levels for 2^32 triangles
+constexpr int BVHMaxSAHDepth = 32;
+// Most nodes on any path from the root to a leaf, which traversal stacks are sized for
+constexpr int BVHMaxDepth = BVHMaxSAHDepth + 31;
+// Smallest subtree worth building on its own thread
+constexpr u32 BVHParallelBuildMinTris = 64 * 1024;
+constexpr u32 BVHNoHit = U32MAX;
+
+struct BVHNode
+{
+    v3 min;
+    u32 rightOrFirst;           // Interior nodes: index of the right child. Leaves: first triangle
+    v3 max;
+    u16 count;                  // Triangles in a leaf, 0 for interior nodes
+    u16 axis;                   // Split axis of interior nodes, so traversal can visit the nearest child first
+};
+static_assert( sizeof(BVHNode) == 32 );
+
+struct BVH
+{
+    std::vector<BVHNode> nodes;
+    // Triangles in leaf order, plus the index each one had in the source array
+    std::vector<tri> tris;
+    std::vector<u32> triIndices;
+};
+
+struct RayHit
+{
+    f32 t;
+    u32 triIndex;               // Into the source array, or BVHNoHit
+    f32 u, v;                   // Barycentrics of the hit relative to v1 and v2
+};
+
+// Rays are traced in packets of as many rays as lanes in F (see simd.h), as long as they're coherent enough
+// to mostly go through the same nodes (e.g. neighbouring pixels)
+template <typename F>
+struct RayPacket
+{
+    static constexpr int Width = SimdLanes<F>::width;
+
+    f32 ox[Width], oy[Width], oz[Width];
+    f32 dx[Width], dy[Width], dz[Width];
+};
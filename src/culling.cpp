@@ -0,0 +1,304 @@
+
+static_assert( CullVisibleBinding >= 2 + MaxChannels, "Culling bindings overlap with channels" );
+
+
+// Dropped when its shader changes, and rebuilt the next time it's needed
+void InvalidateInstanceCuller( void* owner, int variant )
+{
+    InstanceCuller* culler = (InstanceCuller*)owner;
+    DeferRelease( culler->pipeline );
+    culler->pipeline = nullptr;
+}
+
+void InitInstanceCuller( InstanceCuller* culler )
+{
+    std::string source;
+    if( !LoadShaderSource( CullShaderPath, &source, { culler, 0, InvalidateInstanceCuller } ) )
+        return;
+    WGPUShaderModule shaderModule = CreateShaderModule( source.c_str(), CullShaderPath );
+
+    WGPUBindGroupLayoutEntry bindingLayouts[4];
+    for( int i = 0; i < 4; ++i )
+    {
+        bindingLayouts[i] = DefaultBinding();
+        bindingLayouts[i].binding = i;
+        bindingLayouts[i].visibility = WGPUShaderStage_Compute;
+    }
+    bindingLayouts[0].buffer.type = WGPUBufferBindingType_Uniform;
+    bindingLayouts[0].buffer.minBindingSize = sizeof(CullParams);
+    bindingLayouts[1].buffer.type = WGPUBufferBindingType_ReadOnlyStorage;
+    bindingLayouts[2].buffer.type = WGPUBufferBindingType_Storage;
+    bindingLayouts[3].buffer.type = WGPUBufferBindingType_Storage;
+    bindingLayouts[3].buffer.minBindingSize = sizeof(DrawIndirectArgs);
+
+    WGPUBindGroupLayoutDescriptor bindGroupLayoutDesc = {};
+    bindGroupLayoutDesc.nextInChain = nullptr;
+    bindGroupLayoutDesc.entryCount = ARRAYCOUNT(bindingLayouts);
+    bindGroupLayoutDesc.entries = bindingLayouts;
+    // Survives shader reloads
+    if( !culler->bindGroupLayout )
+        culler->bindGroupLayout = wgpuDeviceCreateBindGroupLayout( globalDevice, &bindGroupLayoutDesc );
+
+    WGPUPipelineLayoutDescriptor layoutDesc = {};
+    layoutDesc.nextInChain                  = nullptr;
+    layoutDesc.bindGroupLayoutCount         = 1;
+    layoutDesc.bindGroupLayouts             = &culler->bindGroupLayout;
+    WGPUPipelineLayout pipelineLayout       = wgpuDeviceCreatePipelineLayout( globalDevice, &layoutDesc );
+
+    WGPUComputePipelineDescriptor pipelineDesc = {};
+    pipelineDesc.nextInChain                   = nullptr;
+    pipelineDesc.label                         = "Instance culling";
+    pipelineDesc.layout                        = pipelineLayout;
+    pipelineDesc.compute.module                = shaderModule;
+    pipelineDesc.compute.entryPoint            = "cs_main";
+    pipelineDesc.compute.constantCount         = 0;
+    pipelineDesc.compute.constants             = nullptr;
+    culler->pipeline = wgpuDeviceCreateComputePipeline( globalDevice, &pipelineDesc );
+
+    wgpuPipelineLayoutRelease( pipelineLayout );
+    wgpuShaderModuleRelease( shaderModule );
+}
+
+// Upload the bounds of all instances. Buffers are recreated only when the instance count changes
+void SetInstanceBounds( InstanceCulling* culling, aabb const* bounds, u32 count, char const* owner = nullptr )
+{
+    if( count != culling->instanceCount || !culling->boundsBuffer )
+    {
+        DestroyResource( &culling->boundsBuffer );
+        DestroyResource( &culling->visibleBuffer );
+        DestroyResource( &culling->argsBuffer );
+        DestroyResource( &culling->paramsBuffer );
+        culling->instanceCount = 0;
+
+        WGPUBufferDescriptor bufferDesc = {};
+        bufferDesc.nextInChain          = nullptr;
+        bufferDesc.mappedAtCreation     = false;
+
+        bufferDesc.label = "Instance bounds";
+        bufferDesc.usage = WGPUBufferUsage_Storage | WGPUBufferUsage_CopyDst;
+        bufferDesc.size = Max<u64>( (u64)count * sizeof(aabb), 4 );
+        culling->boundsBuffer = RegisterResource( CreateGPUBuffer( &bufferDesc, owner ), bufferDesc.label );
+
+        bufferDesc.label = "Visible instances";
+        bufferDesc.usage = WGPUBufferUsage_Storage;
+        bufferDesc.size = Max<u64>( (u64)count * sizeof(u32), 4 );
+        culling->visibleBuffer = RegisterResource( CreateGPUBuffer( &bufferDesc, owner ), bufferDesc.label );
+
+        bufferDesc.label = "Culled draw args";
+        bufferDesc.usage = WGPUBufferUsage_Storage | WGPUBufferUsage_Indirect | WGPUBufferUsage_CopyDst | WGPUBufferUsage_CopySrc;
+        bufferDesc.size = sizeof(DrawIndirectArgs);
+        culling->argsBuffer = RegisterResource( CreateGPUBuffer( &bufferDesc, owner ), bufferDesc.label );
+
+        bufferDesc.label = "Cull params";
+        bufferDesc.usage = WGPUBufferUsage_Uniform | WGPUBufferUsage_CopyDst;
+        bufferDesc.size = sizeof(CullParams);
+        culling->paramsBuffer = RegisterResource( CreateGPUBuffer( &bufferDesc, owner ), bufferDesc.label );
+
+        if( !culling->boundsBuffer || !culling->visibleBuffer || !culling->argsBuffer || !culling->paramsBuffer )
+            return;
+    }
+    culling->instanceCount = count;
+
+    if( !StagingWriteSliced( &globalStagingBelt, GetResource( culling->boundsBuffer ), 0, bounds, (u64)count * sizeof(aabb) ) )
+        culling->instanceCount = 0;
+}
+
+void SetCullingCamera( InstanceCulling* culling, m4 const& viewProj )
+{
+    FrustumPlanes( viewProj, culling->planes );
+}
+
+// Reset the draw arguments and upload this frame's planes. Must happen before the staging belt is flushed
+void WriteCullingParams( InstanceCulling const* culling, u32 drawCount, v4 const* planes )
+{
+    WGPUBuffer argsBuffer = GetResource( culling->argsBuffer );
+    WGPUBuffer paramsBuffer = GetResource( culling->paramsBuffer );
+    if( !argsBuffer || !paramsBuffer )
+        return;
+
+    DrawIndirectArgs args = {};
+    args.count = drawCount;
+    if( void* staging = StagingWrite( &globalStagingBelt, argsBuffer, 0, sizeof(args) ) )
+        COPYP( &args, staging, sizeof(args) );
+
+    CullParams params = {};
+    COPYP( planes, params.planes, sizeof(params.planes) );
+    params.instanceCount = culling->instanceCount;
+    if( void* staging = StagingWrite( &globalStagingBelt, paramsBuffer, 0, sizeof(params) ) )
+        COPYP( &params, staging, sizeof(params) );
+}
+
+// Record the culling pass. Anything drawing from the args buffer must be encoded after this
+bool EncodeInstanceCulling( WGPUCommandEncoder encoder, InstanceCulling const* culling,
+                            InstanceCuller* culler /*= &globalInstanceCuller*/ )
+{
+    if( !culler->pipeline )
+        InitInstanceCuller( culler );
+    if( !culler->pipeline || !culling->instanceCount )
+        return false;
+
+    WGPUBindGroupEntry bindings[4] = {};
+    bindings[0].binding = 0;
+    bindings[0].buffer = GetResource( culling->paramsBuffer );
+    bindings[0].size = sizeof(CullParams);
+    bindings[1].binding = 1;
+    bindings[1].buffer = GetResource( culling->boundsBuffer );
+    bindings[1].size = (u64)culling->instanceCount * sizeof(aabb);
+    bindings[2].binding = 2;
+    bindings[2].buffer = GetResource( culling->visibleBuffer );
+    bindings[2].size = (u64)culling->instanceCount * sizeof(u32);
+    bindings[3].binding = 3;
+    bindings[3].buffer = GetResource( culling->argsBuffer );
+    bindings[3].size = sizeof(DrawIndirectArgs);
+
+    WGPUBindGroupDescriptor bindGroupDesc = {};
+    bindGroupDesc.nextInChain = nullptr;
+    bindGroupDesc.layout = culler->bindGroupLayout;
+    bindGroupDesc.entryCount = ARRAYCOUNT(bindings);
+    bindGroupDesc.entries = bindings;
+    WGPUBindGroup bindGroup = wgpuDeviceCreateBindGroup( globalDevice, &bindGroupDesc );
+
+    // Spill into a second dimension past the per-dimension workgroup limit
+    u32 groupCount = (culling->instanceCount + CullWorkgroupSize - 1) / CullWorkgroupSize;
+    u32 maxGroups = Max( globalLimits.maxComputeWorkgroupsPerDimension, 1u );
+    u32 groupsX = Min( groupCount, maxGroups );
+    u32 groupsY = (groupCount + groupsX - 1) / groupsX;
+
+    WGPUComputePassDescriptor passDesc = {};
+    passDesc.nextInChain = nullptr;
+    passDesc.label = "Instance culling";
+    passDesc.timestampWriteCount = 0;
+    passDesc.timestampWrites = nullptr;
+    WGPUComputePassEncoder pass = wgpuCommandEncoderBeginComputePass( encoder, &passDesc );
+    wgpuComputePassEncoderSetPipeline( pass, culler->pipeline );
+    wgpuComputePassEncoderSetBindGroup( pass, 0, bindGroup, 0, nullptr );
+    wgpuComputePassEncoderDispatchWorkgroups( pass, groupsX, groupsY, 1 );
+    wgpuComputePassEncoderEnd( pass );
+#ifdef WEBGPU_BACKEND_DAWN
+    wgpuComputePassEncoderRelease( pass );
+#endif
+
+    // Encoded commands keep their own references
+    wgpuBindGroupRelease( bindGroup );
+    return true;
+}
+
+void ReleaseInstanceCulling( InstanceCulling* culling )
+{
+    DestroyResource( &culling->boundsBuffer );
+    DestroyResource( &culling->visibleBuffer );
+    DestroyResource( &culling->argsBuffer );
+    DestroyResource( &culling->paramsBuffer );
+    *culling = {};
+}
+
+// CPU reference, with the exact same test as the shader. Visible indices come out in ascending order
+void CullInstancesCPU( aabb const* bounds, u32 count, v4 const planes[6], std::vector<u32>* visible )
+{
+    visible->clear();
+    for( u32 i = 0; i < count; ++i )
+    {
+        if( IsInFrustum( bounds[i], planes ) )
+            visible->push_back( i );
+    }
+}
+
+// Turn on culling for a program. Call from its init function, then set its bounds and camera as usual
+void EnableInstanceCulling( Program* program )
+{
+    program->culling.enabled = true;
+}
+
+
+void SetBoundsSoA( BoundsSoA* soa, aabb const* bounds, u32 count )
+{
+    // Zero padding has no extent, and is masked out anyway
+    u32 paddedCount = AlignUp<u32>( count, SimdWidth );
+    std::vector<f32>* arrays[] = { &soa->cx, &soa->cy, &soa->cz, &soa->ex, &soa->ey, &soa->ez };
+    for( std::vector<f32>* a : arrays )
+        a->assign( paddedCount, 0.f );
+
+    for( u32 i = 0; i < count; ++i )
+    {
+        soa->cx[i] = bounds[i].center.x;
+        soa->cy[i] = bounds[i].center.y;
+        soa->cz[i] = bounds[i].center.z;
+        soa->ex[i] = bounds[i].halfSize.x;
+        soa->ey[i] = bounds[i].halfSize.y;
+        soa->ez[i] = bounds[i].halfSize.z;
+    }
+    soa->count = count;
+}
+
+// Test boxes [begin, end) against all planes, SimdWidth at a time, and write out the indices of the visible ones
+// in ascending order. Begin must be a multiple of SimdWidth. Returns how many were visible
+u32 CullBoundsSIMD( BoundsSoA const& soa, v4 const planes[6], u32 begin, u32 end, u32* visible )
+{
+    ASSERT( begin % SimdWidth == 0, "Unaligned batch start" );
+
+    // Same test as the shader: a box is out if its center is further behind any plane than its projected extent
+    simdf nx[6], ny[6], nz[6], ax[6], ay[6], az[6], w[6];
+    for( int p = 0; p < 6; ++p )
+    {
+        nx[p] = SimdSet( planes[p].x );
+        ny[p] = SimdSet( planes[p].y );
+        nz[p] = SimdSet( planes[p].z );
+        ax[p] = SimdSet( Abs( planes[p].x ) );
+        ay[p] = SimdSet( Abs( planes[p].y ) );
+        az[p] = SimdSet( Abs( planes[p].z ) );
+        w[p] = SimdSet( planes[p].w );
+    }
+    simdf zero = SimdSet( 0.f );
+
+    u32 visibleCount = 0;
+    for( u32 i = begin; i < end; i += SimdWidth )
+    {
+        simdf cx = SimdLoad( &soa.cx[i] );
+        simdf cy = SimdLoad( &soa.cy[i] );
+        simdf cz = SimdLoad( &soa.cz[i] );
+        simdf ex = SimdLoad( &soa.ex[i] );
+        simdf ey = SimdLoad( &soa.ey[i] );
+        simdf ez = SimdLoad( &soa.ez[i] );
+
+        u32 mask = end - i >= SimdWidth ? SimdAllLanes<> : (1u << (end - i)) - 1;
+        for( int p = 0; p < 6 && mask; ++p )
+        {
+            simdf distance = SimdMulAdd( nx[p], cx, SimdMulAdd( ny[p], cy, SimdMulAdd( nz[p], cz, w[p] ) ) );
+            simdf radius = SimdMulAdd( ax[p], ex, SimdMulAdd( ay[p], ey, SimdMul( az[p], ez ) ) );
+            mask &= SimdMaskGE( SimdAdd( distance, radius ), zero );
+        }
+        visibleCount += CompactLaneIndices( mask, i, visible + visibleCount );
+    }
+    return visibleCount;
+}
+
+// Cull all boxes in batches of CullBatchSize spread over worker threads. Visible indices come out compacted
+// and in ascending order, same as CullInstancesCPU
+void CullBoundsParallel( BoundsSoA const& soa, v4 const planes[6], std::vector<u32>* visible, int maxThreads = 0 )
+{
+    // Each batch writes its visible indices at the start of its own range, then we close the gaps
+    visible->resize( soa.count );
+    u32 batchCount = (soa.count + CullBatchSize - 1) / CullBatchSize;
+    std::vector<u32> batchVisibleCounts( batchCount );
+
+    u32* out = visible->data();
+    ParallelFor( batchCount, 1, [&]( sz begin, sz end )
+    {
+        for( sz b = begin; b < end; ++b )
+        {
+            u32 first = (u32)b * CullBatchSize;
+            u32 last = Min( first + CullBatchSize, soa.count );
+            batchVisibleCounts[b] = CullBoundsSIMD( soa, planes, first, last, out + first );
+        }
+    }, maxThreads );
+
+    u32 visibleCount = 0;
+    for( u32 b = 0; b < batchCount; ++b )
+    {
+        u32 first = b * CullBatchSize;
+        if( visibleCount != first )
+            memmove( out + visibleCount, out + first, batchVisibleCounts[b] * sizeof(u32) );
+        visibleCount += batchVisibleCounts[b];
+    }
+    visible->resize( visibleCount );
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+// GPU frustum culling for instanced draws.
+// A compute pass tests every instance's bounds against the camera planes, compacts the indices of the visible ones
+// into a buffer and writes the instance count straight into the draw's indirect arguments, so the CPU never sees
+// per-instance visibility. Programs using it draw indirectly, and look up their instances in the vertex shader:
+//
+//   @group(0) @binding(6) var<storage, read> visibleInstances: array<u32>;
+//   @group(0) @binding(7) var<storage, read> instanceBounds: array<InstanceBounds>;
+//   ..
+//   let bounds = instanceBounds[visibleInstances[instance_index]];
+
+constexpr char const* CullShaderPath = "src/shaders/cull.wgsl";
+constexpr u32 CullWorkgroupSize = 64;
+// Bindings in the main pass of programs using culling, right after all channels
+constexpr u32 CullVisibleBinding = 6;
+constexpr u32 CullBoundsBinding = CullVisibleBinding + 1;
+
+// Same layout as drawIndexedIndirect expects. drawIndirect only reads the first four
+struct DrawIndirectArgs
+{
+    u32 count;                  // Vertices or indices per instance
+    u32 instanceCount;          // Filled in by the culling pass
+    u32 first;
+    u32 baseVertexOrFirstInstance;
+    u32 firstInstance;
+};
+
+struct CullParams
+{
+    v4 planes[6];
+    u32 instanceCount;
+    u32 _pad[3];
+};
+static_assert( sizeof(CullParams) % 16 == 0 );
+
+// Bounds are uploaded as plain aabbs (center + half size, 24 bytes each) in a read-only storage buffer
+static_assert( sizeof(aabb) == 24 );
+
+struct InstanceCulling
+{
+    bool enabled;
+    u32 instanceCount;
+    // Camera planes for this frame, pointing inwards (see FrustumPlanes)
+    v4 planes[6];
+
+    BufferHandle boundsBuffer;
+    BufferHandle visibleBuffer;
+    BufferHandle argsBuffer;
+    BufferHandle paramsBuffer;
+};
+
+// Pipeline shared by everything that culls
+struct InstanceCuller
+{
+    WGPUBindGroupLayout bindGroupLayout;
+    WGPUComputePipeline pipeline;
+};
+
+
+// CPU batch culling
+// Bounds are kept as separate arrays of centers and extents, so SimdWidth boxes can be tested against each plane at once.
+// Arrays are padded to a multiple of SimdWidth, and the padding lanes are never reported as visible
+struct BoundsSoA
+{
+    std::vector<f32> cx, cy, cz;
+    std::vector<f32> ex, ey, ez;
+    u32 count;
+};
+
+// Boxes per job when culling from several threads. A multiple of any SimdWidth
+constexpr u32 CullBatchSize = 16 * 1024;
@@ -0,0 +1,422 @@
+
+// Open the file and get memory for its contents
+bool BeginFileLoad( FileLoad* load, bool overlapped )
+{
+    DWORD flags = FILE_FLAG_SEQUENTIAL_SCAN | (overlapped ? FILE_FLAG_OVERLAPPED : 0);
+    load->fileHandle = CreateFile( load->path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, flags, 0 );
+    if( load->fileHandle == INVALID_HANDLE_VALUE )
+    {
+        Log( "ERROR :: Failed opening file '%s' for reading", load->path );
+        load->fileHandle = nullptr;
+        return false;
+    }
+
+    if( !GetFileSizeEx( load->fileHandle, (PLARGE_INTEGER)&load->fileSize ) )
+    {
+        Log( "ERROR :: Failed querying file size for '%s'", load->path );
+        return false;
+    }
+
+    sz allocSize = load->nullTerminate ? load->fileSize + 1 : load->fileSize;
+    u8* data = load->dest;
+    if( data )
+    {
+        if( allocSize > load->destSize )
+        {
+            Log( "ERROR :: File '%s' (%lld bytes) doesn't fit in the memory given for it", load->path, load->fileSize );
+            return false;
+        }
+    }
+    else
+    {
+        data = (u8*)ALLOC( load->allocator ? load->allocator : &globalAlloc, Max<sz>( allocSize, 1 ) );
+        if( !data )
+        {
+            Log( "ERROR :: Couldn't allocate buffer for file contents" );
+            return false;
+        }
+    }
+
+    load->contents = Buffer<u8>( data, load->fileSize );
+    if( load->nullTerminate )
+        data[load->fileSize] = '\0';
+    load->nextOffset = 0;
+    load->readsInFlight = 0;
+    load->status.store( FileLoadStatus::Reading, std::memory_order_relaxed );
+    return true;
+}
+
+void FinishFileLoad( FileLoader* loader, FileLoad* load )
+{
+    if( load->fileHandle )
+    {
+        CloseHandle( load->fileHandle );
+        load->fileHandle = nullptr;
+    }
+
+    if( load->failed )
+    {
+        if( !load->dest && load->contents.data )
+            FREE( load->allocator ? load->allocator : &globalAlloc, load->contents.data );
+        load->contents = Buffer<u8>();
+    }
+    else
+    {
+        loader->bytesRead.fetch_add( load->fileSize, std::memory_order_relaxed );
+        loader->filesRead.fetch_add( 1, std::memory_order_relaxed );
+    }
+
+    // Without a callback the owner may free the load as soon as it sees it done
+    bool hasCallback = load->callback != nullptr;
+    load->status.store( load->failed ? FileLoadStatus::Failed : FileLoadStatus::Done, std::memory_order_release );
+    if( hasCallback )
+    {
+        std::lock_guard<std::mutex> lock( loader->completedMutex );
+        loader->completed.push_back( load );
+    }
+
+    // Taking the lock in between means a waiter either sees the new status or is already waiting
+    {
+        std::lock_guard<std::mutex> lock( loader->finishedMutex );
+    }
+    loader->loadFinished.notify_all();
+}
+
+// Highest priority first, in submission order
+FileLoad* PopQueuedFileLoad( FileLoader* loader, bool wait )
+{
+    std::unique_lock<std::mutex> lock( loader->queueMutex );
+    for( ;; )
+    {
+        for( std::deque<FileLoad*>& queue : loader->queued )
+        {
+            if( !queue.empty() )
+            {
+                FileLoad* load = queue.front();
+                queue.pop_front();
+                return load;
+            }
+        }
+
+        if( !wait || loader->quit )
+            return nullptr;
+        loader->queueChanged.wait( lock );
+    }
+}
+
+
+/////     BLOCKING READS    /////
+
+void RunFileLoaderThread( FileLoader* loader )
+{
+    while( FileLoad* load = PopQueuedFileLoad( loader, true ) )
+    {
+        load->failed = !BeginFileLoad( load, false );
+        while( !load->failed && load->nextOffset < load->fileSize )
+        {
+            DWORD size = (DWORD)Min<sz>( load->fileSize - load->nextOffset, FileLoadChunkSize );
+            DWORD bytesRead;
+            if( !ReadFile( load->fileHandle, load->contents.data + load->nextOffset, size, &bytesRead, 0 ) || bytesRead != size )
+            {
+                Log( "ERROR :: ReadFile failed for '%s'", load->path );
+                load->failed = true;
+            }
+            load->nextOffset += size;
+        }
+
+        FinishFileLoad( loader, load );
+    }
+}
+
+
+/////     COMPLETION PORT    /////
+
+void IssueFileRead( FileLoader* loader, FileLoad* load )
+{
+    FileReadChunk* chunk = loader->freeChunks.back();
+    loader->freeChunks.pop_back();
+
+    u64 offset = (u64)load->nextOffset;
+    chunk->overlapped = {};
+    chunk->overlapped.Offset = (DWORD)offset;
+    chunk->overlapped.OffsetHigh = (DWORD)(offset >> 32);
+    chunk->load = load;
+    chunk->size = (u32)Min<sz>( load->fileSize - load->nextOffset, FileLoadChunkSize );
+
+    // Completes through the port even when it finishes right away
+    if( !ReadFile( load->fileHandle, load->contents.data + offset, chunk->size, nullptr, &chunk->overlapped )
+        && GetLastError() != ERROR_IO_PENDING )
+    {
+        Log( "ERROR :: ReadFile failed for '%s'", load->path );
+        load->failed = true;
+        loader->freeChunks.push_back( chunk );
+        return;
+    }
+
+    load->nextOffset += chunk->size;
+    load->readsInFlight++;
+}
+
+INLINE bool IsFileLoadComplete( FileLoad const* load )
+{
+    return load->readsInFlight == 0 && (load->failed || load->nextOffset >= load->fileSize);
+}
+
+void CloseOpenFileLoad( FileLoader* loader, FileLoad* load )
+{
+    loader->open.erase( std::find( loader->open.begin(), loader->open.end(), load ) );
+    FinishFileLoad( loader, load );
+}
+
+void RunFileLoaderPort( FileLoader* loader )
+{
+    OVERLAPPED_ENTRY entries[MaxFileReadsInFlight];
+    for( ;; )
+    {
+        // Open more files while there's room, highest priority first
+        while( (int)loader->open.size() < MaxFilesOpen )
+        {
+            FileLoad* load = PopQueuedFileLoad( loader, false );
+            if( !load )
+                break;
+
+            load->failed = !BeginFileLoad( load, true )
+                || !CreateIoCompletionPort( load->fileHandle, loader->port, 0, 0 );
+            if( load->failed || load->fileSize == 0 )
+            {
+                FinishFileLoad( loader, load );
+                continue;
+            }
+
+            auto it = loader->open.begin();
+            while( it != loader->open.end() && (*it)->priority <= load->priority )
+                ++it;
+            loader->open.insert( it, load );
+        }
+
+        // Then keep as many reads going as we can, again by priority
+        for( sz i = 0; i < loader->open.size() && !loader->freeChunks.empty(); )
+        {
+            FileLoad* load = loader->open[i];
+            while( !loader->freeChunks.empty() && !load->failed && load->nextOffset < load->fileSize )
+                IssueFileRead( loader, load );
+
+            // Reads can fail to even start
+            if( IsFileLoadComplete( load ) )
+                CloseOpenFileLoad( loader, load );
+            else
+                ++i;
+        }
+
+        if( loader->open.empty() )
+        {
+            std::lock_guard<std::mutex> lock( loader->queueMutex );
+            bool queueEmpty = true;
+            for( std::deque<FileLoad*> const& queue : loader->queued )
+                queueEmpty = queueEmpty && queue.empty();
+            if( loader->quit && queueEmpty )
+                break;
+        }
+
+        ULONG count = 0;
+        if( !GetQueuedCompletionStatusEx( loader->port, entries, MaxFileReadsInFlight, &count, INFINITE, FALSE ) )
+            continue;
+
+        for( ULONG i = 0; i < count; ++i )
+        {
+            // Wake ups for new submissions don't carry anything
+            if( !entries[i].lpOverlapped )
+                continue;
+
+            FileReadChunk* chunk = (FileReadChunk*)entries[i].lpOverlapped;
+            FileLoad* load = chunk->load;
+            if( entries[i].dwNumberOfBytesTransferred != chunk->size )
+            {
+                Log( "ERROR :: ReadFile failed for '%s'", load->path );
+                load->failed = true;
+            }
+            load->readsInFlight--;
+            loader->freeChunks.push_back( chunk );
+
+            if( IsFileLoadComplete( load ) )
+                CloseOpenFileLoad( loader, load );
+        }
+    }
+}
+
+
+bool InitFileLoader( FileLoader* loader, FileLoaderMode mode /*= FileLoaderMode::Auto*/ )
+{
+    loader->quit = false;
+    loader->bytesRead = 0;
+    loader->filesRead = 0;
+
+    loader->port = nullptr;
+    if( mode == FileLoaderMode::Auto )
+    {
+        loader->port = CreateIoCompletionPort( INVALID_HANDLE_VALUE, NULL, 0, 1 );
+        if( !loader->port )
+        {
+            Log( "ERROR :: Could not create an IO completion port. Falling back to blocking reads" );
+            mode = FileLoaderMode::Threads;
+        }
+    }
+    loader->mode = mode;
+
+    if( loader->port )
+    {
+        loader->freeChunks.clear();
+        for( FileReadChunk& chunk : loader->chunks )
+            loader->freeChunks.push_back( &chunk );
+        loader->threads.emplace_back( RunFileLoaderPort, loader );
+    }
+    else
+    {
+        for( int i = 0; i < FileLoaderThreadCount; ++i )
+            loader->threads.emplace_back( RunFileLoaderThread, loader );
+    }
+
+    return true;
+}
+
+// Reads already under way are finished, but anything still queued is cancelled. Then every callback still due runs
+// (even for loads that did get read, which are cancelled too since there's no one left to use them)
+void ShutdownFileLoader( FileLoader* loader )
+{
+    std::vector<FileLoad*> cancelled;
+    {
+        std::lock_guard<std::mutex> lock( loader->queueMutex );
+        loader->quit = true;
+        for( std::deque<FileLoad*>& queue : loader->queued )
+        {
+            cancelled.insert( cancelled.end(), queue.begin(), queue.end() );
+            queue.clear();
+        }
+    }
+    loader->queueChanged.notify_all();
+    if( loader->port )
+        PostQueuedCompletionStatus( loader->port, 0, 0, nullptr );
+
+    for( std::thread& thread : loader->threads )
+        thread.join();
+    loader->threads.clear();
+
+    if( loader->port )
+        CloseHandle( loader->port );
+    loader->port = nullptr;
+    loader->open.clear();
+
+    for( FileLoad* load : loader->completed )
+    {
+        if( !load->dest && load->contents.data )
+            FREE( load->allocator ? load->allocator : &globalAlloc, load->contents.data );
+        load->contents = Buffer<u8>();
+        load->status.store( FileLoadStatus::Cancelled, std::memory_order_relaxed );
+    }
+    for( FileLoad* load : cancelled )
+    {
+        load->status.store( FileLoadStatus::Cancelled, std::memory_order_release );
+        if( load->callback )
+            loader->completed.push_back( load );
+    }
+    {
+        std::lock_guard<std::mutex> lock( loader->finishedMutex );
+    }
+    loader->loadFinished.notify_all();
+    ProcessFileLoads( loader );
+
+    // Nobody asked for these after all
+    for( PrefetchedFile* file : loader->prefetched )
+    {
+        if( file->load.status.load( std::memory_order_relaxed ) == FileLoadStatus::Done )
+            FREE( &globalAlloc, file->load.contents.data );
+        DELETE( &globalAlloc, file, PrefetchedFile );
+    }
+    loader->prefetched.clear();
+}
+
+void SubmitFileLoads( FileLoad* loads, int count, FileLoader* loader /*= &globalFileLoader*/ )
+{
+    {
+        std::lock_guard<std::mutex> lock( loader->queueMutex );
+        for( int i = 0; i < count; ++i )
+        {
+            FileLoad* load = &loads[i];
+            load->status.store( FileLoadStatus::Queued, std::memory_order_relaxed );
+            load->contents = Buffer<u8>();
+            load->fileHandle = nullptr;
+            load->failed = false;
+            loader->queued[(int)load->priority].push_back( load );
+        }
+    }
+
+    if( loader->port )
+        PostQueuedCompletionStatus( loader->port, 0, 0, nullptr );
+    else
+        loader->queueChanged.notify_all();
+}
+
+// Run the callbacks of all loads finished since last time. Returns how many there were
+int ProcessFileLoads( FileLoader* loader /*= &globalFileLoader*/ )
+{
+    std::vector<FileLoad*> completed;
+    {
+        std::lock_guard<std::mutex> lock( loader->completedMutex );
+        completed.swap( loader->completed );
+    }
+
+    for( FileLoad* load : completed )
+        load->callback( load, load->userdata );
+    return (int)completed.size();
+}
+
+// Block until the load is finished. Returns whether it succeeded
+bool WaitForFileLoad( FileLoad* load, FileLoader* loader /*= &globalFileLoader*/ )
+{
+    if( !IsFileLoadFinished( load ) )
+    {
+        std::unique_lock<std::mutex> lock( loader->finishedMutex );
+        loader->loadFinished.wait( lock, [load]() { return IsFileLoadFinished( load ); } );
+    }
+    return load->status.load( std::memory_order_acquire ) == FileLoadStatus::Done;
+}
+
+// Start reading a file that'll be asked for later through TakePrefetchedFile. Does nothing if it's already on its way
+void PrefetchFile( char const* path, bool nullTerminate /*= false*/, FileLoader* loader /*= &globalFileLoader*/ )
+{
+    for( PrefetchedFile* file : loader->prefetched )
+    {
+        if( file->path == path )
+            return;
+    }
+
+    PrefetchedFile* file = NEW( &globalAlloc, PrefetchedFile )();
+    file->path = path;
+    file->load.path = file->path.c_str();
+    file->load.priority = FileLoadPriority::Normal;
+    file->load.nullTerminate = nullTerminate;
+    loader->prefetched.push_back( file );
+    SubmitFileLoads( &file->load, 1, loader );
+}
+
+// Hand over the contents of a prefetched file, waiting for it if it's still being read. Empty if it wasn't prefetched
+// or couldn't be read, so the caller can just read it some other way. The contents are the caller's to free (from
+// globalAlloc)
+Buffer<u8> TakePrefetchedFile( char const* path, FileLoader* loader /*= &globalFileLoader*/ )
+{
+    auto it = std::find_if( loader->prefetched.begin(), loader->prefetched.end(), [=]( PrefetchedFile const* file )
+    {
+        return file->path == path;
+    } );
+    if( it == loader->prefetched.end() )
+        return Buffer<u8>();
+
+    PrefetchedFile* file = *it;
+    loader->prefetched.erase( it );
+
+    Buffer<u8> contents;
+    if( WaitForFileLoad( &file->load, loader ) )
+        contents = file->load.contents;
+    DELETE( &globalAlloc, file, PrefetchedFile );
+    return contents;
+}
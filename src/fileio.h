@@ -0,0 +1,131 @@
+#pragma once
+
+// Asynchronous file loading
+// Loads are submitted in batches and read in the background, straight into caller memory or into memory from a given
+// allocator. Higher priority loads are opened and read first. On Windows a single IO thread keeps many overlapped
+// reads in flight through an IO completion port, splitting big files into chunks; if the port can't be created (or
+// when asked to) a few threads doing plain blocking reads take over instead.
+// Each load works as a future (poll its status or wait on it) and can also have a callback, which runs on whichever
+// thread calls ProcessFileLoads, so it can safely touch the device and other main thread state.
+// Files can also be prefetched: read ahead of time by whoever knows they'll be needed (e.g. a program's assets while the
+// device is being created), and then taken by whatever loads them, waiting only if they aren't in yet.
+// Shutting down cancels whatever hasn't been read yet, and still runs every callback that's due (with the load marked
+// as cancelled) so owners get a chance to free whatever they allocated for it.
+
+struct FileLoad;
+using FileLoadCallback = void( FileLoad* load, void* userdata );
+
+enum class FileLoadPriority : u8
+{
+    High,           // Something the frame is waiting on (e.g. a shader that changed)
+    Normal,
+    Low,            // Streaming and prefetching
+    Count
+};
+
+enum class FileLoadStatus : u8
+{
+    Queued,
+    Reading,
+    Done,
+    Failed,
+    Cancelled,      // The loader shut down before it was read, or before its callback ran
+};
+
+enum class FileLoaderMode
+{
+    Auto,           // Completion port, falling back to threads
+    Threads,        // Blocking reads on a few threads
+};
+
+// Read size for big files, and how many reads the completion port keeps in flight
+constexpr u32 FileLoadChunkSize = 4 * 1024 * 1024;
+constexpr int MaxFileReadsInFlight = 64;
+constexpr int MaxFilesOpen = 64;
+constexpr int FileLoaderThreadCount = 4;
+
+// Owned by whoever submits it, and must stay alive until it's done (or its callback has run, if it has one)
+struct FileLoad
+{
+    // Request
+    char const* path;                   // Must stay valid until done
+    u8* dest;                           // Caller memory for the contents, or null to allocate it
+    sz destSize;                        // Loads fail if the file doesn't fit in here
+    Allocator* allocator;               // Where the contents go when there's no dest (globalAlloc if null). Must be
+                                        // safe to use from the loader threads
+    FileLoadCallback* callback;
+    void* userdata;
+    FileLoadPriority priority;
+    bool nullTerminate;                 // Add a 0 after the contents, to help when handling text files
+
+    // Result
+    std::atomic<FileLoadStatus> status;
+    Buffer<u8> contents;                // Not including the null terminator
+
+    // Internal
+    HANDLE fileHandle;
+    sz fileSize;
+    sz nextOffset;
+    i32 readsInFlight;
+    bool failed;
+};
+
+struct PrefetchedFile
+{
+    std::string path;
+    FileLoad load;
+};
+
+struct FileReadChunk
+{
+    OVERLAPPED overlapped;              // Must be first
+    FileLoad* load;
+    u32 size;
+};
+
+struct FileLoader
+{
+    FileLoaderMode mode;
+    HANDLE port;
+    std::vector<std::thread> threads;
+
+    std::mutex queueMutex;
+    std::condition_variable queueChanged;
+    std::deque<FileLoad*> queued[(int)FileLoadPriority::Count];
+    bool quit;
+
+    // Completion port state, only touched by the IO thread
+    std::vector<FileLoad*> open;        // In priority order
+    FileReadChunk chunks[MaxFileReadsInFlight];
+    std::vector<FileReadChunk*> freeChunks;
+
+    // Finished loads waiting for their callback
+    std::mutex completedMutex;
+    std::vector<FileLoad*> completed;
+
+    // Signalled every time a load finishes, for WaitForFileLoad
+    std::mutex finishedMutex;
+    std::condition_variable loadFinished;
+
+    // Read ahead and not taken yet. Main thread only
+    std::vector<PrefetchedFile*> prefetched;
+
+    std::atomic<u64> bytesRead;
+    std::atomic<u32> filesRead;
+};
+
+extern FileLoader globalFileLoader;
+
+bool InitFileLoader( FileLoader* loader, FileLoaderMode mode = FileLoaderMode::Auto );
+void ShutdownFileLoader( FileLoader* loader );
+void SubmitFileLoads( FileLoad* loads, int count, FileLoader* loader = &globalFileLoader );
+int ProcessFileLoads( FileLoader* loader = &globalFileLoader );
+bool WaitForFileLoad( FileLoad* load, FileLoader* loader = &globalFileLoader );
+void PrefetchFile( char const* path, bool nullTerminate = false, FileLoader* loader = &globalFileLoader );
+Buffer<u8> TakePrefetchedFile( char const* path, FileLoader* loader = &globalFileLoader );
+
+INLINE bool IsFileLoadFinished( FileLoad const* load )
+{
+    FileLoadStatus status = load->status.load( std::memory_order_acquire );
+    return status == FileLoadStatus::Done || status == FileLoadStatus::Failed || status == FileLoadStatus::Cancelled;
+}
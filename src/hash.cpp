@@ -0,0 +1,99 @@
+
+// Same as the template version, 4 or 8 lanes at a time
+void HashAccumulate( u64* acc, u8 const* p, sz stripes, u64 const* keys )
+{
+#if SIMD_AVX2
+    __m256i acc0 = _mm256_loadu_si256( (__m256i const*)acc );
+    __m256i acc1 = _mm256_loadu_si256( (__m256i const*)(acc + 4) );
+    for( sz s = 0; s < stripes; ++s, p += HashStripeSize )
+    {
+        __m256i data0 = _mm256_loadu_si256( (__m256i const*)p );
+        __m256i data1 = _mm256_loadu_si256( (__m256i const*)(p + 32) );
+        __m256i keyed0 = _mm256_xor_si256( data0, _mm256_loadu_si256( (__m256i const*)(keys + s) ) );
+        __m256i keyed1 = _mm256_xor_si256( data1, _mm256_loadu_si256( (__m256i const*)(keys + s + 4) ) );
+
+        // Low half times high half of every lane, plus the data of the neighbouring lane
+        __m256i product0 = _mm256_mul_epu32( keyed0, _mm256_srli_epi64( keyed0, 32 ) );
+        __m256i product1 = _mm256_mul_epu32( keyed1, _mm256_srli_epi64( keyed1, 32 ) );
+        __m256i swapped0 = _mm256_shuffle_epi32( data0, _MM_SHUFFLE( 1, 0, 3, 2 ) );
+        __m256i swapped1 = _mm256_shuffle_epi32( data1, _MM_SHUFFLE( 1, 0, 3, 2 ) );
+        acc0 = _mm256_add_epi64( acc0, _mm256_add_epi64( product0, swapped0 ) );
+        acc1 = _mm256_add_epi64( acc1, _mm256_add_epi64( product1, swapped1 ) );
+    }
+    _mm256_storeu_si256( (__m256i*)acc, acc0 );
+    _mm256_storeu_si256( (__m256i*)(acc + 4), acc1 );
+#else
+    __m128i accs[4];
+    for( int i = 0; i < 4; ++i )
+        accs[i] = _mm_loadu_si128( (__m128i const*)(acc + i * 2) );
+    for( sz s = 0; s < stripes; ++s, p += HashStripeSize )
+    {
+        for( int i = 0; i < 4; ++i )
+        {
+            __m128i data = _mm_loadu_si128( (__m128i const*)(p + i * 16) );
+            __m128i keyed = _mm_xor_si128( data, _mm_loadu_si128( (__m128i const*)(keys + s + i * 2) ) );
+            __m128i product = _mm_mul_epu32( keyed, _mm_srli_epi64( keyed, 32 ) );
+            __m128i swapped = _mm_shuffle_epi32( data, _MM_SHUFFLE( 1, 0, 3, 2 ) );
+            accs[i] = _mm_add_epi64( accs[i], _mm_add_epi64( product, swapped ) );
+        }
+    }
+    for( int i = 0; i < 4; ++i )
+        _mm_storeu_si128( (__m128i*)(acc + i * 2), accs[i] );
+#endif
+}
+
+
+void BeginHash( HashState* state, u64 seed /*= 0*/ )
+{
+    InitHashKeys( state->keys, seed );
+    InitHashAccumulators( state->acc );
+    state->bufferSize = 0;
+    state->totalSize = 0;
+    state->seed = seed;
+}
+
+INLINE void HashBlock( HashState* state, u8 const* block )
+{
+    HashAccumulate( state->acc, block, HashBlockStripes, state->keys );
+    HashScramble( state->acc, state->keys );
+}
+
+void UpdateHash( HashState* state, void const* data, sz size )
+{
+    u8 const* p = (u8 const*)data;
+    state->totalSize += size;
+
+    // Finish the block already started first
+    if( state->bufferSize )
+    {
+        sz count = Min( size, HashBlockSize - state->bufferSize );
+        COPYP( p, state->buffer + state->bufferSize, count );
+        state->bufferSize += count;
+        p += count;
+        size -= count;
+
+        if( state->bufferSize < HashBlockSize )
+            return;
+        HashBlock( state, state->buffer );
+        state->bufferSize = 0;
+    }
+
+    // Whole blocks straight from the input
+    for( ; size >= HashBlockSize; p += HashBlockSize, size -= HashBlockSize )
+        HashBlock( state, p );
+
+    COPYP( p, state->buffer, size );
+    state->bufferSize = size;
+}
+
+// The state is left as is, so more data can still be added after
+Hash128 FinishHash( HashState const* state )
+{
+    // Short inputs never leave the buffer
+    if( state->totalSize <= HashShortMax )
+        return HashShort( state->buffer, (sz)state->totalSize, state->seed );
+
+    u64 acc[8];
+    COPY( state->acc, acc );
+    return FinishLongHash( acc, state->keys, state->buffer, state->bufferSize, state->totalSize );
+}
@@ -0,0 +1,231 @@
+#pragma once
+
+// Content hashing for cache keys and deduplication. Not meant to resist anyone crafting collisions on purpose.
+// Inputs get split into 64 byte stripes, each one mixed into 8 64-bit accumulators with 32 x 32 -> 64 bit multiplies,
+// which SSE2 and AVX2 do several lanes at a time. Accumulators are scrambled after every 1 KB block and folded into 128
+// bits at the end. Small inputs (up to 128 bytes) skip all that and go through a couple of multiply-folds per 16 bytes.
+// The SIMD paths, the streaming API and the constexpr variant (for hashing string literals at compile time) all give
+// exactly the same results, so hashes can be stored and compared across builds.
+
+struct Hash128
+{
+    u64 lo;
+    u64 hi;
+
+    constexpr bool operator ==( Hash128 const& other ) const { return lo == other.lo && hi == other.hi; }
+    constexpr bool operator !=( Hash128 const& other ) const { return !(*this == other); }
+};
+
+constexpr sz HashStripeSize = 64;
+constexpr sz HashBlockStripes = 16;
+constexpr sz HashBlockSize = HashStripeSize * HashBlockStripes;
+constexpr sz HashShortMax = 128;
+// Every stripe in a block uses a different window of 8 keys, sliding one key each time
+constexpr int HashKeyCount = (int)HashBlockStripes + 8;
+
+constexpr u64 HashPrime1 = 0x9E3779B185EBCA87ull;
+constexpr u64 HashPrime2 = 0xC2B2AE3D27D4EB4Full;
+constexpr u64 HashPrime3 = 0x165667B19E3779F9ull;
+constexpr u64 HashPrime32 = 0x9E3779B1ull;
+
+constexpr u64 HashKeys[HashKeyCount] =
+{
+    0xDAEB8EBD244A330Dull, 0x685BD8519D0023DBull, 0x959EF8713231C2CBull, 0xD1EA2FA4DD9AF44Dull,
+    0xA402CBA46B82BDDDull, 0x4F7580CD7B17A39Full, 0xC8B045B99D6FB287ull, 0xCECA0CA0C351E0A7ull,
+    0x38987F53584DF3C9ull, 0xBB74476EE0B6E30Full, 0x9474C83868219521ull, 0xA309F5FBA2117B35ull,
+    0xF901131499F29AADull, 0x6568525F65BE34AFull, 0xE61C980E7426B629ull, 0xF330A10B9EFE9905ull,
+    0x39381640553D574Dull, 0x0E6C783BD0D3AAC1ull, 0x992877185800058Bull, 0xE2B445A3CB88BB31ull,
+    0x42381838BF9D61AFull, 0x475B2AF9C112B40Full, 0x9D73761A2479742Full, 0xA5869770CC27FDBBull,
+};
+
+// Running state for hashing data that comes in pieces
+struct HashState
+{
+    u64 acc[8];
+    u64 keys[HashKeyCount];
+    u8 buffer[HashBlockSize];           // Start of the current block
+    sz bufferSize;
+    u64 totalSize;
+    u64 seed;
+};
+
+void BeginHash( HashState* state, u64 seed = 0 );
+void UpdateHash( HashState* state, void const* data, sz size );
+Hash128 FinishHash( HashState const* state );
+
+
+// Everything below is templated on the byte type so the exact same code can run at compile time (on chars) and at
+// runtime (on u8s, where plain loads and SIMD take over through the non-template overloads)
+
+// Little endian load of up to 8 bytes
+template <typename T>
+constexpr u64 HashRead( T const* p, sz count )
+{
+    u64 result = 0;
+    for( sz i = 0; i < count; ++i )
+        result |= (u64)(u8)p[i] << (8 * i);
+    return result;
+}
+
+INLINE u64 HashRead( u8 const* p, sz count )
+{
+    u64 result = 0;
+    if( count == 8 )
+        memcpy( &result, p, 8 );
+    else
+        memcpy( &result, p, count );
+    return result;
+}
+
+// Mix a number of stripes into the accumulators. Keys are for the first stripe
+template <typename T>
+constexpr void HashAccumulate( u64* acc, T const* p, sz stripes, u64 const* keys )
+{
+    for( sz s = 0; s < stripes; ++s )
+    {
+        for( int i = 0; i < 8; ++i )
+        {
+            u64 data = HashRead( p + s * HashStripeSize + i * 8, 8 );
+            u64 keyed = data ^ keys[s + i];
+            acc[i ^ 1] += data;
+            acc[i] += (keyed & 0xFFFFFFFF) * (keyed >> 32);
+        }
+    }
+}
+
+void HashAccumulate( u64* acc, u8 const* p, sz stripes, u64 const* keys );
+
+// Full 64 x 64 -> 128 bit product, with both halves xored together
+constexpr u64 MulFold64( u64 a, u64 b )
+{
+    u64 aLo = a & 0xFFFFFFFF, aHi = a >> 32;
+    u64 bLo = b & 0xFFFFFFFF, bHi = b >> 32;
+    u64 lolo = aLo * bLo;
+    u64 hilo = aHi * bLo;
+    u64 lohi = aLo * bHi;
+    u64 hihi = aHi * bHi;
+
+    u64 cross = (lolo >> 32) + (hilo & 0xFFFFFFFF) + lohi;
+    u64 hi = hihi + (hilo >> 32) + (cross >> 32);
+    u64 lo = (cross << 32) | (lolo & 0xFFFFFFFF);
+    return lo ^ hi;
+}
+
+constexpr u64 HashAvalanche( u64 x )
+{
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+constexpr void InitHashKeys( u64* keys, u64 seed )
+{
+    for( int i = 0; i < HashKeyCount; ++i )
+        keys[i] = (i & 1) ? HashKeys[i] - seed : HashKeys[i] + seed;
+}
+
+constexpr void InitHashAccumulators( u64* acc )
+{
+    for( int i = 0; i < 8; ++i )
+        acc[i] = HashPrime1 * (u64)(i + 1);
+}
+
+constexpr void HashScramble( u64* acc, u64 const* keys )
+{
+    for( int i = 0; i < 8; ++i )
+    {
+        u64 a = acc[i];
+        a ^= a >> 47;
+        a ^= keys[HashBlockStripes + i];
+        acc[i] = a * HashPrime32;
+    }
+}
+
+template <typename T>
+constexpr Hash128 HashShort( T const* p, sz size, u64 seed )
+{
+    u64 lo = seed + size * HashPrime1;
+    u64 hi = HashAvalanche( seed ^ HashPrime3 ) - size * HashPrime2;
+    for( sz i = 0; i < size; i += 16 )
+    {
+        sz rest = size - i;
+        u64 a = HashRead( p + i, rest < 8 ? rest : 8 );
+        u64 b = rest > 8 ? HashRead( p + i + 8, rest < 16 ? rest - 8 : 8 ) : 0;
+
+        sz k = i / 8;
+        lo += MulFold64( a ^ (HashKeys[k] + seed), b ^ (HashKeys[k + 1] - seed) );
+        hi += MulFold64( a ^ (HashKeys[k + 8] - seed), b ^ (HashKeys[k + 9] + seed) );
+    }
+
+    return { HashAvalanche( lo + hi ), HashAvalanche( hi + lo * HashPrime3 ) };
+}
+
+// Whatever is left after the last full block, and the final fold
+template <typename T>
+constexpr Hash128 FinishLongHash( u64* acc, u64 const* keys, T const* tail, sz tailSize, u64 totalSize )
+{
+    sz stripes = tailSize / HashStripeSize;
+    HashAccumulate( acc, tail, stripes, keys );
+
+    sz rest = tailSize % HashStripeSize;
+    if( rest )
+    {
+        // Zero padded. The total size goes into the result, so that doesn't make different inputs collide
+        T last[HashStripeSize] = {};
+        for( sz i = 0; i < rest; ++i )
+            last[i] = tail[stripes * HashStripeSize + i];
+        HashAccumulate( acc, last, 1, keys + stripes );
+    }
+
+    u64 lo = totalSize * HashPrime1;
+    u64 hi = ~(totalSize * HashPrime2);
+    for( int i = 0; i < 8; i += 2 )
+    {
+        lo += MulFold64( acc[i] ^ keys[i + 3], acc[i + 1] ^ keys[i + 4] );
+        hi += MulFold64( acc[i] ^ keys[i + 13], acc[i + 1] ^ keys[i + 14] );
+    }
+    return { HashAvalanche( lo ), HashAvalanche( hi ) };
+}
+
+template <typename T>
+constexpr Hash128 HashLong( T const* p, sz size, u64 seed )
+{
+    u64 keys[HashKeyCount] = {};
+    u64 acc[8] = {};
+    InitHashKeys( keys, seed );
+    InitHashAccumulators( acc );
+
+    sz blocks = size / HashBlockSize;
+    for( sz b = 0; b < blocks; ++b )
+    {
+        HashAccumulate( acc, p + b * HashBlockSize, HashBlockStripes, keys );
+        HashScramble( acc, keys );
+    }
+
+    return FinishLongHash( acc, keys, p + blocks * HashBlockSize, size % HashBlockSize, size );
+}
+
+
+INLINE Hash128 HashBytes128( void const* data, sz size, u64 seed = 0 )
+{
+    u8 const* p = (u8 const*)data;
+    return size <= HashShortMax ? HashShort( p, size, seed ) : HashLong( p, size, seed );
+}
+
+INLINE u64 HashBytes64( void const* data, sz size, u64 seed = 0 )
+{
+    return HashBytes128( data, size, seed ).lo;
+}
+
+// Same results as HashBytes128 on the same bytes, but usable at compile time
+constexpr Hash128 HashString128( char const* str, sz length, u64 seed = 0 )
+{
+    return length <= HashShortMax ? HashShort( str, length, seed ) : HashLong( str, length, seed );
+}
+
+// e.g. constexpr u64 key = HashLiteral( "shadow pass" );
+template <sz N>
+constexpr u64 HashLiteral( char const (&str)[N], u64 seed = 0 )
+{
+    return HashString128( str, N - 1, seed ).lo;
+}
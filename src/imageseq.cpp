@@ -0,0 +1,280 @@
+void EncodeImageJob( Job const& job );
+
+// Hand mapped frames to encoding jobs, while fewer than encoderCount are running. Each job gets the ring index of
+// its frame as begin, and a conversion buffer of its own as end
+void StartImageEncodes( ImageSequenceExporter* exporter )
+{
+    u64 depth = exporter->readbacks.slots.size();
+    for( ;; )
+    {
+        EncodedImage* image;
+        {
+            std::lock_guard<std::mutex> lock( exporter->queueMutex );
+            if( exporter->encodeQueue.empty() || exporter->freePixelBuffers.empty() )
+                return;
+
+            ReadbackSlot* slot = exporter->encodeQueue.front();
+            exporter->encodeQueue.pop_front();
+            int buffer = exporter->freePixelBuffers.back();
+            exporter->freePixelBuffers.pop_back();
+
+            image = &exporter->images[slot->index % depth];
+            image->job = { EncodeImageJob, exporter, (sz)(slot->index % depth), (sz)buffer, nullptr };
+        }
+
+        // Outside the lock, since the job may run right here (no workers, or a full queue)
+        SubmitJobs( &image->job, 1, &exporter->encodeJobs );
+    }
+}
+
+// Compress a frame, and write out whatever is next due. Only one job writes at a time, so files always come out
+// in frame order
+void EncodeImageJob( Job const& job )
+{
+    ImageSequenceExporter* exporter = (ImageSequenceExporter*)job.data;
+    ReadbackSlot* slot = exporter->readbacks.slots[job.begin];
+    EncodedImage* image = &exporter->images[job.begin];
+    u64 depth = exporter->readbacks.slots.size();
+
+    std::vector<u8>& pixels = exporter->pixelBuffers[job.end];
+    pixels.resize( (sz)exporter->width * exporter->height * 3 );
+    char path[1024];
+
+    image->png.clear();
+    if( slot->data )
+    {
+        for( u32 y = 0; y < exporter->height; ++y )
+            PackRGBRow( slot->data + (sz)y * exporter->readbacks.bytesPerRow, pixels.data() + (sz)y * exporter->width * 3,
+                        exporter->width, exporter->swapRedBlue );
+
+        auto append = []( void* context, void* data, int size )
+        {
+            std::vector<u8>* png = (std::vector<u8>*)context;
+            png->insert( png->end(), (u8 const*)data, (u8 const*)data + size );
+        };
+        // Only touches its own buffers, so any number of jobs can be at it at once
+        if( !stbi_write_png_to_func( append, &image->png, (int)exporter->width, (int)exporter->height, 3, pixels.data(),
+                                     (int)exporter->width * 3 ) )
+            image->png.clear();
+    }
+
+    std::unique_lock<std::mutex> lock( exporter->queueMutex );
+    image->encoded = true;
+    if( !exporter->writing )
+    {
+        exporter->writing = true;
+        for( ;; )
+        {
+            ReadbackSlot* next = exporter->readbacks.slots[exporter->nextWrite % depth];
+            EncodedImage* nextImage = &exporter->images[exporter->nextWrite % depth];
+            if( next->state != ReadbackState::Busy || next->index != exporter->nextWrite || !nextImage->encoded )
+                break;
+
+            bool failed = exporter->writeFailed;
+            lock.unlock();
+            if( nextImage->png.empty() )
+                failed = true;
+            else if( !failed )
+            {
+                snprintf( path, sizeof(path), "%s%05llu.png", exporter->prefix.c_str(), next->index );
+                failed = !Platform::WriteEntireFile( path, nextImage->png.data(), (sz)nextImage->png.size() );
+                if( failed )
+                {
+                    Log( "ERROR :: Could not write '%s'", path );
+                }
+                else
+                    exporter->bytesWritten += nextImage->png.size();
+            }
+            lock.lock();
+
+            exporter->writeFailed = exporter->writeFailed || failed;
+            nextImage->encoded = false;
+            next->state = ReadbackState::Done;
+            exporter->nextWrite++;
+            exporter->framesWritten++;
+        }
+        exporter->writing = false;
+    }
+    exporter->freePixelBuffers.push_back( (int)job.end );
+    lock.unlock();
+
+    // Before this job counts as done, so waiting on encodeJobs also covers whatever it starts
+    StartImageEncodes( exporter );
+}
+
+// Mapped frames get queued for the encoders, oldest first
+void QueueImageFrame( ReadbackSlot* slot, void* userdata )
+{
+    ImageSequenceExporter* exporter = (ImageSequenceExporter*)userdata;
+    if( slot->mapFailed )
+        Log( "ERROR :: Could not map frame %llu", slot->index );
+
+    {
+        std::lock_guard<std::mutex> lock( exporter->queueMutex );
+        exporter->encodeQueue.push_back( slot );
+    }
+    StartImageEncodes( exporter );
+}
+
+// Frames are only written in order, and possibly by some other job than their own, so this just helps out with all
+// encoding in flight until it's done. Waiting runs jobs, so it can't stall even when this is the only worker
+void WaitForImageWritten( ReadbackSlot* slot, void* userdata )
+{
+    ImageSequenceExporter* exporter = (ImageSequenceExporter*)userdata;
+    WaitForCounter( &exporter->encodeJobs );
+}
+
+void ReleaseImageSequence( ImageSequenceExporter* exporter )
+{
+    if( exporter->targetView )
+        wgpuTextureViewRelease( exporter->targetView );
+    DestroyGPUTexture( exporter->target );
+    exporter->targetView = nullptr;
+    exporter->target = nullptr;
+
+    ReleaseReadbackRing( &exporter->readbacks );
+    exporter->images.clear();
+    exporter->pixelBuffers.clear();
+    exporter->freePixelBuffers.clear();
+}
+
+// Frames are rendered by the current program at the given size. Encoders default to one per job system worker, and
+// frames in flight to twice that, so every encoder has its next frame ready when it's done with one
+bool BeginImageSequence( ImageSequenceExporter* exporter, char const* prefix, u32 width, u32 height,
+                         int encoderCount /*= 0*/, int maxFramesInFlight /*= 0*/ )
+{
+    if( !GetReadbackSwizzle( globalSwapChainFormat, &exporter->swapRedBlue ) )
+    {
+        Log( "ERROR :: Can't export images from swap chain format %d", globalSwapChainFormat );
+        return false;
+    }
+    if( !width || !height || width > globalLimits.maxTextureDimension2D || height > globalLimits.maxTextureDimension2D )
+    {
+        Log( "ERROR :: Can't export %u x %u images", width, height );
+        return false;
+    }
+
+    if( encoderCount <= 0 )
+        encoderCount = GetWorkerCount();
+    if( maxFramesInFlight <= 0 )
+        maxFramesInFlight = encoderCount * 2;
+    maxFramesInFlight = Max( maxFramesInFlight, 2 );
+
+    exporter->width = width;
+    exporter->height = height;
+    exporter->prefix = prefix;
+    exporter->encodeQueue.clear();
+    exporter->encodeJobs.pending = 0;
+    exporter->encodeJobs.continuation = nullptr;
+    exporter->writing = false;
+    exporter->nextWrite = 0;
+    exporter->writeFailed = false;
+    exporter->framesWritten = 0;
+    exporter->bytesWritten = 0;
+    exporter->elapsedMillis = 0;
+    exporter->cpuMillis = 0;
+
+    // Create the folder files go into, if any
+    std::string dir = exporter->prefix;
+    std::replace( dir.begin(), dir.end(), '\\', '/' );
+    sz slash = dir.rfind( '/' );
+    if( slash != std::string::npos && slash > 0 )
+        Platform::EnsureDirectoryExists( dir.substr( 0, slash ).c_str() );
+
+    WGPUTextureDescriptor textureDesc = {};
+    textureDesc.nextInChain           = nullptr;
+    textureDesc.label                 = "Exported frame";
+    textureDesc.usage                 = WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_CopySrc;
+    textureDesc.dimension             = WGPUTextureDimension_2D;
+    textureDesc.size                  = { width, height, 1 };
+    textureDesc.format                = globalSwapChainFormat;
+    textureDesc.mipLevelCount         = 1;
+    textureDesc.sampleCount           = 1;
+    textureDesc.viewFormatCount       = 0;
+    textureDesc.viewFormats           = nullptr;
+    exporter->target = CreateGPUTexture( &textureDesc, "Image export" );
+    if( exporter->target )
+        exporter->targetView = wgpuTextureCreateView( exporter->target, nullptr );
+
+    bool readbacksOk = InitTextureReadbackRing( &exporter->readbacks, maxFramesInFlight, width, height, "Image readback",
+                                                "Image export" );
+    exporter->images.assign( (sz)maxFramesInFlight, EncodedImage() );
+
+    if( !exporter->targetView || !readbacksOk )
+    {
+        Log( "ERROR :: Could not create image export resources for %u x %u", width, height );
+        ReleaseImageSequence( exporter );
+        return false;
+    }
+
+    // Buffers are only allocated once a job first uses them
+    exporter->pixelBuffers.resize( (sz)encoderCount );
+    for( int i = encoderCount - 1; i >= 0; --i )
+        exporter->freePixelBuffers.push_back( i );
+
+    exporter->startMillis = Platform::CurrentTimeMillis();
+    exporter->cpuMillis = Platform::ProcessCPUTimeMillis();
+
+    Log( "Exporting %u x %u frames to '%s*.png' with %d encoders, up to %d frames in flight",
+         width, height, prefix, encoderCount, maxFramesInFlight );
+    return true;
+}
+
+// Render the current program into the next frame and queue it for encoding. Only blocks when all readback slots are
+// still busy, i.e. the GPU or the encoders are behind
+bool ExportImageFrame( ImageSequenceExporter* exporter )
+{
+    WaitForReadbackSlot( &exporter->readbacks, NextReadbackSlot( &exporter->readbacks ), QueueImageFrame, WaitForImageWritten,
+                         exporter );
+
+    if( !SubmitFrameTo( exporter->targetView, 0 ) )
+        return false;
+    ReadbackTextureAsync( &exporter->readbacks, exporter->target, exporter->width, exporter->height, "Image export" );
+
+    // Pick up whatever finished meanwhile, without waiting on anything
+    PollDevice( false );
+    RetireReadbacks( &exporter->readbacks, QueueImageFrame, exporter );
+    return true;
+}
+
+// Encode and write every frame still in flight, then release everything
+void EndImageSequence( ImageSequenceExporter* exporter )
+{
+    FinishReadbacks( &exporter->readbacks, QueueImageFrame, WaitForImageWritten, exporter );
+    WaitForCounter( &exporter->encodeJobs );
+
+    ReleaseImageSequence( exporter );
+    exporter->elapsedMillis = Platform::CurrentTimeMillis() - exporter->startMillis;
+    exporter->cpuMillis = Platform::ProcessCPUTimeMillis() - exporter->cpuMillis;
+
+    u64 frames = exporter->framesWritten;
+    f64 seconds = Max( exporter->elapsedMillis * 0.001, 1e-9 );
+    Log( "Exported %llu frames in %.2f s: %.1f fps, %.1f MB written, %.2f cores busy%s", frames, seconds, frames / seconds,
+         exporter->bytesWritten / (1024.0 * 1024.0), exporter->cpuMillis / exporter->elapsedMillis,
+         exporter->writeFailed ? " (writing FAILED)" : "" );
+}
+
+// Offline export: frames advance the program's clock by exactly one frame each, however long they take
+bool ExportProgramImages( Program& program, char const* prefix, u32 width, u32 height, u32 frameCount, u32 fps,
+                          int encoderCount /*= 0*/ )
+{
+    if( !SetCurrentProgram( program ) )
+        return false;
+
+    ImageSequenceExporter exporter = {};
+    if( !BeginImageSequence( &exporter, prefix, width, height, encoderCount ) )
+        return false;
+
+    fps = Max( fps, 1u );
+    bool result = true;
+    for( u32 i = 0; i < frameCount && result; ++i )
+    {
+        Platform::SetFixedAppTime( i * 1000.0 / fps );
+        UpdateCurrentProgramInputs( (f32)width, (f32)height );
+        result = ExportImageFrame( &exporter );
+    }
+    EndImageSequence( &exporter );
+    Platform::SetFixedAppTime( -1 );
+
+    return result && !exporter.writeFailed;
+}
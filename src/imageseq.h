@@ -0,0 +1,60 @@
+#pragma once
+
+// Image sequence export
+// The current program renders offscreen, frames get read back through a ring of buffers, and encoding jobs on the job
+// system (see threading.h) compress them into PNGs (with stb_image_write), several frames at once. Files are always
+// written in frame order, whatever order the jobs finish in: <prefix>00000.png, <prefix>00001.png, ...
+// A frame holds its slot from the moment it's rendered until its file is written, so the ring size bounds how far
+// rendering can run ahead of the encoders (and how much memory all that takes). Once it's full, exporting the next
+// frame waits for the oldest one to be written.
+
+// zlib style level, passed on to stb_image_write once at startup. Higher gives (slightly) smaller files, slower
+constexpr int PNGCompressionLevel = 8;
+
+// What the encoders make of the frame in the readback slot of the same index
+struct EncodedImage
+{
+    Job job;
+    bool encoded;               // Waiting for the frames before it to be written
+    std::vector<u8> png;
+};
+
+struct ImageSequenceExporter
+{
+    u32 width;
+    u32 height;
+    bool swapRedBlue;           // BGRA targets
+    std::string prefix;
+
+    WGPUTexture target;
+    WGPUTextureView targetView;
+
+    // Frames stay with the encoders (busy) from the moment they're mapped until their file is written
+    ReadbackRing readbacks;
+    std::vector<EncodedImage> images;
+
+    // Mapped frames wait here while all encoders are busy. An encoder is an RGB buffer to pack a frame into before
+    // compressing it, so there are only ever as many encoding jobs running as buffers
+    std::vector<std::vector<u8>> pixelBuffers;
+    std::vector<int> freePixelBuffers;
+    JobCounter encodeJobs;
+    std::mutex queueMutex;
+    std::deque<ReadbackSlot*> encodeQueue;
+    // Only one encoder writes at a time, whichever finished the next frame due
+    bool writing;
+    u64 nextWrite;
+    bool writeFailed;
+
+    std::atomic<u64> framesWritten;
+    std::atomic<u64> bytesWritten;
+    f64 startMillis;
+    f64 elapsedMillis;          // From beginning the export until everything was written
+    f64 cpuMillis;              // Used by the whole process meanwhile, on all cores
+};
+
+bool BeginImageSequence( ImageSequenceExporter* exporter, char const* prefix, u32 width, u32 height, int encoderCount = 0,
+                         int maxFramesInFlight = 0 );
+bool ExportImageFrame( ImageSequenceExporter* exporter );
+void EndImageSequence( ImageSequenceExporter* exporter );
+bool ExportProgramImages( Program& program, char const* prefix, u32 width, u32 height, u32 frameCount, u32 fps,
+                          int encoderCount = 0 );
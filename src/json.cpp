@@ -0,0 +1,217 @@
+
+struct JsonParser
+{
+    char const* at;
+    char const* end;
+    bool error;
+};
+
+INLINE void JsonSkipWhitespace( JsonParser* p )
+{
+    while( p->at < p->end && isspace( *p->at ) )
+        p->at++;
+}
+
+INLINE bool JsonExpect( JsonParser* p, char c )
+{
+    JsonSkipWhitespace( p );
+    if( p->at < p->end && *p->at == c )
+    {
+        p->at++;
+        return true;
+    }
+
+    p->error = true;
+    return false;
+}
+
+bool JsonParseString( JsonParser* p, std::string* out )
+{
+    if( !JsonExpect( p, '"' ) )
+        return false;
+
+    out->clear();
+    while( p->at < p->end && *p->at != '"' )
+    {
+        char c = *p->at++;
+        if( c == '\\' && p->at < p->end )
+        {
+            c = *p->at++;
+            switch( c )
+            {
+                case 'b': c = '\b'; break;
+                case 'f': c = '\f'; break;
+                case 'n': c = '\n'; break;
+                case 'r': c = '\r'; break;
+                case 't': c = '\t'; break;
+                case 'u':
+                {
+                    // TODO Decode to UTF-8. We only keep ASCII for now
+                    u32 codepoint = 0;
+                    for( int i = 0; i < 4 && p->at < p->end; ++i )
+                    {
+                        char h = *p->at++;
+                        codepoint = (codepoint << 4) | (isdigit( h ) ? h - '0' : (tolower( h ) - 'a' + 10));
+                    }
+                    c = codepoint < 128 ? (char)codepoint : '?';
+                } break;
+                default: break;     // '"', '\\' and '/' map to themselves
+            }
+        }
+        out->push_back( c );
+    }
+
+    return JsonExpect( p, '"' );
+}
+
+bool JsonParseValue( JsonParser* p, JsonValue* value )
+{
+    JsonSkipWhitespace( p );
+    if( p->at >= p->end )
+    {
+        p->error = true;
+        return false;
+    }
+
+    char c = *p->at;
+    if( c == '{' )
+    {
+        p->at++;
+        value->type = JsonType::Object;
+
+        JsonSkipWhitespace( p );
+        if( p->at < p->end && *p->at == '}' )
+        {
+            p->at++;
+            return true;
+        }
+
+        do
+        {
+            value->items.emplace_back();
+            JsonValue& member = value->items.back();
+            if( !JsonParseString( p, &member.key ) || !JsonExpect( p, ':' ) || !JsonParseValue( p, &member ) )
+                return false;
+
+            JsonSkipWhitespace( p );
+        } while( p->at < p->end && *p->at == ',' && p->at++ );
+
+        return JsonExpect( p, '}' );
+    }
+    else if( c == '[' )
+    {
+        p->at++;
+        value->type = JsonType::Array;
+
+        JsonSkipWhitespace( p );
+        if( p->at < p->end && *p->at == ']' )
+        {
+            p->at++;
+            return true;
+        }
+
+        do
+        {
+            value->items.emplace_back();
+            if( !JsonParseValue( p, &value->items.back() ) )
+                return false;
+
+            JsonSkipWhitespace( p );
+        } while( p->at < p->end && *p->at == ',' && p->at++ );
+
+        return JsonExpect( p, ']' );
+    }
+    else if( c == '"' )
+    {
+        value->type = JsonType::String;
+        return JsonParseString( p, &value->string );
+    }
+    else if( c == 't' || c == 'f' || c == 'n' )
+    {
+        char const* literal = c == 't' ? "true" : c == 'f' ? "false" : "null";
+        sz len = (sz)strlen( literal );
+        if( p->end - p->at < len || strncmp( p->at, literal, len ) != 0 )
+        {
+            p->error = true;
+            return false;
+        }
+
+        p->at += len;
+        value->type = c == 'n' ? JsonType::Null : JsonType::Bool;
+        value->boolean = c == 't';
+        return true;
+    }
+    else
+    {
+        char* numberEnd = nullptr;
+        value->type = JsonType::Number;
+        value->number = strtod( p->at, &numberEnd );
+        if( numberEnd == p->at || numberEnd > p->end )
+        {
+            p->error = true;
+            return false;
+        }
+
+        p->at = numberEnd;
+        return true;
+    }
+}
+
+// NOTE Text doesn't need to be null-terminated, but numbers at the very end of the buffer need a terminator anyway
+bool JsonParse( char const* text, sz length, JsonDocument* doc )
+{
+    JsonParser parser = { text, text + length, false };
+
+    doc->root = JsonValue();
+    doc->valid = JsonParseValue( &parser, &doc->root ) && !parser.error;
+    if( !doc->valid )
+        Log( "ERROR :: JSON parse error at offset %d", (int)(parser.at - text) );
+
+    return doc->valid;
+}
+
+
+JsonValue const* JsonGet( JsonValue const* object, char const* key )
+{
+    if( !object || object->type != JsonType::Object )
+        return nullptr;
+
+    for( JsonValue const& member : object->items )
+        if( member.key == key )
+            return &member;
+
+    return nullptr;
+}
+
+JsonValue const* JsonAt( JsonValue const* array, sz index )
+{
+    if( !array || array->type != JsonType::Array || index < 0 || index >= (sz)array->items.size() )
+        return nullptr;
+
+    return &array->items[index];
+}
+
+INLINE sz JsonCount( JsonValue const* value )
+{
+    return value && (value->type == JsonType::Array || value->type == JsonType::Object) ? (sz)value->items.size() : 0;
+}
+
+INLINE f64 JsonNumber( JsonValue const* value, f64 defaultValue = 0 )
+{
+    return value && value->type == JsonType::Number ? value->number : defaultValue;
+}
+
+INLINE i64 JsonInt( JsonValue const* value, i64 defaultValue = 0 )
+{
+    return value && value->type == JsonType::Number ? (i64)value->number : defaultValue;
+}
+
+INLINE bool JsonBool( JsonValue const* value, bool defaultValue = false )
+{
+    return value && value->type == JsonType::Bool ? value->boolean : defaultValue;
+}
+
+INLINE char const* JsonString( JsonValue const* value, char const* defaultValue = nullptr )
+{
+    return value && value->type == JsonType::String ? value->string.c_str() : defaultValue;
+}
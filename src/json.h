@@ -0,0 +1,29 @@
+#pragma once
+
+// Minimal DOM-style JSON reader, just enough for loading asset descriptions like glTF
+
+enum class JsonType : u8
+{
+    Null,
+    Bool,
+    Number,
+    String,
+    Array,
+    Object,
+};
+
+struct JsonValue
+{
+    JsonType type = JsonType::Null;
+    bool boolean = false;
+    f64 number = 0;
+    std::string string;
+    std::string key;                // Only set for object members
+    std::vector<JsonValue> items;   // Array elements or object members
+};
+
+struct JsonDocument
+{
+    JsonValue root;
+    bool valid = false;
+};
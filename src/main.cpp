@@ -3,9 +3,25 @@
 #include <math.h>
 #include <GLFW/glfw3.h>
 #include <webgpu/webgpu.h>
+#ifdef WEBGPU_BACKEND_WGPU
+#include <webgpu/wgpu.h>
+#endif
 #include <glfw3webgpu.h>
+// PNG writing for image sequences
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_STATIC
+#include <stb_image_write.h>
 // TODO UGH
 #include <vector>
+#include <deque>
+#include <unordered_map>
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <immintrin.h>
 
 
 // App files as a unity build
@@ -14,15 +30,42 @@
 #include "platform.h"
 #include "memory.h"
 #include "math.h"
+#include "simd.h"
+#include "hash.h"
 #include "math_types.h"
+#include "threading.h"
+#include "taskgraph.h"
+#include "fileio.h"
+#include "json.h"
+#include "resources.h"
+#include "shaders.h"
+#include "transform.h"
+#include "culling.h"
+#include "bvh.h"
+#include "raytrace.h"
 #include "program.h"
+#include "mesh.h"
+#include "texture.h"
+#include "mipgen.h"
+#include "staging.h"
+#include "video.h"
+#include "imageseq.h"
+#include "tiled.h"
 
 // Some globals
 WGPUDevice globalDevice;
 WGPUQueue globalQueue;
-WGPURenderPipeline globalPipeline;
 WGPUTextureFormat globalSwapChainFormat;
+WGPULimits globalLimits;
 Program* globalProgram;
+TextureStreamer globalTextureStreamer;
+StagingBelt globalStagingBelt;
+InstanceCuller globalInstanceCuller;
+RayTracer globalRayTracer;
+JobSystem globalJobSystem;
+FileLoader globalFileLoader;
+// Threads used to encode the passes of a frame (0 means one per core)
+int globalEncodeThreadCount = 0;
 
 constexpr char const* ShadersDir = "src/shaders";
 //WGPUColor ClearColor = WGPUColor{ 1.0, 0.0, 1.0, 1.0 };
@@ -30,29 +73,189 @@ WGPUColor ClearColor = WGPUColor{ 0.0, 0.0, 0.0, 1.0 };
 
 #include "basic.cpp"
 #include "utils.cpp"
+#include "hash.cpp"
 #include "platform.cpp"
+#include "threading.cpp"
+#include "taskgraph.cpp"
+#include "fileio.cpp"
+#include "json.cpp"
+#include "resources.cpp"
+#include "shaders.cpp"
 #include "wgpu.cpp"
+#include "staging.cpp"
+#include "texture.cpp"
+#include "mipgen.cpp"
+#include "transform.cpp"
+#include "culling.cpp"
+#include "bvh.cpp"
+#include "raytrace.cpp"
+#include "video.cpp"
+#include "imageseq.cpp"
+#include "tiled.cpp"
+#include "mesh.cpp"
 #include "program.cpp"
+#include "bench.cpp"
 
 Program* globalProgramList[] =
 {
     &starfieldProgram,
     &fireProgram,
     &cloudsProgram,
+    &accretionProgram,
+    &meshProgram,
+    &texturedProgram,
+    &feedbackProgram,
+    &culledProgram,
+    &rayTracedProgram,
 };
 
+// By the name of its shader file (e.g. "fire.wgsl")
+Program* FindProgram( char const* shaderName )
+{
+    for( Program* p : globalProgramList )
+    {
+        if( StringEndsWith( p->shaderPath, shaderName ) )
+            return p;
+    }
+
+    Log( "ERROR :: Unknown program '%s'", shaderName );
+    return nullptr;
+}
+
 
 
 constexpr int WindowWidth = 1024;
 constexpr int WindowHeight = 768;
 
-int main()
+// Everything the tasks of a frame share
+struct MainFrame
+{
+    GLFWwindow* window;
+    WGPUSwapChain swapChain;
+    ShaderUpdateListener* listener;
+    // Re-try presenting after a shader update if we had failed previously
+    bool readyToPresent;
+    // Per frame parity
+    bool submitted[2];
+};
+
+// The frame as a task graph: events on the main thread, then the program update (simulation) on a worker, shader
+// reloads, encoding and submitting, and presenting. The update only writes its frame data, which is buffered per frame
+// parity, so the update for frame N + 1 runs while frame N is still being encoded, and presenting frame N only touches
+// the swap chain, so both can overlap waiting on vsync too. Programs add tasks of their own through their tasksFunc
+void AddMainFrameTasks( TaskGraph* graph, MainFrame* frame )
+{
+    TaskResources events = AddTaskResource( graph, "Events" );
+    // The current program and its CPU side state
+    TaskResources simulation = AddTaskResource( graph, "Simulation" );
+    // Pipelines and GPU resources, which only the main thread touches
+    TaskResources renderState = AddTaskResource( graph, "Render state" );
+    // What the update left for encoding, see ProgramFrameData
+    TaskResources frameData = AddTaskResource( graph, "Frame data", true );
+    TaskResources swapChain = AddTaskResource( graph, "Swap chain" );
+    TaskResources submitted = AddTaskResource( graph, "Submitted", true );
+
+    // Check whether the user clicked on the close button (and any other
+    // mouse/key event, which we don't use so far)
+    AddFrameTask( graph, "Events", []( void* userdata, u64 frameIndex )
+    {
+        glfwPollEvents();
+    }, frame, 0, events, FrameTask_MainThread );
+
+    ProgramTaskResources programResources = { events, simulation };
+    for( Program* p : globalProgramList )
+    {
+        if( p->tasksFunc )
+            p->tasksFunc( p, graph, programResources );
+    }
+
+    // On a worker, overlapping the previous frame's Encode, which is why it leaves the resource registry alone
+    AddFrameTask( graph, "Update", []( void* userdata, u64 frameIndex )
+    {
+        // TODO Support resizing
+        UpdateCurrentProgramInputs( WindowWidth, WindowHeight, frameIndex & 1 );
+    }, frame, events, simulation | frameData );
+
+    // After this frame's update, so a program switch here happens between updates, and the new program's first
+    // update is for the next frame
+    AddFrameTask( graph, "Shader updates", []( void* userdata, u64 frameIndex )
+    {
+        MainFrame* frame = (MainFrame*)userdata;
+        if( Platform::CheckShaderUpdates( frame->listener ) )
+            frame->readyToPresent = true;
+        // Reloaded shaders get their pipelines recreated here
+        if( ProcessFileLoads() )
+            frame->readyToPresent = true;
+    }, frame, 0, simulation | renderState, FrameTask_MainThread );
+
+    AddFrameTask( graph, "Encode", []( void* userdata, u64 frameIndex )
+    {
+        MainFrame* frame = (MainFrame*)userdata;
+        u32 slot = frameIndex & 1;
+        // Nothing to encode right after switching programs
+        bool updated = globalProgram && globalProgram->frameData[slot].ready;
+        bool submitted = frame->readyToPresent && updated && SubmitFrame( frame->swapChain, slot );
+        frame->submitted[slot] = submitted;
+        if( frame->readyToPresent && updated && !submitted )
+            frame->readyToPresent = false;
+    }, frame, frameData, renderState | swapChain | submitted, FrameTask_MainThread );
+
+    AddFrameTask( graph, "Present", []( void* userdata, u64 frameIndex )
+    {
+        MainFrame* frame = (MainFrame*)userdata;
+        if( frame->submitted[frameIndex & 1] )
+            wgpuSwapChainPresent( frame->swapChain );
+    }, frame, submitted, swapChain, FrameTask_MainThread );
+}
+
+int main( int argc, char** argv )
 {
     char cwd[MAX_PATH];
     Platform::GetWorkingDirectory( cwd, sizeof(cwd) );
 
     Log( "Current directory: %s", cwd );
 
+    InitJobSystem( &globalJobSystem );
+    // Workers need joining on every way out of main
+    atexit( []() { ShutdownJobSystem( &globalJobSystem ); } );
+    InitFileLoader( &globalFileLoader );
+    atexit( []() { ShutdownFileLoader( &globalFileLoader ); } );
+    // A global in stb_image_write, read by every PNG encoding job (see imageseq.h)
+    stbi_write_png_compression_level = PNGCompressionLevel;
+
+    // Offline tools that don't need a device
+    if( argc >= 4 && strcmp( argv[1], "--cook-mesh" ) == 0 )
+    {
+        MeshData mesh;
+        return LoadGltf( argv[2], &mesh ) && CookMesh( mesh, argv[3] ) ? 0 : 1;
+    }
+    if( argc >= 4 && strcmp( argv[1], "--cook-texture" ) == 0 )
+    {
+        // Textures are assumed to be colour (sRGB) unless told otherwise
+        bool srgb = !(argc >= 5 && strcmp( argv[4], "--linear" ) == 0);
+        std::vector<u8> pixels;
+        u32 width, height;
+        return LoadTGA( argv[2], &pixels, &width, &height ) && CookTexture( pixels.data(), width, height, srgb, argv[3] ) ? 0 : 1;
+    }
+    char const* benchmarkName = argc >= 3 && strcmp( argv[1], "--bench" ) == 0 ? argv[2] : nullptr;
+    // Append the critical path of every frame to a CSV file
+    char const* criticalPathLogPath = argc >= 3 && strcmp( argv[1], "--critical-path" ) == 0 ? argv[2] : nullptr;
+    // Render a program offline into a video file or an encoder, see video.h
+    char const* recordOutput = argc >= 3 && strcmp( argv[1], "--record" ) == 0 ? argv[2] : nullptr;
+    // Same, into a numbered sequence of PNGs, see imageseq.h
+    char const* exportPrefix = argc >= 3 && strcmp( argv[1], "--export-png" ) == 0 ? argv[2] : nullptr;
+    // Render a single still of any size in tiles, see tiled.h
+    char const* tiledOutput = argc >= 3 && strcmp( argv[1], "--tiled" ) == 0 ? argv[2] : nullptr;
+
+    // Whatever it's going to load is read while the window and device get created
+    Program* startProgram = &cloudsProgram;
+    if( (recordOutput || exportPrefix) && argc > 7 )
+        startProgram = FindProgram( argv[7] );
+    else if( tiledOutput && argc > 6 )
+        startProgram = FindProgram( argv[6] );
+    if( startProgram && !benchmarkName )
+        PrefetchProgram( *startProgram );
+
     if( !glfwInit() )
     {
         Log( "Could not initialize GLFW!" );
@@ -114,12 +317,13 @@ int main()
     // This must be set even if we do not use storage buffers for now
     required.limits.minStorageBufferOffsetAlignment = supported.limits.minStorageBufferOffsetAlignment;
     required.limits.minUniformBufferOffsetAlignment = supported.limits.minUniformBufferOffsetAlignment;
-    // Maximum size of a buffer 
-    required.limits.maxBufferSize = 1 * 1024 * 1024;  // NOTE 1 Mb
+    // Maximum size of a buffer (culling bounds for millions of instances can get big)
+    required.limits.maxBufferSize = supported.limits.maxBufferSize;
     // Maximum stride between 2 consecutive vertices in the vertex buffer
     required.limits.maxVertexBufferArrayStride = 64; // NOTE 64 bytes
-    required.limits.maxVertexBuffers = 1;
-    required.limits.maxVertexAttributes = 4;
+    // Per-vertex plus per-instance buffers
+    required.limits.maxVertexBuffers = MaxVertexBuffers;
+    required.limits.maxVertexAttributes = 8;
     required.limits.maxInterStageShaderComponents = 8;
     // We use at most 1 bind group for now
     required.limits.maxBindGroups = 1;
@@ -127,7 +331,24 @@ int main()
     required.limits.maxUniformBuffersPerShaderStage = 1;
     // Uniform structs have a size of maximum 16 float
     //required.limits.maxUniformBufferBindingSize = 16 * sizeof(f32);
-    required.limits.maxUniformBufferBindingSize = 16 * 2 * sizeof(f32);
+    required.limits.maxUniformBufferBindingSize = 16 * 4 * sizeof(f32);
+    // Streamed textures, sampled through one shared sampler
+    required.limits.maxTextureDimension1D = supported.limits.maxTextureDimension1D;
+    required.limits.maxTextureDimension2D = supported.limits.maxTextureDimension2D;
+    required.limits.maxTextureArrayLayers = 1;
+    required.limits.maxSampledTexturesPerShaderStage = MaxChannels;
+    required.limits.maxSamplersPerShaderStage = 1;
+    // Compute passes (mip generation writes 2 levels at once)
+    required.limits.maxStorageTexturesPerShaderStage = 2;
+    required.limits.maxComputeWorkgroupStorageSize = supported.limits.maxComputeWorkgroupStorageSize;
+    required.limits.maxComputeInvocationsPerWorkgroup = supported.limits.maxComputeInvocationsPerWorkgroup;
+    required.limits.maxComputeWorkgroupSizeX = supported.limits.maxComputeWorkgroupSizeX;
+    required.limits.maxComputeWorkgroupSizeY = supported.limits.maxComputeWorkgroupSizeY;
+    required.limits.maxComputeWorkgroupSizeZ = supported.limits.maxComputeWorkgroupSizeZ;
+    required.limits.maxComputeWorkgroupsPerDimension = supported.limits.maxComputeWorkgroupsPerDimension;
+    // Instance culling reads bounds and writes visible indices + draw args, and its programs read 2 of those back
+    required.limits.maxStorageBuffersPerShaderStage = 3;
+    required.limits.maxStorageBufferBindingSize = supported.limits.maxStorageBufferBindingSize;
 
     WGPUDeviceDescriptor deviceDesc     = {};
     deviceDesc.nextInChain              = nullptr;
@@ -137,6 +358,7 @@ int main()
     deviceDesc.defaultQueue.nextInChain = nullptr;
     deviceDesc.defaultQueue.label       = "The default queue";
     globalDevice = RequestDevice( adapter, &deviceDesc );
+    globalLimits = required.limits;
 
     Log( "WGPU device: %p", globalDevice );
 
@@ -169,34 +391,73 @@ int main()
     Log( "Swapchain created successfully" );
 
 
-    // Set the program that we'll use
-    SetCurrentProgram( cloudsProgram );
+    int result = 0;
+    if( benchmarkName )
+    {
+        result = RunBenchmark( benchmarkName, argc - 3, argv + 3 ) ? 0 : 1;
+        // Skip the main loop
+        glfwSetWindowShouldClose( window, GLFW_TRUE );
+    }
+    else if( recordOutput )
+    {
+        u32 width = argc > 3 ? (u32)atoi( argv[3] ) : 1920;
+        u32 height = argc > 4 ? (u32)atoi( argv[4] ) : 1080;
+        u32 frameCount = argc > 5 ? (u32)atoi( argv[5] ) : 600;
+        u32 fps = argc > 6 ? (u32)atoi( argv[6] ) : 60;
+
+        Program* program = startProgram;
+
+        result = program && RecordProgramVideo( *program, recordOutput, width, height, frameCount, fps ) ? 0 : 1;
+        glfwSetWindowShouldClose( window, GLFW_TRUE );
+    }
+    else if( exportPrefix )
+    {
+        u32 width = argc > 3 ? (u32)atoi( argv[3] ) : 1920;
+        u32 height = argc > 4 ? (u32)atoi( argv[4] ) : 1080;
+        u32 frameCount = argc > 5 ? (u32)atoi( argv[5] ) : 600;
+        u32 fps = argc > 6 ? (u32)atoi( argv[6] ) : 60;
+        Program* program = startProgram;
+        int encoderCount = argc > 8 ? atoi( argv[8] ) : 0;
+
+        result = program && ExportProgramImages( *program, exportPrefix, width, height, frameCount, fps, encoderCount ) ? 0 : 1;
+        glfwSetWindowShouldClose( window, GLFW_TRUE );
+    }
+    else if( tiledOutput )
+    {
+        u32 width = argc > 3 ? (u32)atoi( argv[3] ) : 16384;
+        u32 height = argc > 4 ? (u32)atoi( argv[4] ) : 16384;
+        f32 time = argc > 5 ? (f32)atof( argv[5] ) : 0.f;
+        Program* program = startProgram;
+        u32 tileSize = argc > 7 ? (u32)atoi( argv[7] ) : DefaultTileSize;
+
+        result = program && RenderTiledImage( *program, tiledOutput, width, height, time, tileSize ) ? 0 : 1;
+        glfwSetWindowShouldClose( window, GLFW_TRUE );
+    }
+    else
+    {
+        // Set the program that we'll use
+        SetCurrentProgram( *startProgram );
+    }
 
     // Start listening for directory changes
     ShaderUpdateListener listener = {};
     Platform::SetupShaderUpdateListener( ShadersDir, OnShaderUpdated, &listener );
 
     //  Main loop
-    bool readyToPresent = true;
-    while( !glfwWindowShouldClose( window ) )
-    {
-        // Check if the current shader was updated
-        if( Platform::CheckShaderUpdates( &listener ) )
-            // Re-try presenting if we had failed previously
-            readyToPresent = true;
+    MainFrame frame = { window, swapChain, &listener, true, {} };
+    TaskGraph frameGraph = {};
+    AddMainFrameTasks( &frameGraph, &frame );
+    if( criticalPathLogPath )
+        OpenCriticalPathLog( &frameGraph, criticalPathLogPath );
 
-        // Check whether the user clicked on the close button (and any other
-        // mouse/key event, which we don't use so far)
-        glfwPollEvents();
-
-        if( readyToPresent )
-        {
-            // TODO Support resizing
-            UpdateCurrentProgramInputs( WindowWidth, WindowHeight );
-            readyToPresent = Present( swapChain );
-        }
-    }
+    while( !glfwWindowShouldClose( window ) )
+        RunFrameTasks( &frameGraph );
+    ReleaseTaskGraph( &frameGraph );
 
+    if( globalProgram )
+        ReleaseProgramResources( globalProgram );
+    ReleaseStagingBelt( &globalStagingBelt );
+    ShutdownResources();
 
     wgpuSwapChainRelease( swapChain );
     wgpuDeviceRelease( globalDevice );
@@ -205,7 +466,7 @@ int main()
     wgpuInstanceRelease( instance );
     glfwDestroyWindow( window );
 
-    return 0;
+    return result;
 }
 
 void ParseSwitchFile( char const* filepath )
@@ -53,6 +53,13 @@ INLINE void Clamp( T* value, T min, T max )
     *value = Min( Max( *value, min ), max );
 }
 
+// NOTE Alignment must be a power of 2
+template <typename T>
+INLINE T AlignUp( T value, T alignment )
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
 template <typename T>
 INLINE T Abs( T value )
 {
@@ -133,30 +140,14 @@ Radians( f32 degrees )
 }
 
 
-// TODO Replace with MurmurHash3 128 (just truncate for 32/64 bit hashes) (https://github.com/aappleby/smhasher/blob/master/src/MurmurHash3.cpp)
-// (improve it with http://zimbry.blogspot.com/2011/09/better-bit-mixing-improving-on.html)
-// TODO Add Meow Hash for hashing large blocks (also get the code and study it a little, there's gems in the open there!)
-inline u32
-Fletchef32( const void* buffer, int len )
-{
-	const u8* data = (u8*)buffer;
-	u32 fletch1 = 0xFFFF;
-	u32 fletch2 = 0xFFFF;
-
-	while( data && len > 0 )
-	{
-		int l = (len <= 360) ? len : 360;
-		len -= l;
-		while( l > 0 )
-		{
-            fletch1 += *data++;
-            fletch2 += fletch1;
-            l--;
-		}
-		fletch1 = (fletch1 & 0xFFFF) + (fletch1 >> 16);
-		fletch2 = (fletch2 & 0xFFFF) + (fletch2 >> 16);
-	}
-	return (fletch2 << 16) | (fletch1 & 0xFFFF);
+// Mix a value into a running 64 bit hash (splitmix64 finalizer). Meant for small keys made of a few handles / ints
+inline u64
+HashCombine( u64 seed, u64 value )
+{
+    u64 x = seed ^ (value + 0x9E3779B97F4A7C15ull + (seed << 6) + (seed >> 2));
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
 }
 
 inline u32
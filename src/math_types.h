@@ -45,6 +45,12 @@ inline bool LessOrAlmostEqual( f32 a, f32 b, f32 absoluteEpsilon = 0 );
 inline bool AlmostEqual( f64 a, f64 b, f64 absoluteEpsilon = 0 );
 inline f32 Radians( f32 degrees );
 
+// v4, m4 and qn go through SSE (with FMA where available, see simd.h) unless MATH_SCALAR is defined.
+// Types keep their plain float layout either way, so values are loaded and stored unaligned at each call
+#if !MATH_SCALAR
+    #define MATH_SIMD 1
+#endif
+
 // Vector 2
 
 union v2
@@ -697,6 +703,20 @@ Abs( const v3& v )
     return result;
 }
 
+inline v3
+Min( const v3& a, const v3& b )
+{
+    v3 result = { Min( a.x, b.x ), Min( a.y, b.y ), Min( a.z, b.z ) };
+    return result;
+}
+
+inline v3
+Max( const v3& a, const v3& b )
+{
+    v3 result = { Max( a.x, b.x ), Max( a.y, b.y ), Max( a.z, b.z ) };
+    return result;
+}
+
 inline f32
 Length( const v3& v )
 {
@@ -828,6 +848,11 @@ union v4
 
 const v4 V4Zero = { 0.0f, 0.0f, 0.0f, 0.0f };
 
+#if MATH_SIMD
+INLINE __m128 Load( const v4& v )   { return _mm_loadu_ps( v.e ); }
+INLINE v4 V4( __m128 m )            { v4 result; _mm_storeu_ps( result.e, m ); return result; }
+#endif
+
 
 inline v4
 V4( f32 x, f32 y, f32 z, f32 w )
@@ -858,34 +883,67 @@ operator !=( const v4 &a, const v4 &b )
 inline v4
 operator +( v4 const& a, v4 const& b )
 {
+#if MATH_SIMD
+    return V4( _mm_add_ps( Load( a ), Load( b ) ) );
+#else
     return { a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w };
+#endif
 }
 
 inline v4
 operator -( v4 const& a, v4 const& b )
 {
+#if MATH_SIMD
+    return V4( _mm_sub_ps( Load( a ), Load( b ) ) );
+#else
     return { a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w };
+#endif
 }
 
 inline v4
 operator *( f32 f, const v4 &v )
 {
+#if MATH_SIMD
+    return V4( _mm_mul_ps( _mm_set1_ps( f ), Load( v ) ) );
+#else
     v4 result = { f * v.x, f * v.y, f * v.z, f * v.w };
     return result;
+#endif
 }
 
 inline v4
 operator /( const v4& v, f32 s )
 {
+#if MATH_SIMD
+    return V4( _mm_div_ps( Load( v ), _mm_set1_ps( s ) ) );
+#else
     v4 result = { v.x / s, v.y / s, v.z / s, v.w / s };
     return result;
+#endif
 }
 
 inline v4
 Hadamard( const v4& a, const v4& b )
 {
+#if MATH_SIMD
+    return V4( _mm_mul_ps( Load( a ), Load( b ) ) );
+#else
     v4 result = { a.x * b.x, a.y * b.y, a.z * b.z, a.w * b.w };
     return result;
+#endif
+}
+
+inline f32
+Dot( const v4& a, const v4& b )
+{
+#if MATH_SIMD
+    __m128 p = _mm_mul_ps( Load( a ), Load( b ) );
+    p = _mm_add_ps( p, _mm_movehl_ps( p, p ) );
+    p = _mm_add_ss( p, _mm_shuffle_ps( p, p, _MM_SHUFFLE( 1, 1, 1, 1 ) ) );
+    return _mm_cvtss_f32( p );
+#else
+    return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+#endif
 }
 
 inline u32
@@ -928,6 +986,37 @@ const m4 M4Identity =
     { 0, 0, 0, 1 }
 }};
 
+#if MATH_SIMD
+struct m4Rows
+{
+    __m128 r[4];
+};
+
+INLINE m4Rows Load( const m4& m )
+{
+    return { { _mm_loadu_ps( m.e[0] ), _mm_loadu_ps( m.e[1] ), _mm_loadu_ps( m.e[2] ), _mm_loadu_ps( m.e[3] ) } };
+}
+
+INLINE m4 M4( m4Rows const& rows )
+{
+    m4 result;
+    for( int i = 0; i < 4; ++i )
+        _mm_storeu_ps( result.e[i], rows.r[i] );
+    return result;
+}
+
+// Dot product of each row with v, as a single vector
+INLINE __m128 TransformRows( m4Rows rows, __m128 v )
+{
+    __m128 p0 = _mm_mul_ps( rows.r[0], v );
+    __m128 p1 = _mm_mul_ps( rows.r[1], v );
+    __m128 p2 = _mm_mul_ps( rows.r[2], v );
+    __m128 p3 = _mm_mul_ps( rows.r[3], v );
+    _MM_TRANSPOSE4_PS( p0, p1, p2, p3 );
+    return _mm_add_ps( _mm_add_ps( p0, p1 ), _mm_add_ps( p2, p3 ) );
+}
+#endif
+
 inline m4
 M4Rows( const v3 &x, const v3 &y, const v3 &z )
 {
@@ -1093,13 +1182,11 @@ M4RotPos( const m4 &m, const v3 &p )
     return result;
 }
 
-// TODO SIMD this! (and most of the other stuff!)
+// Left scalar, as packing a v3 in and out of a register costs more than the SSE version saves (see the math bench).
+// For many points at once, see the batch kernels in transform.h
 inline v3
 Transform( const m4 &m, const v3 &v )
 {
-    // FIXME This seems to take a good chunk of time!
-    //TIMED_BLOCK;
-
     v3 r;
     r.x = v.x*m.e[0][0] + v.y*m.e[0][1] + v.z*m.e[0][2] + m.e[0][3];
     r.y = v.x*m.e[1][0] + v.y*m.e[1][1] + v.z*m.e[1][2] + m.e[1][3];
@@ -1111,6 +1198,9 @@ Transform( const m4 &m, const v3 &v )
 inline v4
 Transform( const m4 &m, const v4 &v )
 {
+#if MATH_SIMD
+    return V4( TransformRows( Load( m ), Load( v ) ) );
+#else
     v4 r;
     r.x = v.x*m.e[0][0] + v.y*m.e[0][1] + v.z*m.e[0][2] + v.w*m.e[0][3];
     r.y = v.x*m.e[1][0] + v.y*m.e[1][1] + v.z*m.e[1][2] + v.w*m.e[1][3];
@@ -1118,6 +1208,7 @@ Transform( const m4 &m, const v4 &v )
     r.w = v.x*m.e[3][0] + v.y*m.e[3][1] + v.z*m.e[3][2] + v.w*m.e[3][3];
     
     return r;
+#endif
 }
 
 inline v3
@@ -1137,6 +1228,20 @@ operator*( const m4 &m, const v4 &v )
 inline m4
 operator*( const m4 &m1, const m4 &m2 )
 {
+#if MATH_SIMD
+    // Each row of the result is a combination of the rows of m2, weighted by the same row of m1
+    m4Rows b = Load( m2 );
+    m4Rows result;
+    for( int r = 0; r < 4; ++r )
+    {
+        __m128 row = _mm_mul_ps( _mm_set1_ps( m1.e[r][0] ), b.r[0] );
+        row = SimdMulAdd( _mm_set1_ps( m1.e[r][1] ), b.r[1], row );
+        row = SimdMulAdd( _mm_set1_ps( m1.e[r][2] ), b.r[2], row );
+        row = SimdMulAdd( _mm_set1_ps( m1.e[r][3] ), b.r[3], row );
+        result.r[r] = row;
+    }
+    return M4( result );
+#else
     m4 result = {};
     
     for(int r = 0; r < 4; ++r)
@@ -1151,6 +1256,7 @@ operator*( const m4 &m1, const m4 &m2 )
     }
     
     return result;
+#endif
 }
 
 inline void
@@ -1404,6 +1510,7 @@ GetCameraBasisZ( const m4& m )
 inline m4
 Transposed( const m4 &m )
 {
+    // Compilers already turn this into shuffles
     m4 result =
     {{
          { m.e[0][0], m.e[1][0], m.e[2][0], m.e[3][0] },
@@ -1415,6 +1522,125 @@ Transposed( const m4 &m )
     return result;
 }
 
+#if MATH_SIMD
+// Helpers for the block inverse below. 2x2 matrices are packed row-major into a single vector
+#define SHUFFLE4( a, b, x, y, z, w ) _mm_shuffle_ps( a, b, _MM_SHUFFLE( w, z, y, x ) )
+#define SWIZZLE4( a, x, y, z, w ) _mm_shuffle_ps( a, a, _MM_SHUFFLE( w, z, y, x ) )
+
+// A * B
+INLINE __m128 Mat2Mul( __m128 a, __m128 b )
+{
+    return _mm_add_ps( _mm_mul_ps( a, SWIZZLE4( b, 0, 3, 0, 3 ) ),
+                       _mm_mul_ps( SWIZZLE4( a, 1, 0, 3, 2 ), SWIZZLE4( b, 2, 1, 2, 1 ) ) );
+}
+// Adjugate(A) * B
+INLINE __m128 Mat2AdjMul( __m128 a, __m128 b )
+{
+    return _mm_sub_ps( _mm_mul_ps( SWIZZLE4( a, 3, 3, 0, 0 ), b ),
+                       _mm_mul_ps( SWIZZLE4( a, 1, 1, 2, 2 ), SWIZZLE4( b, 2, 3, 0, 1 ) ) );
+}
+// A * Adjugate(B)
+INLINE __m128 Mat2MulAdj( __m128 a, __m128 b )
+{
+    return _mm_sub_ps( _mm_mul_ps( a, SWIZZLE4( b, 3, 0, 3, 0 ) ),
+                       _mm_mul_ps( SWIZZLE4( a, 1, 0, 3, 2 ), SWIZZLE4( b, 2, 1, 2, 1 ) ) );
+}
+#endif
+
+// General inverse. Returns false (and leaves result untouched) if the matrix is singular
+inline bool
+Inverse( const m4& m, m4* result )
+{
+#if MATH_SIMD
+    // Blockwise inversion over the four 2x2 sub-matrices
+    //   | A B |
+    //   | C D |
+    m4Rows rows = Load( m );
+    __m128 A = _mm_movelh_ps( rows.r[0], rows.r[1] );
+    __m128 B = _mm_movehl_ps( rows.r[1], rows.r[0] );
+    __m128 C = _mm_movelh_ps( rows.r[2], rows.r[3] );
+    __m128 D = _mm_movehl_ps( rows.r[3], rows.r[2] );
+
+    // Determinants of all four blocks at once
+    __m128 detSub = _mm_sub_ps( _mm_mul_ps( SHUFFLE4( rows.r[0], rows.r[2], 0, 2, 0, 2 ), SHUFFLE4( rows.r[1], rows.r[3], 1, 3, 1, 3 ) ),
+                                _mm_mul_ps( SHUFFLE4( rows.r[0], rows.r[2], 1, 3, 1, 3 ), SHUFFLE4( rows.r[1], rows.r[3], 0, 2, 0, 2 ) ) );
+    __m128 detA = SWIZZLE4( detSub, 0, 0, 0, 0 );
+    __m128 detB = SWIZZLE4( detSub, 1, 1, 1, 1 );
+    __m128 detC = SWIZZLE4( detSub, 2, 2, 2, 2 );
+    __m128 detD = SWIZZLE4( detSub, 3, 3, 3, 3 );
+
+    __m128 D_C = Mat2AdjMul( D, C );
+    __m128 A_B = Mat2AdjMul( A, B );
+    // Adjugates of each block of the result
+    __m128 X_ = _mm_sub_ps( _mm_mul_ps( detD, A ), Mat2Mul( B, D_C ) );
+    __m128 W_ = _mm_sub_ps( _mm_mul_ps( detA, D ), Mat2Mul( C, A_B ) );
+    __m128 Y_ = _mm_sub_ps( _mm_mul_ps( detB, C ), Mat2MulAdj( D, A_B ) );
+    __m128 Z_ = _mm_sub_ps( _mm_mul_ps( detC, B ), Mat2MulAdj( A, D_C ) );
+
+    // |M| = |A||D| + |B||C| - tr( A#B * D#C )
+    __m128 tr = _mm_mul_ps( A_B, SWIZZLE4( D_C, 0, 2, 1, 3 ) );
+    tr = _mm_add_ps( tr, _mm_movehl_ps( tr, tr ) );
+    tr = _mm_add_ss( tr, SWIZZLE4( tr, 1, 1, 1, 1 ) );
+    __m128 detM = _mm_sub_ss( _mm_add_ss( _mm_mul_ss( detA, detD ), _mm_mul_ss( detB, detC ) ), tr );
+    f32 det = _mm_cvtss_f32( detM );
+    if( det == 0.f )
+        return false;
+
+    __m128 rDetM = _mm_div_ps( _mm_setr_ps( 1.f, -1.f, -1.f, 1.f ), SWIZZLE4( detM, 0, 0, 0, 0 ) );
+    X_ = _mm_mul_ps( X_, rDetM );
+    Y_ = _mm_mul_ps( Y_, rDetM );
+    Z_ = _mm_mul_ps( Z_, rDetM );
+    W_ = _mm_mul_ps( W_, rDetM );
+
+    // Undo the adjugate swizzle while putting rows back together
+    m4Rows inv;
+    inv.r[0] = SHUFFLE4( X_, Y_, 3, 1, 3, 1 );
+    inv.r[1] = SHUFFLE4( X_, Y_, 2, 0, 2, 0 );
+    inv.r[2] = SHUFFLE4( Z_, W_, 3, 1, 3, 1 );
+    inv.r[3] = SHUFFLE4( Z_, W_, 2, 0, 2, 0 );
+    *result = M4( inv );
+    return true;
+#else
+    // Cofactor expansion
+    f32 const* a = &m.e[0][0];
+    f32 inv[16];
+    inv[0]  =  a[5]*a[10]*a[15] - a[5]*a[11]*a[14] - a[9]*a[6]*a[15] + a[9]*a[7]*a[14] + a[13]*a[6]*a[11] - a[13]*a[7]*a[10];
+    inv[4]  = -a[4]*a[10]*a[15] + a[4]*a[11]*a[14] + a[8]*a[6]*a[15] - a[8]*a[7]*a[14] - a[12]*a[6]*a[11] + a[12]*a[7]*a[10];
+    inv[8]  =  a[4]*a[9]*a[15]  - a[4]*a[11]*a[13] - a[8]*a[5]*a[15] + a[8]*a[7]*a[13] + a[12]*a[5]*a[11] - a[12]*a[7]*a[9];
+    inv[12] = -a[4]*a[9]*a[14]  + a[4]*a[10]*a[13] + a[8]*a[5]*a[14] - a[8]*a[6]*a[13] - a[12]*a[5]*a[10] + a[12]*a[6]*a[9];
+    inv[1]  = -a[1]*a[10]*a[15] + a[1]*a[11]*a[14] + a[9]*a[2]*a[15] - a[9]*a[3]*a[14] - a[13]*a[2]*a[11] + a[13]*a[3]*a[10];
+    inv[5]  =  a[0]*a[10]*a[15] - a[0]*a[11]*a[14] - a[8]*a[2]*a[15] + a[8]*a[3]*a[14] + a[12]*a[2]*a[11] - a[12]*a[3]*a[10];
+    inv[9]  = -a[0]*a[9]*a[15]  + a[0]*a[11]*a[13] + a[8]*a[1]*a[15] - a[8]*a[3]*a[13] - a[12]*a[1]*a[11] + a[12]*a[3]*a[9];
+    inv[13] =  a[0]*a[9]*a[14]  - a[0]*a[10]*a[13] - a[8]*a[1]*a[14] + a[8]*a[2]*a[13] + a[12]*a[1]*a[10] - a[12]*a[2]*a[9];
+    inv[2]  =  a[1]*a[6]*a[15]  - a[1]*a[7]*a[14]  - a[5]*a[2]*a[15] + a[5]*a[3]*a[14] + a[13]*a[2]*a[7]  - a[13]*a[3]*a[6];
+    inv[6]  = -a[0]*a[6]*a[15]  + a[0]*a[7]*a[14]  + a[4]*a[2]*a[15] - a[4]*a[3]*a[14] - a[12]*a[2]*a[7]  + a[12]*a[3]*a[6];
+    inv[10] =  a[0]*a[5]*a[15]  - a[0]*a[7]*a[13]  - a[4]*a[1]*a[15] + a[4]*a[3]*a[13] + a[12]*a[1]*a[7]  - a[12]*a[3]*a[5];
+    inv[14] = -a[0]*a[5]*a[14]  + a[0]*a[6]*a[13]  + a[4]*a[1]*a[14] - a[4]*a[2]*a[13] - a[12]*a[1]*a[6]  + a[12]*a[2]*a[5];
+    inv[3]  = -a[1]*a[6]*a[11]  + a[1]*a[7]*a[10]  + a[5]*a[2]*a[11] - a[5]*a[3]*a[10] - a[9]*a[2]*a[7]   + a[9]*a[3]*a[6];
+    inv[7]  =  a[0]*a[6]*a[11]  - a[0]*a[7]*a[10]  - a[4]*a[2]*a[11] + a[4]*a[3]*a[10] + a[8]*a[2]*a[7]   - a[8]*a[3]*a[6];
+    inv[11] = -a[0]*a[5]*a[11]  + a[0]*a[7]*a[9]   + a[4]*a[1]*a[11] - a[4]*a[3]*a[9]  - a[8]*a[1]*a[7]   + a[8]*a[3]*a[5];
+    inv[15] =  a[0]*a[5]*a[10]  - a[0]*a[6]*a[9]   - a[4]*a[1]*a[10] + a[4]*a[2]*a[9]  + a[8]*a[1]*a[6]   - a[8]*a[2]*a[5];
+
+    f32 det = a[0]*inv[0] + a[1]*inv[4] + a[2]*inv[8] + a[3]*inv[12];
+    if( det == 0.f )
+        return false;
+
+    f32 invDet = 1.f / det;
+    for( int i = 0; i < 16; ++i )
+        result->e[i / 4][i % 4] = inv[i] * invDet;
+    return true;
+#endif
+}
+
+inline m4
+Inverse( const m4& m )
+{
+    m4 result = M4Identity;
+    bool ok = Inverse( m, &result );
+    ASSERT( ok, "Singular matrix" );
+    return result;
+}
+
 
 
 // Symmetric Matrix 4x4 (double precision)
@@ -1499,6 +1725,11 @@ union qn
 
 const qn QnIdentity = { 0.0f, 0.0f, 0.0f, 1.0f };
 
+#if MATH_SIMD
+INLINE __m128 Load( const qn& q )   { return _mm_loadu_ps( q.e ); }
+INLINE qn Qn( __m128 m )            { qn result; _mm_storeu_ps( result.e, m ); return result; }
+#endif
+
 // TODO (Unit) Test everything quaternion related
 
 inline f32
@@ -1706,6 +1937,24 @@ ToM4( const qn& q )
     return result;
 }
 
+// Translation * rotation * scale, straight from the components. Rotation needs to be a unit quaternion
+inline m4
+M4TRS( const v3& p, const qn& q, const v3& s )
+{
+    f32 xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+    f32 xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+    f32 xw = q.x * q.w, yw = q.y * q.w, zw = q.z * q.w;
+
+    m4 result =
+    {{
+         { (1 - 2 * (yy + zz)) * s.x,   2 * (xy - zw) * s.y,          2 * (xz + yw) * s.z,          p.x },
+         { 2 * (xy + zw) * s.x,         (1 - 2 * (xx + zz)) * s.y,    2 * (yz - xw) * s.z,          p.y },
+         { 2 * (xz - yw) * s.x,         2 * (yz + xw) * s.y,          (1 - 2 * (xx + yy)) * s.z,    p.z },
+         { 0,                           0,                            0,                            1 }
+    }};
+    return result;
+}
+
 inline qn
 Conjugate( const qn& q )
 {
@@ -1731,12 +1980,22 @@ Inverse( const qn& q )
 inline qn
 operator *( const qn& a, const qn& b )
 {
+#if MATH_SIMD
+    // Each component of b scales a shuffled, sign flipped copy of a
+    __m128 va = Load( a );
+    __m128 r = _mm_mul_ps( _mm_set1_ps( b.w ), va );
+    r = SimdMulAdd( _mm_set1_ps( b.x ), _mm_mul_ps( SWIZZLE4( va, 3, 2, 1, 0 ), _mm_setr_ps(  1.f,  1.f, -1.f, -1.f ) ), r );
+    r = SimdMulAdd( _mm_set1_ps( b.y ), _mm_mul_ps( SWIZZLE4( va, 2, 3, 0, 1 ), _mm_setr_ps( -1.f,  1.f,  1.f, -1.f ) ), r );
+    r = SimdMulAdd( _mm_set1_ps( b.z ), _mm_mul_ps( SWIZZLE4( va, 1, 0, 3, 2 ), _mm_setr_ps(  1.f, -1.f,  1.f, -1.f ) ), r );
+    return Qn( r );
+#else
     f32 rw = b.w*a.w - b.x*a.x - b.y*a.y - b.z*a.z;
     f32 rx = b.w*a.x + b.x*a.w - b.y*a.z + b.z*a.y;
     f32 ry = b.w*a.y + b.x*a.z + b.y*a.w - b.z*a.x;
     f32 rz = b.w*a.z - b.x*a.y + b.y*a.x + b.z*a.w;
     qn result = { rx, ry, rz, rw };
     return result;
+#endif
 }
 
 inline void
@@ -1745,6 +2004,45 @@ operator *=( qn& a, const qn& b )
     a = a * b;
 }
 
+// Spherical interpolation along the shortest arc. Both need to be unit quaternions
+inline qn
+Slerp( const qn& a, const qn& b, f32 t )
+{
+    f32 cosTheta = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+    // q and -q are the same rotation, so flip b if that's closer
+    f32 sign = 1.f;
+    if( cosTheta < 0.f )
+    {
+        cosTheta = -cosTheta;
+        sign = -1.f;
+    }
+
+    f32 wa, wb;
+    if( cosTheta > 0.9995f )
+    {
+        // Nearly parallel, so just lerp (and normalize below)
+        wa = 1.f - t;
+        wb = t;
+    }
+    else
+    {
+        f32 theta = acosf( cosTheta );
+        f32 invSinTheta = 1.f / sinf( theta );
+        wa = sinf( (1.f - t) * theta ) * invSinTheta;
+        wb = sinf( t * theta ) * invSinTheta;
+    }
+    wb *= sign;
+
+#if MATH_SIMD
+    __m128 r = SimdMulAdd( _mm_set1_ps( wb ), Load( b ), _mm_mul_ps( _mm_set1_ps( wa ), Load( a ) ) );
+    qn result = Qn( r );
+#else
+    qn result = { wa * a.x + wb * b.x, wa * a.y + wb * b.y, wa * a.z + wb * b.z, wa * a.w + wb * b.w };
+#endif
+    Normalize( result );
+    return result;
+}
+
 inline v3
 Rotate( const v3& v, const qn& q )
 {
@@ -1885,11 +2183,36 @@ Enclose( aabb const& a, aabb const& b )
     return result;
 }
 
+// Extract the 6 frustum planes (left, right, bottom, top, near, far) from a view-projection matrix (Gribb & Hartmann).
+// Normals point inwards and are normalized, so Dot( plane.xyz, p ) + plane.w is the signed distance to each plane.
+// Assumes a GL style [-1, 1] clip depth like M4Perspective, which is conservative for APIs with a [0, 1] range
+inline void
+FrustumPlanes( m4 const& viewProj, v4 planes[6] )
+{
+    v4 const& r0 = viewProj.r[0];
+    v4 const& r1 = viewProj.r[1];
+    v4 const& r2 = viewProj.r[2];
+    v4 const& r3 = viewProj.r[3];
+
+    planes[0] = r3 + r0;
+    planes[1] = r3 - r0;
+    planes[2] = r3 + r1;
+    planes[3] = r3 - r1;
+    planes[4] = r3 + r2;
+    planes[5] = r3 - r2;
+
+    for( int i = 0; i < 6; ++i )
+    {
+        f32 length = Length( planes[i].xyz );
+        if( length > 0.f )
+            planes[i] = planes[i] / length;
+    }
+}
+
 // Taken from https://gist.github.com/Kinwailo/d9a07f98d8511206182e50acda4fbc9b
 // (adapted tests as our plane normals point inwards)
-// FIXME Test & debug
 inline bool
-IsInFrustum( aabb const& b, v4 planes[6] )
+IsInFrustum( aabb const& b, v4 const planes[6] )
 {
     bool result = true;
     v3 min = b.center - b.halfSize;
@@ -1899,7 +2222,7 @@ IsInFrustum( aabb const& b, v4 planes[6] )
     for( int i = 0; i < 6; ++i )
     {
         // TODO Use a LUT & precalc min/max corners for all 6 planes as explained in http://www.cse.chalmers.se/~uffe/vfc.pdf page 11
-        v4& plane = planes[i];
+        v4 const& plane = planes[i];
         if( plane.x < 0.f )
         {
             p.x = min.x;
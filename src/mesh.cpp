@@ -0,0 +1,701 @@
+
+/////     GLTF IMPORT    /////
+
+struct GltfBuffer
+{
+    u8 const* data;
+    sz size;
+    std::vector<u8> storage;
+};
+
+struct GltfAccessor
+{
+    u8 const* data;
+    sz count;
+    sz stride;
+    int componentType;
+    int componentCount;
+    bool normalized;
+};
+
+struct GltfPrimitive
+{
+    GltfAccessor position;
+    GltfAccessor normal;
+    GltfAccessor uv;
+    GltfAccessor indices;
+    u32 firstVertex;
+    u32 firstIndex;
+    u32 indexCount;
+    v3 boundsMin;
+    v3 boundsMax;
+};
+
+enum GltfComponentType
+{
+    Gltf_Byte = 5120,
+    Gltf_UnsignedByte = 5121,
+    Gltf_Short = 5122,
+    Gltf_UnsignedShort = 5123,
+    Gltf_UnsignedInt = 5125,
+    Gltf_Float = 5126,
+};
+
+constexpr u32 GlbMagic = 0x46546C67;        // 'glTF'
+constexpr u32 GlbChunkJSON = 0x4E4F534A;
+constexpr u32 GlbChunkBIN = 0x004E4942;
+
+
+INLINE u8 Base64Value( char c )
+{
+    if( c >= 'A' && c <= 'Z' ) return (u8)(c - 'A');
+    if( c >= 'a' && c <= 'z' ) return (u8)(c - 'a' + 26);
+    if( c >= '0' && c <= '9' ) return (u8)(c - '0' + 52);
+    if( c == '+' || c == '-' ) return 62;
+    if( c == '/' || c == '_' ) return 63;
+    return 0;
+}
+
+// Decode in parallel, since every group of 4 input chars maps independently to 3 output bytes
+void Base64Decode( char const* text, sz length, std::vector<u8>* out )
+{
+    while( length > 0 && text[length - 1] == '=' )
+        length--;
+
+    sz fullQuads = length / 4;
+    sz tail = length % 4;
+    out->resize( fullQuads * 3 + (tail ? tail - 1 : 0) );
+    u8* dst = out->data();
+
+    ParallelFor( fullQuads, 64 * 1024, [text, dst]( sz begin, sz end )
+    {
+        for( sz q = begin; q < end; ++q )
+        {
+            char const* src = text + q * 4;
+            u32 bits = (Base64Value( src[0] ) << 18) | (Base64Value( src[1] ) << 12) | (Base64Value( src[2] ) << 6) | Base64Value( src[3] );
+            dst[q * 3 + 0] = (u8)(bits >> 16);
+            dst[q * 3 + 1] = (u8)(bits >> 8);
+            dst[q * 3 + 2] = (u8)bits;
+        }
+    } );
+
+    if( tail )
+    {
+        char const* src = text + fullQuads * 4;
+        u32 bits = 0;
+        for( sz i = 0; i < 4; ++i )
+            bits = (bits << 6) | (i < tail ? Base64Value( src[i] ) : 0);
+
+        for( sz i = 0; i < tail - 1; ++i )
+            dst[fullQuads * 3 + i] = (u8)(bits >> (16 - 8 * i));
+    }
+}
+
+INLINE int GltfComponentSize( int componentType )
+{
+    switch( componentType )
+    {
+        case Gltf_Byte: case Gltf_UnsignedByte: return 1;
+        case Gltf_Short: case Gltf_UnsignedShort: return 2;
+        case Gltf_UnsignedInt: case Gltf_Float: return 4;
+        default: return 0;
+    }
+}
+
+INLINE int GltfComponentCount( char const* type )
+{
+    if( !type ) return 0;
+    if( strcmp( type, "SCALAR" ) == 0 ) return 1;
+    if( strcmp( type, "VEC2" ) == 0 ) return 2;
+    if( strcmp( type, "VEC3" ) == 0 ) return 3;
+    if( strcmp( type, "VEC4" ) == 0 ) return 4;
+    return 0;
+}
+
+bool GetGltfAccessor( JsonValue const* root, std::vector<GltfBuffer> const& buffers, i64 index, GltfAccessor* out )
+{
+    *out = {};
+
+    JsonValue const* accessor = JsonAt( JsonGet( root, "accessors" ), index );
+    if( !accessor )
+        return false;
+
+    if( JsonGet( accessor, "sparse" ) )
+    {
+        Log( "WARNING :: Sparse glTF accessors are not supported" );
+        return false;
+    }
+
+    out->count = JsonInt( JsonGet( accessor, "count" ) );
+    out->componentType = (int)JsonInt( JsonGet( accessor, "componentType" ) );
+    out->componentCount = GltfComponentCount( JsonString( JsonGet( accessor, "type" ) ) );
+    out->normalized = JsonBool( JsonGet( accessor, "normalized" ) );
+
+    sz elementSize = GltfComponentSize( out->componentType ) * out->componentCount;
+    JsonValue const* view = JsonAt( JsonGet( root, "bufferViews" ), JsonInt( JsonGet( accessor, "bufferView" ), -1 ) );
+    if( !view || !elementSize )
+        return false;
+
+    i64 bufferIndex = JsonInt( JsonGet( view, "buffer" ), -1 );
+    if( bufferIndex < 0 || bufferIndex >= (i64)buffers.size() )
+        return false;
+
+    GltfBuffer const& buffer = buffers[bufferIndex];
+    sz offset = JsonInt( JsonGet( view, "byteOffset" ) ) + JsonInt( JsonGet( accessor, "byteOffset" ) );
+    out->stride = JsonInt( JsonGet( view, "byteStride" ), elementSize );
+    out->data = buffer.data + offset;
+
+    if( out->count > 0 && offset + out->stride * (out->count - 1) + elementSize > buffer.size )
+    {
+        Log( "ERROR :: glTF accessor %d out of buffer bounds", (int)index );
+        return false;
+    }
+
+    return true;
+}
+
+INLINE f32 ReadGltfComponent( GltfAccessor const& a, sz element, int component )
+{
+    u8 const* p = a.data + element * a.stride + component * GltfComponentSize( a.componentType );
+    switch( a.componentType )
+    {
+        case Gltf_Float:            { f32 v; COPYP( p, &v, 4 ); return v; }
+        case Gltf_UnsignedByte:     return a.normalized ? *p / 255.f : (f32)*p;
+        case Gltf_Byte:             return a.normalized ? Max( *(i8*)p / 127.f, -1.f ) : (f32)*(i8*)p;
+        case Gltf_UnsignedShort:    { u16 v; COPYP( p, &v, 2 ); return a.normalized ? v / 65535.f : (f32)v; }
+        case Gltf_Short:            { i16 v; COPYP( p, &v, 2 ); return a.normalized ? Max( v / 32767.f, -1.f ) : (f32)v; }
+        case Gltf_UnsignedInt:      { u32 v; COPYP( p, &v, 4 ); return (f32)v; }
+        default:                    return 0.f;
+    }
+}
+
+INLINE u32 ReadGltfIndex( GltfAccessor const& a, sz element )
+{
+    u8 const* p = a.data + element * a.stride;
+    switch( a.componentType )
+    {
+        case Gltf_UnsignedByte:     return *p;
+        case Gltf_UnsignedShort:    { u16 v; COPYP( p, &v, 2 ); return v; }
+        case Gltf_UnsignedInt:      { u32 v; COPYP( p, &v, 4 ); return v; }
+        default:                    return 0;
+    }
+}
+
+void InitMeshStreams( MeshFileHeader* desc )
+{
+    desc->streamCount = 2;
+
+    MeshStreamDesc& positions = desc->streams[0];
+    positions.stride = sizeof(v3);
+    positions.attribCount = 1;
+    positions.attribs[0] = { MeshAttribFormat::Float32x3, 0, 0 };
+
+    MeshStreamDesc& surface = desc->streams[1];
+    surface.stride = sizeof(v3) + sizeof(v2);
+    surface.attribCount = 2;
+    surface.attribs[0] = { MeshAttribFormat::Float32x3, 0, 1 };
+    surface.attribs[1] = { MeshAttribFormat::Float32x2, sizeof(v3), 2 };
+}
+
+// Load all triangle primitives in all meshes of a .gltf or .glb file, concatenated into a single indexed mesh.
+// Buffers are loaded & decoded in parallel, and so are all primitives.
+// TODO Node transforms are ignored, as are materials and any attributes other than position, normal & uv0
+bool LoadGltf( char const* path, MeshData* out )
+{
+    Buffer<> file = Platform::ReadEntireFile( path, &globalAlloc );
+    if( !file )
+        return false;
+
+    // Unpack binary container if needed
+    char const* jsonText = (char const*)file.data;
+    sz jsonLength = file.length;
+    u8 const* glbBin = nullptr;
+    sz glbBinLength = 0;
+
+    u32 const* words = (u32 const*)file.data;
+    if( file.length >= 20 && words[0] == GlbMagic )
+    {
+        jsonLength = 0;
+        sz offset = 12;
+        while( offset + 8 <= file.length )
+        {
+            u32 chunkLength = *(u32 const*)(file.data + offset);
+            u32 chunkType = *(u32 const*)(file.data + offset + 4);
+            if( offset + 8 + chunkLength > (u64)file.length )
+                break;
+
+            if( chunkType == GlbChunkJSON )
+            {
+                jsonText = (char const*)file.data + offset + 8;
+                jsonLength = chunkLength;
+            }
+            else if( chunkType == GlbChunkBIN && !glbBin )
+            {
+                glbBin = file.data + offset + 8;
+                glbBinLength = chunkLength;
+            }
+            offset += 8 + AlignUp<sz>( chunkLength, 4 );
+        }
+    }
+
+    JsonDocument doc;
+    if( !jsonLength || !JsonParse( jsonText, jsonLength, &doc ) )
+    {
+        Log( "ERROR :: Failed parsing glTF file '%s'", path );
+        FREE( &globalAlloc, file.data );
+        return false;
+    }
+    JsonValue const* root = &doc.root;
+
+    // Resolve external files relative to the source file
+    char baseDir[256] = {};
+    char const* lastSlash = strrchr( path, '/' );
+    if( lastSlash )
+        snprintf( baseDir, sizeof(baseDir), "%.*s/", (int)(lastSlash - path), path );
+
+    // Load all buffers in parallel
+    JsonValue const* buffersJson = JsonGet( root, "buffers" );
+    std::vector<GltfBuffer> buffers( JsonCount( buffersJson ) );
+    std::atomic<bool> buffersOk = true;
+
+    ParallelFor( (sz)buffers.size(), 1, [&]( sz begin, sz end )
+    {
+        for( sz i = begin; i < end; ++i )
+        {
+            GltfBuffer& buffer = buffers[i];
+            char const* uri = JsonString( JsonGet( JsonAt( buffersJson, i ), "uri" ) );
+
+            if( !uri )
+            {
+                buffer.data = glbBin;
+                buffer.size = glbBinLength;
+            }
+            else if( strncmp( uri, "data:", 5 ) == 0 )
+            {
+                char const* payload = strstr( uri, ";base64," );
+                if( payload )
+                {
+                    payload += 8;
+                    Base64Decode( payload, (sz)strlen( payload ), &buffer.storage );
+                }
+            }
+            else
+            {
+                char bufferPath[512];
+                snprintf( bufferPath, sizeof(bufferPath), "%s%s", baseDir, uri );
+
+                Buffer<> contents = Platform::ReadEntireFile( bufferPath, &globalAlloc );
+                buffer.storage.assign( contents.begin(), contents.end() );
+                FREE( &globalAlloc, contents.data );
+            }
+
+            if( uri )
+            {
+                buffer.data = buffer.storage.data();
+                buffer.size = (sz)buffer.storage.size();
+            }
+            if( !buffer.data )
+            {
+                Log( "ERROR :: Could not load glTF buffer %d", (int)i );
+                buffersOk = false;
+            }
+        }
+    } );
+
+    if( !buffersOk )
+    {
+        FREE( &globalAlloc, file.data );
+        return false;
+    }
+
+    // Gather all triangle primitives and assign each its range in the final mesh
+    std::vector<GltfPrimitive> primitives;
+    u32 vertexCount = 0;
+    u32 indexCount = 0;
+
+    JsonValue const* meshesJson = JsonGet( root, "meshes" );
+    for( sz m = 0; m < JsonCount( meshesJson ); ++m )
+    {
+        JsonValue const* primitivesJson = JsonGet( JsonAt( meshesJson, m ), "primitives" );
+        for( sz p = 0; p < JsonCount( primitivesJson ); ++p )
+        {
+            JsonValue const* primitiveJson = JsonAt( primitivesJson, p );
+            // Only plain triangle lists for now
+            if( JsonInt( JsonGet( primitiveJson, "mode" ), 4 ) != 4 )
+                continue;
+
+            JsonValue const* attributes = JsonGet( primitiveJson, "attributes" );
+
+            GltfPrimitive prim = {};
+            if( !GetGltfAccessor( root, buffers, JsonInt( JsonGet( attributes, "POSITION" ), -1 ), &prim.position )
+                || prim.position.componentCount != 3 )
+            {
+                Log( "WARNING :: Skipping glTF primitive without valid positions" );
+                continue;
+            }
+            GetGltfAccessor( root, buffers, JsonInt( JsonGet( attributes, "NORMAL" ), -1 ), &prim.normal );
+            GetGltfAccessor( root, buffers, JsonInt( JsonGet( attributes, "TEXCOORD_0" ), -1 ), &prim.uv );
+
+            bool indexed = GetGltfAccessor( root, buffers, JsonInt( JsonGet( primitiveJson, "indices" ), -1 ), &prim.indices );
+
+            prim.firstVertex = vertexCount;
+            prim.firstIndex = indexCount;
+            prim.indexCount = (u32)(indexed ? prim.indices.count : prim.position.count);
+            vertexCount += (u32)prim.position.count;
+            indexCount += prim.indexCount;
+
+            primitives.push_back( prim );
+        }
+    }
+
+    if( primitives.empty() )
+    {
+        Log( "ERROR :: No triangle meshes found in '%s'", path );
+        FREE( &globalAlloc, file.data );
+        return false;
+    }
+
+    // Lay out final streams
+    *out = {};
+    MeshFileHeader& desc = out->desc;
+    desc.magic = MeshFileMagic;
+    desc.version = MeshFileVersion;
+    desc.vertexCount = vertexCount;
+    desc.indexCount = indexCount;
+    desc.indexSize = vertexCount <= U16MAX ? 2 : 4;
+    InitMeshStreams( &desc );
+
+    for( u32 s = 0; s < desc.streamCount; ++s )
+    {
+        desc.streams[s].dataSize = (u64)vertexCount * desc.streams[s].stride;
+        out->streamData[s].resize( desc.streams[s].dataSize );
+    }
+    desc.indexDataSize = (u64)indexCount * desc.indexSize;
+    out->indexData.resize( desc.indexDataSize );
+
+    // Decode all primitives in parallel, each one into its own range
+    std::atomic<bool> indicesOk = true;
+    u8* positionData = out->streamData[0].data();
+    u8* surfaceData = out->streamData[1].data();
+    u8* indexData = out->indexData.data();
+    u32 surfaceStride = desc.streams[1].stride;
+    u32 indexSize = desc.indexSize;
+
+    ParallelFor( (sz)primitives.size(), 1, [&]( sz begin, sz end )
+    {
+        for( sz i = begin; i < end; ++i )
+        {
+            GltfPrimitive& prim = primitives[i];
+            prim.boundsMin = V3( F32MAX );
+            prim.boundsMax = V3( -F32MAX );
+
+            for( sz v = 0; v < prim.position.count; ++v )
+            {
+                v3 p = { ReadGltfComponent( prim.position, v, 0 ),
+                         ReadGltfComponent( prim.position, v, 1 ),
+                         ReadGltfComponent( prim.position, v, 2 ) };
+                COPYP( &p, positionData + (prim.firstVertex + v) * sizeof(v3), sizeof(v3) );
+
+                prim.boundsMin = { Min( prim.boundsMin.x, p.x ), Min( prim.boundsMin.y, p.y ), Min( prim.boundsMin.z, p.z ) };
+                prim.boundsMax = { Max( prim.boundsMax.x, p.x ), Max( prim.boundsMax.y, p.y ), Max( prim.boundsMax.z, p.z ) };
+
+                v3 n = V3Zero;
+                if( prim.normal.data && v < prim.normal.count )
+                    n = { ReadGltfComponent( prim.normal, v, 0 ),
+                          ReadGltfComponent( prim.normal, v, 1 ),
+                          ReadGltfComponent( prim.normal, v, 2 ) };
+                v2 uv = { 0, 0 };
+                if( prim.uv.data && v < prim.uv.count )
+                    uv = { ReadGltfComponent( prim.uv, v, 0 ),
+                           ReadGltfComponent( prim.uv, v, 1 ) };
+
+                u8* surface = surfaceData + (prim.firstVertex + v) * surfaceStride;
+                COPYP( &n, surface, sizeof(v3) );
+                COPYP( &uv, surface + sizeof(v3), sizeof(v2) );
+            }
+
+            for( u32 idx = 0; idx < prim.indexCount; ++idx )
+            {
+                u32 vertex = prim.indices.data ? ReadGltfIndex( prim.indices, idx ) : idx;
+                // Indices past the primitive's own vertices would point into some other primitive, or off the end
+                if( vertex >= prim.position.count )
+                {
+                    indicesOk = false;
+                    vertex = 0;
+                }
+                u32 index = prim.firstVertex + vertex;
+                u8* dst = indexData + (sz)(prim.firstIndex + idx) * indexSize;
+                if( indexSize == 2 )
+                {
+                    u16 index16 = (u16)index;
+                    COPYP( &index16, dst, 2 );
+                }
+                else
+                    COPYP( &index, dst, 4 );
+            }
+        }
+    } );
+
+    v3 boundsMin = V3( F32MAX );
+    v3 boundsMax = V3( -F32MAX );
+    for( GltfPrimitive const& prim : primitives )
+    {
+        boundsMin = { Min( boundsMin.x, prim.boundsMin.x ), Min( boundsMin.y, prim.boundsMin.y ), Min( boundsMin.z, prim.boundsMin.z ) };
+        boundsMax = { Max( boundsMax.x, prim.boundsMax.x ), Max( boundsMax.y, prim.boundsMax.y ), Max( boundsMax.z, prim.boundsMax.z ) };
+    }
+    desc.bounds = AABBMinMax( boundsMin, boundsMax );
+
+    FREE( &globalAlloc, file.data );
+    if( !indicesOk )
+    {
+        Log( "ERROR :: Out of range vertex indices in '%s'", path );
+        return false;
+    }
+    return true;
+}
+
+
+/////     COOKED MESHES    /////
+
+bool CookMesh( MeshData const& mesh, char const* outPath )
+{
+    MeshFileHeader header = mesh.desc;
+
+    // Lay out all sections after the header
+    u64 offset = AlignUp<u64>( sizeof(MeshFileHeader), MeshFileDataAlignment );
+    for( u32 s = 0; s < header.streamCount; ++s )
+    {
+        header.streams[s].dataOffset = offset;
+        offset = AlignUp<u64>( offset + header.streams[s].dataSize, MeshFileDataAlignment );
+    }
+    header.indexDataOffset = offset;
+    offset += header.indexDataSize;
+
+    std::vector<u8> fileData( offset );
+    COPYP( &header, fileData.data(), sizeof(header) );
+    for( u32 s = 0; s < header.streamCount; ++s )
+        COPYP( mesh.streamData[s].data(), fileData.data() + header.streams[s].dataOffset, header.streams[s].dataSize );
+    COPYP( mesh.indexData.data(), fileData.data() + header.indexDataOffset, header.indexDataSize );
+
+    return Platform::WriteEntireFile( outPath, fileData.data(), (sz)fileData.size() );
+}
+
+INLINE WGPUVertexFormat ToWGPUVertexFormat( MeshAttribFormat format )
+{
+    switch( format )
+    {
+        case MeshAttribFormat::Float32x2: return WGPUVertexFormat_Float32x2;
+        case MeshAttribFormat::Float32x3: return WGPUVertexFormat_Float32x3;
+        case MeshAttribFormat::Float32x4: return WGPUVertexFormat_Float32x4;
+    }
+    return WGPUVertexFormat_Undefined;
+}
+
+// Create a GPU buffer mapped at creation, so data goes straight from the source pointer to upload memory
+WGPUBuffer CreateBufferWithData( char const* label, WGPUBufferUsageFlags usage, void const* data, u64 size, u64* outSize )
+{
+    WGPUBufferDescriptor bufferDesc = {};
+    bufferDesc.nextInChain = nullptr;
+    bufferDesc.label = label;
+    bufferDesc.usage = usage;
+    // Mapped buffers must have a size multiple of 4
+    bufferDesc.size = AlignUp<u64>( Max<u64>( size, 4 ), 4 );
+    bufferDesc.mappedAtCreation = true;
+    WGPUBuffer buffer = CreateGPUBuffer( &bufferDesc );
+    if( !buffer )
+    {
+        *outSize = 0;
+        return nullptr;
+    }
+
+    void* mapped = wgpuBufferGetMappedRange( buffer, 0, bufferDesc.size );
+    COPYP( data, mapped, size );
+    wgpuBufferUnmap( buffer );
+
+    *outSize = bufferDesc.size;
+    return buffer;
+}
+
+void UploadMesh( MeshFileHeader const& desc, u8 const* const streamData[], u8 const* indexData, Mesh* out )
+{
+    *out = {};
+    out->streamCount = (int)desc.streamCount;
+    out->vertexCount = desc.vertexCount;
+    out->indexCount = desc.indexCount;
+    out->bounds = desc.bounds;
+
+    for( int s = 0; s < out->streamCount; ++s )
+    {
+        MeshStreamDesc const& stream = desc.streams[s];
+        for( u32 a = 0; a < stream.attribCount; ++a )
+        {
+            WGPUVertexAttribute& attrib = out->attribs[s][a];
+            attrib.format = ToWGPUVertexFormat( stream.attribs[a].format );
+            attrib.offset = stream.attribs[a].offset;
+            attrib.shaderLocation = stream.attribs[a].shaderLocation;
+        }
+
+        WGPUVertexBufferLayout& layout = out->layouts[s];
+        layout = {};
+        layout.arrayStride = stream.stride;
+        layout.stepMode = WGPUVertexStepMode_Vertex;
+        layout.attributeCount = stream.attribCount;
+        layout.attributes = out->attribs[s];
+
+        out->vertexBuffers[s] = CreateBufferWithData( "Mesh vertex data", WGPUBufferUsage_Vertex | WGPUBufferUsage_CopyDst,
+                                                      streamData[s], stream.dataSize, &out->vertexBufferSizes[s] );
+    }
+
+    out->indexFormat = desc.indexSize == 2 ? WGPUIndexFormat_Uint16 : WGPUIndexFormat_Uint32;
+    out->indexBuffer = CreateBufferWithData( "Mesh index data", WGPUBufferUsage_Index | WGPUBufferUsage_CopyDst,
+                                             indexData, desc.indexDataSize, &out->indexBufferSize );
+}
+
+void UploadMesh( MeshData const& mesh, Mesh* out )
+{
+    u8 const* streamData[MaxMeshStreams] = {};
+    for( u32 s = 0; s < mesh.desc.streamCount; ++s )
+        streamData[s] = mesh.streamData[s].data();
+
+    UploadMesh( mesh.desc, streamData, mesh.indexData.data(), out );
+}
+
+template <typename T>
+static bool IndicesInRange( T const* indices, u32 indexCount, u32 vertexCount )
+{
+    for( u32 i = 0; i < indexCount; ++i )
+        if( indices[i] >= vertexCount )
+            return false;
+    return true;
+}
+
+bool UploadCookedMesh( char const* path, u8 const* data, u64 size, Mesh* out )
+{
+    MeshFileHeader const* header = (MeshFileHeader const*)data;
+    bool valid = size >= sizeof(MeshFileHeader)
+        && header->magic == MeshFileMagic
+        && header->version == MeshFileVersion
+        && header->streamCount <= MaxMeshStreams
+        && (header->indexSize == 2 || header->indexSize == 4)
+        && header->indexDataSize == (u64)header->indexCount * header->indexSize
+        && header->indexDataOffset % header->indexSize == 0
+        && header->indexDataOffset + header->indexDataSize <= size;
+    for( u32 s = 0; valid && s < header->streamCount; ++s )
+        valid = header->streams[s].dataSize == (u64)header->vertexCount * header->streams[s].stride
+            && header->streams[s].dataOffset + header->streams[s].dataSize <= size
+            && header->streams[s].attribCount <= MaxMeshStreamAttribs;
+    // An out of range index would make the GPU read past the end of the vertex buffers
+    if( valid )
+        valid = header->indexSize == 2
+            ? IndicesInRange( (u16 const*)(data + header->indexDataOffset), header->indexCount, header->vertexCount )
+            : IndicesInRange( (u32 const*)(data + header->indexDataOffset), header->indexCount, header->vertexCount );
+
+    if( valid )
+    {
+        u8 const* streamData[MaxMeshStreams] = {};
+        for( u32 s = 0; s < header->streamCount; ++s )
+            streamData[s] = data + header->streams[s].dataOffset;
+
+        UploadMesh( *header, streamData, data + header->indexDataOffset, out );
+    }
+    else
+        Log( "ERROR :: Invalid or outdated cooked mesh '%s'", path );
+
+    return valid;
+}
+
+// Uses the file as read ahead by PrefetchMesh if it was, and maps it otherwise
+bool LoadCookedMesh( char const* path, Mesh* out )
+{
+    Buffer<u8> prefetched = TakePrefetchedFile( path );
+    if( prefetched.data )
+    {
+        bool result = UploadCookedMesh( path, prefetched.data, (u64)prefetched.length, out );
+        FREE( &globalAlloc, prefetched.data );
+        return result;
+    }
+
+    MappedFile file;
+    if( !Platform::MapFile( path, &file ) )
+        return false;
+
+    bool result = UploadCookedMesh( path, file.data, (u64)file.size, out );
+    Platform::UnmapFile( &file );
+    return result;
+}
+
+void GetCookedMeshPath( char const* sourcePath, char* outPath, int outPathLength )
+{
+    char const* lastSlash = strrchr( sourcePath, '/' );
+    char const* name = lastSlash ? lastSlash + 1 : sourcePath;
+    char const* ext = strrchr( name, '.' );
+    int nameLength = ext ? (int)(ext - name) : (int)strlen( name );
+
+    // The name alone would make sources with the same name in different folders share (and keep re-cooking) one file
+    u64 pathHash = HashBytes64( sourcePath, (sz)strlen( sourcePath ) );
+    snprintf( outPath, outPathLength, "%s/%.*s-%016llx.mesh", MeshCacheDir, nameLength, name, pathHash );
+}
+
+// Start reading the cooked version of a mesh that's about to be loaded. Meshes that still need cooking are left alone
+void PrefetchMesh( char const* sourcePath )
+{
+    char cookedPath[256];
+    GetCookedMeshPath( sourcePath, cookedPath, sizeof(cookedPath) );
+
+    u64 cookedTime = Platform::GetFileModificationTime( cookedPath );
+    if( cookedTime && cookedTime >= Platform::GetFileModificationTime( sourcePath ) )
+        PrefetchFile( cookedPath );
+}
+
+// Load a mesh through the cache, cooking it first if the cooked version is missing or older than the source
+bool LoadMesh( char const* sourcePath, Mesh* out )
+{
+    char cookedPath[256];
+    GetCookedMeshPath( sourcePath, cookedPath, sizeof(cookedPath) );
+
+    u64 sourceTime = Platform::GetFileModificationTime( sourcePath );
+    u64 cookedTime = Platform::GetFileModificationTime( cookedPath );
+    if( cookedTime && cookedTime >= sourceTime && LoadCookedMesh( cookedPath, out ) )
+        return true;
+
+    MeshData mesh;
+    if( !LoadGltf( sourcePath, &mesh ) )
+        return false;
+
+    Log( "Cooking mesh '%s' into '%s'..", sourcePath, cookedPath );
+    Platform::EnsureDirectoryExists( MeshCacheDir );
+    CookMesh( mesh, cookedPath );
+
+    UploadMesh( mesh, out );
+    return true;
+}
+
+void ReleaseMesh( Mesh* mesh )
+{
+    for( int s = 0; s < mesh->streamCount; ++s )
+        DestroyGPUBuffer( mesh->vertexBuffers[s] );
+    DestroyGPUBuffer( mesh->indexBuffer );
+
+    *mesh = {};
+}
+
+// Declare the mesh vertex streams as the program's vertex buffers, and draw it indexed
+// NOTE Must be called from the program's init function, so the layouts are known when creating the pipeline
+void SetProgramMesh( Program* program, Mesh const& mesh )
+{
+    for( int s = 0; s < mesh.streamCount; ++s )
+    {
+        WGPUVertexBufferLayout const& layout = mesh.layouts[s];
+        int slot = AddVertexBufferLayout( program, layout.attributes, (int)layout.attributeCount,
+                                          layout.arrayStride, layout.stepMode );
+
+        program->vertexBuffers[slot] = mesh.vertexBuffers[s];
+        program->vertexBufferSizes[slot] = mesh.vertexBufferSizes[s];
+    }
+
+    program->indexBuffer = mesh.indexBuffer;
+    program->indexBufferSize = mesh.indexBufferSize;
+    program->indexFormat = mesh.indexFormat;
+    program->indexCount = (int)mesh.indexCount;
+    program->elementCount = (int)mesh.vertexCount;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+// Cooked binary mesh format (.mesh)
+// Vertex streams are stored exactly as they'll be bound through a WGPUVertexBufferLayout, so loading one
+// is just a matter of mapping the file and copying each section straight into a GPU buffer.
+// Streams are:
+//   0: position (float32x3 @location(0))
+//   1: normal (float32x3 @location(1)), uv (float32x2 @location(2))
+
+constexpr u32 MeshFileMagic = 0x4853454D;       // 'MESH'
+constexpr u32 MeshFileVersion = 1;
+constexpr int MaxMeshStreams = 2;
+constexpr int MaxMeshStreamAttribs = 4;
+constexpr u64 MeshFileDataAlignment = 16;
+constexpr char const* MeshCacheDir = "cache";
+
+// NOTE We don't store WGPU enums directly, since their values differ between backends
+enum class MeshAttribFormat : u32
+{
+    Float32x2,
+    Float32x3,
+    Float32x4,
+};
+
+struct MeshAttrib
+{
+    MeshAttribFormat format;
+    u32 offset;
+    u32 shaderLocation;
+};
+
+struct MeshStreamDesc
+{
+    u32 stride;
+    u32 attribCount;
+    MeshAttrib attribs[MaxMeshStreamAttribs];
+    u64 dataOffset;             // From the start of the file
+    u64 dataSize;
+};
+
+struct MeshFileHeader
+{
+    u32 magic;
+    u32 version;
+    u32 vertexCount;
+    u32 indexCount;
+    u32 indexSize;              // Either 2 or 4 bytes
+    u32 streamCount;
+    aabb bounds;
+    MeshStreamDesc streams[MaxMeshStreams];
+    u64 indexDataOffset;
+    u64 indexDataSize;
+};
+static_assert( sizeof(MeshFileHeader) % 8 == 0 );
+
+// CPU-side mesh as decoded from a source asset, already laid out as GPU streams
+struct MeshData
+{
+    MeshFileHeader desc;        // Data offsets are only meaningful once cooked
+    std::vector<u8> streamData[MaxMeshStreams];
+    std::vector<u8> indexData;
+};
+
+// GPU-resident mesh
+struct Mesh
+{
+    WGPUVertexBufferLayout layouts[MaxMeshStreams];
+    WGPUVertexAttribute attribs[MaxMeshStreams][MaxMeshStreamAttribs];
+    WGPUBuffer vertexBuffers[MaxMeshStreams];
+    u64 vertexBufferSizes[MaxMeshStreams];
+    int streamCount;
+
+    WGPUBuffer indexBuffer;
+    u64 indexBufferSize;
+    WGPUIndexFormat indexFormat;
+
+    u32 vertexCount;
+    u32 indexCount;
+    aabb bounds;
+};
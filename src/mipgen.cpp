@@ -0,0 +1,370 @@
+
+MipGenerator globalMipGenerator;
+
+
+INLINE char const* StorageFormatName( WGPUTextureFormat format )
+{
+    switch( format )
+    {
+        case WGPUTextureFormat_RGBA8Unorm: return "rgba8unorm";
+        case WGPUTextureFormat_RGBA16Float: return "rgba16float";
+        case WGPUTextureFormat_RGBA32Float: return "rgba32float";
+        default: return nullptr;
+    }
+}
+
+void ReplaceAll( std::string* str, char const* token, char const* value )
+{
+    sz tokenLength = strlen( token );
+    sz valueLength = strlen( value );
+    for( sz pos = str->find( token ); pos != std::string::npos; pos = str->find( token, pos + valueLength ) )
+        str->replace( pos, tokenLength, value );
+}
+
+// Which of a format's pipelines a shader dependency is for
+enum MipGenPipeline
+{
+    MipGenPipeline_Compute,
+    MipGenPipeline_Blit,
+};
+
+// Dropped when their shader changes, and rebuilt the next time the format needs mips
+void InvalidateMipGenPipeline( void* owner, int variant )
+{
+    MipGenFormat* f = (MipGenFormat*)owner;
+    if( variant == MipGenPipeline_Compute )
+    {
+        DeferRelease( f->computePipeline );
+        f->computePipeline = nullptr;
+    }
+    else
+    {
+        DeferRelease( f->blitPipeline );
+        f->blitPipeline = nullptr;
+    }
+}
+
+void InitMipGenComputePipeline( MipGenFormat* f )
+{
+    WGPUTextureFormat storageFormat = LinearFormat( f->format );
+    char const* storageFormatName = StorageFormatName( storageFormat );
+    if( !storageFormatName )
+    {
+        Log( "ERROR :: Unsupported format for compute mip generation: %d", f->format );
+        return;
+    }
+
+    std::string source;
+    if( !LoadShaderSource( MipGenShaderPath, &source, { f, MipGenPipeline_Compute, InvalidateMipGenPipeline } ) )
+        return;
+
+    ReplaceAll( &source, "STORAGE_FORMAT", storageFormatName );
+    ReplaceAll( &source, "IS_SRGB", IsSRGBFormat( f->format ) ? "true" : "false" );
+    ReplaceAll( &source, "IS_UNORM8", BytesPerTexel( f->format ) == 4 ? "true" : "false" );
+    WGPUShaderModule shaderModule = CreateShaderModule( source.c_str(), MipGenShaderPath );
+
+    WGPUBindGroupLayoutEntry bindingLayouts[3];
+    bindingLayouts[0] = DefaultBinding();
+    bindingLayouts[0].binding = 0;
+    bindingLayouts[0].visibility = WGPUShaderStage_Compute;
+    // Only textureLoad is used, so this works for non-filterable formats too
+    bindingLayouts[0].texture.sampleType = WGPUTextureSampleType_UnfilterableFloat;
+    bindingLayouts[0].texture.viewDimension = WGPUTextureViewDimension_2D;
+    for( int i = 1; i < 3; ++i )
+    {
+        bindingLayouts[i] = DefaultBinding();
+        bindingLayouts[i].binding = i;
+        bindingLayouts[i].visibility = WGPUShaderStage_Compute;
+        bindingLayouts[i].storageTexture.access = WGPUStorageTextureAccess_WriteOnly;
+        bindingLayouts[i].storageTexture.format = storageFormat;
+        bindingLayouts[i].storageTexture.viewDimension = WGPUTextureViewDimension_2D;
+    }
+
+    WGPUBindGroupLayoutDescriptor bindGroupLayoutDesc = {};
+    bindGroupLayoutDesc.nextInChain = nullptr;
+    bindGroupLayoutDesc.entryCount = ARRAYCOUNT(bindingLayouts);
+    bindGroupLayoutDesc.entries = bindingLayouts;
+    // Layout and dummy survive shader reloads
+    if( !f->computeBindGroupLayout )
+        f->computeBindGroupLayout = wgpuDeviceCreateBindGroupLayout( globalDevice, &bindGroupLayoutDesc );
+
+    WGPUPipelineLayoutDescriptor layoutDesc = {};
+    layoutDesc.nextInChain                  = nullptr;
+    layoutDesc.bindGroupLayoutCount         = 1;
+    layoutDesc.bindGroupLayouts             = &f->computeBindGroupLayout;
+    WGPUPipelineLayout pipelineLayout       = wgpuDeviceCreatePipelineLayout( globalDevice, &layoutDesc );
+
+    WGPUComputePipelineDescriptor pipelineDesc = {};
+    pipelineDesc.nextInChain                   = nullptr;
+    pipelineDesc.label                         = "Mip generation";
+    pipelineDesc.layout                        = pipelineLayout;
+    pipelineDesc.compute.module                = shaderModule;
+    pipelineDesc.compute.entryPoint            = "cs_main";
+    pipelineDesc.compute.constantCount         = 0;
+    pipelineDesc.compute.constants             = nullptr;
+    f->computePipeline = wgpuDeviceCreateComputePipeline( globalDevice, &pipelineDesc );
+
+    wgpuPipelineLayoutRelease( pipelineLayout );
+    wgpuShaderModuleRelease( shaderModule );
+    if( f->dummyTexture )
+        return;
+
+    // 1x1 target for the second level when the chain has an odd number of levels left
+    WGPUTextureDescriptor dummyDesc = {};
+    dummyDesc.nextInChain           = nullptr;
+    dummyDesc.label                 = "Mip generation dummy";
+    dummyDesc.usage                 = WGPUTextureUsage_StorageBinding;
+    dummyDesc.dimension             = WGPUTextureDimension_2D;
+    dummyDesc.size                  = { 1, 1, 1 };
+    dummyDesc.format                = storageFormat;
+    dummyDesc.mipLevelCount         = 1;
+    dummyDesc.sampleCount           = 1;
+    dummyDesc.viewFormatCount       = 0;
+    dummyDesc.viewFormats           = nullptr;
+    f->dummyTexture = CreateGPUTexture( &dummyDesc, SharedGPUMemoryOwner );
+    f->dummyView = wgpuTextureCreateView( f->dummyTexture, nullptr );
+}
+
+void InitMipGenBlitPipeline( MipGenerator* gen, MipGenFormat* f )
+{
+    std::string source;
+    if( !LoadShaderSource( MipGenBlitShaderPath, &source, { f, MipGenPipeline_Blit, InvalidateMipGenPipeline } ) )
+        return;
+    WGPUShaderModule shaderModule = CreateShaderModule( source.c_str(), MipGenBlitShaderPath );
+
+    if( !gen->blitSampler )
+    {
+        WGPUSamplerDescriptor samplerDesc = {};
+        samplerDesc.nextInChain   = nullptr;
+        samplerDesc.label         = "Mip generation sampler";
+        samplerDesc.addressModeU  = WGPUAddressMode_ClampToEdge;
+        samplerDesc.addressModeV  = WGPUAddressMode_ClampToEdge;
+        samplerDesc.addressModeW  = WGPUAddressMode_ClampToEdge;
+        samplerDesc.magFilter     = WGPUFilterMode_Linear;
+        samplerDesc.minFilter     = WGPUFilterMode_Linear;
+        samplerDesc.mipmapFilter  = WGPUMipmapFilterMode_Nearest;
+        samplerDesc.lodMinClamp   = 0.f;
+        samplerDesc.lodMaxClamp   = 32.f;
+        samplerDesc.compare       = WGPUCompareFunction_Undefined;
+        samplerDesc.maxAnisotropy = 1;
+        gen->blitSampler = wgpuDeviceCreateSampler( globalDevice, &samplerDesc );
+    }
+
+    WGPUBindGroupLayoutEntry bindingLayouts[2];
+    bindingLayouts[0] = DefaultBinding();
+    bindingLayouts[0].binding = 0;
+    bindingLayouts[0].visibility = WGPUShaderStage_Fragment;
+    bindingLayouts[0].texture.sampleType = WGPUTextureSampleType_Float;
+    bindingLayouts[0].texture.viewDimension = WGPUTextureViewDimension_2D;
+    bindingLayouts[1] = DefaultBinding();
+    bindingLayouts[1].binding = 1;
+    bindingLayouts[1].visibility = WGPUShaderStage_Fragment;
+    bindingLayouts[1].sampler.type = WGPUSamplerBindingType_Filtering;
+
+    WGPUBindGroupLayoutDescriptor bindGroupLayoutDesc = {};
+    bindGroupLayoutDesc.nextInChain = nullptr;
+    bindGroupLayoutDesc.entryCount = ARRAYCOUNT(bindingLayouts);
+    bindGroupLayoutDesc.entries = bindingLayouts;
+    if( !f->blitBindGroupLayout )
+        f->blitBindGroupLayout = wgpuDeviceCreateBindGroupLayout( globalDevice, &bindGroupLayoutDesc );
+
+    WGPUPipelineLayoutDescriptor layoutDesc = {};
+    layoutDesc.nextInChain                  = nullptr;
+    layoutDesc.bindGroupLayoutCount         = 1;
+    layoutDesc.bindGroupLayouts             = &f->blitBindGroupLayout;
+    WGPUPipelineLayout pipelineLayout       = wgpuDeviceCreatePipelineLayout( globalDevice, &layoutDesc );
+
+    WGPUFragmentState fragmentState  = {};
+    fragmentState.module             = shaderModule;
+    fragmentState.entryPoint         = "fs_main";
+    fragmentState.constantCount      = 0;
+    fragmentState.constants          = nullptr;
+    WGPUColorTargetState colorTarget = {};
+    colorTarget.format               = f->format;
+    colorTarget.blend                = nullptr;
+    colorTarget.writeMask            = WGPUColorWriteMask_All;
+    fragmentState.targetCount        = 1;
+    fragmentState.targets            = &colorTarget;
+
+    WGPURenderPipelineDescriptor pipelineDesc       = {};
+    pipelineDesc.nextInChain                        = nullptr;
+    pipelineDesc.label                              = "Mip generation blit";
+    pipelineDesc.vertex.bufferCount                 = 0;
+    pipelineDesc.vertex.buffers                     = nullptr;
+    pipelineDesc.vertex.module                      = shaderModule;
+    pipelineDesc.vertex.entryPoint                  = "vs_main";
+    pipelineDesc.vertex.constantCount               = 0;
+    pipelineDesc.vertex.constants                   = nullptr;
+    pipelineDesc.primitive.topology                 = WGPUPrimitiveTopology_TriangleList;
+    pipelineDesc.primitive.stripIndexFormat         = WGPUIndexFormat_Undefined;
+    pipelineDesc.primitive.frontFace                = WGPUFrontFace_CCW;
+    pipelineDesc.primitive.cullMode                 = WGPUCullMode_None;
+    pipelineDesc.fragment                           = &fragmentState;
+    pipelineDesc.depthStencil                       = nullptr;
+    pipelineDesc.multisample.count                  = 1;
+    pipelineDesc.multisample.mask                   = ~0u;
+    pipelineDesc.multisample.alphaToCoverageEnabled = false;
+    pipelineDesc.layout                             = pipelineLayout;
+    f->blitPipeline = wgpuDeviceCreateRenderPipeline( globalDevice, &pipelineDesc );
+
+    wgpuPipelineLayoutRelease( pipelineLayout );
+    wgpuShaderModuleRelease( shaderModule );
+}
+
+MipGenFormat* GetMipGenFormat( MipGenerator* gen, WGPUTextureFormat format )
+{
+    for( int i = 0; i < gen->formatCount; ++i )
+        if( gen->formats[i].format == format )
+            return &gen->formats[i];
+
+    ASSERT( gen->formatCount < MaxMipGenFormats, "Too many mip generation formats" );
+    MipGenFormat* result = &gen->formats[gen->formatCount++];
+    *result = {};
+    result->format = format;
+    return result;
+}
+
+
+// Record a compute pass filling in all mips of the texture from its top level, two levels per dispatch.
+// The texture must have been created with MipGenUsage (see CreateTexture for how sRGB formats are handled)
+bool GenerateMips( WGPUCommandEncoder encoder, Texture const& texture, MipGenerator* gen = &globalMipGenerator )
+{
+    ASSERT( (texture.usage & MipGenUsage) == MipGenUsage, "Texture wasn't created with MipGenUsage" );
+    if( texture.mipCount < 2 )
+        return true;
+
+    MipGenFormat* f = GetMipGenFormat( gen, texture.format );
+    if( !f->computePipeline )
+        InitMipGenComputePipeline( f );
+    if( !f->computePipeline )
+        return false;
+
+    WGPUTextureFormat storageFormat = LinearFormat( texture.format );
+
+    WGPUComputePassDescriptor passDesc = {};
+    passDesc.nextInChain = nullptr;
+    passDesc.label = "Mip generation";
+    passDesc.timestampWriteCount = 0;
+    passDesc.timestampWrites = nullptr;
+    WGPUComputePassEncoder pass = wgpuCommandEncoderBeginComputePass( encoder, &passDesc );
+    wgpuComputePassEncoderSetPipeline( pass, f->computePipeline );
+
+    for( u32 srcMip = 0; srcMip + 1 < texture.mipCount; srcMip += 2 )
+    {
+        bool hasSecondLevel = srcMip + 2 < texture.mipCount;
+
+        WGPUTextureView srcView = CreateTextureView( texture, srcMip, 1 );
+        WGPUTextureView dst1View = CreateTextureView( texture, srcMip + 1, 1, storageFormat );
+        WGPUTextureView dst2View = hasSecondLevel ? CreateTextureView( texture, srcMip + 2, 1, storageFormat ) : f->dummyView;
+
+        WGPUBindGroupEntry bindings[3] = {};
+        bindings[0].binding = 0;
+        bindings[0].textureView = srcView;
+        bindings[1].binding = 1;
+        bindings[1].textureView = dst1View;
+        bindings[2].binding = 2;
+        bindings[2].textureView = dst2View;
+
+        WGPUBindGroupDescriptor bindGroupDesc = {};
+        bindGroupDesc.nextInChain = nullptr;
+        bindGroupDesc.layout = f->computeBindGroupLayout;
+        bindGroupDesc.entryCount = ARRAYCOUNT(bindings);
+        bindGroupDesc.entries = bindings;
+        WGPUBindGroup bindGroup = wgpuDeviceCreateBindGroup( globalDevice, &bindGroupDesc );
+
+        u32 dst1Width = MipDimension( texture.width, srcMip + 1 );
+        u32 dst1Height = MipDimension( texture.height, srcMip + 1 );
+        wgpuComputePassEncoderSetBindGroup( pass, 0, bindGroup, 0, nullptr );
+        wgpuComputePassEncoderDispatchWorkgroups( pass, (dst1Width + MipGenTileSize - 1) / MipGenTileSize,
+                                                  (dst1Height + MipGenTileSize - 1) / MipGenTileSize, 1 );
+
+        // Encoded commands keep their own references
+        wgpuBindGroupRelease( bindGroup );
+        wgpuTextureViewRelease( srcView );
+        wgpuTextureViewRelease( dst1View );
+        if( hasSecondLevel )
+            wgpuTextureViewRelease( dst2View );
+    }
+
+    wgpuComputePassEncoderEnd( pass );
+#ifdef WEBGPU_BACKEND_DAWN
+    wgpuComputePassEncoderRelease( pass );
+#endif
+    return true;
+}
+
+// Reference implementation with one render pass per level, each sampling the previous one.
+// The texture must have been created with MipGenBlitUsage
+bool GenerateMipsWithRenderPasses( WGPUCommandEncoder encoder, Texture const& texture, MipGenerator* gen = &globalMipGenerator )
+{
+    ASSERT( (texture.usage & MipGenBlitUsage) == MipGenBlitUsage, "Texture wasn't created with MipGenBlitUsage" );
+
+    MipGenFormat* f = GetMipGenFormat( gen, texture.format );
+    if( !f->blitPipeline )
+        InitMipGenBlitPipeline( gen, f );
+    if( !f->blitPipeline )
+        return false;
+
+    for( u32 dstMip = 1; dstMip < texture.mipCount; ++dstMip )
+    {
+        WGPUTextureView srcView = CreateTextureView( texture, dstMip - 1, 1 );
+        WGPUTextureView dstView = CreateTextureView( texture, dstMip, 1 );
+
+        WGPUBindGroupEntry bindings[2] = {};
+        bindings[0].binding = 0;
+        bindings[0].textureView = srcView;
+        bindings[1].binding = 1;
+        bindings[1].sampler = gen->blitSampler;
+
+        WGPUBindGroupDescriptor bindGroupDesc = {};
+        bindGroupDesc.nextInChain = nullptr;
+        bindGroupDesc.layout = f->blitBindGroupLayout;
+        bindGroupDesc.entryCount = ARRAYCOUNT(bindings);
+        bindGroupDesc.entries = bindings;
+        WGPUBindGroup bindGroup = wgpuDeviceCreateBindGroup( globalDevice, &bindGroupDesc );
+
+        WGPURenderPassColorAttachment colorAttachment = {};
+        colorAttachment.view                          = dstView;
+        colorAttachment.resolveTarget                 = nullptr;
+        colorAttachment.loadOp                        = WGPULoadOp_Clear;
+        colorAttachment.storeOp                       = WGPUStoreOp_Store;
+        colorAttachment.clearValue                    = ClearColor;
+
+        WGPURenderPassDescriptor renderPassDesc = {};
+        renderPassDesc.nextInChain              = nullptr;
+        renderPassDesc.colorAttachmentCount     = 1;
+        renderPassDesc.colorAttachments         = &colorAttachment;
+        renderPassDesc.depthStencilAttachment   = nullptr;
+        renderPassDesc.timestampWriteCount      = 0;
+        renderPassDesc.timestampWrites          = nullptr;
+
+        WGPURenderPassEncoder renderPass = wgpuCommandEncoderBeginRenderPass( encoder, &renderPassDesc );
+        wgpuRenderPassEncoderSetPipeline( renderPass, f->blitPipeline );
+        wgpuRenderPassEncoderSetBindGroup( renderPass, 0, bindGroup, 0, nullptr );
+        wgpuRenderPassEncoderDraw( renderPass, 3, 1, 0, 0 );
+        wgpuRenderPassEncoderEnd( renderPass );
+
+        wgpuBindGroupRelease( bindGroup );
+        wgpuTextureViewRelease( srcView );
+        wgpuTextureViewRelease( dstView );
+    }
+
+    return true;
+}
+
+// CPU reference for RGBA8 formats, producing each level tightly packed
+void GenerateMipsCPU( u8 const* pixels, u32 width, u32 height, u32 mipCount, bool srgb, std::vector<u8>* outMips )
+{
+    outMips[0].assign( pixels, pixels + (sz)width * height * 4 );
+    for( u32 m = 1; m < mipCount; ++m )
+    {
+        u32 srcWidth = MipDimension( width, m - 1 );
+        u32 srcHeight = MipDimension( height, m - 1 );
+        u32 dstWidth = MipDimension( width, m );
+        u32 dstHeight = MipDimension( height, m );
+
+        outMips[m].resize( (sz)dstWidth * dstHeight * 4 );
+        DownsampleRGBA8( outMips[m - 1].data(), srcWidth, srcHeight, srcWidth * 4,
+                         outMips[m].data(), dstWidth, dstHeight, dstWidth * 4, srgb );
+    }
+}
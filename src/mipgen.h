@@ -0,0 +1,37 @@
+#pragma once
+
+// GPU mip chain generation for textures created at runtime.
+// The compute path builds two levels per dispatch: each 8x8 workgroup writes an 8x8 tile of the first level,
+// keeps it in workgroup memory, and reduces that to a 4x4 tile of the second level without going back to memory.
+
+constexpr int MaxMipGenFormats = 8;
+constexpr int MipGenTileSize = 8;
+constexpr char const* MipGenShaderPath = "src/shaders/mipgen.wgsl";
+constexpr char const* MipGenBlitShaderPath = "src/shaders/mipgen_blit.wgsl";
+
+// Textures passed to GenerateMips need at least these usages
+constexpr WGPUTextureUsageFlags MipGenUsage = WGPUTextureUsage_TextureBinding | WGPUTextureUsage_StorageBinding;
+// ..while GenerateMipsWithRenderPasses needs these
+constexpr WGPUTextureUsageFlags MipGenBlitUsage = WGPUTextureUsage_TextureBinding | WGPUTextureUsage_RenderAttachment;
+
+// Pipelines are specialized per format, and created the first time each format is seen
+struct MipGenFormat
+{
+    WGPUTextureFormat format;
+
+    WGPUBindGroupLayout computeBindGroupLayout;
+    WGPUComputePipeline computePipeline;
+    // Bound as the second level when there's only one level left to generate
+    WGPUTexture dummyTexture;
+    WGPUTextureView dummyView;
+
+    WGPUBindGroupLayout blitBindGroupLayout;
+    WGPURenderPipeline blitPipeline;
+};
+
+struct MipGenerator
+{
+    MipGenFormat formats[MaxMipGenFormats];
+    int formatCount;
+    WGPUSampler blitSampler;
+};
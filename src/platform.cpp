@@ -57,6 +57,119 @@ namespace Platform
         return Buffer<u8>( resultData, resultLength );
     }
 
+    bool WriteEntireFile( char const* filename, void const* data, sz length )
+    {
+        bool result = false;
+
+        HANDLE fileHandle = CreateFile( filename, GENERIC_WRITE, 0, 0, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0 );
+        if( fileHandle != INVALID_HANDLE_VALUE )
+        {
+            // WriteFile takes a 32-bit size, so go in chunks
+            u8 const* at = (u8 const*)data;
+            result = true;
+            while( length > 0 && result )
+            {
+                DWORD chunkSize = (DWORD)Min<sz>( length, 1024 * 1024 * 1024 );
+                DWORD bytesWritten;
+                result = WriteFile( fileHandle, at, chunkSize, &bytesWritten, 0 ) && bytesWritten == chunkSize;
+
+                at += chunkSize;
+                length -= chunkSize;
+            }
+
+            if( !result )
+                Log( "ERROR :: WriteFile failed for '%s'", filename );
+
+            CloseHandle( fileHandle );
+        }
+        else
+        {
+            Log( "ERROR :: Failed opening file '%s' for writing", filename );
+        }
+
+        return result;
+    }
+
+    // Map a whole file for reading. Pages are only brought in from disk as they're touched
+    bool MapFile( char const* filename, MappedFile* result )
+    {
+        *result = {};
+
+        result->fileHandle = CreateFile( filename, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0 );
+        if( result->fileHandle == INVALID_HANDLE_VALUE )
+        {
+            Log( "ERROR :: Failed opening file '%s' for mapping", filename );
+            return false;
+        }
+
+        if( !GetFileSizeEx( result->fileHandle, (PLARGE_INTEGER)&result->size ) || result->size == 0 )
+        {
+            Log( "ERROR :: Failed querying file size for '%s'", filename );
+            CloseHandle( result->fileHandle );
+            *result = {};
+            return false;
+        }
+
+        result->mappingHandle = CreateFileMapping( result->fileHandle, NULL, PAGE_READONLY, 0, 0, NULL );
+        if( result->mappingHandle )
+            result->data = (u8 const*)MapViewOfFile( result->mappingHandle, FILE_MAP_READ, 0, 0, 0 );
+
+        if( !result->data )
+        {
+            Log( "ERROR :: Failed mapping file '%s'", filename );
+            if( result->mappingHandle )
+                CloseHandle( result->mappingHandle );
+            CloseHandle( result->fileHandle );
+            *result = {};
+            return false;
+        }
+
+        return true;
+    }
+
+    void UnmapFile( MappedFile* file )
+    {
+        if( file->data )
+            UnmapViewOfFile( file->data );
+        if( file->mappingHandle )
+            CloseHandle( file->mappingHandle );
+        if( file->fileHandle )
+            CloseHandle( file->fileHandle );
+
+        *file = {};
+    }
+
+    // Start paging in a mapped file in the background, so touching it later doesn't stall on disk
+    void PrefetchFile( MappedFile const& file )
+    {
+        WIN32_MEMORY_RANGE_ENTRY range = { (void*)file.data, (SIZE_T)file.size };
+        PrefetchVirtualMemory( GetCurrentProcess(), 1, &range, 0 );
+    }
+
+    bool RemoveFile( char const* filename )
+    {
+        return DeleteFile( filename ) != 0;
+    }
+
+    // Returns 0 if the file doesn't exist
+    u64 GetFileModificationTime( char const* filename )
+    {
+        WIN32_FILE_ATTRIBUTE_DATA info;
+        if( !GetFileAttributesEx( filename, GetFileExInfoStandard, &info ) )
+            return 0;
+
+        ULARGE_INTEGER result;
+        result.LowPart = info.ftLastWriteTime.dwLowDateTime;
+        result.HighPart = info.ftLastWriteTime.dwHighDateTime;
+        return result.QuadPart;
+    }
+
+    void EnsureDirectoryExists( char const* path )
+    {
+        // Fails harmlessly if it's already there
+        CreateDirectory( path, NULL );
+    }
+
     bool SetupShaderUpdateListener( char const* relDirPath, OnShaderUpdatedFunc* callback, ShaderUpdateListener* listener )
     {
         listener->dirHandle
@@ -140,6 +253,47 @@ namespace Platform
     }
 
 
+    // Cores this process may actually run on: the ones in its affinity mask, further capped by any hard CPU rate
+    // limit on the job object it belongs to (which is how containers and similar sandboxes limit CPU on Windows)
+    int GetUsableCoreCount()
+    {
+        int systemCount = Max( 1, (int)std::thread::hardware_concurrency() );
+        int count = systemCount;
+
+        DWORD_PTR processMask, systemMask;
+        if( GetProcessAffinityMask( GetCurrentProcess(), &processMask, &systemMask ) && processMask )
+            count = Min( count, PopCount64( (u64)processMask ) );
+
+        JOBOBJECT_CPU_RATE_CONTROL_INFORMATION rate = {};
+        if( QueryInformationJobObject( NULL, JobObjectCpuRateControlInformation, &rate, sizeof(rate), NULL )
+            && (rate.ControlFlags & JOB_OBJECT_CPU_RATE_CONTROL_ENABLE)
+            && (rate.ControlFlags & JOB_OBJECT_CPU_RATE_CONTROL_HARD_CAP) )
+        {
+            // Rate is in hundredths of a percent of all cores
+            int rateCores = (int)(((u64)rate.CpuRate * systemCount + 9999) / 10000);
+            count = Min( count, Max( 1, rateCores ) );
+        }
+
+        return Max( 1, count );
+    }
+
+    // Tie the calling thread to the index-th core the process is allowed to run on (wrapping around)
+    bool PinCurrentThread( int index )
+    {
+        DWORD_PTR processMask, systemMask;
+        if( !GetProcessAffinityMask( GetCurrentProcess(), &processMask, &systemMask ) || !processMask )
+            return false;
+
+        index %= PopCount64( (u64)processMask );
+        u64 mask = (u64)processMask;
+        for( int i = 0; i < index; ++i )
+            mask &= mask - 1;
+        mask &= ~(mask - 1);
+
+        return SetThreadAffinityMask( GetCurrentThread(), (DWORD_PTR)mask ) != 0;
+    }
+
+
     f64 CurrentTimeMillis()
     {
         static f64 perfCounterFrequency = 0;
@@ -156,16 +310,44 @@ namespace Platform
         
         return result;
     }
+    // CPU time used so far by the whole process, on all its threads (kernel and user)
+    f64 ProcessCPUTimeMillis()
+    {
+        FILETIME creation, exit, kernel, user;
+        if( !GetProcessTimes( GetCurrentProcess(), &creation, &exit, &kernel, &user ) )
+            return 0;
+
+        ULARGE_INTEGER k, u;
+        k.LowPart = kernel.dwLowDateTime;
+        k.HighPart = kernel.dwHighDateTime;
+        u.LowPart = user.dwLowDateTime;
+        u.HighPart = user.dwHighDateTime;
+        // In 100 ns units
+        return (f64)(k.QuadPart + u.QuadPart) / 10000.0;
+    }
+
     static f64 appStartTimeMillis = CurrentTimeMillis();
+    // When not negative, app time stays at this instead of following the clock (for offline rendering)
+    static f64 fixedAppTimeMillis = -1;
+
+    void SetFixedAppTime( f64 millis )
+    {
+        fixedAppTimeMillis = millis;
+    }
+
+    static f64 ElapsedAppTimeMillis()
+    {
+        return fixedAppTimeMillis >= 0 ? fixedAppTimeMillis : CurrentTimeMillis() - appStartTimeMillis;
+    }
 
     f32 AppTimeMillis()
     {
-        return (f32)(CurrentTimeMillis() - appStartTimeMillis);
+        return (f32)ElapsedAppTimeMillis();
     }
 
     f32 AppTimeSeconds()
     {
-        return (f32)((CurrentTimeMillis() - appStartTimeMillis) * 0.001);
+        return (f32)(ElapsedAppTimeMillis() * 0.001);
     }
 }
 
@@ -10,3 +10,10 @@ struct ShaderUpdateListener
     OVERLAPPED overlapped;
 };
 
+struct MappedFile
+{
+    u8 const* data;
+    sz size;
+    HANDLE fileHandle;
+    HANDLE mappingHandle;
+};
@@ -15,7 +15,8 @@ struct ShadertoyUniforms
 {
     v2 iResolution;
     f32 iTime;
-    f32 _pad;
+    u32 iFrame;
+    v2 iTileOffset;             // Where the tile being rendered sits in the full image (see shadertoy.wgsl)
 };
 
 void InitStarfield( Program* program, void* userdata )
@@ -32,6 +33,8 @@ void UpdateStarfield( Program* program, void* userdata, f32 viewportWidth, f32 v
     ShadertoyUniforms uniforms;
     uniforms.iResolution = V2( viewportWidth, viewportHeight );
     uniforms.iTime = Platform::AppTimeSeconds();
+    uniforms.iFrame = program->updateFrameIndex;
+    uniforms.iTileOffset = program->tileOffset;
 
     WriteUniformBuffer( program, &uniforms, sizeof(uniforms) );
 }
@@ -40,6 +43,8 @@ Program starfieldProgram =
     "src/shaders/starfield.wgsl",
     InitStarfield,
     UpdateStarfield,
+    nullptr,
+    true,
 };
 
 
@@ -57,6 +62,8 @@ void UpdateFire( Program* program, void* userdata, f32 viewportWidth, f32 viewpo
     ShadertoyUniforms uniforms;
     uniforms.iResolution = V2( viewportWidth, viewportHeight );
     uniforms.iTime = Platform::AppTimeSeconds();
+    uniforms.iFrame = program->updateFrameIndex;
+    uniforms.iTileOffset = program->tileOffset;
 
     WriteUniformBuffer( program, &uniforms, sizeof(uniforms) );
 }
@@ -65,6 +72,8 @@ Program fireProgram =
     "src/shaders/fire.wgsl",
     InitFire,
     UpdateFire,
+    nullptr,
+    true,
 };
 
 
@@ -82,6 +91,8 @@ void UpdateClouds( Program* program, void* userdata, f32 viewportWidth, f32 view
     ShadertoyUniforms uniforms;
     uniforms.iResolution = V2( viewportWidth, viewportHeight );
     uniforms.iTime = Platform::AppTimeSeconds();
+    uniforms.iFrame = program->updateFrameIndex;
+    uniforms.iTileOffset = program->tileOffset;
 
     WriteUniformBuffer( program, &uniforms, sizeof(uniforms) );
 }
@@ -90,10 +101,13 @@ Program cloudsProgram =
     "src/shaders/clouds.wgsl",
     InitClouds,
     UpdateClouds,
+    nullptr,
+    true,
 };
 
 
-struct AccretionVertex
+// Each particle is drawn as an instance of a small quad
+struct AccretionParticle
 {
     v3 position;
     v3 velocity;
@@ -110,9 +124,13 @@ struct AccretionUniforms
 };
 static_assert( sizeof(AccretionUniforms) % sizeof(m4) == 0 );
 
+constexpr int AccretionMaxParticles = 128 * 1024;
+
 struct AccretionState
 {
     f32 cameraFovYDeg;
+    int vertexSlot;
+    int instanceSlot;
 };
 AccretionState accretionState;
 
@@ -122,33 +140,51 @@ void InitAccretion( Program* program, void* userdata )
     AccretionState* state = (AccretionState*)userdata;
     state->cameraFovYDeg = 100;
 
+    program->topology = WGPUPrimitiveTopology_TriangleStrip;
 
-    program->topology = WGPUPrimitiveTopology_PointList;
+    // Per-vertex buffer with the corners of the quad shared by all particles
+    WGPUVertexAttribute cornerAttrib;
+    cornerAttrib.shaderLocation = 0;
+    cornerAttrib.format = WGPUVertexFormat_Float32x2;
+    cornerAttrib.offset = 0;
+    state->vertexSlot = AddVertexBufferLayout( program, &cornerAttrib, 1, sizeof(v2), WGPUVertexStepMode_Vertex );
 
-    // Describe layout for input vertex buffer
+    // Per-instance buffer with one AccretionParticle per instance
     WGPUVertexAttribute attribs[3];
     // position
-    attribs[0].shaderLocation = 0;
+    attribs[0].shaderLocation = 1;
     attribs[0].format = WGPUVertexFormat_Float32x3;
-    attribs[0].offset = offsetof( AccretionVertex, position );
+    attribs[0].offset = offsetof( AccretionParticle, position );
     // velocity
-    attribs[1].shaderLocation = 1;
+    attribs[1].shaderLocation = 2;
     attribs[1].format = WGPUVertexFormat_Float32x3;
-    attribs[1].offset = offsetof( AccretionVertex, velocity );
+    attribs[1].offset = offsetof( AccretionParticle, velocity );
     // color
-    attribs[2].shaderLocation = 2;
+    attribs[2].shaderLocation = 3;
     attribs[2].format = WGPUVertexFormat_Float32x4;
-    attribs[2].offset = offsetof( AccretionVertex, color );
-
-    program->vertexAttribs.insert( program->vertexAttribs.end(), attribs, attribs + ARRAYCOUNT(attribs) );
+    attribs[2].offset = offsetof( AccretionParticle, color );
+    state->instanceSlot = AddVertexBufferLayout( program, attribs, ARRAYCOUNT(attribs), sizeof(AccretionParticle),
+                                                 WGPUVertexStepMode_Instance );
 
-    program->vertexBufferLayout = {};
-    //program->vertexBufferLayout.nextInChain = nullptr;     // Undefined?
-    program->vertexBufferLayout.attributeCount = ARRAYCOUNT(attribs);
-    program->vertexBufferLayout.attributes = program->vertexAttribs.data();
-    program->vertexBufferLayout.arrayStride = sizeof(AccretionVertex);
-    // One instance of AccretionVertex per vertex
-    program->vertexBufferLayout.stepMode = WGPUVertexStepMode_Vertex;
+    v2 corners[] =
+    {
+        { -1.f, -1.f },
+        {  1.f, -1.f },
+        { -1.f,  1.f },
+        {  1.f,  1.f },
+    };
+    WriteVertexBuffer( program, state->vertexSlot, corners, ARRAYCOUNT(corners) );
+
+    // Particles never change, so they're created and uploaded only once. All the motion comes from the transform
+    std::vector<AccretionParticle> particles( AccretionMaxParticles );
+    RandomStream random( 1 );
+    for( AccretionParticle& p : particles )
+    {
+        p.position = { random.GetFloat( -1, 1 ), random.GetFloat( -1, 1 ), random.GetFloat( -1, 1 ) };
+        p.velocity = V3Zero;
+        p.color = { 1, 0, 0, 1 };
+    }
+    WriteVertexBuffer( program, state->instanceSlot, particles.data(), AccretionMaxParticles );
 
 
     // Create binding layout for a uniform
@@ -159,56 +195,343 @@ void InitAccretion( Program* program, void* userdata )
 
 void UpdateAccretion( Program* program, void* userdata, f32 viewportWidth, f32 viewportHeight )
 {
-    AccretionState* state = (AccretionState*)userdata;
+    f32 currentTime = Platform::AppTimeSeconds();
+    AccretionUniforms uniforms;
+    //uniforms.transform = M4Perspective( viewportWidth / viewportHeight, state->cameraFovYDeg );
+    // Slowly spin the whole cloud
+    uniforms.transform = M4ZRotation( currentTime * 0.2f );
+    uniforms.time = currentTime;
 
-    // Clear whatever was there from last pass
-    if( program->vertexBuffer )
-    {
-        wgpuBufferDestroy( program->vertexBuffer );
-        wgpuBufferRelease( program->vertexBuffer );
-    }
+    WriteUniformBuffer( program, &uniforms, sizeof(uniforms) );
+}
+
+Program accretionProgram =
+{
+    "src/shaders/accretion.wgsl",
+    InitAccretion,
+    UpdateAccretion,
+    &accretionState,
+};
 
 
-    constexpr int MaxPoints = 1024;
+struct MeshUniforms
+{
+    m4 viewProj;
+    m4 model;
+    f32 time;
+    f32 _pad[15];
+};
+static_assert( sizeof(MeshUniforms) % sizeof(m4) == 0 );
 
-    program->elementCount = MaxPoints;
-    size_t bufferSize = program->elementCount * program->vertexBufferLayout.arrayStride;
+struct MeshProgramState
+{
+    char const* meshPath;
+    Mesh mesh;
+    f32 cameraFovYDeg;
+};
+MeshProgramState meshProgramState = { "data/meshes/cube.gltf", {}, 0 };
+
+void InitMeshProgram( Program* program, void* userdata )
+{
+    MeshProgramState* state = (MeshProgramState*)userdata;
+    state->cameraFovYDeg = 60;
+
+    if( !state->mesh.vertexCount )
+        LoadMesh( state->meshPath, &state->mesh );
 
-    // Vertex buffer
-    WGPUBufferDescriptor vertexBufferDesc = {};
-    vertexBufferDesc.nextInChain = nullptr;
-    vertexBufferDesc.label = "Point positions";
-    vertexBufferDesc.usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Vertex;
-    vertexBufferDesc.size = bufferSize;
-    vertexBufferDesc.mappedAtCreation = false;
-    program->vertexBuffer = wgpuDeviceCreateBuffer( globalDevice, &vertexBufferDesc );
+    program->topology = WGPUPrimitiveTopology_TriangleList;
+    // No depth buffer yet, so at least get rid of back faces
+    program->cullMode = WGPUCullMode_Back;
+    SetProgramMesh( program, state->mesh );
 
-    // Create some CPU-side data buffer (3 floats per vertex)
+    InitUniformBuffer( program,
+                       WGPUShaderStage_Vertex | WGPUShaderStage_Fragment,
+                       sizeof(MeshUniforms) );
+}
+
+void PrefetchMeshProgram( Program const* program, void* userdata )
+{
+    MeshProgramState* state = (MeshProgramState*)userdata;
+    if( !state->mesh.vertexCount )
+        PrefetchMesh( state->meshPath );
+}
+
+void UpdateMeshProgram( Program* program, void* userdata, f32 viewportWidth, f32 viewportHeight )
+{
+    MeshProgramState* state = (MeshProgramState*)userdata;
     f32 currentTime = Platform::AppTimeSeconds();
-    RandomStream random( currentTime );
-    AccretionVertex pointData[ MaxPoints * 3 ] = {};
-    for( AccretionVertex& p : pointData )
+
+    // Frame the mesh bounds
+    f32 radius = Length( state->mesh.bounds.halfSize );
+    v3 target = state->mesh.bounds.center;
+    v3 eye = target + V3( 0.f, -3.f * radius, 1.5f * radius );
+
+    m4 view = M4CameraLookAt( eye, target, V3Up );
+    m4 proj = M4Perspective( viewportWidth / viewportHeight, state->cameraFovYDeg );
+    m4 model = M4ZRotation( currentTime * 0.5f );
+
+    // NOTE WGSL matrices are column-major
+    MeshUniforms uniforms = {};
+    uniforms.viewProj = Transposed( proj * view );
+    uniforms.model = Transposed( model );
+    uniforms.time = currentTime;
+
+    WriteUniformBuffer( program, &uniforms, sizeof(uniforms) );
+}
+
+Program meshProgram =
+{
+    "src/shaders/mesh.wgsl",
+    InitMeshProgram,
+    UpdateMeshProgram,
+    &meshProgramState,
+    false,
+    nullptr,
+    PrefetchMeshProgram,
+};
+
+
+struct TexturedProgramState
+{
+    char const* texturePath;
+    Texture texture;
+};
+TexturedProgramState texturedProgramState = { "data/textures/checker.tga", {} };
+
+void InitTexturedProgram( Program* program, void* userdata )
+{
+    TexturedProgramState* state = (TexturedProgramState*)userdata;
+
+    // Mips keep streaming in over the next few frames
+    if( !state->texture.texture )
+        LoadTexture( state->texturePath, true, &state->texture );
+
+    program->topology = WGPUPrimitiveTopology_TriangleStrip;
+    SetProgramTexture( program, 0, state->texture );
+
+    InitUniformBuffer( program,
+                       WGPUShaderStage_Fragment,
+                       sizeof(ShadertoyUniforms) );
+}
+void UpdateTexturedProgram( Program* program, void* userdata, f32 viewportWidth, f32 viewportHeight )
+{
+    ShadertoyUniforms uniforms;
+    uniforms.iResolution = V2( viewportWidth, viewportHeight );
+    uniforms.iTime = Platform::AppTimeSeconds();
+    uniforms.iFrame = program->updateFrameIndex;
+    uniforms.iTileOffset = program->tileOffset;
+
+    WriteUniformBuffer( program, &uniforms, sizeof(uniforms) );
+}
+Program texturedProgram =
+{
+    "src/shaders/textured.wgsl",
+    InitTexturedProgram,
+    UpdateTexturedProgram,
+    &texturedProgramState,
+    true,
+};
+
+
+// Buffer A keeps feeding back into itself, so the trails are never recomputed, just advected and faded
+void InitFeedback( Program* program, void* userdata )
+{
+    program->topology = WGPUPrimitiveTopology_TriangleStrip;
+
+    int bufferA = AddProgramBuffer( program, "src/shaders/feedback_a.wgsl" );
+    SetChannelBuffer( program, bufferA, 0, bufferA, true );
+    SetChannelBuffer( program, MainPass, 0, bufferA );
+
+    InitUniformBuffer( program,
+                       WGPUShaderStage_Fragment,
+                       sizeof(ShadertoyUniforms) );
+}
+void UpdateFeedback( Program* program, void* userdata, f32 viewportWidth, f32 viewportHeight )
+{
+    ShadertoyUniforms uniforms;
+    uniforms.iResolution = V2( viewportWidth, viewportHeight );
+    uniforms.iTime = Platform::AppTimeSeconds();
+    uniforms.iFrame = program->updateFrameIndex;
+    uniforms.iTileOffset = program->tileOffset;
+
+    WriteUniformBuffer( program, &uniforms, sizeof(uniforms) );
+}
+Program feedbackProgram =
+{
+    "src/shaders/feedback.wgsl",
+    InitFeedback,
+    UpdateFeedback,
+};
+
+
+// A big field of cubes, culled on the GPU against a camera flying around it
+constexpr int CulledGridSize = 256;
+constexpr f32 CulledGridSpacing = 4.f;
+
+struct CulledUniforms
+{
+    m4 viewProj;
+    f32 time;
+    f32 _pad[15];
+};
+static_assert( sizeof(CulledUniforms) % sizeof(m4) == 0 );
+
+struct CulledProgramState
+{
+    char const* meshPath;
+    Mesh mesh;
+    f32 cameraFovYDeg;
+};
+CulledProgramState culledProgramState = { "data/meshes/cube.gltf", {}, 0 };
+
+void InitCulledInstances( Program* program, void* userdata )
+{
+    CulledProgramState* state = (CulledProgramState*)userdata;
+    state->cameraFovYDeg = 60;
+
+    if( !state->mesh.vertexCount )
+        LoadMesh( state->meshPath, &state->mesh );
+
+    program->topology = WGPUPrimitiveTopology_TriangleList;
+    program->cullMode = WGPUCullMode_Back;
+    SetProgramMesh( program, state->mesh );
+    EnableInstanceCulling( program );
+
+    std::vector<aabb> bounds( CulledGridSize * CulledGridSize );
+    RandomStream random( 1234 );
+    f32 offset = (CulledGridSize - 1) * CulledGridSpacing * 0.5f;
+    for( int y = 0; y < CulledGridSize; ++y )
     {
-        p.position = { random.GetFloat( -1, 1 ), random.GetFloat( -1, 1 ), random.GetFloat( -1, 1 ) };
-        p.color = { 1, 0, 0, 1 };
+        for( int x = 0; x < CulledGridSize; ++x )
+        {
+            f32 height = random.GetFloat( 0.2f, 1.5f );
+            aabb& b = bounds[y * CulledGridSize + x];
+            b.center = V3( x * CulledGridSpacing - offset, y * CulledGridSpacing - offset, height );
+            b.halfSize = V3( 0.5f, 0.5f, height );
+        }
     }
+    SetInstanceBounds( &program->culling, bounds.data(), (u32)bounds.size() );
 
-    // Copy this from pointData (RAM) to VRAM
-    wgpuQueueWriteBuffer( globalQueue, program->vertexBuffer, 0, pointData, bufferSize );
+    InitUniformBuffer( program,
+                       WGPUShaderStage_Vertex,
+                       sizeof(CulledUniforms) );
+}
 
+void PrefetchCulledInstances( Program const* program, void* userdata )
+{
+    CulledProgramState* state = (CulledProgramState*)userdata;
+    if( !state->mesh.vertexCount )
+        PrefetchMesh( state->meshPath );
+}
 
-    AccretionUniforms uniforms;
-    //uniforms.transform = M4Perspective( viewportWidth / viewportHeight, state->cameraFovYDeg );
-    uniforms.transform = M4Identity;
+void UpdateCulledInstances( Program* program, void* userdata, f32 viewportWidth, f32 viewportHeight )
+{
+    CulledProgramState* state = (CulledProgramState*)userdata;
+    f32 currentTime = Platform::AppTimeSeconds();
+
+    // Circle low over the field, looking across it so most of it falls outside the frustum
+    f32 angle = currentTime * 0.1f;
+    f32 radius = CulledGridSize * CulledGridSpacing * 0.25f;
+    v3 eye = V3( cosf( angle ) * radius, sinf( angle ) * radius, 12.f );
+    v3 target = V3( cosf( angle + 0.5f ) * radius * 0.5f, sinf( angle + 0.5f ) * radius * 0.5f, 0.f );
+
+    m4 view = M4CameraLookAt( eye, target, V3Up );
+    m4 proj = M4Perspective( viewportWidth / viewportHeight, state->cameraFovYDeg );
+    m4 viewProj = proj * view;
+    SetCullingCamera( &program->culling, viewProj );
+
+    // NOTE WGSL matrices are column-major
+    CulledUniforms uniforms = {};
+    uniforms.viewProj = Transposed( viewProj );
     uniforms.time = currentTime;
 
     WriteUniformBuffer( program, &uniforms, sizeof(uniforms) );
 }
 
-Program accretionProgram =
+Program culledProgram =
 {
-    "src/shaders/accretion.wgsl",
-    InitAccretion,
-    UpdateAccretion,
-    &accretionState,
+    "src/shaders/culled_instances.wgsl",
+    InitCulledInstances,
+    UpdateCulledInstances,
+    &culledProgramState,
+    false,
+    nullptr,
+    PrefetchCulledInstances,
+};
+
+
+// Rolling hills of gridSize x gridSize vertices over the unit square, as a triangle soup
+void MakeWavesHeightfield( int gridSize, std::vector<tri>* out )
+{
+    auto GridPoint = [gridSize]( int x, int y )
+    {
+        f32 u = (f32)x / (gridSize - 1);
+        f32 v = (f32)y / (gridSize - 1);
+        return V3( u - 0.5f, v - 0.5f, 0.05f * sinf( u * 20.f ) * cosf( v * 20.f ) );
+    };
+
+    out->clear();
+    out->reserve( (sz)(gridSize - 1) * (gridSize - 1) * 2 );
+    for( int y = 0; y < gridSize - 1; ++y )
+    {
+        for( int x = 0; x < gridSize - 1; ++x )
+        {
+            out->push_back( Tri( GridPoint( x, y ), GridPoint( x + 1, y ), GridPoint( x + 1, y + 1 ) ) );
+            out->push_back( Tri( GridPoint( x, y ), GridPoint( x + 1, y + 1 ), GridPoint( x, y + 1 ) ) );
+        }
+    }
+}
+
+// A heightfield ray traced in a compute shader, with no rasterization other than showing the result
+struct RayTracedProgramState
+{
+    int gridSize;
+    GPUBVHFormat format;
+    BVH bvh;
+};
+RayTracedProgramState rayTracedProgramState = { 512, GPUBVHFormat::Quantized, {} };
+
+void InitRayTraced( Program* program, void* userdata )
+{
+    RayTracedProgramState* state = (RayTracedProgramState*)userdata;
+
+    if( state->bvh.nodes.empty() )
+    {
+        std::vector<tri> tris;
+        MakeWavesHeightfield( state->gridSize, &tris );
+        BuildBVH( tris.data(), (u32)tris.size(), &state->bvh );
+    }
+
+    program->topology = WGPUPrimitiveTopology_TriangleStrip;
+    EnableRayTracing( program );
+    SetRayTracedScene( &program->rayTracing, state->bvh, state->format, program->shaderPath );
+
+    InitUniformBuffer( program,
+                       WGPUShaderStage_Fragment,
+                       sizeof(ShadertoyUniforms) );
+}
+
+void UpdateRayTraced( Program* program, void* userdata, f32 viewportWidth, f32 viewportHeight )
+{
+    f32 currentTime = Platform::AppTimeSeconds();
+
+    f32 angle = currentTime * 0.2f;
+    v3 eye = V3( cosf( angle ) * 0.9f, sinf( angle ) * 0.9f, 0.4f );
+    SetRayTracingCamera( &program->rayTracing, eye, V3Zero, 60.f, viewportWidth / viewportHeight );
+
+    ShadertoyUniforms uniforms;
+    uniforms.iResolution = V2( viewportWidth, viewportHeight );
+    uniforms.iTime = currentTime;
+    uniforms.iFrame = program->updateFrameIndex;
+    uniforms.iTileOffset = program->tileOffset;
+
+    WriteUniformBuffer( program, &uniforms, sizeof(uniforms) );
+}
+
+Program rayTracedProgram =
+{
+    "src/shaders/raytraced.wgsl",
+    InitRayTraced,
+    UpdateRayTraced,
+    &rayTracedProgramState,
 };
@@ -1,26 +1,181 @@
 #pragma once
 
 struct Program;
+constexpr int MaxVertexBuffers = 4;
+constexpr int MaxVertexAttribsPerBuffer = 8;
+constexpr int MaxChannels = 4;
+constexpr int MaxProgramBuffers = 4;
+// Pass index meaning the program's main pass (the one drawing to the screen)
+constexpr int MainPass = -1;
+
 using InitProgramFunc = void( Program*, void* );
 using UpdateInputFunc = void( Program*, void*, f32, f32 );
+using PrefetchProgramFunc = void( Program const*, void* );
+
+// Resources a program's own frame tasks can be ordered against (see AddMainFrameTasks)
+struct ProgramTaskResources
+{
+    TaskResources events;       // Input polled for the frame
+    // State the program's update reads and writes on the CPU. Tasks reading it run after the previous frame's update
+    // and before this frame's one
+    TaskResources simulation;
+};
+using AddProgramTasksFunc = void( Program*, TaskGraph*, ProgramTaskResources const& );
+
+enum class ChannelType
+{
+    None,
+    Texture,        // Any texture view, e.g. from a loaded Texture
+    Buffer,         // The output of one of the program's offscreen buffers
+};
+
+struct ChannelInput
+{
+    ChannelType type;
+    WGPUTextureView textureView;
+    int buffer;
+    // Read what the buffer contained at the end of the last frame.
+    // This is implied when reading from a buffer that doesn't render before the current pass (including itself)
+    bool previousFrame;
+};
+
+// Pre-recorded draw commands for a pass, replayed with executeBundles.
+// Channels reading ping-pong buffers alternate between two sets of bindings, so there's one bundle per frame parity
+struct PassBundle
+{
+    WGPURenderBundle bundle;
+    WGPUBindGroup bindGroup;
+    u64 key;                    // Hash of everything the commands reference. Re-recorded whenever it changes
+};
+
+// One render pass of a frame, encoded into its own command buffer so passes can be encoded in parallel
+struct PassEncodeJob
+{
+    int pass;                   // A buffer index or MainPass
+    WGPUTextureView target;
+    WGPUTextureFormat format;
+    WGPUColor clearValue;
+    char const* label;
+
+    // Prepared on the calling thread when the program uses bundles, since that touches shared state
+    WGPURenderBundle bundle;
+    // Output
+    WGPUCommandBuffer commands;
+};
+
+// Offscreen pass drawing a fullscreen quad into its own texture, like Shadertoy's Buffer A..D.
+// Buffers render in declaration order before the main pass, and are double buffered so they can read
+// their own previous frame, which keeps any state they simulate on the GPU from one frame to the next
+struct ProgramBuffer
+{
+    char const* shaderPath;
+    WGPUTextureFormat format;
+    ChannelInput channels[MaxChannels];
+    int channelCount;
+
+    // Runtime state
+    BindGroupLayoutHandle bindGroupLayout;
+    RenderPipelineHandle pipeline;
+    // Ping-pong targets, indexed by frame parity
+    TextureHandle targets[2];
+    TextureViewHandle targetViews[2];
+    u32 width;
+    u32 height;
+    PassBundle bundles[2];
+};
+
+// What a program's update produced for one frame, kept on the CPU until the frame is encoded, which is when it gets
+// uploaded. There's one per frame in flight, so the update for the next frame can already run while the current one
+// is still being encoded, without either touching what the other one is using
+struct ProgramFrameData
+{
+    bool ready;                 // Filled in by an update, and not encoded yet
+    u32 frameIndex;             // Picks the ping-pong targets when encoded
+    // Size of what's rendered, which offscreen targets get resized to
+    u32 targetWidth;
+    u32 targetHeight;
+
+    std::vector<u8> uniforms;   // Empty if not written
+    std::vector<u8> vertexData[MaxVertexBuffers];
+    int vertexCounts[MaxVertexBuffers];         // -1 for slots not written
+    // Cameras for the culling and ray tracing passes, as they were when the update finished
+    v4 cullingPlanes[6];
+    RayTraceParams rayTraceParams;
+};
 
 struct Program
 {
     // Program description (define these)
     char const* const shaderPath = nullptr;         // NOTE Use forward slashes!
     InitProgramFunc* const initFunc = nullptr;
+    // Runs on a worker, so it only writes uniforms / vertex data and never touches resource handles (see resources.h)
     UpdateInputFunc* const updateFunc = nullptr;
     void* userdata = nullptr;
+    // Every pass takes its pixel coordinates through pixelCoord() (see shadertoy.wgsl), which is what makes the program
+    // render right in tiles (see tiled.h)
+    bool const supportsTiles = false;
+    // Optional. Registers frame tasks of the program's own, once for the whole run. They're there whether the program
+    // is current or not, so they should do nothing when it isn't. Only FrameTask_MainThread tasks may use resource handles
+    AddProgramTasksFunc* const tasksFunc = nullptr;
+    // Optional. Starts reading whatever the init function is going to load (see PrefetchProgram)
+    PrefetchProgramFunc* const prefetchFunc = nullptr;
 
     // Runtime state
     WGPUPrimitiveTopology topology = (WGPUPrimitiveTopology)-1;
-    std::vector<WGPUVertexAttribute> vertexAttribs;
-
-    WGPUBindGroupLayout bindGroupLayout = {};
-    WGPUBindGroup bindGroup = {};
-    WGPUBuffer uniformBuffer = {};
-    WGPUVertexBufferLayout vertexBufferLayout = {};
-    WGPUBuffer vertexBuffer = {};
-    int elementCount = 0;       // How many elements in the vertex buffer
+    WGPUCullMode cullMode = WGPUCullMode_None;
+    // One layout per vertex buffer slot, each stepping either per vertex or per instance
+    WGPUVertexBufferLayout vertexBufferLayouts[MaxVertexBuffers] = {};
+    WGPUVertexAttribute vertexAttribs[MaxVertexBuffers][MaxVertexAttribsPerBuffer] = {};
+    int vertexBufferCount = 0;
+
+    RenderPipelineHandle pipeline = {};
+    // Bind groups are created every frame, since channels reading from buffers alternate between ping-pong targets
+    BindGroupLayoutHandle bindGroupLayout = {};
+    BufferHandle uniformBuffer = {};
+    size_t uniformSize = 0;
+    WGPUShaderStageFlags uniformVisibility = WGPUShaderStage_None;
+    // Optional inputs, sampled as iChannel0..N in the shader. They're bound right after the
+    // uniform buffer, with a shared sampler at binding 1 and each channel at binding 2 + index
+    ChannelInput channels[MaxChannels] = {};
+    int channelCount = 0;
+    SamplerHandle sampler = {};
+
+    // Optional offscreen passes, rendered before the main one. Their uniforms are shared with the main pass
+    ProgramBuffer buffers[MaxProgramBuffers] = {};
+    int bufferCount = 0;
+    // Frame being encoded, which flips the ping-pong targets
+    u32 frameIndex = 0;
+    // Frame the next update is for. Updates run ahead of encoding, so this is what shaders should get (e.g. as iFrame)
+    u32 updateFrameIndex = 0;
+    ProgramFrameData frameData[2] = {};
+    // Where WriteUniformBuffer and WriteVertexBuffer go during an update. Outside of one (e.g. from the init function)
+    // they write straight to the GPU
+    ProgramFrameData* updating = nullptr;
+    // Pixel offset of the region being rendered when the output is split into tiles (see tiled.h), zero otherwise.
+    // Viewport sizes passed to updateFunc are always those of the full image
+    v2 tileOffset = {};
+
+    // Replay each pass from a cached render bundle instead of encoding its draws every frame
+    bool useRenderBundles = true;
+    PassBundle bundles[2] = {};
+    int bundlesRecorded = 0;
+
+    WGPUBuffer vertexBuffers[MaxVertexBuffers] = {};
+    size_t vertexBufferSizes[MaxVertexBuffers] = {};
+    // Vertex buffers created by WriteVertexBuffer belong to the program. Others (e.g. from a Mesh) are just borrowed
+    BufferHandle ownedVertexBuffers[MaxVertexBuffers] = {};
+    int elementCount = 0;       // How many vertices to draw per instance
+    int instanceCount = 1;      // How many instances to draw
+
+    // Optional index buffer. When present, we draw indexCount indices per instance
+    WGPUBuffer indexBuffer = {};
+    size_t indexBufferSize = 0;
+    WGPUIndexFormat indexFormat = WGPUIndexFormat_Undefined;
+    int indexCount = 0;
+
+    // Optional GPU culling of instances. When enabled, the main pass draws indirectly with only the visible ones
+    InstanceCulling culling = {};
+    // Optional compute ray tracing pass, running before all others. Its output is bound as the main pass' iChannel0
+    RayTracing rayTracing = {};
 };
 
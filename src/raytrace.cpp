@@ -0,0 +1,314 @@
+
+// Dropped when its shader changes, and rebuilt the next time that format is traced
+void InvalidateRayTracer( void* owner, int format )
+{
+    RayTracer* tracer = (RayTracer*)owner;
+    DeferRelease( tracer->pipelines[format] );
+    tracer->pipelines[format] = nullptr;
+}
+
+// Each BVH format gets its own pipeline (entry point), built on first use
+void InitRayTracer( RayTracer* tracer, GPUBVHFormat format )
+{
+    std::string source;
+    if( !LoadShaderSource( RayTraceShaderPath, &source, { tracer, (int)format, InvalidateRayTracer } ) )
+        return;
+    WGPUShaderModule shaderModule = CreateShaderModule( source.c_str(), RayTraceShaderPath );
+
+    WGPUBindGroupLayoutEntry bindingLayouts[4];
+    for( int i = 0; i < 4; ++i )
+    {
+        bindingLayouts[i] = DefaultBinding();
+        bindingLayouts[i].binding = i;
+        bindingLayouts[i].visibility = WGPUShaderStage_Compute;
+    }
+    bindingLayouts[0].buffer.type = WGPUBufferBindingType_Uniform;
+    bindingLayouts[0].buffer.minBindingSize = sizeof(RayTraceParams);
+    bindingLayouts[1].buffer.type = WGPUBufferBindingType_ReadOnlyStorage;
+    bindingLayouts[2].buffer.type = WGPUBufferBindingType_ReadOnlyStorage;
+    bindingLayouts[3].storageTexture.access = WGPUStorageTextureAccess_WriteOnly;
+    bindingLayouts[3].storageTexture.format = RayTraceOutputFormat;
+    bindingLayouts[3].storageTexture.viewDimension = WGPUTextureViewDimension_2D;
+
+    WGPUBindGroupLayoutDescriptor bindGroupLayoutDesc = {};
+    bindGroupLayoutDesc.nextInChain = nullptr;
+    bindGroupLayoutDesc.entryCount = ARRAYCOUNT(bindingLayouts);
+    bindGroupLayoutDesc.entries = bindingLayouts;
+    // Shared by all formats, and survives shader reloads
+    if( !tracer->bindGroupLayout )
+        tracer->bindGroupLayout = wgpuDeviceCreateBindGroupLayout( globalDevice, &bindGroupLayoutDesc );
+
+    WGPUPipelineLayoutDescriptor layoutDesc = {};
+    layoutDesc.nextInChain                  = nullptr;
+    layoutDesc.bindGroupLayoutCount         = 1;
+    layoutDesc.bindGroupLayouts             = &tracer->bindGroupLayout;
+    WGPUPipelineLayout pipelineLayout       = wgpuDeviceCreatePipelineLayout( globalDevice, &layoutDesc );
+
+    WGPUComputePipelineDescriptor pipelineDesc = {};
+    pipelineDesc.nextInChain                   = nullptr;
+    pipelineDesc.label                         = "Ray tracing";
+    pipelineDesc.layout                        = pipelineLayout;
+    pipelineDesc.compute.module                = shaderModule;
+    pipelineDesc.compute.entryPoint            = RayTraceEntryPoints[(int)format];
+    pipelineDesc.compute.constantCount         = 0;
+    pipelineDesc.compute.constants             = nullptr;
+    tracer->pipelines[(int)format] = wgpuDeviceCreateComputePipeline( globalDevice, &pipelineDesc );
+
+    wgpuPipelineLayoutRelease( pipelineLayout );
+    wgpuShaderModuleRelease( shaderModule );
+}
+
+// Node array in the given GPU format. Full nodes are uploaded straight from the BVH
+void PackGPUBVHNodes( BVH const& bvh, v3 const& sceneMin, v3 const& sceneMax, std::vector<GPUBVHNodeQuantized>* out )
+{
+    v3 extent = sceneMax - sceneMin;
+    v3 scale = { extent.x > 0.f ? 65535.f / extent.x : 0.f,
+                 extent.y > 0.f ? 65535.f / extent.y : 0.f,
+                 extent.z > 0.f ? 65535.f / extent.z : 0.f };
+
+    out->resize( bvh.nodes.size() );
+    for( sz i = 0; i < (sz)bvh.nodes.size(); ++i )
+    {
+        BVHNode const& node = bvh.nodes[i];
+        GPUBVHNodeQuantized& q = (*out)[i];
+        for( int a = 0; a < 3; ++a )
+        {
+            // One extra step each way covers any rounding when dequantizing on the GPU
+            f32 min = floorf( (node.min.e[a] - sceneMin.e[a]) * scale.e[a] ) - 1.f;
+            f32 max = ceilf( (node.max.e[a] - sceneMin.e[a]) * scale.e[a] ) + 1.f;
+            Clamp( &min, 0.f, 65535.f );
+            Clamp( &max, 0.f, 65535.f );
+            q.min[a] = (u16)min;
+            q.max[a] = (u16)max;
+        }
+        ASSERT( node.rightOrFirst < (1u << 29), "Too many nodes for the quantized format" );
+        q.indexAndCount = node.rightOrFirst | ((u32)node.count << 29);
+    }
+}
+
+// Upload a BVH to trace against. Buffers are recreated only when they need to grow
+void SetRayTracedScene( RayTracing* tracing, BVH const& bvh, GPUBVHFormat format, char const* owner = nullptr )
+{
+    if( bvh.nodes.empty() )
+        return;
+
+    // Traversal pushes at most one node for each interior node on the current path. Past that, the shader would have
+    // to drop nodes, and silently miss whatever they contain
+    u32 depth = GetBVHDepth( bvh );
+    if( depth - 1 > RayTraceStackSize )
+    {
+        Log( "ERROR :: BVH is %u levels deep, but ray tracing only supports up to %u", depth, RayTraceStackSize + 1 );
+        tracing->nodeCount = tracing->triCount = 0;
+        return;
+    }
+
+    BVHNode const& root = bvh.nodes[0];
+    tracing->format = format;
+    tracing->sceneMin = root.min;
+    tracing->sceneMax = root.max;
+
+    std::vector<GPUBVHNodeQuantized> quantizedNodes;
+    void const* nodeData = bvh.nodes.data();
+    u64 nodesSize = bvh.nodes.size() * sizeof(BVHNode);
+    if( format == GPUBVHFormat::Quantized )
+    {
+        PackGPUBVHNodes( bvh, root.min, root.max, &quantizedNodes );
+        nodeData = quantizedNodes.data();
+        nodesSize = quantizedNodes.size() * sizeof(GPUBVHNodeQuantized);
+    }
+
+    std::vector<GPUBVHTri> tris( bvh.tris.size() );
+    for( sz i = 0; i < (sz)tris.size(); ++i )
+    {
+        tri const& t = bvh.tris[i];
+        tris[i] = { t.v0, t.v1 - t.v0, t.v2 - t.v0 };
+    }
+    u64 trisSize = tris.size() * sizeof(GPUBVHTri);
+
+    WGPUBufferDescriptor bufferDesc = {};
+    bufferDesc.nextInChain          = nullptr;
+    bufferDesc.mappedAtCreation     = false;
+    bufferDesc.usage                = WGPUBufferUsage_Storage | WGPUBufferUsage_CopyDst;
+
+    WGPUBuffer nodesBuffer = GetResource( tracing->nodesBuffer );
+    if( !nodesBuffer || wgpuBufferGetSize( nodesBuffer ) < nodesSize )
+    {
+        DestroyResource( &tracing->nodesBuffer );
+        bufferDesc.label = "BVH nodes";
+        bufferDesc.size = nodesSize;
+        tracing->nodesBuffer = RegisterResource( CreateGPUBuffer( &bufferDesc, owner ), bufferDesc.label );
+    }
+    WGPUBuffer trisBuffer = GetResource( tracing->trisBuffer );
+    if( !trisBuffer || wgpuBufferGetSize( trisBuffer ) < trisSize )
+    {
+        DestroyResource( &tracing->trisBuffer );
+        bufferDesc.label = "BVH triangles";
+        bufferDesc.size = trisSize;
+        tracing->trisBuffer = RegisterResource( CreateGPUBuffer( &bufferDesc, owner ), bufferDesc.label );
+    }
+    if( !tracing->paramsBuffer )
+    {
+        bufferDesc.label = "Ray tracing params";
+        bufferDesc.usage = WGPUBufferUsage_Uniform | WGPUBufferUsage_CopyDst;
+        bufferDesc.size = sizeof(RayTraceParams);
+        tracing->paramsBuffer = RegisterResource( CreateGPUBuffer( &bufferDesc, owner ), bufferDesc.label );
+    }
+
+    nodesBuffer = GetResource( tracing->nodesBuffer );
+    trisBuffer = GetResource( tracing->trisBuffer );
+    if( !nodesBuffer || !trisBuffer || !tracing->paramsBuffer )
+    {
+        tracing->nodeCount = tracing->triCount = 0;
+        return;
+    }
+
+    if( !StagingWriteSliced( &globalStagingBelt, nodesBuffer, 0, nodeData, nodesSize ) ||
+        !StagingWriteSliced( &globalStagingBelt, trisBuffer, 0, tris.data(), trisSize ) )
+    {
+        tracing->nodeCount = tracing->triCount = 0;
+        return;
+    }
+    tracing->nodeCount = (u32)bvh.nodes.size();
+    tracing->triCount = (u32)tris.size();
+}
+
+// (Re)create the output texture whenever the size changes
+bool ResizeRayTracingOutput( RayTracing* tracing, u32 width, u32 height, char const* owner = nullptr )
+{
+    if( tracing->output && tracing->width == width && tracing->height == height )
+        return true;
+
+    DestroyResource( &tracing->outputView );
+    DestroyResource( &tracing->output );
+    tracing->width = tracing->height = 0;
+
+    WGPUTextureDescriptor textureDesc = {};
+    textureDesc.nextInChain           = nullptr;
+    textureDesc.label                 = "Ray tracing output";
+    textureDesc.usage                 = WGPUTextureUsage_StorageBinding | WGPUTextureUsage_TextureBinding;
+    textureDesc.dimension             = WGPUTextureDimension_2D;
+    textureDesc.size                  = { width, height, 1 };
+    textureDesc.format                = RayTraceOutputFormat;
+    textureDesc.mipLevelCount         = 1;
+    textureDesc.sampleCount           = 1;
+    textureDesc.viewFormatCount       = 0;
+    textureDesc.viewFormats           = nullptr;
+    WGPUTexture output = CreateGPUTexture( &textureDesc, owner );
+    if( !output )
+        return false;
+
+    tracing->output = RegisterResource( output, textureDesc.label );
+    tracing->outputView = RegisterResource( wgpuTextureCreateView( output, nullptr ), textureDesc.label );
+    tracing->width = width;
+    tracing->height = height;
+    return true;
+}
+
+void SetRayTracingCamera( RayTracing* tracing, v3 const& eye, v3 const& target, f32 fovYDeg, f32 aspect )
+{
+    v3 forward = Normalized( target - eye );
+    v3 right = Normalized( Cross( forward, V3Up ) );
+    v3 up = Cross( right, forward );
+    f32 tanHalfFov = tanf( Radians( fovYDeg ) * 0.5f );
+
+    RayTraceParams& params = tracing->params;
+    params.eye = V4( eye, 1.f );
+    params.forward = V4( forward, 0.f );
+    params.right = V4( right * (tanHalfFov * aspect), 0.f );
+    params.up = V4( up * tanHalfFov, 0.f );
+}
+
+// Upload this frame's camera (as set by SetRayTracingCamera). Must happen before the staging belt is flushed
+void WriteRayTracingParams( RayTracing const* tracing, RayTraceParams params )
+{
+    WGPUBuffer paramsBuffer = GetResource( tracing->paramsBuffer );
+    if( !paramsBuffer )
+        return;
+
+    v3 extent = tracing->sceneMax - tracing->sceneMin;
+    params.sceneMin = V4( tracing->sceneMin, 0.f );
+    params.sceneScale = V4( extent / 65535.f, 0.f );
+    params.width = tracing->width;
+    params.height = tracing->height;
+    if( void* staging = StagingWrite( &globalStagingBelt, paramsBuffer, 0, sizeof(params) ) )
+        COPYP( &params, staging, sizeof(params) );
+}
+
+// Record the ray tracing pass. Anything sampling the output must be encoded after this
+bool EncodeRayTracing( WGPUCommandEncoder encoder, RayTracing const* tracing, RayTracer* tracer /*= &globalRayTracer*/ )
+{
+    if( !tracer->pipelines[(int)tracing->format] )
+        InitRayTracer( tracer, tracing->format );
+    WGPUComputePipeline pipeline = tracer->pipelines[(int)tracing->format];
+    WGPUTextureView outputView = GetResource( tracing->outputView );
+    if( !pipeline || !outputView || !tracing->nodeCount )
+        return false;
+
+    WGPUBindGroupEntry bindings[4] = {};
+    bindings[0].binding = 0;
+    bindings[0].buffer = GetResource( tracing->paramsBuffer );
+    bindings[0].size = sizeof(RayTraceParams);
+    bindings[1].binding = 1;
+    bindings[1].buffer = GetResource( tracing->nodesBuffer );
+    bindings[1].size = wgpuBufferGetSize( bindings[1].buffer );
+    bindings[2].binding = 2;
+    bindings[2].buffer = GetResource( tracing->trisBuffer );
+    bindings[2].size = wgpuBufferGetSize( bindings[2].buffer );
+    bindings[3].binding = 3;
+    bindings[3].textureView = outputView;
+
+    WGPUBindGroupDescriptor bindGroupDesc = {};
+    bindGroupDesc.nextInChain = nullptr;
+    bindGroupDesc.layout = tracer->bindGroupLayout;
+    bindGroupDesc.entryCount = ARRAYCOUNT(bindings);
+    bindGroupDesc.entries = bindings;
+    WGPUBindGroup bindGroup = wgpuDeviceCreateBindGroup( globalDevice, &bindGroupDesc );
+
+    WGPUComputePassDescriptor passDesc = {};
+    passDesc.nextInChain = nullptr;
+    passDesc.label = "Ray tracing";
+    passDesc.timestampWriteCount = 0;
+    passDesc.timestampWrites = nullptr;
+    WGPUComputePassEncoder pass = wgpuCommandEncoderBeginComputePass( encoder, &passDesc );
+    wgpuComputePassEncoderSetPipeline( pass, pipeline );
+    wgpuComputePassEncoderSetBindGroup( pass, 0, bindGroup, 0, nullptr );
+    wgpuComputePassEncoderDispatchWorkgroups( pass, (tracing->width + RayTraceTileSize - 1) / RayTraceTileSize,
+                                              (tracing->height + RayTraceTileSize - 1) / RayTraceTileSize, 1 );
+    wgpuComputePassEncoderEnd( pass );
+#ifdef WEBGPU_BACKEND_DAWN
+    wgpuComputePassEncoderRelease( pass );
+#endif
+
+    // Encoded commands keep their own references
+    wgpuBindGroupRelease( bindGroup );
+    return true;
+}
+
+void ReleaseRayTracing( RayTracing* tracing )
+{
+    DestroyResource( &tracing->nodesBuffer );
+    DestroyResource( &tracing->trisBuffer );
+    DestroyResource( &tracing->paramsBuffer );
+    DestroyResource( &tracing->outputView );
+    DestroyResource( &tracing->output );
+    *tracing = {};
+}
+
+// Turn on ray tracing for a program. Call from its init function, then set a scene and camera as usual.
+// The traced image replaces whatever the main pass had in iChannel0
+void EnableRayTracing( Program* program )
+{
+    program->rayTracing.enabled = true;
+    ResizeRayTracingOutput( &program->rayTracing, 1, 1, program->shaderPath );
+    *GetPassChannel( program, MainPass, 0 ) = { ChannelType::Texture, GetResource( program->rayTracing.outputView ), 0, false };
+}
+
+// Keep the output at the viewport size
+void ResizeProgramRayTracing( Program* program, u32 width, u32 height )
+{
+    if( !program->rayTracing.enabled )
+        return;
+
+    ResizeRayTracingOutput( &program->rayTracing, width, height, program->shaderPath );
+    program->channels[0].textureView = GetResource( program->rayTracing.outputView );
+}
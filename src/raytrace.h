@@ -0,0 +1,97 @@
+#pragma once
+
+// Ray tracing of triangle meshes in a compute shader, over a BVH built on the CPU (see bvh.h).
+// Nodes are uploaded either as is, or with their bounds quantized to 16 bits relative to the whole scene, which halves
+// their size. The compute pass writes a storage texture, which the program's main pass gets as iChannel0:
+//
+//   @group(0) @binding(2) var iChannel0: texture_2d<f32>;
+//
+// so meshes can be shown without any rasterization pipeline at all.
+
+constexpr char const* RayTraceShaderPath = "src/shaders/raytrace.wgsl";
+constexpr u32 RayTraceTileSize = 8;
+// Entries in the traversal stack of each invocation (StackSize in the shader). Deeper BVHs can't be traced
+constexpr u32 RayTraceStackSize = 64;
+static_assert( BVHMaxDepth - 1 <= RayTraceStackSize );
+constexpr WGPUTextureFormat RayTraceOutputFormat = WGPUTextureFormat_RGBA8Unorm;
+
+enum class GPUBVHFormat : u32
+{
+    Full,                       // BVHNode as is (32 bytes)
+    Quantized,                  // GPUBVHNodeQuantized (16 bytes)
+
+    Count
+};
+
+constexpr char const* GPUBVHFormatNames[] =
+{
+    "full",
+    "quantized",
+};
+static_assert( ARRAYCOUNT(GPUBVHFormatNames) == (int)GPUBVHFormat::Count );
+
+constexpr char const* RayTraceEntryPoints[] =
+{
+    "cs_full",
+    "cs_quantized",
+};
+static_assert( ARRAYCOUNT(RayTraceEntryPoints) == (int)GPUBVHFormat::Count );
+
+// Bounds are rounded outwards, so the boxes can only grow
+struct GPUBVHNodeQuantized
+{
+    u16 min[3];
+    u16 max[3];
+    u32 indexAndCount;          // Right child or first triangle in the low 29 bits, leaf triangle count in the top 3
+};
+static_assert( sizeof(GPUBVHNodeQuantized) == 16 );
+static_assert( BVHMaxLeafSize < 8 );
+
+// A vertex plus both edges, which is all the intersection test needs
+struct GPUBVHTri
+{
+    v3 v0, e1, e2;
+};
+
+struct RayTraceParams
+{
+    v4 eye;
+    v4 forward;
+    // Scaled by the tangent of half the field of view, and the aspect ratio
+    v4 right;
+    v4 up;
+    // Dequantization of node bounds
+    v4 sceneMin;
+    v4 sceneScale;
+    u32 width;
+    u32 height;
+    u32 _pad[2];
+};
+static_assert( sizeof(RayTraceParams) % 16 == 0 );
+
+struct RayTracing
+{
+    bool enabled;
+    GPUBVHFormat format;
+    u32 nodeCount;
+    u32 triCount;
+    v3 sceneMin;
+    v3 sceneMax;
+    // Camera for this frame
+    RayTraceParams params;
+
+    BufferHandle nodesBuffer;
+    BufferHandle trisBuffer;
+    BufferHandle paramsBuffer;
+    TextureHandle output;
+    TextureViewHandle outputView;
+    u32 width;
+    u32 height;
+};
+
+// Pipelines shared by everything that ray traces, one per node format
+struct RayTracer
+{
+    WGPUBindGroupLayout bindGroupLayout;
+    WGPUComputePipeline pipelines[(int)GPUBVHFormat::Count];
+};
@@ -0,0 +1,383 @@
+
+ResourceRegistry globalResources;
+
+void WaitForGPU();
+
+void AddToCounter( GPUMemoryCounter* counter, i64 count, i64 bytes )
+{
+    counter->count += (int)count;
+    counter->bytes += bytes;
+    counter->peakBytes = Max( counter->peakBytes, counter->bytes );
+}
+
+// Returns false when the allocation should be refused
+bool CheckGPUBudget( GPUMemoryCounter* counter, u64 limit, u64 size, char const* what, char const* label,
+                     bool canFail, GPUMemoryStats* stats )
+{
+    if( !limit || counter->bytes + size <= limit )
+    {
+        counter->overBudget = false;
+        return true;
+    }
+
+    if( stats->budget.failOnExceed && canFail )
+    {
+        Log( "ERROR :: Allocating %llu bytes for '%s' would exceed the GPU memory budget for %s (%.1f / %.1f MB)",
+             (unsigned long long)size, label, what, counter->bytes / (1024.0 * 1024.0), limit / (1024.0 * 1024.0) );
+        return false;
+    }
+    if( !counter->overBudget )
+    {
+        Log( "WARNING :: GPU memory budget for %s exceeded by '%s' (%.1f / %.1f MB)",
+             what, label, (counter->bytes + size) / (1024.0 * 1024.0), limit / (1024.0 * 1024.0) );
+        counter->overBudget = true;
+    }
+    return true;
+}
+
+char const* ResolveGPUMemoryOwner( char const* owner, GPUMemoryStats const& stats )
+{
+    if( owner )
+        return owner;
+    return stats.currentOwner ? stats.currentOwner : SharedGPUMemoryOwner;
+}
+
+// Check a new allocation against the runtime and per-program budgets
+bool CheckGPUAllocation( u64 size, char const* owner, char const* label, ResourceRegistry* registry )
+{
+    GPUMemoryStats& stats = registry->memory;
+    owner = ResolveGPUMemoryOwner( owner, stats );
+    label = label ? label : "";
+
+    // The runtime can't do without its own objects, so those only ever warn
+    bool isShared = strcmp( owner, SharedGPUMemoryOwner ) == 0;
+    if( !CheckGPUBudget( &stats.total, stats.budget.totalBytes, size, "the runtime", label, !isShared, &stats ) ||
+        (!isShared && !CheckGPUBudget( &stats.byOwner[owner], stats.budget.perProgramBytes, size, owner, label, true, &stats )) )
+    {
+        stats.failedAllocations++;
+        return false;
+    }
+    return true;
+}
+
+void TrackGPUAllocation( void* object, GPUMemoryType type, u64 size, char const* owner, char const* label,
+                         ResourceRegistry* registry )
+{
+    GPUMemoryStats& stats = registry->memory;
+    owner = ResolveGPUMemoryOwner( owner, stats );
+    label = label ? label : "";
+
+    AddToCounter( &stats.total, 1, size );
+    AddToCounter( &stats.byType[(int)type], 1, size );
+    AddToCounter( &stats.byOwner[owner], 1, size );
+    AddToCounter( &stats.byLabel[label], 1, size );
+    stats.allocations[object] = { type, size, owner, label };
+}
+
+void UntrackGPUAllocation( void* object, ResourceRegistry* registry )
+{
+    GPUMemoryStats& stats = registry->memory;
+    auto it = stats.allocations.find( object );
+    if( it == stats.allocations.end() )
+        return;
+
+    GPUAllocation const& a = it->second;
+    i64 size = (i64)a.size;
+    AddToCounter( &stats.total, -1, -size );
+    AddToCounter( &stats.byType[(int)a.type], -1, -size );
+    AddToCounter( &stats.byOwner[a.owner], -1, -size );
+    AddToCounter( &stats.byLabel[a.label], -1, -size );
+    stats.allocations.erase( it );
+}
+
+u64 EstimateTextureSize( WGPUTextureDescriptor const& desc )
+{
+    u64 result = 0;
+    u32 layers = desc.dimension == WGPUTextureDimension_3D ? 1 : desc.size.depthOrArrayLayers;
+    for( u32 mip = 0; mip < desc.mipLevelCount; ++mip )
+    {
+        u64 width = Max( desc.size.width >> mip, 1u );
+        u64 height = Max( desc.size.height >> mip, 1u );
+        u64 depth = desc.dimension == WGPUTextureDimension_3D ? Max( desc.size.depthOrArrayLayers >> mip, 1u ) : 1;
+        result += width * height * depth;
+    }
+    return result * layers * Max( desc.sampleCount, 1u ) * BytesPerTexel( desc.format );
+}
+
+// Set the owner for everything created from now on (when not given explicitly). Returns the previous one
+char const* SetGPUMemoryOwner( char const* owner, ResourceRegistry* registry = &globalResources )
+{
+    char const* previous = registry->memory.currentOwner;
+    registry->memory.currentOwner = owner;
+    return previous;
+}
+
+// All buffer creation should go through here. Returns null if the budget doesn't allow it
+WGPUBuffer CreateGPUBuffer( WGPUBufferDescriptor const* desc, char const* owner = nullptr,
+                            ResourceRegistry* registry = &globalResources )
+{
+    if( !CheckGPUAllocation( desc->size, owner, desc->label, registry ) )
+        return nullptr;
+
+    WGPUBuffer buffer = wgpuDeviceCreateBuffer( globalDevice, desc );
+    if( buffer )
+        TrackGPUAllocation( buffer, GPUMemoryType::Buffer, desc->size, owner, desc->label, registry );
+    return buffer;
+}
+
+// All texture creation should go through here. Returns null if the budget doesn't allow it
+WGPUTexture CreateGPUTexture( WGPUTextureDescriptor const* desc, char const* owner = nullptr,
+                              ResourceRegistry* registry = &globalResources )
+{
+    u64 size = EstimateTextureSize( *desc );
+    if( !CheckGPUAllocation( size, owner, desc->label, registry ) )
+        return nullptr;
+
+    WGPUTexture texture = wgpuDeviceCreateTexture( globalDevice, desc );
+    if( texture )
+        TrackGPUAllocation( texture, GPUMemoryType::Texture, size, owner, desc->label, registry );
+    return texture;
+}
+
+void DestroyGPUBuffer( WGPUBuffer buffer, ResourceRegistry* registry = &globalResources )
+{
+    if( !buffer )
+        return;
+
+    UntrackGPUAllocation( buffer, registry );
+    wgpuBufferDestroy( buffer );
+    wgpuBufferRelease( buffer );
+}
+
+void DestroyGPUTexture( WGPUTexture texture, ResourceRegistry* registry = &globalResources )
+{
+    if( !texture )
+        return;
+
+    UntrackGPUAllocation( texture, registry );
+    wgpuTextureDestroy( texture );
+    wgpuTextureRelease( texture );
+}
+
+void LogGPUMemoryCounters( std::unordered_map<std::string, GPUMemoryCounter> const& counters )
+{
+    // Biggest first
+    std::vector<std::pair<std::string, GPUMemoryCounter>> sorted( counters.begin(), counters.end() );
+    std::sort( sorted.begin(), sorted.end(), []( auto const& a, auto const& b ) { return a.second.bytes > b.second.bytes; } );
+
+    for( auto const& it : sorted )
+    {
+        if( !it.second.count && !it.second.peakBytes )
+            continue;
+        Log( "    %-32s %6d objects %10.2f MB (peak %.2f MB)", it.first.empty() ? "(no label)" : it.first.c_str(),
+             it.second.count, it.second.bytes / (1024.0 * 1024.0), it.second.peakBytes / (1024.0 * 1024.0) );
+    }
+}
+
+void LogGPUMemory( ResourceRegistry* registry = &globalResources )
+{
+    GPUMemoryStats const& stats = registry->memory;
+
+    Log( "GPU memory: %d objects, %.2f MB (peak %.2f MB)",
+         stats.total.count, stats.total.bytes / (1024.0 * 1024.0), stats.total.peakBytes / (1024.0 * 1024.0) );
+    for( int t = 0; t < (int)GPUMemoryType::Count; ++t )
+    {
+        GPUMemoryCounter const& c = stats.byType[t];
+        Log( "  %-8s %6d objects %10.2f MB (peak %.2f MB)",
+             GPUMemoryTypeNames[t], c.count, c.bytes / (1024.0 * 1024.0), c.peakBytes / (1024.0 * 1024.0) );
+    }
+    Log( "  By program:" );
+    LogGPUMemoryCounters( stats.byOwner );
+    Log( "  By label:" );
+    LogGPUMemoryCounters( stats.byLabel );
+    if( stats.failedAllocations )
+        Log( "  %d allocations refused for being over budget", stats.failedAllocations );
+}
+
+void ReleaseResourceObject( ResourceType type, void* object, ResourceRegistry* registry )
+{
+    switch( type )
+    {
+        case ResourceType::Buffer: DestroyGPUBuffer( (WGPUBuffer)object, registry ); break;
+        case ResourceType::Texture: DestroyGPUTexture( (WGPUTexture)object, registry ); break;
+        case ResourceType::TextureView: wgpuTextureViewRelease( (WGPUTextureView)object ); break;
+        case ResourceType::Sampler: wgpuSamplerRelease( (WGPUSampler)object ); break;
+        case ResourceType::BindGroupLayout: wgpuBindGroupLayoutRelease( (WGPUBindGroupLayout)object ); break;
+        case ResourceType::BindGroup: wgpuBindGroupRelease( (WGPUBindGroup)object ); break;
+        case ResourceType::PipelineLayout: wgpuPipelineLayoutRelease( (WGPUPipelineLayout)object ); break;
+        case ResourceType::RenderPipeline: wgpuRenderPipelineRelease( (WGPURenderPipeline)object ); break;
+        case ResourceType::ComputePipeline: wgpuComputePipelineRelease( (WGPUComputePipeline)object ); break;
+        case ResourceType::ShaderModule: wgpuShaderModuleRelease( (WGPUShaderModule)object ); break;
+        case ResourceType::RenderBundle: wgpuRenderBundleRelease( (WGPURenderBundle)object ); break;
+        default: ASSERT( false, "Unknown resource type" );
+    }
+}
+
+INLINE void AssertOwnerThread( ResourceRegistry const* registry )
+{
+    ASSERT( std::this_thread::get_id() == registry->ownerThread, "Resource registry used from some other thread" );
+}
+
+// Take ownership of an object and return a handle to it. Null objects give a null handle
+template <typename T>
+Handle<T> RegisterResource( T object, char const* label, ResourceRegistry* registry = &globalResources )
+{
+    AssertOwnerThread( registry );
+    if( !object )
+        return {};
+
+    ResourcePool& pool = registry->pools[(int)ResourceTraits<T>::type];
+
+    u32 index;
+    if( (sz)pool.freeSlots.size() > MinFreeResourceSlots )
+    {
+        index = pool.freeSlots.front();
+        pool.freeSlots.pop_front();
+    }
+    else
+    {
+        index = (u32)pool.objects.size();
+        ASSERT( index <= ResourceIndexMask, "Too many resources" );
+        pool.objects.push_back( nullptr );
+        pool.generations.push_back( 1 );
+        pool.labels.emplace_back();
+    }
+
+    pool.objects[index] = (void*)object;
+    pool.labels[index] = label ? label : "";
+    pool.liveCount++;
+
+    return { ((u32)pool.generations[index] << ResourceIndexBits) | index };
+}
+
+// Resolve a handle. Returns null for null or stale handles
+template <typename T>
+T GetResource( Handle<T> handle, ResourceRegistry* registry = &globalResources )
+{
+    AssertOwnerThread( registry );
+    if( !handle )
+        return nullptr;
+
+    ResourcePool const& pool = registry->pools[(int)ResourceTraits<T>::type];
+    u32 index = handle.id & ResourceIndexMask;
+    u32 generation = handle.id >> ResourceIndexBits;
+
+    if( index >= pool.objects.size() || pool.generations[index] != generation )
+        return nullptr;
+    return (T)pool.objects[index];
+}
+
+// Queue an object that's not in the registry for release once the GPU is done with the current frame
+template <typename T>
+void DeferRelease( T object, ResourceRegistry* registry = &globalResources )
+{
+    AssertOwnerThread( registry );
+    if( object )
+        registry->deferred.push_back( { ResourceTraits<T>::type, (void*)object, registry->currentFrame } );
+}
+
+// Invalidate the handle right away, and release the object once the GPU is done with the current frame
+template <typename T>
+void DestroyResource( Handle<T>* handle, ResourceRegistry* registry = &globalResources )
+{
+    T object = GetResource( *handle, registry );
+    if( object )
+    {
+        ResourcePool& pool = registry->pools[(int)ResourceTraits<T>::type];
+        u32 index = handle->id & ResourceIndexMask;
+
+        // Generations never wrap back to 0 (so no valid handle is ever 0) or to any value handed out before:
+        // once a slot has used them all up, it just stays out of the free list
+        u8& generation = pool.generations[index];
+        pool.objects[index] = nullptr;
+        pool.labels[index].clear();
+        if( generation < MaxResourceGeneration )
+        {
+            generation++;
+            pool.freeSlots.push_back( index );
+        }
+        else
+            generation = 0;
+        pool.liveCount--;
+
+        DeferRelease( object, registry );
+    }
+
+    *handle = {};
+}
+
+// Actually release everything the GPU is done with
+void CollectDeferredReleases( ResourceRegistry* registry = &globalResources )
+{
+    AssertOwnerThread( registry );
+    sz kept = 0;
+    for( DeferredRelease const& d : registry->deferred )
+    {
+        if( d.frame <= registry->completedFrame )
+            ReleaseResourceObject( d.type, d.object, registry );
+        else
+            registry->deferred[kept++] = d;
+    }
+    registry->deferred.resize( kept );
+}
+
+// Call right after submitting each frame
+void EndResourceFrame( ResourceRegistry* registry = &globalResources )
+{
+    struct FrameDone
+    {
+        ResourceRegistry* registry;
+        u64 frame;
+    };
+    FrameDone* done = NEW( &globalAlloc, FrameDone ) { registry, registry->currentFrame };
+
+    auto onWorkDone = []( WGPUQueueWorkDoneStatus status, void* pUserData )
+    {
+        FrameDone* done = (FrameDone*)pUserData;
+        done->registry->completedFrame = Max( done->registry->completedFrame, done->frame );
+        DELETE( &globalAlloc, done, FrameDone );
+    };
+    wgpuQueueOnSubmittedWorkDone( globalQueue, onWorkDone, done );
+
+    registry->currentFrame++;
+    CollectDeferredReleases( registry );
+}
+
+// Log every object that's still registered. Returns the number of leaked objects
+int ReportResourceLeaks( ResourceRegistry* registry = &globalResources )
+{
+    int total = 0;
+    for( int t = 0; t < (int)ResourceType::Count; ++t )
+        total += registry->pools[t].liveCount;
+
+    if( !total )
+    {
+        Log( "No GPU resource leaks" );
+        return 0;
+    }
+
+    Log( "WARNING :: %d GPU resources still alive at shutdown:", total );
+    for( int t = 0; t < (int)ResourceType::Count; ++t )
+    {
+        ResourcePool const& pool = registry->pools[t];
+        if( !pool.liveCount )
+            continue;
+
+        Log( "  %s: %d", ResourceTypeNames[t], pool.liveCount );
+        for( sz i = 0; i < pool.objects.size(); ++i )
+            if( pool.objects[i] )
+                Log( "    [%llu] '%s'", (unsigned long long)i, pool.labels[i].c_str() );
+    }
+    return total;
+}
+
+// Wait for the GPU, flush all pending releases and report whatever is left
+void ShutdownResources( ResourceRegistry* registry = &globalResources )
+{
+    WaitForGPU();
+    registry->completedFrame = registry->currentFrame;
+    CollectDeferredReleases( registry );
+
+    LogGPUMemory( registry );
+    ReportResourceLeaks( registry );
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+// Registry for WebGPU objects owned by the runtime.
+// Objects are referred to through 32 bit handles (24 bit slot index + 8 bit generation), so a stale handle
+// to a destroyed object just resolves to null instead of a dangling pointer.
+// Destroying an object only queues it: it's actually released once the GPU has finished the frame it was
+// destroyed in, so hot reloads and program switches never pull anything out from under in-flight work.
+// Registries aren't synchronized. Handles are only registered, resolved and destroyed on the thread that created the
+// registry (the main thread for globalResources), so frame tasks running on workers must not touch them at all.
+
+enum class ResourceType : u8
+{
+    Buffer,
+    Texture,
+    TextureView,
+    Sampler,
+    BindGroupLayout,
+    BindGroup,
+    PipelineLayout,
+    RenderPipeline,
+    ComputePipeline,
+    ShaderModule,
+    RenderBundle,
+
+    Count
+};
+
+constexpr char const* ResourceTypeNames[] =
+{
+    "Buffer",
+    "Texture",
+    "TextureView",
+    "Sampler",
+    "BindGroupLayout",
+    "BindGroup",
+    "PipelineLayout",
+    "RenderPipeline",
+    "ComputePipeline",
+    "ShaderModule",
+    "RenderBundle",
+};
+static_assert( ARRAYCOUNT(ResourceTypeNames) == (int)ResourceType::Count );
+
+constexpr u32 ResourceIndexBits = 24;
+constexpr u32 ResourceIndexMask = (1u << ResourceIndexBits) - 1;
+
+template <typename T>
+struct Handle
+{
+    u32 id;                     // 0 is never a valid handle
+
+    explicit operator bool() const { return id != 0; }
+    bool operator ==( Handle const& other ) const { return id == other.id; }
+    bool operator !=( Handle const& other ) const { return id != other.id; }
+};
+
+template <typename T>
+struct ResourceTraits;
+
+#define RESOURCE_TYPE( name )                                                                               \
+    template <> struct ResourceTraits<WGPU##name> { static constexpr ResourceType type = ResourceType::name; };  \
+    using name##Handle = Handle<WGPU##name>;
+
+RESOURCE_TYPE( Buffer );
+RESOURCE_TYPE( Texture );
+RESOURCE_TYPE( TextureView );
+RESOURCE_TYPE( Sampler );
+RESOURCE_TYPE( BindGroupLayout );
+RESOURCE_TYPE( BindGroup );
+RESOURCE_TYPE( PipelineLayout );
+RESOURCE_TYPE( RenderPipeline );
+RESOURCE_TYPE( ComputePipeline );
+RESOURCE_TYPE( ShaderModule );
+RESOURCE_TYPE( RenderBundle );
+
+#undef RESOURCE_TYPE
+
+
+// Freed slots wait in a FIFO until at least this many others are free too, so a slot freed by a hot reload isn't
+// handed right back to the object replacing it, and its generation only comes around again after many reuses
+constexpr sz MinFreeResourceSlots = 1024;
+constexpr u8 MaxResourceGeneration = 255;
+
+// Dense per-type arrays. Slots are recycled through a free list, bumping their generation each time.
+// Slots that have gone through every generation are retired for good, so a stale handle can never resolve again
+struct ResourcePool
+{
+    std::vector<void*> objects;
+    std::vector<u8> generations;
+    std::vector<std::string> labels;
+    std::deque<u32> freeSlots;
+    int liveCount;
+};
+
+struct DeferredRelease
+{
+    ResourceType type;
+    void* object;
+    u64 frame;                  // Safe to release once the GPU has completed this frame
+};
+
+
+// GPU memory accounting
+// Every buffer and texture is created through CreateGPUBuffer / CreateGPUTexture, which keep live object counts
+// and byte totals per type, per owning program and per label, and check them against the configured budgets.
+// Sizes are estimates from the descriptors (drivers add their own padding), but they're good enough to spot growth.
+
+enum class GPUMemoryType : u8
+{
+    Buffer,
+    Texture,
+
+    Count
+};
+
+constexpr char const* GPUMemoryTypeNames[] =
+{
+    "Buffers",
+    "Textures",
+};
+static_assert( ARRAYCOUNT(GPUMemoryTypeNames) == (int)GPUMemoryType::Count );
+
+// Owner for anything created outside a program (staging chunks, benchmarks..)
+constexpr char const* SharedGPUMemoryOwner = "(shared)";
+
+struct GPUMemoryCounter
+{
+    int count;
+    u64 bytes;
+    u64 peakBytes;
+    bool overBudget;            // So we only warn when crossing the limit
+};
+
+struct GPUAllocation
+{
+    GPUMemoryType type;
+    u64 size;
+    std::string owner;
+    std::string label;
+};
+
+// Zero means unlimited
+struct GPUMemoryBudget
+{
+    u64 totalBytes = 1536ull * 1024 * 1024;
+    u64 perProgramBytes = 512ull * 1024 * 1024;
+    // Make creation fail (returning null) instead of just warning when a budget would be exceeded
+    bool failOnExceed = false;
+};
+
+struct GPUMemoryStats
+{
+    GPUMemoryCounter total;
+    GPUMemoryCounter byType[(int)GPUMemoryType::Count];
+    std::unordered_map<std::string, GPUMemoryCounter> byOwner;
+    std::unordered_map<std::string, GPUMemoryCounter> byLabel;
+    std::unordered_map<void*, GPUAllocation> allocations;
+
+    GPUMemoryBudget budget;
+    // Owner assigned to objects created without an explicit one
+    char const* currentOwner = nullptr;
+    int failedAllocations;
+};
+
+
+struct ResourceRegistry
+{
+    ResourcePool pools[(int)ResourceType::Count];
+    std::vector<DeferredRelease> deferred;
+    GPUMemoryStats memory;
+
+    u64 currentFrame = 1;       // The frame currently being recorded
+    u64 completedFrame = 0;     // Latest frame the GPU is known to have finished
+
+    // The only thread allowed to use it
+    std::thread::id ownerThread = std::this_thread::get_id();
+};
@@ -0,0 +1,322 @@
+ShaderDependencies globalShaderDependencies;
+
+
+// Forward slashes, and no '.' or '..' parts (where they can be resolved), so every file has a single key
+std::string NormalizeShaderPath( std::string path )
+{
+    std::replace( path.begin(), path.end(), '\\', '/' );
+
+    std::vector<std::string> parts;
+    for( sz start = 0; start <= path.size(); )
+    {
+        sz end = path.find( '/', start );
+        if( end == std::string::npos )
+            end = path.size();
+        std::string part = path.substr( start, end - start );
+
+        if( part == ".." && !parts.empty() && parts.back() != ".." && !parts.back().empty() )
+            parts.pop_back();
+        else if( part != "." && (!part.empty() || parts.empty()) )
+            parts.push_back( part );
+        start = end + 1;
+    }
+
+    std::string result;
+    for( sz i = 0; i < parts.size(); ++i )
+    {
+        if( i )
+            result += '/';
+        result += parts[i];
+    }
+    return result;
+}
+
+// Whether the line is an include, and if so the path of the file it includes (empty if the line is malformed)
+bool ParseShaderInclude( std::string const& path, char const* line, char const* lineEnd, std::string* includePath )
+{
+    char const* c = line;
+    while( c < lineEnd && (*c == ' ' || *c == '\t') )
+        ++c;
+    if( lineEnd - c < 8 || strncmp( c, "#include", 8 ) != 0 )
+        return false;
+
+    char const* open = (char const*)memchr( c, '"', lineEnd - c );
+    char const* close = open ? (char const*)memchr( open + 1, '"', lineEnd - open - 1 ) : nullptr;
+    includePath->clear();
+    if( close )
+    {
+        sz dirLength = path.rfind( '/' ) + 1;       // Also right if there's no slash
+        *includePath = NormalizeShaderPath( path.substr( 0, dirLength ) + std::string( open + 1, close ) );
+    }
+    return true;
+}
+
+INLINE char const* FindLineEnd( char const* line )
+{
+    char const* lineEnd = strchr( line, '\n' );
+    return lineEnd ? lineEnd : line + strlen( line );
+}
+
+// Add every file the source includes directly that isn't in the list yet, both to the list and to the output
+void FindShaderIncludes( std::string const& path, char const* source, std::vector<std::string>* known,
+                         std::vector<std::string>* out )
+{
+    std::string includePath;
+    for( char const* line = source; *line; )
+    {
+        char const* lineEnd = FindLineEnd( line );
+        // Malformed includes get reported when expanding
+        if( ParseShaderInclude( path, line, lineEnd, &includePath ) && !includePath.empty()
+            && std::find( known->begin(), known->end(), includePath ) == known->end() )
+        {
+            known->push_back( includePath );
+            out->push_back( includePath );
+        }
+        line = *lineEnd ? lineEnd + 1 : lineEnd;
+    }
+}
+
+bool IncludeShaderFile( std::string const& path, ShaderFileContents const& contents, std::string* out,
+                        std::vector<std::string>* files );
+
+// Copy the source over, replacing include lines with whatever they include
+bool ExpandShaderIncludes( std::string const& path, char const* source, ShaderFileContents const& contents,
+                           std::string* out, std::vector<std::string>* files )
+{
+    std::string includePath;
+    for( char const* line = source; *line; )
+    {
+        char const* lineEnd = FindLineEnd( line );
+        char const* next = *lineEnd ? lineEnd + 1 : lineEnd;
+
+        if( ParseShaderInclude( path, line, lineEnd, &includePath ) )
+        {
+            if( includePath.empty() )
+            {
+                Log( "ERROR :: Malformed include in '%s': %.*s", path.c_str(), (int)(lineEnd - line), line );
+                return false;
+            }
+            if( !IncludeShaderFile( includePath, contents, out, files ) )
+            {
+                Log( "ERROR :: Could not include '%s' from '%s'", includePath.c_str(), path.c_str() );
+                return false;
+            }
+            // Whatever follows still starts on its own line
+            if( !out->empty() && out->back() != '\n' )
+                out->push_back( '\n' );
+        }
+        else
+            out->append( line, next );
+
+        line = next;
+    }
+
+    return true;
+}
+
+// Expand the file, which fails if it couldn't be read. Files already included are skipped, which also stops cycles
+bool IncludeShaderFile( std::string const& path, ShaderFileContents const& contents, std::string* out,
+                        std::vector<std::string>* files )
+{
+    if( std::find( files->begin(), files->end(), path ) != files->end() )
+        return true;
+    files->push_back( path );
+
+    auto it = contents.find( path );
+    return it != contents.end() && ExpandShaderIncludes( path, it->second, contents, out, files );
+}
+
+// Read a shader and everything it includes through the file loader, blocking until it's all in. Each level of includes
+// is read in one go, so at least files at the same depth load in parallel. Files that can't be read are left out
+void ReadShaderFiles( char const* path, ShaderFileContents* out, FileLoader* loader = &globalFileLoader )
+{
+    std::vector<std::string> known = { NormalizeShaderPath( path ) };
+    std::vector<std::string> paths = known, next;
+    while( !paths.empty() )
+    {
+        std::vector<FileLoad> loads( paths.size() );
+        int loadCount = 0;
+        for( std::string const& p : paths )
+        {
+            // Programs get their top file read ahead (see PrefetchProgram)
+            Buffer<u8> prefetched = TakePrefetchedFile( p.c_str(), loader );
+            if( prefetched.data )
+            {
+                (*out)[p] = (char const*)prefetched.data;
+                continue;
+            }
+
+            FileLoad& load = loads[loadCount++];
+            load.path = p.c_str();
+            load.priority = FileLoadPriority::High;
+            load.nullTerminate = true;
+        }
+        SubmitFileLoads( loads.data(), loadCount, loader );
+
+        for( int i = 0; i < loadCount; ++i )
+        {
+            if( WaitForFileLoad( &loads[i], loader ) )
+                (*out)[loads[i].path] = (char const*)loads[i].contents.data;
+        }
+
+        next.clear();
+        for( std::string const& p : paths )
+        {
+            auto it = out->find( p );
+            if( it != out->end() )
+                FindShaderIncludes( p, it->second, &known, &next );
+        }
+        paths.swap( next );
+    }
+}
+
+void FreeShaderFiles( ShaderFileContents* contents )
+{
+    for( auto const& file : *contents )
+        FREE( &globalAlloc, (void*)file.second );
+    contents->clear();
+}
+
+struct ShaderFilesRead;
+
+struct ShaderFileRead
+{
+    FileLoad load;
+    std::string path;
+    ShaderFilesRead* owner;
+};
+
+struct ShaderFilesRead
+{
+    std::vector<std::string> known;         // Top file first
+    std::vector<ShaderFileRead*> reads;
+    ShaderFileContents contents;
+    int pending;
+    bool cancelled;
+
+    ShaderFilesReadFunc* callback;
+    void* userdata;
+    FileLoader* loader;
+};
+
+void ReadShaderFileAsync( ShaderFilesRead* files, std::string const& path );
+
+// Includes are only known once the file including them is in, so they're queued from here
+void OnShaderFileRead( FileLoad* load, void* userdata )
+{
+    ShaderFileRead* read = (ShaderFileRead*)userdata;
+    ShaderFilesRead* files = read->owner;
+
+    FileLoadStatus status = load->status.load( std::memory_order_relaxed );
+    if( status == FileLoadStatus::Done )
+    {
+        files->contents[read->path] = (char const*)load->contents.data;
+        if( !files->cancelled )
+        {
+            std::vector<std::string> includes;
+            FindShaderIncludes( read->path, (char const*)load->contents.data, &files->known, &includes );
+            for( std::string const& include : includes )
+                ReadShaderFileAsync( files, include );
+        }
+    }
+    else if( status == FileLoadStatus::Cancelled )
+        files->cancelled = true;
+
+    if( --files->pending == 0 )
+    {
+        bool topFileRead = files->contents.find( files->known[0] ) != files->contents.end();
+        files->callback( topFileRead && !files->cancelled ? &files->contents : nullptr, files->userdata );
+
+        FreeShaderFiles( &files->contents );
+        for( ShaderFileRead* r : files->reads )
+            DELETE( &globalAlloc, r, ShaderFileRead );
+        DELETE( &globalAlloc, files, ShaderFilesRead );
+    }
+}
+
+void ReadShaderFileAsync( ShaderFilesRead* files, std::string const& path )
+{
+    ShaderFileRead* read = NEW( &globalAlloc, ShaderFileRead )();
+    read->path = path;
+    read->owner = files;
+    read->load.path = read->path.c_str();
+    read->load.priority = FileLoadPriority::High;
+    read->load.nullTerminate = true;
+    read->load.callback = OnShaderFileRead;
+    read->load.userdata = read;
+
+    files->reads.push_back( read );
+    files->pending++;
+    SubmitFileLoads( &read->load, 1, files->loader );
+}
+
+// Read a shader and everything it includes in the background, then hand it all to the callback (from ProcessFileLoads).
+// Missing includes are left out, so whoever builds from it gets the same errors as when reading them in place
+void ReadShaderFilesAsync( char const* path, ShaderFilesReadFunc* callback, void* userdata,
+                           FileLoader* loader /*= &globalFileLoader*/ )
+{
+    ShaderFilesRead* files = NEW( &globalAlloc, ShaderFilesRead )();
+    files->known.push_back( NormalizeShaderPath( path ) );
+    files->callback = callback;
+    files->userdata = userdata;
+    files->loader = loader;
+    ReadShaderFileAsync( files, files->known[0] );
+}
+
+// Put together the full source for a pipeline variant, and make it depend on every file that went into it (replacing
+// whatever it depended on before). Files are read through the file loader unless they're all given
+bool LoadShaderSource( char const* path, std::string* out, ShaderDependent const& dependent,
+                       ShaderFileContents const* contents /*= nullptr*/, ShaderDependencies* deps /*= &globalShaderDependencies*/ )
+{
+    ShaderFileContents read;
+    if( !contents )
+    {
+        ReadShaderFiles( path, &read );
+        contents = &read;
+    }
+
+    out->clear();
+    std::vector<std::string> files;
+    bool result = IncludeShaderFile( NormalizeShaderPath( path ), *contents, out, &files );
+    FreeShaderFiles( &read );
+
+    // Even when it failed, so fixing whatever was wrong brings it back
+    RemoveShaderDependents( dependent.owner, dependent.variant, deps );
+    for( std::string const& file : files )
+        deps->dependents[file].push_back( dependent );
+
+    return result;
+}
+
+// Forget all variants of the owner, or just the one given
+void RemoveShaderDependents( void* owner, int variant /*= AllShaderVariants*/, ShaderDependencies* deps /*= &globalShaderDependencies*/ )
+{
+    for( auto it = deps->dependents.begin(); it != deps->dependents.end(); )
+    {
+        std::vector<ShaderDependent>& dependents = it->second;
+        dependents.erase( std::remove_if( dependents.begin(), dependents.end(), [=]( ShaderDependent const& d )
+        {
+            return d.owner == owner && (variant == AllShaderVariants || d.variant == variant);
+        } ), dependents.end() );
+
+        if( dependents.empty() )
+            it = deps->dependents.erase( it );
+        else
+            ++it;
+    }
+}
+
+// Invalidate every pipeline variant built from the file. Returns how many there were
+int InvalidateShaderFile( char const* path, ShaderDependencies* deps /*= &globalShaderDependencies*/ )
+{
+    auto it = deps->dependents.find( NormalizeShaderPath( path ) );
+    if( it == deps->dependents.end() )
+        return 0;
+
+    // Owners may well load their shaders again right away, which changes the graph
+    std::vector<ShaderDependent> dependents = it->second;
+    for( ShaderDependent const& d : dependents )
+        d.invalidate( d.owner, d.variant );
+
+    return (int)dependents.size();
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+// Shader sources and the pipelines built from them
+// WGSL has no preprocessor, so shaders pull in shared snippets with an `#include "file.wgsl"` line (relative to the
+// including file) which gets replaced by the file's contents before compiling. Each file goes in only once per shader,
+// so snippets can include each other freely.
+// Every pipeline variant records all the files that went into it, as a dependent: whoever owns it, which variant of
+// theirs it is, and how to invalidate it. When a file changes, exactly the pipelines built from it (directly or through
+// includes) get invalidated, whichever program or subsystem they belong to. What invalidating means is up to the owner:
+// programs reload in the background, subsystems just drop theirs and rebuild it the next time they need it.
+// All files are read through the file loader. Building a pipeline right away reads what it needs a level of includes at
+// a time, while reloads read it all in the background first and only build once everything is in.
+
+using ShaderInvalidateFunc = void( void* owner, int variant );
+
+struct ShaderDependent
+{
+    void* owner;
+    int variant;
+    ShaderInvalidateFunc* invalidate;
+};
+
+// Variants are up to each owner (and may be negative, like MainPass)
+constexpr int AllShaderVariants = I32MIN;
+
+struct ShaderDependencies
+{
+    // Keyed by file path, always with forward slashes
+    std::unordered_map<std::string, std::vector<ShaderDependent>> dependents;
+};
+
+extern ShaderDependencies globalShaderDependencies;
+
+// Null terminated contents of shader files, by path (always with forward slashes)
+using ShaderFileContents = std::unordered_map<std::string, char const*>;
+// Contents are null when the top file couldn't be read, or the loader shut down first. They're only valid during the call
+using ShaderFilesReadFunc = void( ShaderFileContents const* contents, void* userdata );
+
+void ReadShaderFilesAsync( char const* path, ShaderFilesReadFunc* callback, void* userdata,
+                           FileLoader* loader = &globalFileLoader );
+bool LoadShaderSource( char const* path, std::string* out, ShaderDependent const& dependent,
+                       ShaderFileContents const* contents = nullptr, ShaderDependencies* deps = &globalShaderDependencies );
+void RemoveShaderDependents( void* owner, int variant = AllShaderVariants, ShaderDependencies* deps = &globalShaderDependencies );
+int InvalidateShaderFile( char const* path, ShaderDependencies* deps = &globalShaderDependencies );
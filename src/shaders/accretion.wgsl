@@ -1,8 +1,11 @@
 struct VertexInput
 {
-    @location(0) position: vec3f,
-    @location(1) velocity: vec3f,
-    @location(2) color: vec4f,
+    // Per vertex
+    @location(0) corner: vec2f,
+    // Per instance
+    @location(1) position: vec3f,
+    @location(2) velocity: vec3f,
+    @location(3) color: vec4f,
 };
 
 struct VertexOutput
@@ -24,12 +27,16 @@ struct Uniforms
 };
 @group(0) @binding(0) var<uniform> uniforms: Uniforms;
 
+const particleSize = 0.004;
+
 @vertex
 fn vs_main( in: VertexInput ) -> VertexOutput
 {
     var out: VertexOutput;
     /*out.position = vec4f( in.position, 1.0 );*/
     out.position = uniforms.transform * vec4f( in.position, 1.0 );
+    // Expand each instance into a small screen-aligned quad
+    out.position += vec4f( in.corner * particleSize * out.position.w, 0.0, 0.0 );
     out.velocity = in.velocity;
     out.color = in.color; // forward to the fragment shader
     return out;
@@ -1,29 +1,7 @@
 // https://gist.github.com/greggman/3c7b4729e0f0aedf49b6993e54050527
 
-struct ShadertoyUniforms
-{
-    iResolution: vec2f,
-    iTime: f32,
-};
-@group(0) @binding(0) var<uniform> uniforms: ShadertoyUniforms;
-
-
-// Ideally we'd like this to be constant, but this errors out and points to a github issue in wgpu-native
-//const positions = array(
-var<private> positions: array<vec2f,4> = array<vec2f,4>(
-    vec2f(-1.0, -1.0),
-    vec2f( 1.0, -1.0),
-    vec2f(-1.0,  1.0),
-    vec2f( 1.0,  1.0)
-);
-
-@vertex
-fn vs_main( @builtin(vertex_index) in_vertex_index: u32 ) -> @builtin(position) vec4f
-{
-    // Emit hardcoded positions for the 4 corners of the window
-    // Invoke this with a WGPUPrimitiveTopology_TriangleStrip call (and a count of 4)
-    return vec4f( positions[in_vertex_index], 0.0, 1.0 );
-}
+#include "shadertoy.wgsl"
+#include "fullscreen_quad.wgsl"
 
 
 // Protean clouds by nimitz (twitter: @stormoid)
@@ -192,6 +170,6 @@ fn mainImage(fragCoord: vec2<f32>) -> vec4<f32>
 @fragment
 fn fs_main( @builtin(position) fragCoord: vec4<f32> ) -> @location(0) vec4<f32>
 {
-    return mainImage(fragCoord.xy);
+    return mainImage(pixelCoord( fragCoord ));
 }
 
@@ -0,0 +1,86 @@
+// Frustum culling of instance bounds.
+// Visible instances are compacted per workgroup first, so there's only one global atomic per workgroup
+
+struct CullParams
+{
+    planes: array<vec4f, 6>,
+    instanceCount: u32,
+};
+
+// Plain (unaligned) aabb, same layout as on the CPU
+struct InstanceBounds
+{
+    cx: f32, cy: f32, cz: f32,
+    hx: f32, hy: f32, hz: f32,
+};
+
+struct DrawArgs
+{
+    count: u32,
+    instanceCount: atomic<u32>,
+    first: u32,
+    baseVertexOrFirstInstance: u32,
+    firstInstance: u32,
+};
+
+@group(0) @binding(0) var<uniform> params: CullParams;
+@group(0) @binding(1) var<storage, read> bounds: array<InstanceBounds>;
+@group(0) @binding(2) var<storage, read_write> visibleInstances: array<u32>;
+@group(0) @binding(3) var<storage, read_write> args: DrawArgs;
+
+var<workgroup> groupVisibleCount: atomic<u32>;
+var<workgroup> groupBase: u32;
+
+
+// Same test as IsInFrustum: the box is out if its most positive corner along any plane normal is behind it
+fn isInFrustum( center: vec3f, halfSize: vec3f ) -> bool
+{
+    for( var i = 0; i < 6; i++ )
+    {
+        let plane = params.planes[i];
+        if( dot( plane.xyz, center ) + dot( abs( plane.xyz ), halfSize ) + plane.w < 0.0 )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Dispatched as a 2D grid when there's more workgroups than fit in one dimension
+@compute @workgroup_size(64)
+fn cs_main( @builtin(workgroup_id) groupId: vec3u, @builtin(num_workgroups) groupCount: vec3u,
+            @builtin(local_invocation_index) localIndex: u32 )
+{
+    let index = (groupId.y * groupCount.x + groupId.x) * 64u + localIndex;
+
+    if( localIndex == 0u )
+    {
+        atomicStore( &groupVisibleCount, 0u );
+    }
+    workgroupBarrier();
+
+    var visible = false;
+    var localSlot = 0u;
+    if( index < params.instanceCount )
+    {
+        let b = bounds[index];
+        visible = isInFrustum( vec3f( b.cx, b.cy, b.cz ), vec3f( b.hx, b.hy, b.hz ) );
+        if( visible )
+        {
+            localSlot = atomicAdd( &groupVisibleCount, 1u );
+        }
+    }
+    workgroupBarrier();
+
+    // Reserve space for the whole workgroup at once
+    if( localIndex == 0u )
+    {
+        groupBase = atomicAdd( &args.instanceCount, atomicLoad( &groupVisibleCount ) );
+    }
+    workgroupBarrier();
+
+    if( visible )
+    {
+        visibleInstances[groupBase + localSlot] = index;
+    }
+}
@@ -0,0 +1,57 @@
+// A field of cubes, culled on the GPU. Each instance is placed and sized from its own bounds
+
+struct VertexInput
+{
+    @builtin(instance_index) instance: u32,
+    @location(0) position: vec3f,
+    @location(1) normal: vec3f,
+    @location(2) uv: vec2f,
+};
+
+struct VertexOutput
+{
+    @builtin(position) position: vec4f,
+    @location(0) normal: vec3f,
+    @location(1) color: vec3f,
+};
+
+struct Uniforms
+{
+    viewProj: mat4x4f,
+    time: f32,
+};
+
+struct InstanceBounds
+{
+    cx: f32, cy: f32, cz: f32,
+    hx: f32, hy: f32, hz: f32,
+};
+
+@group(0) @binding(0) var<uniform> uniforms: Uniforms;
+@group(0) @binding(6) var<storage, read> visibleInstances: array<u32>;
+@group(0) @binding(7) var<storage, read> instanceBounds: array<InstanceBounds>;
+
+@vertex
+fn vs_main( in: VertexInput ) -> VertexOutput
+{
+    let index = visibleInstances[in.instance];
+    let b = instanceBounds[index];
+    let center = vec3f( b.cx, b.cy, b.cz );
+    let halfSize = vec3f( b.hx, b.hy, b.hz );
+
+    // The source cube is a unit cube around the origin
+    var out: VertexOutput;
+    out.position = uniforms.viewProj * vec4f( center + in.position * 2.0 * halfSize, 1.0 );
+    out.normal = in.normal;
+    out.color = 0.5 + 0.5 * cos( vec3f( 0.0, 2.0, 4.0 ) + f32( index % 97u ) * 0.37 );
+    return out;
+}
+
+@fragment
+fn fs_main( in: VertexOutput ) -> @location(0) vec4f
+{
+    let lightDir = normalize( vec3f( 0.5, -0.7, 1.0 ) );
+    let diffuse = max( dot( normalize( in.normal ), lightDir ), 0.0 ) * 0.8 + 0.2;
+
+    return vec4f( in.color * diffuse, 1.0 );
+}
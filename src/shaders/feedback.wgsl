@@ -0,0 +1,17 @@
+// Main pass: displays the current frame of Buffer A through iChannel0
+
+#include "shadertoy.wgsl"
+#include "fullscreen_quad.wgsl"
+@group(0) @binding(1) var channelSampler: sampler;
+@group(0) @binding(2) var iChannel0: texture_2d<f32>;
+
+
+@fragment
+fn fs_main( @builtin(position) fragCoord: vec4f ) -> @location(0) vec4f
+{
+    let uv = fragCoord.xy / uniforms.iResolution;
+    let hdr = textureSampleLevel( iChannel0, channelSampler, uv, 0.0 ).rgb;
+
+    // Buffer A accumulates unbounded values, so tone map them
+    return vec4f( 1.0 - exp( -1.5 * hdr ), 1.0 );
+}
@@ -0,0 +1,38 @@
+// Buffer A: reads its own previous frame through iChannel0
+
+#include "shadertoy.wgsl"
+#include "fullscreen_quad.wgsl"
+@group(0) @binding(1) var channelSampler: sampler;
+@group(0) @binding(2) var iChannel0: texture_2d<f32>;
+
+
+fn palette( t: f32 ) -> vec3f
+{
+    return 0.5 + 0.5 * cos( 6.28318 * (t + vec3f(0.0, 0.33, 0.67)) );
+}
+
+@fragment
+fn fs_main( @builtin(position) fragCoord: vec4f ) -> @location(0) vec4f
+{
+    let t = uniforms.iTime;
+    let aspect = uniforms.iResolution.x / uniforms.iResolution.y;
+    let uv = fragCoord.xy / uniforms.iResolution;
+
+    // Advect last frame with a slow swirl towards the center
+    let p = (uv - 0.5) * vec2f(aspect, 1.0);
+    let angle = 0.004 + 0.01 * length( p );
+    let rot = mat2x2f( cos(angle), sin(angle), -sin(angle), cos(angle) );
+    let src = (rot * p) * 0.996 / vec2f(aspect, 1.0) + 0.5;
+    var color = textureSampleLevel( iChannel0, channelSampler, src, 0.0 ).rgb * 0.985;
+
+    // Inject some colour from a couple of moving emitters
+    for( var i = 0; i < 2; i++ )
+    {
+        let phase = f32(i) * 2.1;
+        let emitter = vec2f( 0.35 * aspect * sin( t * 0.9 + phase ), 0.35 * sin( t * 1.3 + phase * 1.7 ) );
+        let d = length( p - emitter );
+        color += smoothstep( 0.04, 0.0, d ) * palette( t * 0.1 + f32(i) * 0.5 ) * 0.5;
+    }
+
+    return vec4f( color, 1.0 );
+}
@@ -1,29 +1,7 @@
 //https://www.shadertoy.com/view/MdKfDh
 
-struct ShadertoyUniforms
-{
-    iResolution: vec2f,
-    iTime: f32,
-};
-@group(0) @binding(0) var<uniform> uniforms: ShadertoyUniforms;
-
-
-// Ideally we'd like this to be constant, but this errors out and points to a github issue in wgpu-native
-//const positions = array(
-var<private> positions: array<vec2f,4> = array<vec2f,4>(
-    vec2f(-1.0, -1.0),
-    vec2f( 1.0, -1.0),
-    vec2f(-1.0,  1.0),
-    vec2f( 1.0,  1.0)
-);
-
-@vertex
-fn vs_main( @builtin(vertex_index) in_vertex_index: u32 ) -> @builtin(position) vec4f
-{
-    // Emit hardcoded positions for the 4 corners of the window
-    // Invoke this with a WGPUPrimitiveTopology_TriangleStrip call (and a count of 4)
-    return vec4f( positions[in_vertex_index], 0.0, 1.0 );
-}
+#include "shadertoy.wgsl"
+#include "fullscreen_quad.wgsl"
 
 
 const fireMovement        = vec2f(-0.09, -0.5);
@@ -99,7 +77,8 @@ fn bumpMap( uv: vec2f ) -> vec3f
 @fragment
 fn fs_main( @builtin(position) fragCoord: vec4f ) -> @location(0) vec4f
 {
-    let fragPos = vec2f( fragCoord.x, uniforms.iResolution.y - fragCoord.y );
+    let coord = pixelCoord( fragCoord );
+    let fragPos = vec2f( coord.x, uniforms.iResolution.y - coord.y );
     var uv = fragPos.xy/uniforms.iResolution.xy;
 
     let timeScale: f32 = uniforms.iTime * .5;
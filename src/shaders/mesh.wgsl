@@ -0,0 +1,40 @@
+struct VertexInput
+{
+    @location(0) position: vec3f,
+    @location(1) normal: vec3f,
+    @location(2) uv: vec2f,
+};
+
+struct VertexOutput
+{
+    @builtin(position) position: vec4f,
+    @location(0) normal: vec3f,
+    @location(1) uv: vec2f,
+};
+
+struct Uniforms
+{
+    viewProj: mat4x4f,
+    model: mat4x4f,
+    time: f32,
+};
+@group(0) @binding(0) var<uniform> uniforms: Uniforms;
+
+@vertex
+fn vs_main( in: VertexInput ) -> VertexOutput
+{
+    var out: VertexOutput;
+    out.position = uniforms.viewProj * uniforms.model * vec4f( in.position, 1.0 );
+    out.normal = (uniforms.model * vec4f( in.normal, 0.0 )).xyz;
+    out.uv = in.uv;
+    return out;
+}
+
+@fragment
+fn fs_main( in: VertexOutput ) -> @location(0) vec4f
+{
+    let lightDir = normalize( vec3f( 0.5, -0.7, 1.0 ) );
+    let diffuse = max( dot( normalize( in.normal ), lightDir ), 0.0 ) * 0.8 + 0.2;
+
+    return vec4f( vec3f( in.uv, 1.0 ) * diffuse, 1.0 );
+}
@@ -0,0 +1,91 @@
+// Generates two mip levels per dispatch.
+// STORAGE_FORMAT, IS_SRGB and IS_UNORM8 are replaced before compiling, once per texture format
+
+@group(0) @binding(0) var srcMip: texture_2d<f32>;
+@group(0) @binding(1) var dstMip1: texture_storage_2d<STORAGE_FORMAT, write>;
+@group(0) @binding(2) var dstMip2: texture_storage_2d<STORAGE_FORMAT, write>;
+
+const srgb = IS_SRGB;
+const unorm8 = IS_UNORM8;
+
+var<workgroup> tile: array<array<vec4f, 8>, 8>;
+
+
+fn linearToSrgb( c: vec3f ) -> vec3f
+{
+    return select( 1.055 * pow( c, vec3f(1.0 / 2.4) ) - 0.055, c * 12.92, c <= vec3f(0.0031308) );
+}
+
+fn srgbToLinear( c: vec3f ) -> vec3f
+{
+    return select( pow( (c + 0.055) / 1.055, vec3f(2.4) ), c / 12.92, c <= vec3f(0.04045) );
+}
+
+// Storage views of sRGB textures are linear, so we have to encode ourselves
+fn encode( c: vec4f ) -> vec4f
+{
+    if( srgb )
+    {
+        return vec4f( linearToSrgb( c.rgb ), c.a );
+    }
+    return c;
+}
+
+// Round-trip through the stored representation, so the second level is filtered from exactly
+// the same values a separate pass would read back from the first one
+fn quantize( c: vec4f ) -> vec4f
+{
+    if( unorm8 )
+    {
+        let stored = round( saturate( encode( c ) ) * 255.0 ) / 255.0;
+        if( srgb )
+        {
+            return vec4f( srgbToLinear( stored.rgb ), stored.a );
+        }
+        return stored;
+    }
+    return c;
+}
+
+@compute @workgroup_size(8, 8)
+fn cs_main( @builtin(global_invocation_id) globalId: vec3u,
+            @builtin(local_invocation_id) localId: vec3u,
+            @builtin(workgroup_id) groupId: vec3u )
+{
+    // First level: box filter 2x2 texels from the source, clamping at the edges for odd sizes
+    let srcMax = textureDimensions( srcMip ) - 1u;
+    let dst1Size = textureDimensions( dstMip1 );
+    let p = globalId.xy * 2u;
+
+    let c = ( textureLoad( srcMip, min( p, srcMax ), 0 )
+            + textureLoad( srcMip, min( p + vec2u(1u, 0u), srcMax ), 0 )
+            + textureLoad( srcMip, min( p + vec2u(0u, 1u), srcMax ), 0 )
+            + textureLoad( srcMip, min( p + vec2u(1u, 1u), srcMax ), 0 ) ) * 0.25;
+
+    if( all( globalId.xy < dst1Size ) )
+    {
+        textureStore( dstMip1, globalId.xy, encode( c ) );
+    }
+    tile[localId.y][localId.x] = quantize( c );
+
+    workgroupBarrier();
+
+    // Second level: a quarter of the threads reduce the tile we just wrote
+    if( all( localId.xy < vec2u(4u) ) )
+    {
+        let dst2Size = textureDimensions( dstMip2 );
+        let d = groupId.xy * 4u + localId.xy;
+        // Clamp to the edge of the first level (not the tile), same as above
+        let tileMax = min( dst1Size - 1u - groupId.xy * 8u, vec2u(7u) );
+        let t = localId.xy * 2u;
+
+        let t00 = min( t, tileMax );
+        let t11 = min( t + vec2u(1u), tileMax );
+        let c2 = ( tile[t00.y][t00.x] + tile[t00.y][t11.x] + tile[t11.y][t00.x] + tile[t11.y][t11.x] ) * 0.25;
+
+        if( all( d < dst2Size ) )
+        {
+            textureStore( dstMip2, d, encode( c2 ) );
+        }
+    }
+}
@@ -0,0 +1,29 @@
+// Naive mip generation, one render pass per level.
+// Bilinear sampling right between 4 source texels gives the 2x2 box filter for even sizes
+
+@group(0) @binding(0) var srcMip: texture_2d<f32>;
+@group(0) @binding(1) var srcSampler: sampler;
+
+struct VertexOutput
+{
+    @builtin(position) position: vec4f,
+    @location(0) uv: vec2f,
+};
+
+@vertex
+fn vs_main( @builtin(vertex_index) in_vertex_index: u32 ) -> VertexOutput
+{
+    // Single triangle covering the whole target
+    let uv = vec2f( f32( (in_vertex_index << 1u) & 2u ), f32( in_vertex_index & 2u ) );
+
+    var out: VertexOutput;
+    out.position = vec4f( uv * vec2f(2.0, -2.0) + vec2f(-1.0, 1.0), 0.0, 1.0 );
+    out.uv = uv;
+    return out;
+}
+
+@fragment
+fn fs_main( in: VertexOutput ) -> @location(0) vec4f
+{
+    return textureSampleLevel( srcMip, srcSampler, in.uv, 0.0 );
+}
@@ -0,0 +1,244 @@
+// Ray tracing of triangle meshes over a BVH built on the CPU.
+// Nodes are read as raw words so both node formats can share the same bindings (see raytrace.h)
+
+struct Params
+{
+    eye: vec4f,
+    forward: vec4f,
+    right: vec4f,
+    up: vec4f,
+    sceneMin: vec4f,
+    sceneScale: vec4f,
+    width: u32,
+    height: u32,
+};
+
+struct Node
+{
+    bmin: vec3f,
+    bmax: vec3f,
+    index: u32,         // Right child, or first triangle of a leaf
+    count: u32,         // Triangles in a leaf, 0 for interior nodes
+};
+
+struct Hit
+{
+    t: f32,
+    tri: u32,
+};
+
+@group(0) @binding(0) var<uniform> params: Params;
+@group(0) @binding(1) var<storage, read> nodes: array<u32>;
+// Each triangle is a vertex plus both edges, as 9 floats
+@group(0) @binding(2) var<storage, read> tris: array<f32>;
+@group(0) @binding(3) var outputTexture: texture_storage_2d<rgba8unorm, write>;
+
+const NoHit = 0xffffffffu;
+const Far = 3.0e38;
+// Same as RayTraceStackSize. BVHs deeper than this are refused when uploaded, so the stack can never overflow
+const StackSize = 64;
+
+
+// Same layout as BVHNode
+fn loadFullNode( i: u32 ) -> Node
+{
+    let b = i * 8u;
+    var n: Node;
+    n.bmin = vec3f( bitcast<f32>( nodes[b] ), bitcast<f32>( nodes[b + 1u] ), bitcast<f32>( nodes[b + 2u] ) );
+    n.index = nodes[b + 3u];
+    n.bmax = vec3f( bitcast<f32>( nodes[b + 4u] ), bitcast<f32>( nodes[b + 5u] ), bitcast<f32>( nodes[b + 6u] ) );
+    n.count = nodes[b + 7u] & 0xffffu;
+    return n;
+}
+
+// Same layout as GPUBVHNodeQuantized: 16 bit bounds relative to the scene, then index and count packed together
+fn loadQuantizedNode( i: u32 ) -> Node
+{
+    let b = i * 4u;
+    let w0 = nodes[b];
+    let w1 = nodes[b + 1u];
+    let w2 = nodes[b + 2u];
+    let w3 = nodes[b + 3u];
+
+    let qmin = vec3f( f32( w0 & 0xffffu ), f32( w0 >> 16u ), f32( w1 & 0xffffu ) );
+    let qmax = vec3f( f32( w1 >> 16u ), f32( w2 & 0xffffu ), f32( w2 >> 16u ) );
+    var n: Node;
+    n.bmin = params.sceneMin.xyz + qmin * params.sceneScale.xyz;
+    n.bmax = params.sceneMin.xyz + qmax * params.sceneScale.xyz;
+    n.index = w3 & 0x1fffffffu;
+    n.count = w3 >> 29u;
+    return n;
+}
+
+fn loadNode( i: u32, quantized: bool ) -> Node
+{
+    if( quantized )
+    {
+        return loadQuantizedNode( i );
+    }
+    return loadFullNode( i );
+}
+
+// Distance to where the ray enters the box, or Far if it misses it or only enters it past maxT
+fn intersectBox( o: vec3f, invDir: vec3f, n: Node, maxT: f32 ) -> f32
+{
+    let t0 = (n.bmin - o) * invDir;
+    let t1 = (n.bmax - o) * invDir;
+    let tNear = min( t0, t1 );
+    let tFar = max( t0, t1 );
+    let tEnter = max( max( tNear.x, tNear.y ), tNear.z );
+    let tExit = min( min( tFar.x, tFar.y ), tFar.z );
+    if( tExit >= tEnter && tExit >= 0.0 && tEnter < maxT )
+    {
+        return tEnter;
+    }
+    return Far;
+}
+
+fn triVector( i: u32, v: u32 ) -> vec3f
+{
+    let b = i * 9u + v * 3u;
+    return vec3f( tris[b], tris[b + 1u], tris[b + 2u] );
+}
+
+// Möller-Trumbore, same as IntersectRayTri
+fn intersectTri( o: vec3f, d: vec3f, i: u32 ) -> f32
+{
+    let v0 = triVector( i, 0u );
+    let e1 = triVector( i, 1u );
+    let e2 = triVector( i, 2u );
+
+    let p = cross( d, e2 );
+    let det = dot( e1, p );
+    if( abs( det ) < 1e-12 )
+    {
+        return Far;
+    }
+    let invDet = 1.0 / det;
+    let s = o - v0;
+    let u = dot( s, p ) * invDet;
+    let q = cross( s, e1 );
+    let v = dot( d, q ) * invDet;
+    let t = dot( e2, q ) * invDet;
+    if( u < 0.0 || u > 1.0 || v < 0.0 || u + v > 1.0 || t <= 1e-6 )
+    {
+        return Far;
+    }
+    return t;
+}
+
+fn trace( o: vec3f, d: vec3f, quantized: bool ) -> Hit
+{
+    var hit = Hit( Far, NoHit );
+    let invDir = 1.0 / d;
+    if( intersectBox( o, invDir, loadNode( 0u, quantized ), hit.t ) == Far )
+    {
+        return hit;
+    }
+
+    var stackNodes: array<u32, StackSize>;
+    var stackT: array<f32, StackSize>;
+    var stackSize = 0;
+    var index = 0u;
+
+    loop
+    {
+        let n = loadNode( index, quantized );
+        var descend = false;
+        if( n.count > 0u )
+        {
+            for( var i = n.index; i < n.index + n.count; i++ )
+            {
+                let t = intersectTri( o, d, i );
+                if( t < hit.t )
+                {
+                    hit = Hit( t, i );
+                }
+            }
+        }
+        else
+        {
+            // Nearest child first
+            var nearIndex = index + 1u;
+            var farIndex = n.index;
+            var tNear = intersectBox( o, invDir, loadNode( nearIndex, quantized ), hit.t );
+            var tFar = intersectBox( o, invDir, loadNode( farIndex, quantized ), hit.t );
+            if( tFar < tNear )
+            {
+                let swapIndex = nearIndex; nearIndex = farIndex; farIndex = swapIndex;
+                let swapT = tNear; tNear = tFar; tFar = swapT;
+            }
+            if( tNear < Far )
+            {
+                if( tFar < Far && stackSize < StackSize )
+                {
+                    stackNodes[stackSize] = farIndex;
+                    stackT[stackSize] = tFar;
+                    stackSize++;
+                }
+                index = nearIndex;
+                descend = true;
+            }
+        }
+
+        if( !descend )
+        {
+            // Skip anything that can't be closer than what we've already hit
+            while( stackSize > 0 && stackT[stackSize - 1] >= hit.t )
+            {
+                stackSize--;
+            }
+            if( stackSize == 0 )
+            {
+                break;
+            }
+            stackSize--;
+            index = stackNodes[stackSize];
+        }
+    }
+    return hit;
+}
+
+fn shade( d: vec3f, hit: Hit ) -> vec3f
+{
+    if( hit.tri == NoHit )
+    {
+        // Sky
+        return mix( vec3f( 0.8, 0.85, 0.9 ), vec3f( 0.3, 0.5, 0.8 ), clamp( d.z * 2.0, 0.0, 1.0 ) );
+    }
+
+    var n = normalize( cross( triVector( hit.tri, 1u ), triVector( hit.tri, 2u ) ) );
+    if( dot( n, d ) > 0.0 )
+    {
+        n = -n;
+    }
+    let lightDir = normalize( vec3f( 0.5, -0.7, 1.0 ) );
+    let diffuse = max( dot( n, lightDir ), 0.0 ) * 0.8 + 0.2;
+    let albedo = 0.5 + 0.5 * n;
+    return albedo * diffuse;
+}
+
+fn render( pixel: vec2u, quantized: bool )
+{
+    if( pixel.x >= params.width || pixel.y >= params.height )
+    {
+        return;
+    }
+
+    let uv = (vec2f( pixel ) + 0.5) / vec2f( f32( params.width ), f32( params.height ) ) * 2.0 - 1.0;
+    let d = normalize( params.forward.xyz + uv.x * params.right.xyz - uv.y * params.up.xyz );
+    let hit = trace( params.eye.xyz, d, quantized );
+    textureStore( outputTexture, vec2i( pixel ), vec4f( shade( d, hit ), 1.0 ) );
+}
+
+@compute @workgroup_size(8, 8)
+fn cs_full( @builtin(global_invocation_id) id: vec3u )
+{
+    render( id.xy, false );
+}
+
+@compute @workgroup_size(8, 8)
+fn cs_quantized( @builtin(global_invocation_id) id: vec3u )
+{
+    render( id.xy, true );
+}
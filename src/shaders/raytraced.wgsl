@@ -0,0 +1,13 @@
+// Shows the output of the program's ray tracing pass (see raytrace.wgsl)
+
+#include "shadertoy.wgsl"
+#include "fullscreen_quad.wgsl"
+@group(0) @binding(1) var channelSampler: sampler;
+@group(0) @binding(2) var iChannel0: texture_2d<f32>;
+
+
+@fragment
+fn fs_main( @builtin(position) fragCoord: vec4f ) -> @location(0) vec4f
+{
+    return textureSample( iChannel0, channelSampler, fragCoord.xy / uniforms.iResolution );
+}
@@ -0,0 +1,18 @@
+// Uniforms shared by all Shadertoy style programs (ShadertoyUniforms in program.cpp)
+// Programs can be rendered in tiles, for images bigger than any render target. iResolution is always the size of the
+// whole image, and iTileOffset is where the tile being rendered starts in it, so fragment positions should go through
+// pixelCoord() to get coordinates in the whole image
+
+struct ShadertoyUniforms
+{
+    iResolution: vec2f,
+    iTime: f32,
+    iFrame: u32,
+    iTileOffset: vec2f,
+};
+@group(0) @binding(0) var<uniform> uniforms: ShadertoyUniforms;
+
+fn pixelCoord( fragCoord: vec4f ) -> vec2f
+{
+    return fragCoord.xy + uniforms.iTileOffset;
+}
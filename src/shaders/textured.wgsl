@@ -0,0 +1,18 @@
+#include "shadertoy.wgsl"
+#include "fullscreen_quad.wgsl"
+@group(0) @binding(1) var channelSampler: sampler;
+@group(0) @binding(2) var iChannel0: texture_2d<f32>;
+
+
+@fragment
+fn fs_main( @builtin(position) fragCoord: vec4f ) -> @location(0) vec4f
+{
+    let uv = (pixelCoord( fragCoord ) - 0.5 * uniforms.iResolution) / uniforms.iResolution.y;
+
+    // Zoom in and out over time so the whole mip chain gets some use
+    let zoom = exp2( 4.0 * sin( uniforms.iTime * 0.3 ) + 2.0 );
+    let angle = uniforms.iTime * 0.1;
+    let rot = mat2x2f( cos(angle), sin(angle), -sin(angle), cos(angle) );
+
+    return textureSample( iChannel0, channelSampler, rot * uv * zoom );
+}
@@ -0,0 +1,106 @@
+// Conversion of a rendered frame to YUV 4:2:0 for video encoding: BT.709, limited range.
+// Every invocation does a block of 8 x 2 pixels, which is 4 whole words of luma and 4 chroma samples, so words never
+// get shared between invocations. Chroma is the average of each 2 x 2 quad, taken after gamma encoding.
+// Output is NV12 (Y plane, then UV interleaved) or I420 (Y, U and V planes), as tightly packed bytes
+
+struct YUVParams
+{
+    width: u32,
+    height: u32,
+    planar: u32,
+    linearInput: u32,
+};
+
+@group(0) @binding(0) var<uniform> params: YUVParams;
+@group(0) @binding(1) var source: texture_2d<f32>;
+@group(0) @binding(2) var<storage, read_write> yuv: array<u32>;
+
+
+fn linearToSrgb( c: vec3f ) -> vec3f
+{
+    return select( 1.055 * pow( c, vec3f(1.0 / 2.4) ) - 0.055, c * 12.92, c <= vec3f(0.0031308) );
+}
+
+fn loadColor( x: u32, y: u32 ) -> vec3f
+{
+    var c = clamp( textureLoad( source, vec2u( x, y ), 0 ).rgb, vec3f(0.0), vec3f(1.0) );
+    if( params.linearInput != 0u )
+    {
+        c = linearToSrgb( c );
+    }
+    return c;
+}
+
+fn luma( c: vec3f ) -> f32
+{
+    return dot( c, vec3f( 0.2126, 0.7152, 0.0722 ) );
+}
+
+fn toByte( v: f32 ) -> u32
+{
+    return u32( clamp( round( v ), 0.0, 255.0 ) );
+}
+
+fn pack4( a: u32, b: u32, c: u32, d: u32 ) -> u32
+{
+    return a | (b << 8u) | (c << 16u) | (d << 24u);
+}
+
+@compute @workgroup_size(8, 8)
+fn cs_main( @builtin(global_invocation_id) id: vec3u )
+{
+    let x0 = id.x * 8u;
+    let y0 = id.y * 2u;
+    if( x0 >= params.width || y0 >= params.height )
+    {
+        return;
+    }
+
+    var lumaBytes: array<u32, 16>;
+    var cb: array<u32, 4>;
+    var cr: array<u32, 4>;
+    for( var q = 0u; q < 4u; q++ )
+    {
+        let x = x0 + q * 2u;
+        let c00 = loadColor( x, y0 );
+        let c10 = loadColor( x + 1u, y0 );
+        let c01 = loadColor( x, y0 + 1u );
+        let c11 = loadColor( x + 1u, y0 + 1u );
+
+        lumaBytes[q * 2u] = toByte( 16.0 + 219.0 * luma( c00 ) );
+        lumaBytes[q * 2u + 1u] = toByte( 16.0 + 219.0 * luma( c10 ) );
+        lumaBytes[8u + q * 2u] = toByte( 16.0 + 219.0 * luma( c01 ) );
+        lumaBytes[8u + q * 2u + 1u] = toByte( 16.0 + 219.0 * luma( c11 ) );
+
+        let avg = (c00 + c10 + c01 + c11) * 0.25;
+        let y = luma( avg );
+        cb[q] = toByte( 128.0 + 224.0 * (avg.b - y) / 1.8556 );
+        cr[q] = toByte( 128.0 + 224.0 * (avg.r - y) / 1.5748 );
+    }
+
+    // Everything below is in words. Widths are a multiple of 8, so rows and planes all start on a word
+    let rowWords = params.width / 4u;
+    let lumaWord = y0 * rowWords + x0 / 4u;
+    for( var r = 0u; r < 2u; r++ )
+    {
+        let b = r * 8u;
+        yuv[lumaWord + r * rowWords] = pack4( lumaBytes[b], lumaBytes[b + 1u], lumaBytes[b + 2u], lumaBytes[b + 3u] );
+        yuv[lumaWord + r * rowWords + 1u] = pack4( lumaBytes[b + 4u], lumaBytes[b + 5u], lumaBytes[b + 6u], lumaBytes[b + 7u] );
+    }
+
+    let lumaWords = params.width * params.height / 4u;
+    let chromaRow = id.y;
+    if( params.planar != 0u )
+    {
+        let planeWords = lumaWords / 4u;
+        let chromaWord = chromaRow * (rowWords / 2u) + id.x;
+        yuv[lumaWords + chromaWord] = pack4( cb[0], cb[1], cb[2], cb[3] );
+        yuv[lumaWords + planeWords + chromaWord] = pack4( cr[0], cr[1], cr[2], cr[3] );
+    }
+    else
+    {
+        let chromaWord = lumaWords + chromaRow * rowWords + x0 / 4u;
+        yuv[chromaWord] = pack4( cb[0], cr[0], cb[1], cr[1] );
+        yuv[chromaWord + 1u] = pack4( cb[2], cr[2], cb[3], cr[3] );
+    }
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+// Thin wrappers over x86 float SIMD (see SIMD_LEVEL in CMakeLists.txt).
+// simdf is the widest type the build targets: 4 lanes with SSE, 8 with AVX2 and 16 with AVX-512. Narrower types are
+// still available (e.g. 4-wide ray packets in an AVX2 build), and the same functions work on all of them.
+// Comparisons return plain bitmasks (one bit per lane), so they can be combined and iterated the same way everywhere.
+
+#if defined(__AVX512F__)
+    #define SIMD_AVX512 1
+    #define SIMD_AVX2 1
+    using simdf = __m512;
+#elif defined(__AVX2__)
+    #define SIMD_AVX2 1
+    using simdf = __m256;
+#else
+    #define SIMD_SSE 1
+    using simdf = __m128;
+#endif
+
+template <typename F>
+struct SimdLanes;
+template <> struct SimdLanes<__m128> { static constexpr int width = 4; };
+#if SIMD_AVX2
+template <> struct SimdLanes<__m256> { static constexpr int width = 8; };
+#endif
+#if SIMD_AVX512
+template <> struct SimdLanes<__m512> { static constexpr int width = 16; };
+#endif
+
+constexpr int SimdWidth = SimdLanes<simdf>::width;
+
+template <typename F = simdf>
+constexpr u32 SimdAllLanes = (u32)((1ull << SimdLanes<F>::width) - 1);
+
+// Only the return type tells these apart, so pick the width explicitly when it's not simdf
+template <typename F = simdf> INLINE F SimdLoad( f32 const* p );
+template <typename F = simdf> INLINE F SimdSet( f32 v );
+
+
+template <> INLINE __m128 SimdLoad<__m128>( f32 const* p )  { return _mm_loadu_ps( p ); }
+template <> INLINE __m128 SimdSet<__m128>( f32 v )          { return _mm_set1_ps( v ); }
+INLINE void SimdStore( f32* p, __m128 a )                   { _mm_storeu_ps( p, a ); }
+INLINE __m128 SimdAdd( __m128 a, __m128 b )                 { return _mm_add_ps( a, b ); }
+INLINE __m128 SimdSub( __m128 a, __m128 b )                 { return _mm_sub_ps( a, b ); }
+INLINE __m128 SimdMul( __m128 a, __m128 b )                 { return _mm_mul_ps( a, b ); }
+INLINE __m128 SimdDiv( __m128 a, __m128 b )                 { return _mm_div_ps( a, b ); }
+#if SIMD_AVX2
+INLINE __m128 SimdMulAdd( __m128 a, __m128 b, __m128 c )    { return _mm_fmadd_ps( a, b, c ); }
+#else
+// No FMA guaranteed at this level
+INLINE __m128 SimdMulAdd( __m128 a, __m128 b, __m128 c )    { return _mm_add_ps( _mm_mul_ps( a, b ), c ); }
+#endif
+INLINE __m128 SimdMin( __m128 a, __m128 b )                 { return _mm_min_ps( a, b ); }
+INLINE __m128 SimdMax( __m128 a, __m128 b )                 { return _mm_max_ps( a, b ); }
+INLINE __m128 SimdAbs( __m128 a )                           { return _mm_andnot_ps( _mm_set1_ps( -0.f ), a ); }
+INLINE u32 SimdMaskGE( __m128 a, __m128 b )                 { return (u32)_mm_movemask_ps( _mm_cmpge_ps( a, b ) ); }
+INLINE u32 SimdMaskLT( __m128 a, __m128 b )                 { return (u32)_mm_movemask_ps( _mm_cmplt_ps( a, b ) ); }
+
+#if SIMD_AVX2
+template <> INLINE __m256 SimdLoad<__m256>( f32 const* p )  { return _mm256_loadu_ps( p ); }
+template <> INLINE __m256 SimdSet<__m256>( f32 v )          { return _mm256_set1_ps( v ); }
+INLINE void SimdStore( f32* p, __m256 a )                   { _mm256_storeu_ps( p, a ); }
+INLINE __m256 SimdAdd( __m256 a, __m256 b )                 { return _mm256_add_ps( a, b ); }
+INLINE __m256 SimdSub( __m256 a, __m256 b )                 { return _mm256_sub_ps( a, b ); }
+INLINE __m256 SimdMul( __m256 a, __m256 b )                 { return _mm256_mul_ps( a, b ); }
+INLINE __m256 SimdDiv( __m256 a, __m256 b )                 { return _mm256_div_ps( a, b ); }
+INLINE __m256 SimdMulAdd( __m256 a, __m256 b, __m256 c )    { return _mm256_fmadd_ps( a, b, c ); }
+INLINE __m256 SimdMin( __m256 a, __m256 b )                 { return _mm256_min_ps( a, b ); }
+INLINE __m256 SimdMax( __m256 a, __m256 b )                 { return _mm256_max_ps( a, b ); }
+INLINE __m256 SimdAbs( __m256 a )                           { return _mm256_andnot_ps( _mm256_set1_ps( -0.f ), a ); }
+INLINE u32 SimdMaskGE( __m256 a, __m256 b )                 { return (u32)_mm256_movemask_ps( _mm256_cmp_ps( a, b, _CMP_GE_OQ ) ); }
+INLINE u32 SimdMaskLT( __m256 a, __m256 b )                 { return (u32)_mm256_movemask_ps( _mm256_cmp_ps( a, b, _CMP_LT_OQ ) ); }
+#endif
+
+#if SIMD_AVX512
+template <> INLINE __m512 SimdLoad<__m512>( f32 const* p )  { return _mm512_loadu_ps( p ); }
+template <> INLINE __m512 SimdSet<__m512>( f32 v )          { return _mm512_set1_ps( v ); }
+INLINE void SimdStore( f32* p, __m512 a )                   { _mm512_storeu_ps( p, a ); }
+INLINE __m512 SimdAdd( __m512 a, __m512 b )                 { return _mm512_add_ps( a, b ); }
+INLINE __m512 SimdSub( __m512 a, __m512 b )                 { return _mm512_sub_ps( a, b ); }
+INLINE __m512 SimdMul( __m512 a, __m512 b )                 { return _mm512_mul_ps( a, b ); }
+INLINE __m512 SimdDiv( __m512 a, __m512 b )                 { return _mm512_div_ps( a, b ); }
+INLINE __m512 SimdMulAdd( __m512 a, __m512 b, __m512 c )    { return _mm512_fmadd_ps( a, b, c ); }
+INLINE __m512 SimdMin( __m512 a, __m512 b )                 { return _mm512_min_ps( a, b ); }
+INLINE __m512 SimdMax( __m512 a, __m512 b )                 { return _mm512_max_ps( a, b ); }
+INLINE __m512 SimdAbs( __m512 a )                           { return _mm512_abs_ps( a ); }
+INLINE u32 SimdMaskGE( __m512 a, __m512 b )                 { return _mm512_cmp_ps_mask( a, b, _CMP_GE_OQ ); }
+INLINE u32 SimdMaskLT( __m512 a, __m512 b )                 { return _mm512_cmp_ps_mask( a, b, _CMP_LT_OQ ); }
+#endif
+
+
+// Index of the lowest set bit. Mask must not be zero
+INLINE u32 FindFirstSetBit( u32 mask )
+{
+#if _MSC_VER
+    unsigned long index;
+    _BitScanForward( &index, mask );
+    return (u32)index;
+#else
+    return (u32)__builtin_ctz( mask );
+#endif
+}
+
+INLINE int PopCount64( u64 mask )
+{
+#if _MSC_VER && defined(__AVX__)
+    return (int)__popcnt64( mask );
+#elif _MSC_VER
+    // __popcnt64 is always the POPCNT instruction, which MSVC only implies from /arch:AVX on
+    mask = mask - ((mask >> 1) & 0x5555555555555555ull);
+    mask = (mask & 0x3333333333333333ull) + ((mask >> 2) & 0x3333333333333333ull);
+    mask = (mask + (mask >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+    return (int)((mask * 0x0101010101010101ull) >> 56);
+#else
+    return __builtin_popcountll( mask );
+#endif
+}
+
+// Append the index of every set lane in mask to out, starting at base, and return how many were written
+INLINE int CompactLaneIndices( u32 mask, u32 base, u32* out )
+{
+    int count = 0;
+    while( mask )
+    {
+        out[count++] = base + FindFirstSetBit( mask );
+        mask &= mask - 1;
+    }
+    return count;
+}
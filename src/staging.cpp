@@ -0,0 +1,188 @@
+
+void OnStagingChunkMapped( WGPUBufferMapAsyncStatus status, void* pUserData )
+{
+    StagingChunk* chunk = (StagingChunk*)pUserData;
+    StagingBelt* belt = chunk->belt;
+
+    auto it = std::find( belt->closed.begin(), belt->closed.end(), chunk );
+    ASSERT( it != belt->closed.end(), "Mapped a staging chunk that wasn't in flight" );
+    belt->closed.erase( it );
+    chunk->mapRequested = false;
+
+    if( status == WGPUBufferMapAsyncStatus_Success )
+    {
+        chunk->data = (u8*)wgpuBufferGetMappedRange( chunk->buffer, 0, chunk->size );
+        chunk->used = 0;
+        belt->free.push_back( chunk );
+    }
+    else
+    {
+        Log( "ERROR :: Could not map staging chunk (%d)", status );
+        belt->totalSize -= chunk->size;
+        DestroyGPUBuffer( chunk->buffer );
+        DELETE( &globalAlloc, chunk, StagingChunk );
+    }
+}
+
+StagingChunk* AcquireStagingChunk( StagingBelt* belt, u64 size )
+{
+    for( ;; )
+    {
+        // Smallest free chunk that fits
+        int best = -1;
+        for( int i = 0; i < (int)belt->free.size(); ++i )
+            if( belt->free[i]->size >= size && (best < 0 || belt->free[i]->size < belt->free[best]->size) )
+                best = i;
+
+        if( best >= 0 )
+        {
+            StagingChunk* chunk = belt->free[best];
+            belt->free.erase( belt->free.begin() + best );
+            return chunk;
+        }
+
+        u64 chunkSize = Max( belt->chunkSize, size );
+        if( belt->totalSize + chunkSize <= belt->maxTotalSize || belt->closed.empty() )
+            break;
+
+        // Over budget, so wait for something to come back (this is what throttles huge uploads)
+        PollDevice( true );
+    }
+
+    WGPUBufferDescriptor bufferDesc = {};
+    bufferDesc.nextInChain          = nullptr;
+    bufferDesc.label                = "Staging chunk";
+    bufferDesc.usage                = WGPUBufferUsage_MapWrite | WGPUBufferUsage_CopySrc;
+    bufferDesc.size                 = Max( belt->chunkSize, size );
+    bufferDesc.mappedAtCreation     = true;
+    WGPUBuffer buffer = CreateGPUBuffer( &bufferDesc, SharedGPUMemoryOwner );
+    if( !buffer )
+    {
+        Log( "ERROR :: Could not create a %llu bytes staging chunk", (unsigned long long)bufferDesc.size );
+        return nullptr;
+    }
+
+    StagingChunk* chunk = NEW( &globalAlloc, StagingChunk );
+    chunk->buffer = buffer;
+    chunk->size = bufferDesc.size;
+    chunk->used = 0;
+    chunk->mapRequested = false;
+    chunk->belt = belt;
+    chunk->data = (u8*)wgpuBufferGetMappedRange( chunk->buffer, 0, chunk->size );
+
+    belt->totalSize += chunk->size;
+    return chunk;
+}
+
+// Reserve mapped staging memory. The copy out of it must be recorded into an encoder that's submitted before
+// the next RecallStagingBelt, and after FlushStagingBelt has unmapped the chunk.
+// Returns an allocation with null data if no chunk could be created
+StagingAllocation StagingAlloc( StagingBelt* belt, u64 size, u64 alignment = 4 )
+{
+    // Copies need 4 byte aligned offsets and sizes
+    size = AlignUp<u64>( size, 4 );
+
+    StagingChunk* chunk = nullptr;
+    for( StagingChunk* c : belt->active )
+    {
+        if( AlignUp( c->used, alignment ) + size <= c->size )
+        {
+            chunk = c;
+            break;
+        }
+    }
+    if( !chunk )
+    {
+        chunk = AcquireStagingChunk( belt, size );
+        if( !chunk )
+            return {};
+        belt->active.push_back( chunk );
+    }
+
+    u64 offset = AlignUp( chunk->used, alignment );
+    chunk->used = offset + size;
+    belt->totalBytesWritten += size;
+
+    return { chunk->buffer, offset, chunk->data + offset };
+}
+
+// Returns a pointer to write 'size' bytes into, which will end up at dstOffset in dst once the frame is submitted.
+// Returns null (and no copy happens) if the staging memory couldn't be allocated
+void* StagingWrite( StagingBelt* belt, WGPUBuffer dst, u64 dstOffset, u64 size )
+{
+    ASSERT( (dstOffset & 3) == 0 && (size & 3) == 0, "Buffer copies must be 4 byte aligned" );
+
+    StagingAllocation alloc = StagingAlloc( belt, size );
+    if( !alloc.data )
+        return nullptr;
+    belt->pendingCopies.push_back( { alloc.buffer, alloc.offset, dst, dstOffset, size } );
+    return alloc.data;
+}
+
+// Copy a whole block of data in, in slices, so big uploads don't need a single huge chunk
+bool StagingWriteSliced( StagingBelt* belt, WGPUBuffer dst, u64 dstOffset, void const* data, u64 size,
+                         u64 sliceSize = 16 * 1024 * 1024 )
+{
+    for( u64 offset = 0; offset < size; offset += sliceSize )
+    {
+        u64 sliceBytes = Min( sliceSize, size - offset );
+        void* slice = StagingWrite( belt, dst, dstOffset + offset, sliceBytes );
+        if( !slice )
+            return false;
+        COPYP( (u8 const*)data + offset, slice, sliceBytes );
+    }
+    return true;
+}
+
+// Record all pending copies and unmap the chunks used this frame. Call right before finishing the encoder
+void FlushStagingBelt( StagingBelt* belt, WGPUCommandEncoder encoder )
+{
+    for( StagingCopy const& copy : belt->pendingCopies )
+        wgpuCommandEncoderCopyBufferToBuffer( encoder, copy.src, copy.srcOffset, copy.dst, copy.dstOffset, copy.size );
+    belt->pendingCopies.clear();
+
+    for( StagingChunk* chunk : belt->active )
+    {
+        wgpuBufferUnmap( chunk->buffer );
+        chunk->data = nullptr;
+        belt->closed.push_back( chunk );
+    }
+    belt->active.clear();
+}
+
+// Call once the frame's commands have been submitted, to start recycling the chunks they used
+void RecallStagingBelt( StagingBelt* belt )
+{
+    for( StagingChunk* chunk : belt->closed )
+    {
+        if( !chunk->mapRequested )
+        {
+            chunk->mapRequested = true;
+            wgpuBufferMapAsync( chunk->buffer, WGPUMapMode_Write, 0, chunk->size, OnStagingChunkMapped, chunk );
+        }
+    }
+
+    // Pick up any chunks that are ready without blocking
+    PollDevice( false );
+}
+
+void ReleaseStagingBelt( StagingBelt* belt )
+{
+    for( StagingChunk* chunk : belt->active )
+        wgpuBufferUnmap( chunk->buffer );
+    belt->free.insert( belt->free.end(), belt->active.begin(), belt->active.end() );
+    belt->active.clear();
+    belt->pendingCopies.clear();
+
+    RecallStagingBelt( belt );
+    while( !belt->closed.empty() )
+        PollDevice( true );
+
+    for( StagingChunk* chunk : belt->free )
+    {
+        DestroyGPUBuffer( chunk->buffer );
+        DELETE( &globalAlloc, chunk, StagingChunk );
+    }
+    belt->free.clear();
+    belt->totalSize = 0;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+// Staging belt for CPU -> GPU uploads.
+// Callers write straight into persistently mapped MapWrite|CopySrc chunks, and the belt records the copies into
+// the frame's encoder. Once submitted, chunks are mapped again asynchronously and go back to the free list,
+// so steady-state uploads involve no allocations and no extra copy in the driver.
+
+struct StagingBelt;
+
+struct StagingChunk
+{
+    WGPUBuffer buffer;
+    u64 size;
+    u64 used;
+    u8* data;                   // Only valid while mapped
+    bool mapRequested;
+    StagingBelt* belt;
+};
+
+// Space reserved in a chunk. Callers that record their own copies (e.g. into textures) use this directly
+struct StagingAllocation
+{
+    WGPUBuffer buffer;
+    u64 offset;
+    u8* data;
+};
+
+struct StagingCopy
+{
+    WGPUBuffer src;
+    u64 srcOffset;
+    WGPUBuffer dst;
+    u64 dstOffset;
+    u64 size;
+};
+
+struct StagingBelt
+{
+    // Minimum size for new chunks. Bigger requests get a chunk of their own
+    u64 chunkSize = 1024 * 1024;
+    // When we'd go over this, wait for in-flight chunks to come back instead of allocating more
+    u64 maxTotalSize = 768ull * 1024 * 1024;
+    u64 totalSize = 0;
+
+    std::vector<StagingChunk*> active;          // Mapped, being written this frame
+    std::vector<StagingChunk*> closed;          // Submitted, waiting to be mapped again
+    std::vector<StagingChunk*> free;            // Mapped and ready for reuse
+    std::vector<StagingCopy> pendingCopies;
+
+    u64 totalBytesWritten = 0;
+};
+
+
+// Readback ring for GPU -> CPU transfers, the other way round.
+// A few map-read buffers are used in turn: the GPU copies into one, which then gets mapped asynchronously, and once
+// mapped it's handed over to whoever consumes it (possibly another thread), in the order they were submitted. Once
+// they're done with it, it gets unmapped and reused. Only the thread submitting readbacks maps and unmaps buffers,
+// so consumers only ever touch the mapped data and the slot's state.
+
+enum class ReadbackState : u32
+{
+    Free,
+    Mapping,                    // Copied into and waiting to be mapped
+    Mapped,
+    Busy,                       // Handed over to its consumer
+    Done,                       // Consumed, waiting to be unmapped and reused
+};
+
+struct ReadbackSlot
+{
+    WGPUBuffer buffer;
+    std::atomic<ReadbackState> state;
+    u64 index;                  // Order it was submitted in
+    u8 const* data;             // While handed over. Null if mapping failed
+    bool mapFailed;
+    // Region copied into it, for textures
+    u32 width;
+    u32 height;
+};
+
+struct ReadbackRing
+{
+    std::vector<ReadbackSlot*> slots;
+    u64 bufferSize;
+    u32 bytesPerRow;            // Of texture copies, aligned as copies need it
+    u64 submitted;
+    u64 retired;                // Handed over so far, always in order
+};
+
+// Called with slots being handed over, or to block until a consumer is done with one
+using ReadbackFunc = void( ReadbackSlot* slot, void* userdata );
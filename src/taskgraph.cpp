@@ -0,0 +1,312 @@
+
+TaskResources AddTaskResource( TaskGraph* graph, char const* name, bool buffered /*= false*/ )
+{
+    ASSERT( !graph->built, "Task graph already running" );
+    ASSERT( graph->resourceCount < MaxTaskResources, "Too many task resources" );
+
+    int index = graph->resourceCount++;
+    graph->resourceNames[index] = name;
+    TaskResources bit = (TaskResources)1 << index;
+    if( buffered )
+        graph->bufferedResources |= bit;
+    return bit;
+}
+
+// Tasks run in the order they're added whenever they touch the same resources
+u32 AddFrameTask( TaskGraph* graph, char const* name, FrameTaskFunc* func, void* userdata,
+                  TaskResources reads, TaskResources writes, u32 flags /*= FrameTask_None*/ )
+{
+    ASSERT( !graph->built, "Task graph already running" );
+
+    FrameTask task = {};
+    task.name = name;
+    task.func = func;
+    task.userdata = userdata;
+    task.reads = reads;
+    task.writes = writes;
+    task.flags = flags;
+    graph->tasks.push_back( task );
+    return (u32)graph->tasks.size() - 1;
+}
+
+INLINE bool TasksConflict( FrameTask const& first, FrameTask const& second, TaskResources mask )
+{
+    return ((first.writes & (second.reads | second.writes)) | (first.reads & second.writes)) & mask;
+}
+
+void RunFrameTask( Job const& job );
+
+void BuildTaskGraph( TaskGraph* graph )
+{
+    u32 taskCount = (u32)graph->tasks.size();
+    for( u32 j = 0; j < taskCount; ++j )
+    {
+        FrameTask& task = graph->tasks[j];
+        for( u32 i = 0; i < j; ++i )
+        {
+            if( TasksConflict( graph->tasks[i], task, ~(TaskResources)0 ) )
+            {
+                task.predecessors.push_back( i );
+                graph->tasks[i].successors.push_back( j );
+            }
+        }
+
+        // Buffered resources use a different copy each frame. Tasks never overlap with themselves either
+        for( u32 i = 0; i < taskCount; ++i )
+        {
+            if( i == j || TasksConflict( graph->tasks[i], task, ~graph->bufferedResources ) )
+            {
+                graph->tasks[i].nextFrameSuccessors.push_back( j );
+                task.prevFramePredecessorCount++;
+            }
+        }
+    }
+
+    for( u32 f = 0; f < 2; ++f )
+    {
+        FrameInFlight* frame = &graph->frames[f];
+        frame->tasks = new FrameTaskState[taskCount];
+        for( u32 t = 0; t < taskCount; ++t )
+            frame->tasks[t].job = { RunFrameTask, graph, (sz)f, (sz)t, nullptr };
+        frame->pendingTasks = 0;
+        frame->launched = false;
+    }
+
+    graph->built = true;
+}
+
+void QueueFrameTask( TaskGraph* graph, u32 taskIndex, FrameTaskState* state )
+{
+    bool mainThread = graph->tasks[taskIndex].flags & FrameTask_MainThread;
+#ifdef WEBGPU_BACKEND_DAWN
+    // Dawn's C API isn't thread safe for us (yet)
+    mainThread = true;
+#endif
+
+    if( mainThread )
+    {
+        std::lock_guard<std::mutex> lock( graph->mainThreadMutex );
+        graph->mainThreadJobs.push_back( &state->job );
+    }
+    else
+        SubmitJobs( &state->job, 1, nullptr, graph->jobSystem );
+}
+
+INLINE void ReleaseFrameTask( TaskGraph* graph, u32 slot, u32 taskIndex )
+{
+    FrameTaskState* state = &graph->frames[slot].tasks[taskIndex];
+    if( state->remaining.fetch_sub( 1, std::memory_order_acq_rel ) == 1 )
+        QueueFrameTask( graph, taskIndex, state );
+}
+
+void RunFrameTask( Job const& job )
+{
+    TaskGraph* graph = (TaskGraph*)job.data;
+    u32 slot = (u32)job.begin;
+    u32 taskIndex = (u32)job.end;
+    FrameInFlight* frame = &graph->frames[slot];
+    FrameTask const& task = graph->tasks[taskIndex];
+    FrameTaskState* state = &frame->tasks[taskIndex];
+
+    state->startMillis = Platform::CurrentTimeMillis();
+    task.func( task.userdata, frame->frameIndex );
+    state->endMillis = Platform::CurrentTimeMillis();
+
+    for( u32 s : task.successors )
+        ReleaseFrameTask( graph, slot, s );
+    // If the next frame already launched it's up to us to let it know, otherwise it'll find out when it does
+    if( state->handoff.fetch_or( 1, std::memory_order_acq_rel ) & 2 )
+    {
+        for( u32 s : task.nextFrameSuccessors )
+            ReleaseFrameTask( graph, slot ^ 1, s );
+    }
+
+    frame->pendingTasks.fetch_sub( 1, std::memory_order_release );
+}
+
+void LaunchFrame( TaskGraph* graph )
+{
+    u64 frameIndex = graph->nextFrameIndex++;
+    u32 slot = (u32)(frameIndex & 1);
+    FrameInFlight* frame = &graph->frames[slot];
+    FrameInFlight* prevFrame = &graph->frames[slot ^ 1];
+    ASSERT( !frame->launched, "Frame slot still in use" );
+
+    u32 taskCount = (u32)graph->tasks.size();
+    // Only still running frames hold anything back
+    bool prevRunning = prevFrame->launched;
+    for( u32 t = 0; t < taskCount; ++t )
+    {
+        FrameTask const& task = graph->tasks[t];
+        frame->tasks[t].remaining = 1 + (i32)task.predecessors.size() + (prevRunning ? task.prevFramePredecessorCount : 0);
+        frame->tasks[t].handoff = 0;
+        frame->tasks[t].startMillis = 0;
+        frame->tasks[t].endMillis = 0;
+    }
+    frame->pendingTasks = (i32)taskCount;
+    frame->frameIndex = frameIndex;
+    frame->launchMillis = Platform::CurrentTimeMillis();
+    frame->launched = true;
+
+    if( prevRunning )
+    {
+        for( u32 i = 0; i < taskCount; ++i )
+        {
+            if( prevFrame->tasks[i].handoff.fetch_or( 2, std::memory_order_acq_rel ) & 1 )
+            {
+                for( u32 s : graph->tasks[i].nextFrameSuccessors )
+                    ReleaseFrameTask( graph, slot, s );
+            }
+        }
+    }
+
+    // Drop the launch reference, which starts everything that isn't waiting on anything else
+    for( u32 t = 0; t < taskCount; ++t )
+        ReleaseFrameTask( graph, slot, t );
+}
+
+bool RunMainThreadTask( TaskGraph* graph )
+{
+    Job* job = nullptr;
+    {
+        std::lock_guard<std::mutex> lock( graph->mainThreadMutex );
+        if( !graph->mainThreadJobs.empty() )
+        {
+            job = graph->mainThreadJobs.front();
+            graph->mainThreadJobs.pop_front();
+        }
+    }
+
+    if( job )
+        RunJob( job, graph->jobSystem );
+    return job != nullptr;
+}
+
+// Work back from the task that ended last, always through the predecessor that ended last
+void RecordCriticalPath( TaskGraph* graph, FrameInFlight const* frame )
+{
+    u32 taskCount = (u32)graph->tasks.size();
+    if( !taskCount )
+        return;
+
+    u32 last = 0;
+    for( u32 t = 1; t < taskCount; ++t )
+        if( frame->tasks[t].endMillis > frame->tasks[last].endMillis )
+            last = t;
+
+    graph->criticalPath.clear();
+    for( u32 t = last; ; )
+    {
+        graph->criticalPath.push_back( t );
+        std::vector<u32> const& predecessors = graph->tasks[t].predecessors;
+        if( predecessors.empty() )
+            break;
+
+        u32 next = predecessors[0];
+        for( u32 p : predecessors )
+            if( frame->tasks[p].endMillis > frame->tasks[next].endMillis )
+                next = p;
+        t = next;
+    }
+    std::reverse( graph->criticalPath.begin(), graph->criticalPath.end() );
+
+    graph->criticalPathMillis = frame->tasks[last].endMillis - frame->launchMillis;
+    graph->criticalPathFrame = frame->frameIndex;
+
+    if( graph->criticalPathLog )
+    {
+        // Time before the first task could start is spent waiting on the previous frame
+        FrameTaskState const& first = frame->tasks[graph->criticalPath[0]];
+        fprintf( graph->criticalPathLog, "%llu,%.3f,%.3f,", (unsigned long long)frame->frameIndex,
+                 graph->criticalPathMillis, first.startMillis - frame->launchMillis );
+        for( sz i = 0; i < graph->criticalPath.size(); ++i )
+        {
+            u32 t = graph->criticalPath[i];
+            fprintf( graph->criticalPathLog, "%s%s %.3f", i ? " > " : "", graph->tasks[t].name,
+                     frame->tasks[t].endMillis - frame->tasks[t].startMillis );
+        }
+        fprintf( graph->criticalPathLog, "\n" );
+    }
+}
+
+// Run main thread tasks and help with any other jobs until the frame is done
+void WaitForFrame( TaskGraph* graph, FrameInFlight* frame )
+{
+    JobSystem* js = graph->jobSystem;
+    while( frame->pendingTasks.load( std::memory_order_acquire ) > 0 )
+    {
+        if( RunMainThreadTask( graph ) )
+            continue;
+        if( Job* job = js->running ? FindJob( js ) : nullptr )
+            RunJob( job, js );
+        else
+            _mm_pause();
+    }
+
+    RecordCriticalPath( graph, frame );
+    frame->launched = false;
+}
+
+bool OpenCriticalPathLog( TaskGraph* graph, char const* path )
+{
+    graph->criticalPathLog = fopen( path, "w" );
+    if( !graph->criticalPathLog )
+    {
+        Log( "ERROR :: Could not open '%s' for writing", path );
+        return false;
+    }
+
+    fprintf( graph->criticalPathLog, "frame,critical path ms,wait ms,tasks\n" );
+    return true;
+}
+
+// Launch the next frame, once the one two frames back is done (running main thread tasks in the meantime).
+// The frame just launched and the one before it may still be running on return
+void RunFrameTasks( TaskGraph* graph, JobSystem* js /*= &globalJobSystem*/ )
+{
+    if( !graph->built )
+    {
+        graph->jobSystem = js;
+        BuildTaskGraph( graph );
+    }
+
+    FrameInFlight* frame = &graph->frames[graph->nextFrameIndex & 1];
+    if( frame->launched )
+        WaitForFrame( graph, frame );
+
+    LaunchFrame( graph );
+}
+
+// Wait for all frames in flight, oldest first
+void FinishFrameTasks( TaskGraph* graph )
+{
+    if( !graph->built )
+        return;
+
+    for( u64 i = 0; i < 2; ++i )
+    {
+        FrameInFlight* frame = &graph->frames[(graph->nextFrameIndex + i) & 1];
+        if( frame->launched )
+            WaitForFrame( graph, frame );
+    }
+}
+
+void ReleaseTaskGraph( TaskGraph* graph )
+{
+    FinishFrameTasks( graph );
+    for( FrameInFlight& frame : graph->frames )
+    {
+        delete[] frame.tasks;
+        frame.tasks = nullptr;
+    }
+    if( graph->criticalPathLog )
+        fclose( graph->criticalPathLog );
+
+    graph->tasks.clear();
+    graph->mainThreadJobs.clear();
+    graph->criticalPathLog = nullptr;
+    graph->bufferedResources = 0;
+    graph->resourceCount = 0;
+    graph->nextFrameIndex = 0;
+    graph->built = false;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+// Per-frame task graph
+// Subsystems register their per-frame tasks once, each with the resources it reads and writes (just names, standing
+// for whatever state they share), and the order between tasks falls out of those: a task waits for every earlier task
+// that writes something it touches or reads something it writes. Anything else runs concurrently on the job system.
+// The same rules hold between consecutive frames, so the next frame gets going as soon as nothing it touches is still
+// in use by the previous one, with at most two frames in flight. Buffered resources keep one copy per frame in flight
+// (picked by frame parity), so they never hold the next frame back.
+// Each frame's critical path (the chain of tasks that decided how long it took) is kept for analysis.
+
+using FrameTaskFunc = void( void* userdata, u64 frameIndex );
+
+// Bits for naming a set of resources. Up to 64 of them
+using TaskResources = u64;
+constexpr int MaxTaskResources = 64;
+
+enum FrameTaskFlags : u32
+{
+    FrameTask_None          = 0,
+    // Must run on the thread driving the graph (windowing, presenting..)
+    FrameTask_MainThread    = 0x1,
+};
+
+struct FrameTask
+{
+    char const* name;
+    FrameTaskFunc* func;
+    void* userdata;
+    TaskResources reads;
+    TaskResources writes;
+    u32 flags;
+
+    // Worked out from the resources when the graph is built
+    std::vector<u32> predecessors;                  // Earlier tasks in the same frame
+    std::vector<u32> successors;                    // Later tasks in the same frame
+    std::vector<u32> nextFrameSuccessors;           // Tasks in the next frame that wait for this one
+    i32 prevFramePredecessorCount;
+};
+
+// State of a task within one frame in flight
+struct FrameTaskState
+{
+    std::atomic<i32> remaining;                     // Predecessors still running, plus one until the frame launches
+    // Whether the task finished (1) and the next frame launched (2), so exactly one of both notifies the next frame
+    std::atomic<u32> handoff;
+    f64 startMillis;
+    f64 endMillis;
+    Job job;
+};
+
+struct FrameInFlight
+{
+    FrameTaskState* tasks;
+    std::atomic<i32> pendingTasks;
+    u64 frameIndex;
+    f64 launchMillis;
+    bool launched;
+};
+
+struct TaskGraph
+{
+    std::vector<FrameTask> tasks;
+    char const* resourceNames[MaxTaskResources];
+    TaskResources bufferedResources;
+    int resourceCount;
+    bool built;
+
+    // Indexed by frame parity
+    FrameInFlight frames[2];
+    u64 nextFrameIndex;
+    JobSystem* jobSystem;
+
+    // Ready tasks flagged as FrameTask_MainThread
+    std::mutex mainThreadMutex;
+    std::deque<Job*> mainThreadJobs;
+
+    // Critical path of the last finished frame, from its launch to its last task ending
+    std::vector<u32> criticalPath;
+    f64 criticalPathMillis;
+    u64 criticalPathFrame;
+    // When set, every frame's critical path gets appended here as a CSV line
+    FILE* criticalPathLog;
+};
+
+TaskResources AddTaskResource( TaskGraph* graph, char const* name, bool buffered = false );
+u32 AddFrameTask( TaskGraph* graph, char const* name, FrameTaskFunc* func, void* userdata,
+                  TaskResources reads, TaskResources writes, u32 flags = FrameTask_None );
+bool OpenCriticalPathLog( TaskGraph* graph, char const* path );
+void RunFrameTasks( TaskGraph* graph, JobSystem* js = &globalJobSystem );
+void FinishFrameTasks( TaskGraph* graph );
+void ReleaseTaskGraph( TaskGraph* graph );
@@ -0,0 +1,577 @@
+
+/////     SOURCE IMAGES    /////
+
+// Load an uncompressed or RLE truecolor TGA image as top-down RGBA8
+bool LoadTGA( char const* path, std::vector<u8>* outPixels, u32* outWidth, u32* outHeight )
+{
+    Buffer<> file = Platform::ReadEntireFile( path, &globalAlloc );
+    if( !file )
+        return false;
+
+    bool result = false;
+    u8 const* header = file.data;
+    if( file.length >= 18 )
+    {
+        u32 imageType = header[2];
+        u32 width = header[12] | (header[13] << 8);
+        u32 height = header[14] | (header[15] << 8);
+        u32 bytesPerPixel = header[16] / 8;
+        bool topDown = (header[17] & 0x20) != 0;
+
+        if( (imageType == 2 || imageType == 10) && (bytesPerPixel == 3 || bytesPerPixel == 4) && width && height )
+        {
+            outPixels->resize( (sz)width * height * 4 );
+            u8* dst = outPixels->data();
+            u8 const* src = file.data + 18 + header[0];
+            u8 const* srcEnd = file.data + file.length;
+
+            sz pixelCount = (sz)width * height;
+            sz p = 0;
+            while( p < pixelCount && src < srcEnd )
+            {
+                // Uncompressed images are just one long raw packet
+                sz runLength = pixelCount - p;
+                bool repeat = false;
+                if( imageType == 10 )
+                {
+                    runLength = (*src & 0x7F) + 1;
+                    repeat = (*src & 0x80) != 0;
+                    src++;
+                }
+
+                for( sz i = 0; i < runLength && p < pixelCount; ++i, ++p )
+                {
+                    if( src + bytesPerPixel > srcEnd )
+                        break;
+
+                    // BGR(A) to RGBA
+                    u8* out = dst + p * 4;
+                    out[0] = src[2];
+                    out[1] = src[1];
+                    out[2] = src[0];
+                    out[3] = bytesPerPixel == 4 ? src[3] : 255;
+
+                    if( !repeat || i == runLength - 1 )
+                        src += bytesPerPixel;
+                }
+            }
+
+            if( !topDown )
+            {
+                std::vector<u8> row( width * 4 );
+                for( u32 y = 0; y < height / 2; ++y )
+                {
+                    u8* a = dst + (sz)y * width * 4;
+                    u8* b = dst + (sz)(height - 1 - y) * width * 4;
+                    COPYP( a, row.data(), width * 4 );
+                    COPYP( b, a, width * 4 );
+                    COPYP( row.data(), b, width * 4 );
+                }
+            }
+
+            *outWidth = width;
+            *outHeight = height;
+            result = p == pixelCount;
+        }
+
+        if( !result )
+            Log( "ERROR :: Unsupported or corrupt TGA file '%s'", path );
+    }
+
+    FREE( &globalAlloc, file.data );
+    return result;
+}
+
+
+/////     MIP GENERATION    /////
+
+INLINE f32 SRGBToLinear( f32 c )
+{
+    return c <= 0.04045f ? c / 12.92f : powf( (c + 0.055f) / 1.055f, 2.4f );
+}
+
+INLINE f32 LinearToSRGB( f32 c )
+{
+    return c <= 0.0031308f ? c * 12.92f : 1.055f * powf( c, 1.f / 2.4f ) - 0.055f;
+}
+
+INLINE u32 MipDimension( u32 size, u32 mip )
+{
+    return Max( size >> mip, 1u );
+}
+
+INLINE u32 MipCountForSize( u32 width, u32 height )
+{
+    u32 count = 1;
+    while( (width | height) >> count )
+        count++;
+    return count;
+}
+
+struct SRGBToLinearTable
+{
+    f32 values[256];
+
+    SRGBToLinearTable()
+    {
+        for( int i = 0; i < 256; ++i )
+            values[i] = SRGBToLinear( i / 255.f );
+    }
+};
+
+// Box-filter the next mip level of an RGBA8 image. Odd source sizes just clamp at the last row / column.
+// sRGB colour channels are averaged in linear space
+void DownsampleRGBA8( u8 const* src, u32 srcWidth, u32 srcHeight, u32 srcPitch,
+                      u8* dst, u32 dstWidth, u32 dstHeight, u32 dstPitch, bool srgb )
+{
+    // Built by the first caller. Static initialization is thread-safe, so concurrent cooks can call this freely
+    static SRGBToLinearTable const srgbToLinear;
+
+    for( u32 y = 0; y < dstHeight; ++y )
+    {
+        u8 const* row0 = src + (sz)Min( y * 2, srcHeight - 1 ) * srcPitch;
+        u8 const* row1 = src + (sz)Min( y * 2 + 1, srcHeight - 1 ) * srcPitch;
+        u8* out = dst + (sz)y * dstPitch;
+
+        for( u32 x = 0; x < dstWidth; ++x )
+        {
+            u32 x0 = Min( x * 2, srcWidth - 1 ) * 4;
+            u32 x1 = Min( x * 2 + 1, srcWidth - 1 ) * 4;
+            u8 const* texels[4] = { row0 + x0, row0 + x1, row1 + x0, row1 + x1 };
+
+            for( int c = 0; c < 4; ++c )
+            {
+                f32 sum = 0;
+                if( srgb && c < 3 )
+                {
+                    for( u8 const* t : texels )
+                        sum += srgbToLinear.values[t[c]];
+                    out[x * 4 + c] = (u8)Round( LinearToSRGB( sum * 0.25f ) * 255.f );
+                }
+                else
+                {
+                    for( u8 const* t : texels )
+                        sum += t[c];
+                    out[x * 4 + c] = (u8)Round( sum * 0.25f );
+                }
+            }
+        }
+    }
+}
+
+
+/////     COOKED TEXTURES    /////
+
+INLINE WGPUTextureFormat ToWGPUTextureFormat( TextureFileFormat format )
+{
+    switch( format )
+    {
+        case TextureFileFormat::RGBA8Unorm: return WGPUTextureFormat_RGBA8Unorm;
+        case TextureFileFormat::RGBA8UnormSrgb: return WGPUTextureFormat_RGBA8UnormSrgb;
+    }
+    return WGPUTextureFormat_Undefined;
+}
+
+INLINE bool IsSRGBFormat( WGPUTextureFormat format )
+{
+    return format == WGPUTextureFormat_RGBA8UnormSrgb || format == WGPUTextureFormat_BGRA8UnormSrgb;
+}
+
+// Storage textures can't be sRGB, so anything writing to one through a storage binding needs a linear view
+INLINE WGPUTextureFormat LinearFormat( WGPUTextureFormat format )
+{
+    switch( format )
+    {
+        case WGPUTextureFormat_RGBA8UnormSrgb: return WGPUTextureFormat_RGBA8Unorm;
+        case WGPUTextureFormat_BGRA8UnormSrgb: return WGPUTextureFormat_BGRA8Unorm;
+        default: return format;
+    }
+}
+
+// Create a view of a range of mips, optionally reinterpreting the texture with a compatible format
+WGPUTextureView CreateTextureView( Texture const& texture, u32 baseMip, u32 mipCount,
+                                   WGPUTextureFormat format = WGPUTextureFormat_Undefined )
+{
+    WGPUTextureViewDescriptor viewDesc = {};
+    viewDesc.nextInChain               = nullptr;
+    viewDesc.label                     = nullptr;
+    viewDesc.format                    = format != WGPUTextureFormat_Undefined ? format : texture.format;
+    viewDesc.dimension                 = WGPUTextureViewDimension_2D;
+    viewDesc.baseMipLevel              = baseMip;
+    viewDesc.mipLevelCount             = mipCount;
+    viewDesc.baseArrayLayer            = 0;
+    viewDesc.arrayLayerCount           = 1;
+    viewDesc.aspect                    = WGPUTextureAspect_All;
+    return wgpuTextureCreateView( texture.texture, &viewDesc );
+}
+
+// Create a 2D texture plus a view of all its mips. Pass a mipCount of 0 for a full mip chain.
+// sRGB textures also allow views with their linear format, so their mips can be generated with GenerateMips
+bool CreateTexture( Texture* out, char const* label, u32 width, u32 height, u32 mipCount,
+                    WGPUTextureFormat format, WGPUTextureUsageFlags usage )
+{
+    *out = {};
+    out->format = format;
+    out->usage = usage;
+    out->width = width;
+    out->height = height;
+    out->mipCount = mipCount ? mipCount : MipCountForSize( width, height );
+
+    WGPUTextureFormat linearFormat = LinearFormat( format );
+
+    WGPUTextureDescriptor textureDesc = {};
+    textureDesc.nextInChain           = nullptr;
+    textureDesc.label                 = label;
+    textureDesc.usage                 = usage;
+    textureDesc.dimension             = WGPUTextureDimension_2D;
+    textureDesc.size                  = { width, height, 1 };
+    textureDesc.format                = format;
+    textureDesc.mipLevelCount         = out->mipCount;
+    textureDesc.sampleCount           = 1;
+    textureDesc.viewFormatCount       = linearFormat != format ? 1 : 0;
+    textureDesc.viewFormats           = linearFormat != format ? &linearFormat : nullptr;
+    out->texture = CreateGPUTexture( &textureDesc );
+    if( !out->texture )
+        return false;
+
+    out->view = CreateTextureView( *out, 0, out->mipCount );
+    return true;
+}
+
+// Copy a mip back to the CPU, tightly packed. Blocks until the GPU is done with everything submitted so far
+bool ReadbackTexture( Texture const& texture, u32 mip, std::vector<u8>* out )
+{
+    ASSERT( texture.usage & WGPUTextureUsage_CopySrc, "Texture can't be read back" );
+
+    u32 width = MipDimension( texture.width, mip );
+    u32 height = MipDimension( texture.height, mip );
+    u32 rowSize = width * BytesPerTexel( texture.format );
+    u32 bytesPerRow = AlignUp( rowSize, TextureRowPitchAlignment );
+
+    WGPUBufferDescriptor bufferDesc = {};
+    bufferDesc.nextInChain          = nullptr;
+    bufferDesc.label                = "Texture readback";
+    bufferDesc.usage                = WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst;
+    bufferDesc.size                 = (u64)bytesPerRow * height;
+    bufferDesc.mappedAtCreation     = false;
+    WGPUBuffer buffer = CreateGPUBuffer( &bufferDesc );
+    if( !buffer )
+        return false;
+
+    WGPUCommandEncoderDescriptor encoderDesc = {};
+    encoderDesc.nextInChain                  = nullptr;
+    encoderDesc.label                        = "Texture readback";
+    WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder( globalDevice, &encoderDesc );
+
+    WGPUImageCopyTexture src = {};
+    src.texture = texture.texture;
+    src.mipLevel = mip;
+    src.origin = { 0, 0, 0 };
+    src.aspect = WGPUTextureAspect_All;
+
+    WGPUImageCopyBuffer dst = {};
+    dst.buffer = buffer;
+    dst.layout.offset = 0;
+    dst.layout.bytesPerRow = bytesPerRow;
+    dst.layout.rowsPerImage = height;
+
+    WGPUExtent3D extent = { width, height, 1 };
+    wgpuCommandEncoderCopyTextureToBuffer( encoder, &src, &dst, &extent );
+
+    WGPUCommandBufferDescriptor cmdBufferDescriptor = {};
+    cmdBufferDescriptor.nextInChain                 = nullptr;
+    cmdBufferDescriptor.label                       = "Texture readback";
+    WGPUCommandBuffer command = wgpuCommandEncoderFinish( encoder, &cmdBufferDescriptor );
+    wgpuQueueSubmit( globalQueue, 1, &command );
+#ifdef WEBGPU_BACKEND_DAWN
+    wgpuCommandEncoderRelease( encoder );
+    wgpuCommandBufferRelease( command );
+#endif
+
+    struct MapResult
+    {
+        bool done;
+        bool success;
+    } result = {};
+    auto onMapped = []( WGPUBufferMapAsyncStatus status, void* pUserData )
+    {
+        MapResult* result = (MapResult*)pUserData;
+        result->success = status == WGPUBufferMapAsyncStatus_Success;
+        result->done = true;
+    };
+    wgpuBufferMapAsync( buffer, WGPUMapMode_Read, 0, bufferDesc.size, onMapped, &result );
+    while( !result.done )
+        PollDevice( true );
+
+    if( result.success )
+    {
+        u8 const* data = (u8 const*)wgpuBufferGetConstMappedRange( buffer, 0, bufferDesc.size );
+        out->resize( (sz)rowSize * height );
+        for( u32 y = 0; y < height; ++y )
+            COPYP( data + (sz)y * bytesPerRow, out->data() + (sz)y * rowSize, rowSize );
+        wgpuBufferUnmap( buffer );
+    }
+
+    DestroyGPUBuffer( buffer );
+    return result.success;
+}
+
+// Generate the full mip chain for an RGBA8 image and write it in GPU upload layout
+bool CookTexture( u8 const* pixels, u32 width, u32 height, bool srgb, char const* outPath )
+{
+    TextureFileHeader header = {};
+    header.magic = TextureFileMagic;
+    header.version = TextureFileVersion;
+    header.format = srgb ? TextureFileFormat::RGBA8UnormSrgb : TextureFileFormat::RGBA8Unorm;
+    header.width = width;
+    header.height = height;
+    header.mipCount = Min<u32>( MipCountForSize( width, height ), MaxTextureMips );
+
+    u64 offset = AlignUp<u64>( sizeof(TextureFileHeader), TextureFileDataAlignment );
+    for( u32 m = 0; m < header.mipCount; ++m )
+    {
+        TextureFileMip& mip = header.mips[m];
+        mip.width = MipDimension( width, m );
+        mip.height = MipDimension( height, m );
+        mip.bytesPerRow = AlignUp( mip.width * 4, TextureRowPitchAlignment );
+        mip.dataOffset = offset;
+        mip.dataSize = (u64)mip.bytesPerRow * mip.height;
+        offset = AlignUp<u64>( offset + mip.dataSize, TextureFileDataAlignment );
+    }
+
+    std::vector<u8> fileData( offset );
+    COPYP( &header, fileData.data(), sizeof(header) );
+
+    TextureFileMip const& top = header.mips[0];
+    for( u32 y = 0; y < height; ++y )
+        COPYP( pixels + (sz)y * width * 4, fileData.data() + top.dataOffset + (sz)y * top.bytesPerRow, width * 4 );
+
+    for( u32 m = 1; m < header.mipCount; ++m )
+    {
+        TextureFileMip const& src = header.mips[m - 1];
+        TextureFileMip const& dst = header.mips[m];
+        DownsampleRGBA8( fileData.data() + src.dataOffset, src.width, src.height, src.bytesPerRow,
+                         fileData.data() + dst.dataOffset, dst.width, dst.height, dst.bytesPerRow, srgb );
+    }
+
+    return Platform::WriteEntireFile( outPath, fileData.data(), (sz)fileData.size() );
+}
+
+// Create the texture and queue all of its mips for streaming. The file stays mapped until everything is uploaded
+bool LoadCookedTexture( char const* path, Texture* out, TextureStreamer* streamer = &globalTextureStreamer )
+{
+    StreamedTextureFile* source = NEW( &globalAlloc, StreamedTextureFile );
+    source->refCount = 0;
+    if( !Platform::MapFile( path, &source->file ) )
+    {
+        DELETE( &globalAlloc, source, StreamedTextureFile );
+        return false;
+    }
+
+    MappedFile const& file = source->file;
+    TextureFileHeader const* header = (TextureFileHeader const*)file.data;
+    bool valid = (u64)file.size >= sizeof(TextureFileHeader)
+        && header->magic == TextureFileMagic
+        && header->version == TextureFileVersion
+        && header->mipCount > 0 && header->mipCount <= MaxTextureMips;
+    for( u32 m = 0; valid && m < header->mipCount; ++m )
+        valid = header->mips[m].dataOffset + header->mips[m].dataSize <= (u64)file.size;
+
+    if( !valid )
+    {
+        Log( "ERROR :: Invalid or outdated cooked texture '%s'", path );
+        Platform::UnmapFile( &source->file );
+        DELETE( &globalAlloc, source, StreamedTextureFile );
+        return false;
+    }
+
+    // Mips are copied out of the mapping a few at a time over the next frames, so make sure they're in memory by then
+    Platform::PrefetchFile( file );
+
+    if( !CreateTexture( out, path, header->width, header->height, header->mipCount, ToWGPUTextureFormat( header->format ),
+                        WGPUTextureUsage_TextureBinding | WGPUTextureUsage_CopyDst ) )
+    {
+        Platform::UnmapFile( &source->file );
+        DELETE( &globalAlloc, source, StreamedTextureFile );
+        return false;
+    }
+
+    // Queue smallest mips first, so there's something reasonable to sample as soon as possible
+    for( int m = (int)header->mipCount - 1; m >= 0; --m )
+    {
+        streamer->pending.push_back( { out, source, (u32)m, 0, header->mips[m].height } );
+        out->pendingUploads++;
+        source->refCount++;
+    }
+
+    return true;
+}
+
+// Colour and linear cooks of the same source are different files, since their texel data is interpreted differently
+void GetCookedTexturePath( char const* sourcePath, bool srgb, char* outPath, int outPathLength )
+{
+    char const* lastSlash = strrchr( sourcePath, '/' );
+    char const* name = lastSlash ? lastSlash + 1 : sourcePath;
+    char const* ext = strrchr( name, '.' );
+    int nameLength = ext ? (int)(ext - name) : (int)strlen( name );
+
+    // The name alone would make sources with the same name in different folders share (and keep re-cooking) one file
+    u64 pathHash = HashBytes64( sourcePath, (sz)strlen( sourcePath ) );
+    snprintf( outPath, outPathLength, "%s/%.*s-%016llx%s.tex", TextureCacheDir, nameLength, name, pathHash,
+              srgb ? "" : "-linear" );
+}
+
+// Load a texture through the cache, cooking it first if the cooked version is missing or older than the source
+bool LoadTexture( char const* sourcePath, bool srgb, Texture* out, TextureStreamer* streamer = &globalTextureStreamer )
+{
+    char cookedPath[256];
+    GetCookedTexturePath( sourcePath, srgb, cookedPath, sizeof(cookedPath) );
+
+    u64 sourceTime = Platform::GetFileModificationTime( sourcePath );
+    u64 cookedTime = Platform::GetFileModificationTime( cookedPath );
+    if( !cookedTime || cookedTime < sourceTime )
+    {
+        std::vector<u8> pixels;
+        u32 width, height;
+        if( !LoadTGA( sourcePath, &pixels, &width, &height ) )
+            return false;
+
+        Log( "Cooking texture '%s' into '%s'..", sourcePath, cookedPath );
+        Platform::EnsureDirectoryExists( TextureCacheDir );
+        if( !CookTexture( pixels.data(), width, height, srgb, cookedPath ) )
+            return false;
+    }
+
+    return LoadCookedTexture( cookedPath, out, streamer );
+}
+
+void ReleaseTexture( Texture* texture )
+{
+    ASSERT( texture->pendingUploads == 0, "Releasing a texture that's still being streamed in" );
+
+    if( texture->view )
+        wgpuTextureViewRelease( texture->view );
+    DestroyGPUTexture( texture->texture );
+
+    *texture = {};
+}
+
+// Bind a texture as iChannel<channel> in the shader of the given pass (a buffer index or MainPass)
+void SetProgramTexture( Program* program, int channel, Texture const& texture, int pass = MainPass )
+{
+    *GetPassChannel( program, pass, channel ) = { ChannelType::Texture, texture.view, 0, false };
+}
+
+
+/////     STREAMING    /////
+
+// Record copies for as many pending regions as fit in this frame's budget. Mips that don't fit whole are split by rows.
+// Returns the number of bytes recorded
+u64 StreamTextureUploads( TextureStreamer* streamer, StagingBelt* belt, WGPUCommandEncoder encoder )
+{
+    struct Batch
+    {
+        TextureUpload upload;
+        u64 stagingOffset;
+        bool lastForRegion;
+    };
+    std::vector<Batch> batches;
+    u64 totalSize = 0;
+
+    while( !streamer->pending.empty() && totalSize < streamer->budgetPerFrame )
+    {
+        TextureUpload& upload = streamer->pending.front();
+        TextureFileHeader const* header = (TextureFileHeader const*)upload.source->file.data;
+        u32 bytesPerRow = header->mips[upload.mip].bytesPerRow;
+
+        u32 rowsThatFit = (u32)((streamer->budgetPerFrame - totalSize) / bytesPerRow);
+        if( rowsThatFit == 0 )
+        {
+            // Always make some progress, even with a tiny budget
+            if( totalSize )
+                break;
+            rowsThatFit = 1;
+        }
+
+        Batch batch = { upload, totalSize, false };
+        batch.upload.rowCount = Min( upload.rowCount, rowsThatFit );
+        batch.lastForRegion = batch.upload.rowCount == upload.rowCount;
+        totalSize += (u64)batch.upload.rowCount * bytesPerRow;
+        batches.push_back( batch );
+
+        if( batch.lastForRegion )
+            streamer->pending.pop_front();
+        else
+        {
+            upload.firstRow += batch.upload.rowCount;
+            upload.rowCount -= batch.upload.rowCount;
+        }
+    }
+
+    if( batches.empty() )
+        return 0;
+
+    // Rows are already in upload layout, so the whole batch is one contiguous copy per region
+    StagingAllocation staging = StagingAlloc( belt, totalSize );
+    if( !staging.data )
+    {
+        // Put everything back in order, to try again next frame. Only the last batch can be part of a region
+        for( auto it = batches.rbegin(); it != batches.rend(); ++it )
+        {
+            if( it->lastForRegion )
+                streamer->pending.push_front( it->upload );
+            else
+            {
+                streamer->pending.front().firstRow = it->upload.firstRow;
+                streamer->pending.front().rowCount += it->upload.rowCount;
+            }
+        }
+        return 0;
+    }
+
+    for( Batch const& batch : batches )
+    {
+        TextureUpload const& upload = batch.upload;
+        TextureFileHeader const* header = (TextureFileHeader const*)upload.source->file.data;
+        TextureFileMip const& mip = header->mips[upload.mip];
+
+        COPYP( upload.source->file.data + mip.dataOffset + (u64)upload.firstRow * mip.bytesPerRow,
+               staging.data + batch.stagingOffset, (u64)upload.rowCount * mip.bytesPerRow );
+    }
+
+    for( Batch const& batch : batches )
+    {
+        TextureUpload const& upload = batch.upload;
+        TextureFileHeader const* header = (TextureFileHeader const*)upload.source->file.data;
+        TextureFileMip const& mip = header->mips[upload.mip];
+
+        WGPUImageCopyBuffer src = {};
+        src.buffer = staging.buffer;
+        src.layout.offset = staging.offset + batch.stagingOffset;
+        src.layout.bytesPerRow = mip.bytesPerRow;
+        src.layout.rowsPerImage = upload.rowCount;
+
+        WGPUImageCopyTexture dst = {};
+        dst.texture = upload.texture->texture;
+        dst.mipLevel = upload.mip;
+        dst.origin = { 0, upload.firstRow, 0 };
+        dst.aspect = WGPUTextureAspect_All;
+
+        WGPUExtent3D extent = { mip.width, upload.rowCount, 1 };
+        wgpuCommandEncoderCopyBufferToTexture( encoder, &src, &dst, &extent );
+
+        if( batch.lastForRegion )
+        {
+            upload.texture->pendingUploads--;
+            if( --upload.source->refCount == 0 )
+            {
+                StreamedTextureFile* source = upload.source;
+                Platform::UnmapFile( &source->file );
+                DELETE( &globalAlloc, source, StreamedTextureFile );
+            }
+        }
+    }
+
+    streamer->totalBytesUploaded += totalSize;
+    return totalSize;
+}
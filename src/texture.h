@@ -0,0 +1,98 @@
+#pragma once
+
+// Cooked texture format (.tex)
+// Holds the full mip chain, with each level already laid out as expected by copyBufferToTexture
+// (rows padded to a 256 byte pitch), so uploading is just a copy from the mapped file into a staging buffer.
+
+constexpr u32 TextureFileMagic = 0x52584554;    // 'TEXR'
+constexpr u32 TextureFileVersion = 1;
+constexpr int MaxTextureMips = 16;
+constexpr u32 TextureRowPitchAlignment = 256;
+constexpr u64 TextureFileDataAlignment = 256;
+constexpr char const* TextureCacheDir = "cache";
+
+// NOTE We don't store WGPU enums directly, since their values differ between backends
+enum class TextureFileFormat : u32
+{
+    RGBA8Unorm,
+    RGBA8UnormSrgb,
+};
+
+struct TextureFileMip
+{
+    u32 width;
+    u32 height;
+    u32 bytesPerRow;
+    u32 _pad;
+    u64 dataOffset;             // From the start of the file
+    u64 dataSize;
+};
+
+struct TextureFileHeader
+{
+    u32 magic;
+    u32 version;
+    TextureFileFormat format;
+    u32 width;
+    u32 height;
+    u32 mipCount;
+    TextureFileMip mips[MaxTextureMips];
+};
+static_assert( sizeof(TextureFileHeader) % 8 == 0 );
+
+INLINE u32 BytesPerTexel( WGPUTextureFormat format )
+{
+    switch( format )
+    {
+        case WGPUTextureFormat_RGBA8Unorm:
+        case WGPUTextureFormat_RGBA8UnormSrgb:
+        case WGPUTextureFormat_BGRA8Unorm:
+        case WGPUTextureFormat_BGRA8UnormSrgb:
+            return 4;
+        case WGPUTextureFormat_RGBA16Float:
+            return 8;
+        case WGPUTextureFormat_RGBA32Float:
+            return 16;
+        default:
+            ASSERT( false, "Unsupported texture format" );
+    }
+    return 0;
+}
+
+struct Texture
+{
+    WGPUTexture texture;
+    WGPUTextureView view;
+    WGPUTextureFormat format;
+    WGPUTextureUsageFlags usage;
+    u32 width;
+    u32 height;
+    u32 mipCount;
+
+    // Number of regions still waiting to be streamed in. The texture is fully resident once this reaches 0
+    int pendingUploads;
+};
+
+
+struct StreamedTextureFile
+{
+    MappedFile file;
+    int refCount;
+};
+
+struct TextureUpload
+{
+    Texture* texture;
+    StreamedTextureFile* source;
+    u32 mip;
+    u32 firstRow;
+    u32 rowCount;
+};
+
+// Uploads all queued texture data through the staging belt, copying at most budgetPerFrame bytes every frame
+struct TextureStreamer
+{
+    std::deque<TextureUpload> pending;
+    u64 budgetPerFrame = 16 * 1024 * 1024;
+    u64 totalBytesUploaded = 0;
+};
@@ -0,0 +1,275 @@
+
+// Worker running on this thread, if any
+thread_local JobWorker* globalCurrentWorker = nullptr;
+
+// Times an idle worker looks for jobs before going to sleep
+constexpr int JobIdleSpinCount = 2000;
+
+
+// Owner only. Returns false if the queue is full
+bool PushJob( JobQueue* queue, Job* job )
+{
+    i64 b = queue->bottom.load( std::memory_order_relaxed );
+    i64 t = queue->top.load( std::memory_order_acquire );
+    if( b - t >= JobQueueCapacity )
+        return false;
+
+    queue->jobs[b & (JobQueueCapacity - 1)].store( job, std::memory_order_relaxed );
+    std::atomic_thread_fence( std::memory_order_release );
+    queue->bottom.store( b + 1, std::memory_order_relaxed );
+    return true;
+}
+
+// Owner only. Takes the most recently pushed job
+Job* PopJob( JobQueue* queue )
+{
+    i64 b = queue->bottom.load( std::memory_order_relaxed ) - 1;
+    queue->bottom.store( b, std::memory_order_relaxed );
+    std::atomic_thread_fence( std::memory_order_seq_cst );
+    i64 t = queue->top.load( std::memory_order_relaxed );
+
+    Job* job = nullptr;
+    if( t <= b )
+    {
+        job = queue->jobs[b & (JobQueueCapacity - 1)].load( std::memory_order_relaxed );
+        if( t == b )
+        {
+            // Last one left, so race any thieves for it
+            if( !queue->top.compare_exchange_strong( t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed ) )
+                job = nullptr;
+            queue->bottom.store( b + 1, std::memory_order_relaxed );
+        }
+    }
+    else
+        queue->bottom.store( b + 1, std::memory_order_relaxed );
+
+    return job;
+}
+
+// Any thread. Takes the oldest job, or nothing if empty or some other thread got there first
+Job* StealJob( JobQueue* queue )
+{
+    i64 t = queue->top.load( std::memory_order_acquire );
+    std::atomic_thread_fence( std::memory_order_seq_cst );
+    i64 b = queue->bottom.load( std::memory_order_acquire );
+    if( t >= b )
+        return nullptr;
+
+    Job* job = queue->jobs[t & (JobQueueCapacity - 1)].load( std::memory_order_relaxed );
+    if( !queue->top.compare_exchange_strong( t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed ) )
+        return nullptr;
+    return job;
+}
+
+INLINE u32 NextRandom( u32* state )
+{
+    // xorshift32
+    u32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+Job* FindJob( JobSystem* js )
+{
+    JobWorker* self = globalCurrentWorker;
+    Job* job = self ? PopJob( &self->queue ) : nullptr;
+
+    if( !job )
+    {
+        // Go round everyone else starting at a random worker, so thieves don't all pile on the same one
+        thread_local u32 outsiderRandomState = 0x9E3779B9u;
+        u32 workerCount = (u32)js->workers.size();
+        u32 first = NextRandom( self ? &self->randomState : &outsiderRandomState ) % workerCount;
+        for( u32 i = 0; i < workerCount && !job; ++i )
+        {
+            JobWorker* victim = js->workers[(first + i) % workerCount];
+            if( victim != self )
+                job = StealJob( &victim->queue );
+        }
+    }
+
+    if( !job && js->injectedCount.load( std::memory_order_acquire ) > 0 )
+    {
+        std::lock_guard<std::mutex> lock( js->injectedMutex );
+        if( !js->injected.empty() )
+        {
+            job = js->injected.front();
+            js->injected.pop_front();
+            js->injectedCount.fetch_sub( 1, std::memory_order_relaxed );
+        }
+    }
+
+    if( job )
+        js->queuedCount.fetch_sub( 1, std::memory_order_relaxed );
+    return job;
+}
+
+void RunJob( Job* job, JobSystem* js )
+{
+    // Whoever waits on the counter may free it (and the job) as soon as it drops to zero
+    JobCounter* counter = job->counter;
+    Job* continuation = counter ? counter->continuation : nullptr;
+
+    job->func( *job );
+
+    if( counter && counter->pending.fetch_sub( 1, std::memory_order_acq_rel ) == 1 && continuation )
+        SubmitJobs( continuation, 1, nullptr, js );
+}
+
+// Queue up jobs to run on any worker. Jobs and counter must stay alive until the counter drops to zero.
+// With no counter, each job keeps whatever counter it already had (if any), which must already account for it.
+// That's how continuations work: their counter is charged up front, so waiting on it also covers the jobs before them
+void SubmitJobs( Job* jobs, int count, JobCounter* counter, JobSystem* js /*= &globalJobSystem*/ )
+{
+    if( counter )
+    {
+        counter->pending.fetch_add( count, std::memory_order_relaxed );
+        for( int i = 0; i < count; ++i )
+            jobs[i].counter = counter;
+    }
+
+    if( !js->running )
+    {
+        for( int i = 0; i < count; ++i )
+            RunJob( &jobs[i], js );
+        return;
+    }
+
+    JobWorker* self = globalCurrentWorker;
+    for( int i = 0; i < count; ++i )
+    {
+        js->queuedCount.fetch_add( 1, std::memory_order_seq_cst );
+        if( self )
+        {
+            if( !PushJob( &self->queue, &jobs[i] ) )
+            {
+                // Full, so it's quicker to just get on with it
+                js->queuedCount.fetch_sub( 1, std::memory_order_relaxed );
+                RunJob( &jobs[i], js );
+            }
+        }
+        else
+        {
+            std::lock_guard<std::mutex> lock( js->injectedMutex );
+            js->injected.push_back( &jobs[i] );
+            js->injectedCount.fetch_add( 1, std::memory_order_release );
+        }
+    }
+
+    // Taking the lock makes sure a worker that's about to sleep either sees the new jobs or gets the notification
+    if( js->sleepingCount.load( std::memory_order_seq_cst ) > 0 )
+    {
+        { std::lock_guard<std::mutex> lock( js->sleepMutex ); }
+        if( count > 1 )
+            js->wakeUp.notify_all();
+        else
+            js->wakeUp.notify_one();
+    }
+}
+
+// Run other jobs until the counter drops to zero
+void WaitForCounter( JobCounter* counter, JobSystem* js /*= &globalJobSystem*/ )
+{
+    while( counter->pending.load( std::memory_order_acquire ) > 0 )
+    {
+        if( Job* job = js->running ? FindJob( js ) : nullptr )
+            RunJob( job, js );
+        else
+            _mm_pause();
+    }
+}
+
+void RunWorker( JobSystem* js, JobWorker* worker, bool pinThread )
+{
+    globalCurrentWorker = worker;
+    if( pinThread )
+        Platform::PinCurrentThread( worker->index );
+
+    int idleSpins = 0;
+    while( !js->quit.load( std::memory_order_acquire ) )
+    {
+        if( Job* job = FindJob( js ) )
+        {
+            RunJob( job, js );
+            idleSpins = 0;
+            continue;
+        }
+        if( ++idleSpins < JobIdleSpinCount )
+        {
+            _mm_pause();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock( js->sleepMutex );
+        js->sleepingCount.fetch_add( 1, std::memory_order_seq_cst );
+        js->wakeUp.wait( lock, [js]()
+        {
+            return js->queuedCount.load( std::memory_order_seq_cst ) > 0 || js->quit.load( std::memory_order_acquire );
+        } );
+        js->sleepingCount.fetch_sub( 1, std::memory_order_relaxed );
+        idleSpins = 0;
+    }
+
+    globalCurrentWorker = nullptr;
+}
+
+// Start workerCount workers (or one per usable core when 0), counting the calling thread as the first one.
+// Pinning ties each extra worker to its own core
+bool InitJobSystem( JobSystem* js, int workerCount /*= 0*/, bool pinThreads /*= false*/ )
+{
+    ASSERT( !js->running, "Job system already running" );
+    if( workerCount <= 0 )
+        workerCount = Platform::GetUsableCoreCount();
+
+    js->quit = false;
+    js->injectedCount = 0;
+    js->queuedCount = 0;
+    js->sleepingCount = 0;
+    for( int i = 0; i < workerCount; ++i )
+    {
+        JobWorker* worker = new JobWorker();
+        worker->index = (u32)i;
+        worker->randomState = 0x9E3779B9u * (u32)(i + 1);
+        js->workers.push_back( worker );
+    }
+
+    globalCurrentWorker = js->workers[0];
+    js->running = true;
+    for( int i = 1; i < workerCount; ++i )
+        js->workers[i]->thread = std::thread( RunWorker, js, js->workers[i], pinThreads );
+
+    Log( "Job system started with %d workers", workerCount );
+    return true;
+}
+
+// Must be called from the thread that started the system, once nothing is waiting on any jobs
+void ShutdownJobSystem( JobSystem* js )
+{
+    if( !js->running )
+        return;
+
+    js->quit.store( true, std::memory_order_release );
+    {
+        std::lock_guard<std::mutex> lock( js->sleepMutex );
+        js->wakeUp.notify_all();
+    }
+    for( JobWorker* worker : js->workers )
+    {
+        if( worker->thread.joinable() )
+            worker->thread.join();
+        delete worker;
+    }
+
+    js->workers.clear();
+    js->injected.clear();
+    js->running = false;
+    globalCurrentWorker = nullptr;
+}
+
+int GetWorkerCount( JobSystem const* js /*= &globalJobSystem*/ )
+{
+    return js->running ? (int)js->workers.size() : Platform::GetUsableCoreCount();
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+// Work-stealing job system.
+// Every worker owns a Chase-Lev deque: it pushes and pops jobs at the bottom, while idle workers steal from the top of
+// someone else's. The thread that starts the system is worker 0, so it takes part in everything it submits.
+// Jobs are plain descriptors owned by whoever submits them, which must keep them alive until they're done. Each job
+// can decrement a counter when it finishes. Waiting on a counter runs other jobs in the meantime instead of blocking,
+// and a counter can also have a continuation job that gets submitted once it drops to zero.
+
+struct Job;
+using JobFunc = void( Job const& job );
+
+struct JobCounter
+{
+    std::atomic<i32> pending;
+    // Submitted by whoever finishes the last job
+    Job* continuation;
+};
+
+struct Job
+{
+    JobFunc* func;
+    void* data;
+    // Range of items for parallel loops, free for any other use otherwise
+    sz begin;
+    sz end;
+    JobCounter* counter;
+};
+
+// Jobs a worker can have queued before new ones just run in place. Must be a power of two
+constexpr i64 JobQueueCapacity = 4096;
+
+// Lock-free Chase-Lev deque over a fixed ring of job pointers (in the formulation from "Correct and Efficient
+// Work-Stealing for Weak Memory Models", Lê et al. 2013)
+struct JobQueue
+{
+    alignas(64) std::atomic<i64> top;
+    alignas(64) std::atomic<i64> bottom;
+    alignas(64) std::atomic<Job*> jobs[JobQueueCapacity];
+};
+
+struct JobWorker
+{
+    JobQueue queue;
+    std::thread thread;
+    u32 index;
+    // For picking steal victims
+    u32 randomState;
+};
+
+struct JobSystem
+{
+    std::vector<JobWorker*> workers;
+    // Jobs submitted from threads that aren't workers
+    std::mutex injectedMutex;
+    std::deque<Job*> injected;
+    std::atomic<i32> injectedCount;
+
+    // Queued jobs nobody has picked up yet, so idle workers know when to go to sleep
+    std::atomic<i32> queuedCount;
+    std::atomic<i32> sleepingCount;
+    std::mutex sleepMutex;
+    std::condition_variable wakeUp;
+    std::atomic<bool> quit;
+    bool running;
+};
+
+extern JobSystem globalJobSystem;
+
+bool InitJobSystem( JobSystem* js, int workerCount = 0, bool pinThreads = false );
+void ShutdownJobSystem( JobSystem* js );
+int GetWorkerCount( JobSystem const* js = &globalJobSystem );
+void SubmitJobs( Job* jobs, int count, JobCounter* counter, JobSystem* js = &globalJobSystem );
+void WaitForCounter( JobCounter* counter, JobSystem* js = &globalJobSystem );
+
+
+// Split the range [0, count) into contiguous chunks of at least minChunkSize items, and call func( begin, end )
+// for each of them from a few workers (at most maxThreads, or all of them when 0). The calling thread processes
+// the first chunk itself, and the call returns only once all chunks are done.
+// Without a running job system, chunks get a thread each instead.
+template <typename Func>
+void ParallelFor( sz count, sz minChunkSize, Func&& func, sz maxThreads = 0 )
+{
+    if( count <= 0 )
+        return;
+
+    minChunkSize = Max<sz>( minChunkSize, 1 );
+    if( maxThreads <= 0 )
+        maxThreads = (sz)GetWorkerCount();
+    sz threadCount = Min<sz>( maxThreads, (count + minChunkSize - 1) / minChunkSize );
+    if( threadCount <= 1 )
+    {
+        func( (sz)0, count );
+        return;
+    }
+
+    sz chunkSize = (count + threadCount - 1) / threadCount;
+
+    if( globalJobSystem.running )
+    {
+        using FuncType = std::remove_reference_t<Func>;
+        std::vector<Job> jobs;
+        jobs.reserve( threadCount - 1 );
+        for( sz begin = chunkSize; begin < count; begin += chunkSize )
+        {
+            Job job = {};
+            job.func = []( Job const& j ) { (*(FuncType*)j.data)( j.begin, j.end ); };
+            job.data = (void*)&func;
+            job.begin = begin;
+            job.end = Min( begin + chunkSize, count );
+            jobs.push_back( job );
+        }
+
+        JobCounter counter = {};
+        SubmitJobs( jobs.data(), (int)jobs.size(), &counter );
+        func( (sz)0, Min( chunkSize, count ) );
+        WaitForCounter( &counter );
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    threads.reserve( threadCount - 1 );
+    for( sz begin = chunkSize; begin < count; begin += chunkSize )
+    {
+        sz end = Min( begin + chunkSize, count );
+        threads.emplace_back( [&func, begin, end]() { func( begin, end ); } );
+    }
+
+    func( (sz)0, Min( chunkSize, count ) );
+
+    for( std::thread& t : threads )
+        t.join();
+}
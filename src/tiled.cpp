@@ -0,0 +1,182 @@
+
+bool SubmitFrameTo( WGPUTextureView target, u32 slot );
+void UpdateCurrentProgramTile( f32 viewportWidth, f32 viewportHeight, u32 tileX, u32 tileY, u32 tileWidth, u32 tileHeight,
+                               u32 slot );
+
+// Write a tile into its place in the output, one row at a time, and recycle its slot
+void WriteTile( ReadbackSlot* slot, void* userdata )
+{
+    TiledRender* render = (TiledRender*)userdata;
+    TilePosition tile = render->positions[slot->index % TileReadbackDepth];
+    if( slot->mapFailed )
+    {
+        Log( "ERROR :: Could not map tile at %u, %u", tile.x, tile.y );
+    }
+
+    if( !slot->data )
+        render->writeFailed = true;
+    else if( !render->writeFailed )
+    {
+        sz rowSize = (sz)slot->width * 3;
+        for( u32 y = 0; y < slot->height; ++y )
+        {
+            PackRGBRow( slot->data + (sz)y * render->readbacks.bytesPerRow, render->row.data(), slot->width,
+                        render->swapRedBlue );
+
+            u64 offset = render->headerSize + ((u64)(tile.y + y) * render->width + tile.x) * 3;
+            if( _fseeki64( render->out, (i64)offset, SEEK_SET ) != 0
+                || fwrite( render->row.data(), 1, (size_t)rowSize, render->out ) != (size_t)rowSize )
+            {
+                Log( "ERROR :: Could not write tile at %u, %u", tile.x, tile.y );
+                render->writeFailed = true;
+                break;
+            }
+        }
+    }
+
+    slot->state = ReadbackState::Done;
+    render->tilesWritten++;
+}
+
+void ReleaseTiledRender( TiledRender* render )
+{
+    if( render->targetView )
+        wgpuTextureViewRelease( render->targetView );
+    DestroyGPUTexture( render->target );
+    render->targetView = nullptr;
+    render->target = nullptr;
+
+    ReleaseReadbackRing( &render->readbacks );
+
+    if( render->out && fclose( render->out ) != 0 )
+    {
+        Log( "ERROR :: Could not finish writing the tiled image" );
+        render->writeFailed = true;
+    }
+    render->out = nullptr;
+}
+
+bool BeginTiledRender( TiledRender* render, char const* path, u32 width, u32 height, u32 tileSize )
+{
+    if( !GetReadbackSwizzle( globalSwapChainFormat, &render->swapRedBlue ) )
+    {
+        Log( "ERROR :: Can't render tiles from swap chain format %d", globalSwapChainFormat );
+        return false;
+    }
+    if( !width || !height || !tileSize )
+    {
+        Log( "ERROR :: Can't render a %u x %u image in %u x %u tiles", width, height, tileSize, tileSize );
+        return false;
+    }
+
+    // Tiles are as big as the device allows, and no bigger than the image
+    tileSize = Min( tileSize, globalLimits.maxTextureDimension2D );
+    u32 targetWidth = Min( tileSize, width );
+    u32 targetHeight = Min( tileSize, height );
+
+    render->width = width;
+    render->height = height;
+    render->tileSize = tileSize;
+    render->row.resize( (sz)targetWidth * 3 );
+    render->tilesWritten = 0;
+    render->writeFailed = false;
+
+    render->out = fopen( path, "wb" );
+    if( !render->out )
+    {
+        Log( "ERROR :: Could not open '%s' for writing", path );
+        return false;
+    }
+    int headerSize = fprintf( render->out, "P6\n%u %u\n255\n", width, height );
+    render->headerSize = (u64)Max( headerSize, 0 );
+
+    WGPUTextureDescriptor textureDesc = {};
+    textureDesc.nextInChain           = nullptr;
+    textureDesc.label                 = "Image tile";
+    textureDesc.usage                 = WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_CopySrc;
+    textureDesc.dimension             = WGPUTextureDimension_2D;
+    textureDesc.size                  = { targetWidth, targetHeight, 1 };
+    textureDesc.format                = globalSwapChainFormat;
+    textureDesc.mipLevelCount         = 1;
+    textureDesc.sampleCount           = 1;
+    textureDesc.viewFormatCount       = 0;
+    textureDesc.viewFormats           = nullptr;
+    render->target = CreateGPUTexture( &textureDesc, "Tiled render" );
+    if( render->target )
+        render->targetView = wgpuTextureCreateView( render->target, nullptr );
+
+    bool readbacksOk = InitTextureReadbackRing( &render->readbacks, TileReadbackDepth, targetWidth, targetHeight,
+                                                "Tile readback", "Tiled render" );
+
+    if( headerSize <= 0 || !render->targetView || !readbacksOk )
+    {
+        Log( "ERROR :: Could not create tiled render resources for %u x %u tiles", targetWidth, targetHeight );
+        ReleaseTiledRender( render );
+        return false;
+    }
+    return true;
+}
+
+// Render the tile at x, y of the image with the current program, and queue its readback. Only blocks when all
+// readback slots are still busy
+bool RenderTile( TiledRender* render, u32 x, u32 y )
+{
+    WaitForReadbackSlot( &render->readbacks, NextReadbackSlot( &render->readbacks ), WriteTile, nullptr, render );
+
+    // Edge tiles only copy the part that's inside the image
+    u32 width = Min( render->tileSize, render->width - x );
+    u32 height = Min( render->tileSize, render->height - y );
+
+    UpdateCurrentProgramTile( (f32)render->width, (f32)render->height, x, y, width, height, 0 );
+    if( !SubmitFrameTo( render->targetView, 0 ) )
+        return false;
+
+    render->positions[render->readbacks.submitted % TileReadbackDepth] = { x, y };
+    ReadbackTextureAsync( &render->readbacks, render->target, width, height, "Tiled render" );
+
+    // Write whatever finished meanwhile, without waiting on anything
+    PollDevice( false );
+    RetireReadbacks( &render->readbacks, WriteTile, render );
+    return true;
+}
+
+// All tiles render at the same fixed time, so they match at the seams whatever the program animates
+bool RenderTiledImage( Program& program, char const* path, u32 width, u32 height, f32 time /*= 0*/,
+                       u32 tileSize /*= DefaultTileSize*/ )
+{
+    if( !program.supportsTiles )
+    {
+        Log( "ERROR :: Program '%s' doesn't render in tiles", program.shaderPath );
+        return false;
+    }
+    if( !SetCurrentProgram( program ) )
+        return false;
+
+    TiledRender render = {};
+    if( !BeginTiledRender( &render, path, width, height, tileSize ) )
+        return false;
+
+    u32 tilesX = (width + render.tileSize - 1) / render.tileSize;
+    u32 tilesY = (height + render.tileSize - 1) / render.tileSize;
+    Log( "Rendering %u x %u image to '%s' in %u x %u tiles of %u", width, height, path, tilesX, tilesY, render.tileSize );
+
+    f64 startMillis = Platform::CurrentTimeMillis();
+    Platform::SetFixedAppTime( time * 1000.0 );
+
+    bool result = true;
+    for( u32 y = 0; y < height && result; y += render.tileSize )
+        for( u32 x = 0; x < width && result; x += render.tileSize )
+            result = RenderTile( &render, x, y );
+
+    FinishReadbacks( &render.readbacks, WriteTile, nullptr, &render );
+
+    program.tileOffset = V2Zero;
+    Platform::SetFixedAppTime( -1 );
+    ReleaseTiledRender( &render );
+
+    f64 seconds = Max( (Platform::CurrentTimeMillis() - startMillis) * 0.001, 1e-9 );
+    Log( "Rendered %llu tiles in %.2f s: %.1f Mpixels/s%s", render.tilesWritten, seconds,
+         (f64)width * height / seconds * 1e-6, render.writeFailed ? " (writing FAILED)" : "" );
+
+    return result && !render.writeFailed;
+}
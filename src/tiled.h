@@ -0,0 +1,50 @@
+#pragma once
+
+// Tiled rendering of stills
+// Renders a single image of any size (well past the largest texture the device can create, e.g. 32k x 32k for print)
+// one tile at a time. Every tile renders the current program into the same tile-sized target, with the full image size
+// as its resolution and the tile's position passed along as Program::tileOffset, so Shadertoy-style shaders that take
+// their pixel coordinates through pixelCoord() (see shadertoy.wgsl) render their part of the big picture unchanged.
+// Tiles get read back through a small ring of buffers and written straight into their place in the output file, row by
+// row, so memory stays at a few tiles however big the image is, while the GPU keeps rendering the tiles after them.
+//
+//   App --tiled poster.ppm 16384 16384 12.5 clouds.wgsl
+//
+// (output, then width, height, time in seconds, program and tile size, all optional but the output).
+// The output is a binary PPM, which is trivial to write rows of at any offset, and which most tools convert from.
+// Only programs that opt in through Program::supportsTiles can be tiled. Anything else (offscreen buffers, ray tracing,
+// or shaders drawing geometry rather than shading pixels by their coordinate) works on the whole frame at once.
+
+constexpr u32 DefaultTileSize = 2048;
+constexpr int TileReadbackDepth = 3;
+
+// Where the tile in the readback slot of the same index goes
+struct TilePosition
+{
+    u32 x;
+    u32 y;
+};
+
+struct TiledRender
+{
+    u32 width;
+    u32 height;
+    u32 tileSize;
+    bool swapRedBlue;           // BGRA targets
+
+    FILE* out;
+    u64 headerSize;
+    std::vector<u8> row;        // One tile row, converted to RGB
+
+    WGPUTexture target;
+    WGPUTextureView targetView;
+
+    // Tiles get written as soon as they're mapped, so slots never stay with the writer
+    ReadbackRing readbacks;
+    TilePosition positions[TileReadbackDepth];
+    u64 tilesWritten;
+    bool writeFailed;
+};
+
+bool RenderTiledImage( Program& program, char const* path, u32 width, u32 height, f32 time = 0,
+                       u32 tileSize = DefaultTileSize );
@@ -0,0 +1,441 @@
+
+void SetV3SoA( V3SoA* soa, v3 const* v, u32 count )
+{
+    u32 paddedCount = AlignUp<u32>( count, SimdWidth );
+    soa->x.assign( paddedCount, 0.f );
+    soa->y.assign( paddedCount, 0.f );
+    soa->z.assign( paddedCount, 0.f );
+
+    for( u32 i = 0; i < count; ++i )
+    {
+        soa->x[i] = v[i].x;
+        soa->y[i] = v[i].y;
+        soa->z[i] = v[i].z;
+    }
+    soa->count = count;
+}
+
+void SetV4SoA( V4SoA* soa, v4 const* v, u32 count )
+{
+    u32 paddedCount = AlignUp<u32>( count, SimdWidth );
+    soa->x.assign( paddedCount, 0.f );
+    soa->y.assign( paddedCount, 0.f );
+    soa->z.assign( paddedCount, 0.f );
+    soa->w.assign( paddedCount, 0.f );
+
+    for( u32 i = 0; i < count; ++i )
+    {
+        soa->x[i] = v[i].x;
+        soa->y[i] = v[i].y;
+        soa->z[i] = v[i].z;
+        soa->w[i] = v[i].w;
+    }
+    soa->count = count;
+}
+
+void SetV3AoSoA( V3AoSoA* aosoa, v3 const* v, u32 count )
+{
+    aosoa->blocks.assign( AlignUp<u32>( count, SimdWidth ) / SimdWidth, V3Block() );
+
+    for( u32 i = 0; i < count; ++i )
+    {
+        V3Block& block = aosoa->blocks[i / SimdWidth];
+        block.x[i % SimdWidth] = v[i].x;
+        block.y[i % SimdWidth] = v[i].y;
+        block.z[i % SimdWidth] = v[i].z;
+    }
+    aosoa->count = count;
+}
+
+void SetAffineSoA( AffineSoA* soa, m4 const* m, u32 count )
+{
+    u32 paddedCount = AlignUp<u32>( count, SimdWidth );
+    for( int r = 0; r < 3; ++r )
+        for( int c = 0; c < 4; ++c )
+            soa->e[r][c].assign( paddedCount, 0.f );
+
+    for( u32 i = 0; i < count; ++i )
+        for( int r = 0; r < 3; ++r )
+            for( int c = 0; c < 4; ++c )
+                soa->e[r][c][i] = m[i].e[r][c];
+    soa->count = count;
+}
+
+INLINE v3 GetV3SoA( V3SoA const& soa, u32 i )
+{
+    return V3( soa.x[i], soa.y[i], soa.z[i] );
+}
+
+INLINE v4 GetV4SoA( V4SoA const& soa, u32 i )
+{
+    return V4( soa.x[i], soa.y[i], soa.z[i], soa.w[i] );
+}
+
+INLINE v3 GetV3AoSoA( V3AoSoA const& aosoa, u32 i )
+{
+    V3Block const& block = aosoa.blocks[i / SimdWidth];
+    return V3( block.x[i % SimdWidth], block.y[i % SimdWidth], block.z[i % SimdWidth] );
+}
+
+
+// Matrix rows broadcast to all lanes. Translation is premultiplied by w, so vectors just add zero
+struct SimdAffine
+{
+    simdf e[3][3];
+    simdf t[3];
+};
+
+INLINE SimdAffine SimdBroadcast( m4 const& m, f32 w )
+{
+    SimdAffine result;
+    for( int r = 0; r < 3; ++r )
+    {
+        for( int c = 0; c < 3; ++c )
+            result.e[r][c] = SimdSet( m.e[r][c] );
+        result.t[r] = SimdSet( m.e[r][3] * w );
+    }
+    return result;
+}
+
+INLINE void SimdTransformLanes( SimdAffine const& m, f32 const* x, f32 const* y, f32 const* z,
+                                f32* outX, f32* outY, f32* outZ )
+{
+    simdf vx = SimdLoad( x );
+    simdf vy = SimdLoad( y );
+    simdf vz = SimdLoad( z );
+    // Write out only after all loads, so transforming in place works
+    simdf rx = SimdMulAdd( m.e[0][0], vx, SimdMulAdd( m.e[0][1], vy, SimdMulAdd( m.e[0][2], vz, m.t[0] ) ) );
+    simdf ry = SimdMulAdd( m.e[1][0], vx, SimdMulAdd( m.e[1][1], vy, SimdMulAdd( m.e[1][2], vz, m.t[1] ) ) );
+    simdf rz = SimdMulAdd( m.e[2][0], vx, SimdMulAdd( m.e[2][1], vy, SimdMulAdd( m.e[2][2], vz, m.t[2] ) ) );
+    SimdStore( outX, rx );
+    SimdStore( outY, ry );
+    SimdStore( outZ, rz );
+}
+
+// Transform elements [begin, end) of a stream by the same matrix, with w = 1 for points or 0 for vectors.
+// Begin must be a multiple of SimdWidth, and out must be at least as big as in
+void TransformSoA( m4 const& m, f32 w, V3SoA const& in, V3SoA* out, u32 begin, u32 end )
+{
+    ASSERT( begin % SimdWidth == 0, "Unaligned batch start" );
+    ASSERT( out->x.size() >= in.x.size(), "Output stream too small" );
+
+    // Going through raw pointers keeps the compiler from reloading each vector's data on every iteration
+    SimdAffine sm = SimdBroadcast( m, w );
+    f32 const* x = in.x.data();
+    f32 const* y = in.y.data();
+    f32 const* z = in.z.data();
+    f32* outX = out->x.data();
+    f32* outY = out->y.data();
+    f32* outZ = out->z.data();
+    for( u32 i = begin; i < end; i += SimdWidth )
+        SimdTransformLanes( sm, x + i, y + i, z + i, outX + i, outY + i, outZ + i );
+}
+
+void TransformSoA( m4 const& m, V4SoA const& in, V4SoA* out, u32 begin, u32 end )
+{
+    ASSERT( begin % SimdWidth == 0, "Unaligned batch start" );
+    ASSERT( out->x.size() >= in.x.size(), "Output stream too small" );
+
+    simdf e[4][4];
+    for( int r = 0; r < 4; ++r )
+        for( int c = 0; c < 4; ++c )
+            e[r][c] = SimdSet( m.e[r][c] );
+
+    // Rows are spelled out, as compilers won't always unroll small loops over them and end up going through the stack
+    f32 const* x = in.x.data();
+    f32 const* y = in.y.data();
+    f32 const* z = in.z.data();
+    f32 const* w = in.w.data();
+    f32* outX = out->x.data();
+    f32* outY = out->y.data();
+    f32* outZ = out->z.data();
+    f32* outW = out->w.data();
+    for( u32 i = begin; i < end; i += SimdWidth )
+    {
+        simdf vx = SimdLoad( x + i );
+        simdf vy = SimdLoad( y + i );
+        simdf vz = SimdLoad( z + i );
+        simdf vw = SimdLoad( w + i );
+        simdf rx = SimdMulAdd( e[0][0], vx, SimdMulAdd( e[0][1], vy, SimdMulAdd( e[0][2], vz, SimdMul( e[0][3], vw ) ) ) );
+        simdf ry = SimdMulAdd( e[1][0], vx, SimdMulAdd( e[1][1], vy, SimdMulAdd( e[1][2], vz, SimdMul( e[1][3], vw ) ) ) );
+        simdf rz = SimdMulAdd( e[2][0], vx, SimdMulAdd( e[2][1], vy, SimdMulAdd( e[2][2], vz, SimdMul( e[2][3], vw ) ) ) );
+        simdf rw = SimdMulAdd( e[3][0], vx, SimdMulAdd( e[3][1], vy, SimdMulAdd( e[3][2], vz, SimdMul( e[3][3], vw ) ) ) );
+        SimdStore( outX + i, rx );
+        SimdStore( outY + i, ry );
+        SimdStore( outZ + i, rz );
+        SimdStore( outW + i, rw );
+    }
+}
+
+// Same, but each element has its own matrix
+void TransformSoA( AffineSoA const& m, f32 w, V3SoA const& in, V3SoA* out, u32 begin, u32 end )
+{
+    ASSERT( begin % SimdWidth == 0, "Unaligned batch start" );
+    ASSERT( out->x.size() >= in.x.size(), "Output stream too small" );
+    ASSERT( m.e[0][0].size() >= in.x.size(), "Not enough matrices" );
+
+    f32 const* e[3][4];
+    for( int r = 0; r < 3; ++r )
+        for( int c = 0; c < 4; ++c )
+            e[r][c] = m.e[r][c].data();
+    f32 const* x = in.x.data();
+    f32 const* y = in.y.data();
+    f32 const* z = in.z.data();
+    f32* outX = out->x.data();
+    f32* outY = out->y.data();
+    f32* outZ = out->z.data();
+
+    simdf sw = SimdSet( w );
+    for( u32 i = begin; i < end; i += SimdWidth )
+    {
+        simdf vx = SimdLoad( x + i );
+        simdf vy = SimdLoad( y + i );
+        simdf vz = SimdLoad( z + i );
+        simdf rx = SimdMulAdd( SimdLoad( e[0][0] + i ), vx, SimdMulAdd( SimdLoad( e[0][1] + i ), vy,
+                   SimdMulAdd( SimdLoad( e[0][2] + i ), vz, SimdMul( SimdLoad( e[0][3] + i ), sw ) ) ) );
+        simdf ry = SimdMulAdd( SimdLoad( e[1][0] + i ), vx, SimdMulAdd( SimdLoad( e[1][1] + i ), vy,
+                   SimdMulAdd( SimdLoad( e[1][2] + i ), vz, SimdMul( SimdLoad( e[1][3] + i ), sw ) ) ) );
+        simdf rz = SimdMulAdd( SimdLoad( e[2][0] + i ), vx, SimdMulAdd( SimdLoad( e[2][1] + i ), vy,
+                   SimdMulAdd( SimdLoad( e[2][2] + i ), vz, SimdMul( SimdLoad( e[2][3] + i ), sw ) ) ) );
+        SimdStore( outX + i, rx );
+        SimdStore( outY + i, ry );
+        SimdStore( outZ + i, rz );
+    }
+}
+
+// Transform blocks [begin, end) of an AoSoA stream
+void TransformAoSoA( m4 const& m, f32 w, V3AoSoA const& in, V3AoSoA* out, u32 begin, u32 end )
+{
+    ASSERT( out->blocks.size() >= in.blocks.size(), "Output stream too small" );
+
+    SimdAffine sm = SimdBroadcast( m, w );
+    for( u32 b = begin; b < end; ++b )
+    {
+        V3Block const& src = in.blocks[b];
+        V3Block& dst = out->blocks[b];
+        SimdTransformLanes( sm, src.x, src.y, src.z, dst.x, dst.y, dst.z );
+    }
+}
+
+
+// Split a padded stream of count elements into SimdWidth aligned batches of TransformBatchSize and
+// call func( begin, end ) on each from worker threads
+template <typename Func>
+void ParallelForLanes( u32 count, Func&& func, int maxThreads )
+{
+    u32 laneGroupCount = AlignUp<u32>( count, SimdWidth ) / SimdWidth;
+    ParallelFor( laneGroupCount, TransformBatchSize / SimdWidth, [&func]( sz begin, sz end )
+    {
+        func( (u32)begin * SimdWidth, (u32)end * SimdWidth );
+    }, maxThreads );
+}
+
+void ResizeV3SoA( V3SoA* soa, u32 count )
+{
+    u32 paddedCount = AlignUp<u32>( count, SimdWidth );
+    soa->x.resize( paddedCount );
+    soa->y.resize( paddedCount );
+    soa->z.resize( paddedCount );
+    soa->count = count;
+}
+
+// Transform whole streams from a few worker threads. Out is resized to match, and can be the same as in
+void TransformPointsSoA( m4 const& m, V3SoA const& in, V3SoA* out, int maxThreads = 0 )
+{
+    ResizeV3SoA( out, in.count );
+    ParallelForLanes( in.count, [&]( u32 begin, u32 end ) { TransformSoA( m, 1.f, in, out, begin, end ); }, maxThreads );
+}
+
+void TransformVectorsSoA( m4 const& m, V3SoA const& in, V3SoA* out, int maxThreads = 0 )
+{
+    ResizeV3SoA( out, in.count );
+    ParallelForLanes( in.count, [&]( u32 begin, u32 end ) { TransformSoA( m, 0.f, in, out, begin, end ); }, maxThreads );
+}
+
+void TransformPointsSoA( AffineSoA const& m, V3SoA const& in, V3SoA* out, int maxThreads = 0 )
+{
+    ASSERT( m.count == in.count, "Need one matrix per point" );
+    ResizeV3SoA( out, in.count );
+    ParallelForLanes( in.count, [&]( u32 begin, u32 end ) { TransformSoA( m, 1.f, in, out, begin, end ); }, maxThreads );
+}
+
+void TransformV4SoA( m4 const& m, V4SoA const& in, V4SoA* out, int maxThreads = 0 )
+{
+    u32 paddedCount = AlignUp<u32>( in.count, SimdWidth );
+    out->x.resize( paddedCount );
+    out->y.resize( paddedCount );
+    out->z.resize( paddedCount );
+    out->w.resize( paddedCount );
+    out->count = in.count;
+    ParallelForLanes( in.count, [&]( u32 begin, u32 end ) { TransformSoA( m, in, out, begin, end ); }, maxThreads );
+}
+
+void TransformPointsAoSoA( m4 const& m, V3AoSoA const& in, V3AoSoA* out, int maxThreads = 0 )
+{
+    out->blocks.resize( in.blocks.size() );
+    out->count = in.count;
+    ParallelFor( in.blocks.size(), TransformBatchSize / SimdWidth, [&]( sz begin, sz end )
+    {
+        TransformAoSoA( m, 1.f, in, out, (u32)begin, (u32)end );
+    }, maxThreads );
+}
+
+void TransformVectorsAoSoA( m4 const& m, V3AoSoA const& in, V3AoSoA* out, int maxThreads = 0 )
+{
+    out->blocks.resize( in.blocks.size() );
+    out->count = in.count;
+    ParallelFor( in.blocks.size(), TransformBatchSize / SimdWidth, [&]( sz begin, sz end )
+    {
+        TransformAoSoA( m, 0.f, in, out, (u32)begin, (u32)end );
+    }, maxThreads );
+}
+
+
+INLINE void MarkTransformDirty( TransformHierarchy* h, u32 node )
+{
+    if( !h->dirty[node] )
+    {
+        h->dirty[node] = 1;
+        h->dirtyRoots.push_back( node );
+    }
+}
+
+// Add a node as the last child of parent (or as a new root), and return its index.
+// Adding nodes in depth-first order only ever appends, otherwise every node after the new one shifts down by one
+u32 AddTransformNode( TransformHierarchy* h, u32 parent, v3 const& position, qn const& rotation, v3 const& scale )
+{
+    u32 count = (u32)h->parents.size();
+    u32 node = count;
+    if( parent != TransformNoParent )
+    {
+        ASSERT( parent < count, "Invalid parent" );
+        node = parent + h->subtreeSizes[parent];
+        // Every ancestor's subtree grows by one
+        for( u32 p = parent; p != TransformNoParent; p = h->parents[p] )
+            h->subtreeSizes[p]++;
+    }
+
+    if( node < count )
+    {
+        // Anything pointing past the insertion point moves with it
+        for( u32 i = node; i < count; ++i )
+            if( h->parents[i] != TransformNoParent && h->parents[i] >= node )
+                h->parents[i]++;
+        for( u32& root : h->dirtyRoots )
+            if( root >= node )
+                root++;
+    }
+
+    h->parents.insert( h->parents.begin() + node, parent );
+    h->subtreeSizes.insert( h->subtreeSizes.begin() + node, 1 );
+    h->positions.insert( h->positions.begin() + node, position );
+    h->rotations.insert( h->rotations.begin() + node, rotation );
+    h->scales.insert( h->scales.begin() + node, scale );
+    h->worldMatrices.insert( h->worldMatrices.begin() + node, M4Identity );
+    h->dirty.insert( h->dirty.begin() + node, 0 );
+    MarkTransformDirty( h, node );
+
+    return node;
+}
+
+void SetLocalTransform( TransformHierarchy* h, u32 node, v3 const& position, qn const& rotation, v3 const& scale )
+{
+    h->positions[node] = position;
+    h->rotations[node] = rotation;
+    h->scales[node] = scale;
+    MarkTransformDirty( h, node );
+}
+
+void SetLocalPosition( TransformHierarchy* h, u32 node, v3 const& position )
+{
+    h->positions[node] = position;
+    MarkTransformDirty( h, node );
+}
+
+void SetLocalRotation( TransformHierarchy* h, u32 node, qn const& rotation )
+{
+    h->rotations[node] = rotation;
+    MarkTransformDirty( h, node );
+}
+
+INLINE void UpdateWorldTransform( TransformHierarchy* h, u32 node )
+{
+    m4 local = M4TRS( h->positions[node], h->rotations[node], h->scales[node] );
+    u32 parent = h->parents[node];
+    h->worldMatrices[node] = parent == TransformNoParent ? local : h->worldMatrices[parent] * local;
+}
+
+// Recompute world matrices of all dirty subtrees, and return how many nodes were updated
+u32 UpdateWorldTransforms( TransformHierarchy* h, int maxThreads = 0 )
+{
+    if( h->dirtyRoots.empty() )
+        return 0;
+
+    // Subtrees are either nested or disjoint, so once sorted any root inside the previous kept range is redundant.
+    // With lots of changes, collecting them back in order from the flags is quicker than sorting
+    u32 nodeCount = (u32)h->parents.size();
+    if( h->dirtyRoots.size() > nodeCount / 32 )
+    {
+        h->dirtyRoots.clear();
+        for( u32 i = 0; i < nodeCount; ++i )
+            if( h->dirty[i] )
+                h->dirtyRoots.push_back( i );
+    }
+    else
+        std::sort( h->dirtyRoots.begin(), h->dirtyRoots.end() );
+
+    std::vector<u32> subtrees;
+    std::vector<u32> pending;
+    u32 updatedCount = 0;
+    u32 rangeEnd = 0;
+    for( u32 root : h->dirtyRoots )
+    {
+        h->dirty[root] = 0;
+        if( root < rangeEnd )
+            continue;
+
+        rangeEnd = root + h->subtreeSizes[root];
+        updatedCount += h->subtreeSizes[root];
+        if( h->subtreeSizes[root] <= TransformSubtreeBatchSize )
+        {
+            subtrees.push_back( root );
+            continue;
+        }
+
+        // Split big subtrees: update the root right here, and queue its children as independent ranges.
+        // Children are pushed in reverse so they come out front to back
+        pending.push_back( root );
+        while( !pending.empty() )
+        {
+            u32 node = pending.back();
+            pending.pop_back();
+            if( h->subtreeSizes[node] <= TransformSubtreeBatchSize )
+            {
+                subtrees.push_back( node );
+                continue;
+            }
+
+            UpdateWorldTransform( h, node );
+            u32 end = node + h->subtreeSizes[node];
+            sz firstChild = pending.size();
+            for( u32 child = node + 1; child < end; child += h->subtreeSizes[child] )
+                pending.push_back( child );
+            std::reverse( pending.begin() + firstChild, pending.end() );
+        }
+    }
+    h->dirtyRoots.clear();
+
+    // Each range is in depth-first order, so parents are always done before their children
+    ParallelFor( subtrees.size(), 1, [h, &subtrees]( sz begin, sz end )
+    {
+        for( sz s = begin; s < end; ++s )
+        {
+            u32 first = subtrees[s];
+            u32 last = first + h->subtreeSizes[first];
+            for( u32 node = first; node < last; ++node )
+                UpdateWorldTransform( h, node );
+        }
+    }, maxThreads );
+
+    return updatedCount;
+}
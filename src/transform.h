@@ -0,0 +1,67 @@
+#pragma once
+
+// Batch transforms of many points or vectors at once, for CPU particles and culling prep.
+// Streams are kept either as SoA (one array per component) or AoSoA (blocks of SimdWidth elements, each block holding
+// its own component arrays, so a block sits in a single couple of cache lines), and transformed SimdWidth at a time.
+// Arrays are padded to a multiple of SimdWidth, and padding lanes are transformed along with the rest.
+// Points have an implicit w = 1 and pick up the translation, vectors have w = 0 and don't.
+
+// Elements per job when transforming from several threads. A multiple of any SimdWidth
+constexpr u32 TransformBatchSize = 16 * 1024;
+
+struct V3SoA
+{
+    std::vector<f32> x, y, z;
+    u32 count;
+};
+
+struct V4SoA
+{
+    std::vector<f32> x, y, z, w;
+    u32 count;
+};
+
+struct V3Block
+{
+    f32 x[SimdWidth];
+    f32 y[SimdWidth];
+    f32 z[SimdWidth];
+};
+
+struct V3AoSoA
+{
+    std::vector<V3Block> blocks;
+    u32 count;
+};
+
+// One affine matrix per element, for the top 3 rows of an m4 (the bottom row is implied to be 0 0 0 1)
+struct AffineSoA
+{
+    std::vector<f32> e[3][4];
+    u32 count;
+};
+
+
+// Transform hierarchy
+// Nodes are stored depth-first, each field in its own array, so every node comes after its parent and a whole subtree
+// is the contiguous range [node, node + subtreeSize). Changing a node only records it as a dirty root; updating then
+// sorts those, drops the ones already inside another dirty subtree, and recomputes just those ranges front to back.
+// Big subtrees are split by their children, and the resulting independent ranges spread over worker threads.
+
+constexpr u32 TransformNoParent = U32MAX;
+// Subtrees bigger than this are split into their children when updating from several threads
+constexpr u32 TransformSubtreeBatchSize = 16 * 1024;
+
+struct TransformHierarchy
+{
+    std::vector<u32> parents;
+    std::vector<u32> subtreeSizes;          // Including the node itself
+    // Local transform relative to the parent
+    std::vector<v3> positions;
+    std::vector<qn> rotations;
+    std::vector<v3> scales;
+    std::vector<m4> worldMatrices;
+
+    std::vector<u8> dirty;
+    std::vector<u32> dirtyRoots;
+};
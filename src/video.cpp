@@ -0,0 +1,405 @@
+
+bool SubmitFrameTo( WGPUTextureView target, u32 slot );
+
+// Dropped when its shader changes, and rebuilt before the next frame is converted
+void InvalidateVideoRecorder( void* owner, int variant )
+{
+    VideoRecorder* recorder = (VideoRecorder*)owner;
+    DeferRelease( recorder->pipeline );
+    recorder->pipeline = nullptr;
+}
+
+void InitVideoPipeline( VideoRecorder* recorder )
+{
+    WGPUBindGroupLayoutEntry bindingLayouts[3];
+    for( int i = 0; i < 3; ++i )
+    {
+        bindingLayouts[i] = DefaultBinding();
+        bindingLayouts[i].binding = i;
+        bindingLayouts[i].visibility = WGPUShaderStage_Compute;
+    }
+    bindingLayouts[0].buffer.type = WGPUBufferBindingType_Uniform;
+    bindingLayouts[0].buffer.minBindingSize = sizeof(YUVParams);
+    bindingLayouts[1].texture.sampleType = WGPUTextureSampleType_UnfilterableFloat;
+    bindingLayouts[1].texture.viewDimension = WGPUTextureViewDimension_2D;
+    bindingLayouts[2].buffer.type = WGPUBufferBindingType_Storage;
+
+    WGPUBindGroupLayoutDescriptor bindGroupLayoutDesc = {};
+    bindGroupLayoutDesc.nextInChain = nullptr;
+    bindGroupLayoutDesc.entryCount = ARRAYCOUNT(bindingLayouts);
+    bindGroupLayoutDesc.entries = bindingLayouts;
+    // Survives shader reloads, and so does the bind group
+    if( !recorder->bindGroupLayout )
+        recorder->bindGroupLayout = wgpuDeviceCreateBindGroupLayout( globalDevice, &bindGroupLayoutDesc );
+
+    std::string source;
+    if( !LoadShaderSource( YUVShaderPath, &source, { recorder, 0, InvalidateVideoRecorder } ) )
+        return;
+    WGPUShaderModule shaderModule = CreateShaderModule( source.c_str(), YUVShaderPath );
+
+    WGPUPipelineLayoutDescriptor layoutDesc = {};
+    layoutDesc.nextInChain                  = nullptr;
+    layoutDesc.bindGroupLayoutCount         = 1;
+    layoutDesc.bindGroupLayouts             = &recorder->bindGroupLayout;
+    WGPUPipelineLayout pipelineLayout       = wgpuDeviceCreatePipelineLayout( globalDevice, &layoutDesc );
+
+    WGPUComputePipelineDescriptor pipelineDesc = {};
+    pipelineDesc.nextInChain                   = nullptr;
+    pipelineDesc.label                         = "YUV conversion";
+    pipelineDesc.layout                        = pipelineLayout;
+    pipelineDesc.compute.module                = shaderModule;
+    pipelineDesc.compute.entryPoint            = "cs_main";
+    pipelineDesc.compute.constantCount         = 0;
+    pipelineDesc.compute.constants             = nullptr;
+    recorder->pipeline = wgpuDeviceCreateComputePipeline( globalDevice, &pipelineDesc );
+
+    wgpuPipelineLayoutRelease( pipelineLayout );
+    wgpuShaderModuleRelease( shaderModule );
+}
+
+// Writes out frames in the order they were queued, so the main thread never blocks on the file or the encoder
+void RunVideoWriter( VideoRecorder* recorder )
+{
+    // Stands in for frames that couldn't be read back, so the stream keeps its length and timing
+    std::vector<u8> blackFrame;
+
+    for( ;; )
+    {
+        ReadbackSlot* slot = nullptr;
+        bool failed = false;
+        {
+            std::unique_lock<std::mutex> lock( recorder->writeMutex );
+            recorder->writeQueueChanged.wait( lock, [recorder]() { return recorder->quit || !recorder->writeQueue.empty(); } );
+            if( recorder->writeQueue.empty() )
+                break;
+            slot = recorder->writeQueue.front();
+            recorder->writeQueue.pop_front();
+            failed = recorder->writeFailed;
+        }
+
+        // Once anything failed (a closed pipe, a full disk) frames are just let through
+        if( !failed )
+        {
+            u8 const* data = slot->data;
+            if( !data )
+            {
+                if( blackFrame.empty() )
+                {
+                    // Limited range black: Y at 16, both chroma planes (or the interleaved UV plane) at 128
+                    sz lumaSize = (sz)recorder->width * recorder->height;
+                    blackFrame.resize( recorder->frameSize, 128 );
+                    memset( blackFrame.data(), 16, lumaSize );
+                }
+                data = blackFrame.data();
+            }
+
+            bool ok = true;
+            if( recorder->format == VideoFormat::Y4M )
+                ok = fwrite( "FRAME\n", 1, 6, recorder->out ) == 6;
+            ok = ok && fwrite( data, 1, (size_t)recorder->frameSize, recorder->out ) == (size_t)recorder->frameSize;
+            if( !ok )
+            {
+                Log( "ERROR :: Could not write video frame %llu", slot->index );
+                failed = true;
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock( recorder->writeMutex );
+            recorder->writeFailed = recorder->writeFailed || failed;
+            slot->state = ReadbackState::Done;
+            recorder->framesWritten++;
+        }
+        recorder->writeQueueChanged.notify_all();
+    }
+}
+
+// Mapped frames go to the writer thread
+void QueueVideoFrame( ReadbackSlot* slot, void* userdata )
+{
+    VideoRecorder* recorder = (VideoRecorder*)userdata;
+    if( slot->mapFailed )
+        Log( "ERROR :: Could not map video frame %llu, writing a black frame instead", slot->index );
+
+    {
+        std::lock_guard<std::mutex> lock( recorder->writeMutex );
+        recorder->writeQueue.push_back( slot );
+    }
+    recorder->writeQueueChanged.notify_all();
+}
+
+void WaitForVideoWriter( ReadbackSlot* slot, void* userdata )
+{
+    VideoRecorder* recorder = (VideoRecorder*)userdata;
+    std::unique_lock<std::mutex> lock( recorder->writeMutex );
+    recorder->writeQueueChanged.wait( lock, [slot]() { return slot->state != ReadbackState::Busy; } );
+}
+
+bool OpenVideoOutput( VideoRecorder* recorder, char const* output )
+{
+    recorder->isPipe = output[0] == '|';
+    if( recorder->isPipe )
+        recorder->out = _popen( output + 1, "wb" );
+    else
+        recorder->out = fopen( output, "wb" );
+    if( !recorder->out )
+    {
+        Log( "ERROR :: Could not open video output '%s'", output );
+        return false;
+    }
+
+    recorder->format = recorder->isPipe || StringEndsWith( output, ".y4m" ) ? VideoFormat::Y4M : VideoFormat::NV12;
+    if( recorder->format == VideoFormat::Y4M )
+    {
+        // Chroma sited at the centre of each quad, which is what averaging them gives
+        fprintf( recorder->out, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n",
+                 recorder->width, recorder->height, recorder->fps );
+    }
+    return true;
+}
+
+void CloseVideoOutput( VideoRecorder* recorder )
+{
+    if( !recorder->out )
+        return;
+
+    if( recorder->isPipe )
+    {
+        // Waits for the encoder to finish
+        int exitCode = _pclose( recorder->out );
+        if( exitCode != 0 )
+            Log( "ERROR :: Video encoder exited with code %d", exitCode );
+    }
+    else if( fclose( recorder->out ) != 0 )
+        Log( "ERROR :: Could not finish writing the video output" );
+    recorder->out = nullptr;
+}
+
+void ReleaseVideoRecorder( VideoRecorder* recorder )
+{
+    CloseVideoOutput( recorder );
+
+    RemoveShaderDependents( recorder );
+    if( recorder->pipeline )
+        wgpuComputePipelineRelease( recorder->pipeline );
+    if( recorder->bindGroup )
+        wgpuBindGroupRelease( recorder->bindGroup );
+    if( recorder->bindGroupLayout )
+        wgpuBindGroupLayoutRelease( recorder->bindGroupLayout );
+    if( recorder->targetView )
+        wgpuTextureViewRelease( recorder->targetView );
+    DestroyGPUTexture( recorder->target );
+    DestroyGPUBuffer( recorder->paramsBuffer );
+    DestroyGPUBuffer( recorder->yuvBuffer );
+    ReleaseReadbackRing( &recorder->readbacks );
+
+    recorder->pipeline = nullptr;
+    recorder->bindGroup = nullptr;
+    recorder->bindGroupLayout = nullptr;
+    recorder->targetView = nullptr;
+    recorder->target = nullptr;
+    recorder->paramsBuffer = nullptr;
+    recorder->yuvBuffer = nullptr;
+}
+
+// Frames are rendered by the current program at the given size, which must be a multiple of 8 x 2 pixels
+bool BeginVideoRecording( VideoRecorder* recorder, char const* output, u32 width, u32 height, u32 fps )
+{
+    if( !width || !height || width % YUVBlockWidth || height % YUVBlockHeight )
+    {
+        Log( "ERROR :: Video frames must be a multiple of %u x %u pixels (asked for %u x %u)",
+             YUVBlockWidth, YUVBlockHeight, width, height );
+        return false;
+    }
+    if( width > globalLimits.maxTextureDimension2D || height > globalLimits.maxTextureDimension2D )
+    {
+        Log( "ERROR :: Video frames can't be larger than %u pixels a side", globalLimits.maxTextureDimension2D );
+        return false;
+    }
+
+    recorder->width = width;
+    recorder->height = height;
+    recorder->fps = Max( fps, 1u );
+    recorder->frameSize = (sz)width * height * 3 / 2;
+    recorder->framesWritten = 0;
+    recorder->writeQueue.clear();
+    recorder->quit = false;
+    recorder->writeFailed = false;
+    recorder->elapsedMillis = 0;
+
+    if( !OpenVideoOutput( recorder, output ) )
+        return false;
+
+    // Same format as the swap chain, so the program's pipelines and bundles can draw into it
+    WGPUTextureDescriptor textureDesc = {};
+    textureDesc.nextInChain           = nullptr;
+    textureDesc.label                 = "Video frame";
+    textureDesc.usage                 = WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_TextureBinding;
+    textureDesc.dimension             = WGPUTextureDimension_2D;
+    textureDesc.size                  = { width, height, 1 };
+    textureDesc.format                = globalSwapChainFormat;
+    textureDesc.mipLevelCount         = 1;
+    textureDesc.sampleCount           = 1;
+    textureDesc.viewFormatCount       = 0;
+    textureDesc.viewFormats           = nullptr;
+    recorder->target = CreateGPUTexture( &textureDesc, "Video recording" );
+    if( recorder->target )
+        recorder->targetView = wgpuTextureCreateView( recorder->target, nullptr );
+
+    WGPUBufferDescriptor bufferDesc = {};
+    bufferDesc.nextInChain          = nullptr;
+    bufferDesc.mappedAtCreation     = false;
+
+    bufferDesc.label = "YUV params";
+    bufferDesc.usage = WGPUBufferUsage_Uniform | WGPUBufferUsage_CopyDst;
+    bufferDesc.size = sizeof(YUVParams);
+    recorder->paramsBuffer = CreateGPUBuffer( &bufferDesc, "Video recording" );
+
+    bufferDesc.label = "YUV frame";
+    bufferDesc.usage = WGPUBufferUsage_Storage | WGPUBufferUsage_CopySrc;
+    bufferDesc.size = (u64)recorder->frameSize;
+    recorder->yuvBuffer = CreateGPUBuffer( &bufferDesc, "Video recording" );
+
+    bool readbacksOk = InitReadbackRing( &recorder->readbacks, VideoReadbackDepth, (u64)recorder->frameSize,
+                                         "Video readback", "Video recording" );
+
+    if( !recorder->targetView || !recorder->paramsBuffer || !recorder->yuvBuffer || !readbacksOk )
+    {
+        Log( "ERROR :: Could not create video recording resources for %u x %u", width, height );
+        ReleaseVideoRecorder( recorder );
+        return false;
+    }
+
+    YUVParams params = {};
+    params.width = width;
+    params.height = height;
+    params.planar = recorder->format == VideoFormat::Y4M;
+    params.linearInput = IsSRGBFormat( globalSwapChainFormat );
+    wgpuQueueWriteBuffer( globalQueue, recorder->paramsBuffer, 0, &params, sizeof(params) );
+
+    InitVideoPipeline( recorder );
+
+    WGPUBindGroupEntry bindings[3] = {};
+    bindings[0].binding = 0;
+    bindings[0].buffer = recorder->paramsBuffer;
+    bindings[0].size = sizeof(YUVParams);
+    bindings[1].binding = 1;
+    bindings[1].textureView = recorder->targetView;
+    bindings[2].binding = 2;
+    bindings[2].buffer = recorder->yuvBuffer;
+    bindings[2].size = (u64)recorder->frameSize;
+
+    WGPUBindGroupDescriptor bindGroupDesc = {};
+    bindGroupDesc.nextInChain = nullptr;
+    bindGroupDesc.layout = recorder->bindGroupLayout;
+    bindGroupDesc.entryCount = ARRAYCOUNT(bindings);
+    bindGroupDesc.entries = bindings;
+    recorder->bindGroup = wgpuDeviceCreateBindGroup( globalDevice, &bindGroupDesc );
+
+    recorder->writer = std::thread( RunVideoWriter, recorder );
+    recorder->startMillis = Platform::CurrentTimeMillis();
+
+    Log( "Recording %u x %u at %u fps into '%s' (%s, %.1f MB per frame)", width, height, recorder->fps, output,
+         recorder->format == VideoFormat::Y4M ? "Y4M" : "NV12", recorder->frameSize / (1024.0 * 1024.0) );
+    return true;
+}
+
+// Render the current program into the next frame and queue it for writing. Only blocks when all readback slots are
+// still busy, i.e. the GPU or the writer are behind
+bool RecordVideoFrame( VideoRecorder* recorder )
+{
+    ReadbackSlot* slot = NextReadbackSlot( &recorder->readbacks );
+    WaitForReadbackSlot( &recorder->readbacks, slot, QueueVideoFrame, WaitForVideoWriter, recorder );
+
+    if( !recorder->pipeline )
+        InitVideoPipeline( recorder );
+    if( !recorder->pipeline || !recorder->bindGroup || !SubmitFrameTo( recorder->targetView, 0 ) )
+        return false;
+
+    WGPUCommandEncoderDescriptor encoderDesc = {};
+    encoderDesc.nextInChain                  = nullptr;
+    encoderDesc.label                        = "Video frame";
+    WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder( globalDevice, &encoderDesc );
+
+    WGPUComputePassDescriptor passDesc = {};
+    passDesc.nextInChain = nullptr;
+    passDesc.label = "YUV conversion";
+    passDesc.timestampWriteCount = 0;
+    passDesc.timestampWrites = nullptr;
+    WGPUComputePassEncoder pass = wgpuCommandEncoderBeginComputePass( encoder, &passDesc );
+    wgpuComputePassEncoderSetPipeline( pass, recorder->pipeline );
+    wgpuComputePassEncoderSetBindGroup( pass, 0, recorder->bindGroup, 0, nullptr );
+    u32 blocksX = recorder->width / YUVBlockWidth;
+    u32 blocksY = recorder->height / YUVBlockHeight;
+    wgpuComputePassEncoderDispatchWorkgroups( pass, (blocksX + YUVWorkgroupSize - 1) / YUVWorkgroupSize,
+                                              (blocksY + YUVWorkgroupSize - 1) / YUVWorkgroupSize, 1 );
+    wgpuComputePassEncoderEnd( pass );
+
+    wgpuCommandEncoderCopyBufferToBuffer( encoder, recorder->yuvBuffer, 0, slot->buffer, 0, (u64)recorder->frameSize );
+
+    WGPUCommandBufferDescriptor cmdBufferDescriptor = {};
+    cmdBufferDescriptor.nextInChain                 = nullptr;
+    cmdBufferDescriptor.label                       = "Video frame";
+    WGPUCommandBuffer command = wgpuCommandEncoderFinish( encoder, &cmdBufferDescriptor );
+    wgpuQueueSubmit( globalQueue, 1, &command );
+#ifdef WEBGPU_BACKEND_DAWN
+    wgpuComputePassEncoderRelease( pass );
+    wgpuCommandEncoderRelease( encoder );
+    wgpuCommandBufferRelease( command );
+#endif
+
+    MapNextReadbackSlot( &recorder->readbacks );
+
+    // Pick up whatever finished meanwhile, without waiting on anything
+    PollDevice( false );
+    RetireReadbacks( &recorder->readbacks, QueueVideoFrame, recorder );
+    return true;
+}
+
+// Write out every frame still in flight, close the output (which waits for an encoder to finish) and release everything
+void EndVideoRecording( VideoRecorder* recorder )
+{
+    FinishReadbacks( &recorder->readbacks, QueueVideoFrame, WaitForVideoWriter, recorder );
+
+    if( recorder->writer.joinable() )
+    {
+        {
+            std::lock_guard<std::mutex> lock( recorder->writeMutex );
+            recorder->quit = true;
+        }
+        recorder->writeQueueChanged.notify_all();
+        recorder->writer.join();
+    }
+
+    bool failed = recorder->writeFailed;
+    ReleaseVideoRecorder( recorder );
+    recorder->elapsedMillis = Platform::CurrentTimeMillis() - recorder->startMillis;
+
+    u64 frames = recorder->framesWritten;
+    f64 seconds = recorder->elapsedMillis * 0.001;
+    Log( "Recorded %llu frames in %.2f s: %.1f fps, %.1f MB/s%s", frames, seconds, frames / Max( seconds, 1e-9 ),
+         frames * recorder->frameSize / (1024.0 * 1024.0) / Max( seconds, 1e-9 ), failed ? " (writing FAILED)" : "" );
+}
+
+// Offline recording: frames advance the program's clock by exactly one frame each, however long they take to render
+bool RecordProgramVideo( Program& program, char const* output, u32 width, u32 height, u32 frameCount, u32 fps )
+{
+    if( !SetCurrentProgram( program ) )
+        return false;
+
+    VideoRecorder recorder = {};
+    if( !BeginVideoRecording( &recorder, output, width, height, fps ) )
+        return false;
+
+    bool result = true;
+    for( u32 i = 0; i < frameCount && result; ++i )
+    {
+        Platform::SetFixedAppTime( i * 1000.0 / recorder.fps );
+        UpdateCurrentProgramInputs( (f32)width, (f32)height );
+        result = RecordVideoFrame( &recorder );
+    }
+    EndVideoRecording( &recorder );
+    Platform::SetFixedAppTime( -1 );
+
+    return result && !recorder.writeFailed;
+}
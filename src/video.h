@@ -0,0 +1,78 @@
+#pragma once
+
+// Video recording
+// The current program renders offscreen at any size, a compute pass converts each frame to YUV 4:2:0 (BT.709, limited
+// range, chroma averaged over every 2x2 block), and only that gets read back: 1.5 bytes per pixel, 37.5% of RGBA8.
+// Readbacks go through a ring of buffers, so several frames are in flight between the GPU and the CPU, and a writer
+// thread streams them out in order, either to a file or into the stdin of an encoder process, e.g.
+//
+//   App --record "|ffmpeg -y -i - -c:v libx264 -pix_fmt yuv420p out.mp4" 1920 1080 600 60 fire.wgsl
+//
+// (output, then width, height, frame count, fps and program, all optional but the output). Offline recordings step
+// the program's clock by exactly one frame each time, so they come out smooth however slow rendering is.
+// Outputs starting with '|' are commands to pipe into. Pipes and .y4m files get Y4M (planar I420, which ffmpeg takes
+// straight from stdin), anything else gets raw NV12 (e.g. '-f rawvideo -pix_fmt nv12 -s 1920x1080 -r 60 -i out.nv12').
+// Whenever the ring is full, recording waits for the oldest frame to be written, so a slow encoder holds rendering back.
+// A frame that can't be read back is written out black, so the stream still has one frame per frame rendered.
+
+constexpr char const* YUVShaderPath = "src/shaders/yuv.wgsl";
+constexpr u32 YUVWorkgroupSize = 8;
+// Each invocation converts a block of 8 x 2 pixels, so frames must be a multiple of that
+constexpr u32 YUVBlockWidth = 8;
+constexpr u32 YUVBlockHeight = 2;
+constexpr int VideoReadbackDepth = 4;
+
+enum class VideoFormat : u32
+{
+    Y4M,            // Y4M stream, I420 planes
+    NV12,           // Raw frames, Y plane then interleaved UV
+};
+
+struct YUVParams
+{
+    u32 width;
+    u32 height;
+    u32 planar;                 // I420 instead of NV12
+    u32 linearInput;            // Source is an sRGB format, so texture loads come back linear
+};
+static_assert( sizeof(YUVParams) % 16 == 0 );
+
+struct VideoRecorder
+{
+    u32 width;
+    u32 height;
+    u32 fps;
+    VideoFormat format;
+    sz frameSize;
+
+    FILE* out;
+    bool isPipe;
+
+    // The program renders here
+    WGPUTexture target;
+    WGPUTextureView targetView;
+    WGPUBuffer paramsBuffer;
+    WGPUBuffer yuvBuffer;
+    WGPUBindGroupLayout bindGroupLayout;
+    WGPUBindGroup bindGroup;
+    WGPUComputePipeline pipeline;
+
+    // Frames get handed to the writer in order, which marks them done once written
+    ReadbackRing readbacks;
+
+    std::thread writer;
+    std::mutex writeMutex;
+    std::condition_variable writeQueueChanged;
+    std::deque<ReadbackSlot*> writeQueue;
+    bool quit;
+    bool writeFailed;
+    std::atomic<u64> framesWritten;
+
+    f64 startMillis;
+    f64 elapsedMillis;          // From beginning the recording until everything was written
+};
+
+bool BeginVideoRecording( VideoRecorder* recorder, char const* output, u32 width, u32 height, u32 fps );
+bool RecordVideoFrame( VideoRecorder* recorder );
+void EndVideoRecording( VideoRecorder* recorder );
+bool RecordProgramVideo( Program& program, char const* output, u32 width, u32 height, u32 frameCount, u32 fps );
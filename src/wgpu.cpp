@@ -76,24 +76,36 @@ void OnDeviceError( WGPUErrorType type, char const* message, void* pUserData )
 };
 
 
-WGPURenderPipeline CreatePipeline( Program const& program )
+WGPUShaderModule CreateShaderModule( char const* source, char const* label )
 {
-    // Load shaders
-    Buffer<> shaderSource = Platform::ReadEntireFile( program.shaderPath, &globalAlloc, true );
-
     WGPUShaderModuleWGSLDescriptor shaderCodeDesc = {};
     shaderCodeDesc.chain.next                     = nullptr;
     shaderCodeDesc.chain.sType                    = WGPUSType_ShaderModuleWGSLDescriptor;
-    shaderCodeDesc.code                           = (char const*)shaderSource.begin();
+    shaderCodeDesc.code                           = source;
     WGPUShaderModuleDescriptor shaderDesc         = {};
 #ifdef WEBGPU_BACKEND_WGPU
     shaderDesc.hintCount                          = 0;
     shaderDesc.hints                              = nullptr;
 #endif
     shaderDesc.nextInChain                        = &shaderCodeDesc.chain;
-    WGPUShaderModule shaderModule                 = wgpuDeviceCreateShaderModule( globalDevice, &shaderDesc );
+    shaderDesc.label                              = label;
+    return wgpuDeviceCreateShaderModule( globalDevice, &shaderDesc );
+}
 
-    FREE( &globalAlloc, shaderSource.data );
+void InvalidateProgramPipeline( void* owner, int pass );
+
+// Create the pipeline for the program's main pass, or for one of its offscreen buffers.
+// The shader and its includes are read unless they've been read already (see ReadShaderFilesAsync)
+RenderPipelineHandle CreatePipeline( Program const& program, int bufferIndex = MainPass,
+                                     ShaderFileContents const* contents = nullptr )
+{
+    ProgramBuffer const* buffer = bufferIndex != MainPass ? &program.buffers[bufferIndex] : nullptr;
+    char const* shaderPath = buffer ? buffer->shaderPath : program.shaderPath;
+
+    // Load shaders
+    std::string shaderSource;
+    LoadShaderSource( shaderPath, &shaderSource, { (void*)&program, bufferIndex, InvalidateProgramPipeline }, contents );
+    WGPUShaderModule shaderModule = CreateShaderModule( shaderSource.c_str(), shaderPath );
 
     // Fragment, blend, color states
     WGPUFragmentState fragmentState  = {};
@@ -109,8 +121,9 @@ WGPURenderPipeline CreatePipeline( Program const& program )
     blendState.alpha.dstFactor       = WGPUBlendFactor_One;
     blendState.alpha.operation       = WGPUBlendOperation_Add;
     WGPUColorTargetState colorTarget = {};
-    colorTarget.format               = globalSwapChainFormat;
-    colorTarget.blend                = &blendState;
+    colorTarget.format               = buffer ? buffer->format : globalSwapChainFormat;
+    // Buffers hold arbitrary data in all four channels, so they just overwrite their target
+    colorTarget.blend                = buffer ? nullptr : &blendState;
     colorTarget.writeMask            = WGPUColorWriteMask_All;
     // We have only one target because our render pass has only one output color attachment.
     fragmentState.targetCount        = 1;
@@ -119,22 +132,26 @@ WGPURenderPipeline CreatePipeline( Program const& program )
     // Render pipeline
     WGPUPipelineLayoutDescriptor layoutDesc = {};
     layoutDesc.nextInChain                  = nullptr;
-    layoutDesc.bindGroupLayoutCount         = program.bindGroupLayout ? 1 : 0;
-    layoutDesc.bindGroupLayouts             = program.bindGroupLayout ? &program.bindGroupLayout : nullptr;
+    WGPUBindGroupLayout bindGroupLayout     = GetResource( buffer ? buffer->bindGroupLayout : program.bindGroupLayout );
+    layoutDesc.bindGroupLayoutCount         = bindGroupLayout ? 1 : 0;
+    layoutDesc.bindGroupLayouts             = bindGroupLayout ? &bindGroupLayout : nullptr;
     WGPUPipelineLayout pipelineLayout       = wgpuDeviceCreatePipelineLayout( globalDevice, &layoutDesc );
 
+    // Buffers are always a fullscreen quad
+    int vertexBufferCount = buffer ? 0 : program.vertexBufferCount;
+    WGPUPrimitiveTopology topology = (!buffer && program.topology != -1) ? program.topology : WGPUPrimitiveTopology_TriangleStrip;
+
     WGPURenderPipelineDescriptor pipelineDesc       = {};
     pipelineDesc.nextInChain                        = nullptr;
-    // TODO Only 1 buffer for now
-    // TODO Assumes all attribs are in the same buffer
-    pipelineDesc.vertex.bufferCount                 = program.vertexAttribs.size() ? 1 : 0;
-    pipelineDesc.vertex.buffers                     = program.vertexAttribs.size() ? &program.vertexBufferLayout : nullptr;
+    pipelineDesc.label                              = shaderPath;
+    pipelineDesc.vertex.bufferCount                 = vertexBufferCount;
+    pipelineDesc.vertex.buffers                     = vertexBufferCount ? program.vertexBufferLayouts : nullptr;
     pipelineDesc.vertex.module                      = shaderModule;
     pipelineDesc.vertex.entryPoint                  = "vs_main";
     pipelineDesc.vertex.constantCount               = 0;
     pipelineDesc.vertex.constants                   = nullptr;
     // Each sequence of 3 vertices is considered as a triangle
-    pipelineDesc.primitive.topology                 = (program.topology != -1) ? program.topology : WGPUPrimitiveTopology_TriangleStrip;
+    pipelineDesc.primitive.topology                 = topology;
     // We'll see later how to specify the order in which vertices should be
     // connected. When not specified, vertices are considered sequentially.
     pipelineDesc.primitive.stripIndexFormat         = WGPUIndexFormat_Undefined;
@@ -142,10 +159,9 @@ WGPURenderPipeline CreatePipeline( Program const& program )
     // from the front of the face, its corner vertices are enumerated
     // in the counter-clockwise (CCW) order.
     pipelineDesc.primitive.frontFace                = WGPUFrontFace_CCW;
-    // But the face orientation does not matter much because we do not
-    // cull (i.e. "hide") the faces pointing away from us (which is often
-    // used for optimization).
-    pipelineDesc.primitive.cullMode                 = WGPUCullMode_None;
+    // But the face orientation does not matter much unless the program
+    // asks to cull (i.e. "hide") the faces pointing away from us.
+    pipelineDesc.primitive.cullMode                 = buffer ? WGPUCullMode_None : program.cullMode;
     pipelineDesc.fragment                           = &fragmentState;
     pipelineDesc.depthStencil                       = nullptr;
     // Samples per pixel
@@ -157,54 +173,565 @@ WGPURenderPipeline CreatePipeline( Program const& program )
     pipelineDesc.layout = pipelineLayout;
 
     WGPURenderPipeline pipeline = wgpuDeviceCreateRenderPipeline( globalDevice, &pipelineDesc );
-    return pipeline;
+
+    // The pipeline keeps its own references to these
+    wgpuPipelineLayoutRelease( pipelineLayout );
+    wgpuShaderModuleRelease( shaderModule );
+
+    return RegisterResource( pipeline, shaderPath );
 }
 
 
+BindGroupLayoutHandle CreateChannelBindGroupLayout( Program* program, WGPUShaderStageFlags visibility,
+                                                    ChannelInput const* channels, int channelCount,
+                                                    InstanceCulling const* culling = nullptr );
+WGPUBindGroup CreateChannelBindGroup( Program const* program, int pass );
+void ReleaseProgramResources( Program* program );
+
+// Start reading what setting the program up is going to need, so it overlaps whatever comes first (like creating the
+// device). Buffer passes are only declared by the init function, so just the main shader is read ahead of those
+void PrefetchProgram( Program const& program )
+{
+    PrefetchFile( program.shaderPath, true );
+    if( program.prefetchFunc )
+        program.prefetchFunc( &program, program.userdata );
+}
+
 bool SetCurrentProgram( Program& program )
 {
+    // Anything the previous program created is released once the GPU is done with it
+    if( globalProgram )
+        ReleaseProgramResources( globalProgram );
     globalProgram = &program;
 
+    // Everything created from here on (including meshes and textures loaded by the init function) is accounted to this program
+    char const* previousOwner = SetGPUMemoryOwner( program.shaderPath );
+
+    // Layouts are re-declared by the init function every time
+    ReleaseProgramResources( &program );
+    program.vertexBufferCount = 0;
+    program.indexBuffer = nullptr;
+    program.uniformSize = 0;
+    program.channelCount = 0;
+    program.bufferCount = 0;
+    program.frameIndex = 0;
+    program.updateFrameIndex = 0;
+    // Whatever the previous program (or this one, last time) left for encoding doesn't apply anymore
+    for( ProgramFrameData& data : program.frameData )
+        data.ready = false;
+    program.updating = nullptr;
+    program.culling = {};
+    program.rayTracing = {};
     if( program.initFunc )
         program.initFunc( &program, program.userdata );
 
-    globalPipeline = CreatePipeline( program );
+    if( program.uniformSize || program.channelCount || program.culling.enabled )
+        program.bindGroupLayout = CreateChannelBindGroupLayout( &program, program.uniformVisibility,
+                                                                program.channels, program.channelCount, &program.culling );
+
+    bool result = true;
+    for( int i = 0; i < program.bufferCount; ++i )
+    {
+        ProgramBuffer& buffer = program.buffers[i];
+        buffer.bindGroupLayout = CreateChannelBindGroupLayout( &program, WGPUShaderStage_Fragment,
+                                                               buffer.channels, buffer.channelCount );
+        buffer.pipeline = CreatePipeline( program, i );
+        result = result && buffer.pipeline;
+    }
+
+    program.pipeline = CreatePipeline( program );
+
+    SetGPUMemoryOwner( previousOwner );
+    LogGPUMemory();
+
     // TODO Draw a pink screen when this is invalid
-    return globalPipeline != nullptr;
+    return result && program.pipeline;
+}
+
+// (Re)create offscreen buffer targets whenever the viewport size changes
+void ResizeProgramBuffers( Program* program, u32 width, u32 height )
+{
+    for( int i = 0; i < program->bufferCount; ++i )
+    {
+        ProgramBuffer& buffer = program->buffers[i];
+        if( buffer.width == width && buffer.height == height )
+            continue;
+
+        for( int t = 0; t < 2; ++t )
+        {
+            DestroyResource( &buffer.targetViews[t] );
+            DestroyResource( &buffer.targets[t] );
+
+            WGPUTextureDescriptor textureDesc = {};
+            textureDesc.nextInChain           = nullptr;
+            textureDesc.label                 = buffer.shaderPath;
+            textureDesc.usage                 = WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_TextureBinding;
+            textureDesc.dimension             = WGPUTextureDimension_2D;
+            textureDesc.size                  = { width, height, 1 };
+            textureDesc.format                = buffer.format;
+            textureDesc.mipLevelCount         = 1;
+            textureDesc.sampleCount           = 1;
+            textureDesc.viewFormatCount       = 0;
+            textureDesc.viewFormats           = nullptr;
+            // NOTE New textures are zero-initialized, which is what feedback effects expect on their first frame
+            WGPUTexture target = CreateGPUTexture( &textureDesc, program->shaderPath );
+            if( !target )
+                continue;
+            buffer.targets[t] = RegisterResource( target, buffer.shaderPath );
+            buffer.targetViews[t] = RegisterResource( wgpuTextureCreateView( target, nullptr ), buffer.shaderPath );
+        }
+        buffer.width = width;
+        buffer.height = height;
+    }
+}
+
+void ResizeProgramRayTracing( Program* program, u32 width, u32 height );
+
+// Run the program's update for the next frame, rendering only a tileWidth x tileHeight region of a full
+// viewportWidth x viewportHeight image, starting at tileX, tileY. The program still sees the full image size.
+// Everything the update writes is kept in the program's frame data for the given slot, until SubmitFrameTo uploads it,
+// so this only touches the program's CPU side state, and can run while the previous frame is still being encoded
+void UpdateCurrentProgramTile( f32 viewportWidth, f32 viewportHeight, u32 tileX, u32 tileY, u32 tileWidth, u32 tileHeight,
+                               u32 slot = 0 )
+{
+    Program* program = globalProgram;
+    if( !program )
+        return;
+
+    ProgramFrameData* data = &program->frameData[slot];
+    data->frameIndex = program->updateFrameIndex;
+    // Offscreen targets are sized to the tile
+    data->targetWidth = tileWidth;
+    data->targetHeight = tileHeight;
+    data->uniforms.clear();
+    for( int s = 0; s < MaxVertexBuffers; ++s )
+        data->vertexCounts[s] = -1;
+
+    program->tileOffset = V2( (f32)tileX, (f32)tileY );
+    program->updating = data;
+    if( program->updateFunc )
+        program->updateFunc( program, program->userdata, viewportWidth, viewportHeight );
+    program->updating = nullptr;
+
+    COPY( program->culling.planes, data->cullingPlanes );
+    data->rayTraceParams = program->rayTracing.params;
+    data->ready = true;
+    program->updateFrameIndex++;
 }
 
-void UpdateCurrentProgramInputs( f32 viewportWidth, f32 viewportHeight )
+void UpdateCurrentProgramInputs( f32 viewportWidth, f32 viewportHeight, u32 slot = 0 )
 {
-    if( globalProgram && globalProgram->updateFunc )
-        globalProgram->updateFunc( globalProgram, globalProgram->userdata, viewportWidth, viewportHeight );
+    UpdateCurrentProgramTile( viewportWidth, viewportHeight, 0, 0, (u32)viewportWidth, (u32)viewportHeight, slot );
 }
 
 void ParseSwitchFile( char const* path );
+u64 StreamTextureUploads( TextureStreamer* streamer, StagingBelt* belt, WGPUCommandEncoder encoder );
+void* StagingWrite( StagingBelt* belt, WGPUBuffer dst, u64 dstOffset, u64 size );
+void FlushStagingBelt( StagingBelt* belt, WGPUCommandEncoder encoder );
+void RecallStagingBelt( StagingBelt* belt );
+void UploadUniformBuffer( Program* program, void const* data, size_t size );
+void UploadVertexBuffer( Program* program, int slot, void const* data, int count );
+void WriteCullingParams( InstanceCulling const* culling, u32 drawCount, v4 const* planes );
+bool EncodeInstanceCulling( WGPUCommandEncoder encoder, InstanceCulling const* culling,
+                            InstanceCuller* culler = &globalInstanceCuller );
+void ReleaseInstanceCulling( InstanceCulling* culling );
+void WriteRayTracingParams( RayTracing const* tracing, RayTraceParams params );
+bool EncodeRayTracing( WGPUCommandEncoder encoder, RayTracing const* tracing, RayTracer* tracer = &globalRayTracer );
+void ReleaseRayTracing( RayTracing* tracing );
+
+struct PipelineReload
+{
+    Program* program;
+    int pass;
+};
+
+// Re-read the shader for a pass (and everything it includes) in the background, and swap in the new pipeline once
+// it's all there
+void ReloadPipeline( Program* program, int pass )
+{
+    PipelineReload* reload = NEW( &globalAlloc, PipelineReload )();
+    reload->program = program;
+    reload->pass = pass;
+
+    char const* path = pass != MainPass ? program->buffers[pass].shaderPath : program->shaderPath;
+    ReadShaderFilesAsync( path, []( ShaderFileContents const* contents, void* userdata )
+    {
+        PipelineReload* reload = (PipelineReload*)userdata;
+        // Programs may have been switched in the meantime
+        Program* program = reload->program;
+        if( contents && program == globalProgram )
+        {
+            RenderPipelineHandle* pipeline = reload->pass != MainPass ? &program->buffers[reload->pass].pipeline
+                                                                      : &program->pipeline;
+            // The old one may still be in use by frames in flight
+            DestroyResource( pipeline );
+            *pipeline = CreatePipeline( *program, reload->pass, contents );
+        }
+
+        DELETE( &globalAlloc, reload, PipelineReload );
+    }, reload );
+}
+
+// Programs only have pipelines registered while they're current, and those rebuild in the background
+void InvalidateProgramPipeline( void* owner, int pass )
+{
+    Program* program = (Program*)owner;
+    if( program == globalProgram )
+        ReloadPipeline( program, pass );
+}
 
 bool OnShaderUpdated( char const* filename )
 {
     char path[256];
     snprintf( path, sizeof(path), "%s/%s", ShadersDir, filename );
 
-    bool result = false;
     if( strcmp( path, "src/shaders/switch.wgsl" ) == 0 )
     {
         ParseSwitchFile( path );
-        result = true;
+        return true;
     }
-    else if( globalProgram && strcmp( path, globalProgram->shaderPath ) == 0 )
+
+    // Everything built from it, directly or through includes
+    return InvalidateShaderFile( path ) > 0;
+}
+
+
+// Thin overloads, so the same draw sequence can be encoded into either a render pass or a render bundle
+INLINE void EncodeSetPipeline( WGPURenderPassEncoder e, WGPURenderPipeline pipeline ) { wgpuRenderPassEncoderSetPipeline( e, pipeline ); }
+INLINE void EncodeSetPipeline( WGPURenderBundleEncoder e, WGPURenderPipeline pipeline ) { wgpuRenderBundleEncoderSetPipeline( e, pipeline ); }
+INLINE void EncodeSetBindGroup( WGPURenderPassEncoder e, WGPUBindGroup group ) { wgpuRenderPassEncoderSetBindGroup( e, 0, group, 0, nullptr ); }
+INLINE void EncodeSetBindGroup( WGPURenderBundleEncoder e, WGPUBindGroup group ) { wgpuRenderBundleEncoderSetBindGroup( e, 0, group, 0, nullptr ); }
+INLINE void EncodeSetVertexBuffer( WGPURenderPassEncoder e, int slot, WGPUBuffer buffer, u64 size )
+{ wgpuRenderPassEncoderSetVertexBuffer( e, slot, buffer, 0, size ); }
+INLINE void EncodeSetVertexBuffer( WGPURenderBundleEncoder e, int slot, WGPUBuffer buffer, u64 size )
+{ wgpuRenderBundleEncoderSetVertexBuffer( e, slot, buffer, 0, size ); }
+INLINE void EncodeSetIndexBuffer( WGPURenderPassEncoder e, WGPUBuffer buffer, WGPUIndexFormat format, u64 size )
+{ wgpuRenderPassEncoderSetIndexBuffer( e, buffer, format, 0, size ); }
+INLINE void EncodeSetIndexBuffer( WGPURenderBundleEncoder e, WGPUBuffer buffer, WGPUIndexFormat format, u64 size )
+{ wgpuRenderBundleEncoderSetIndexBuffer( e, buffer, format, 0, size ); }
+INLINE void EncodeDraw( WGPURenderPassEncoder e, int vertexCount, int instanceCount ) { wgpuRenderPassEncoderDraw( e, vertexCount, instanceCount, 0, 0 ); }
+INLINE void EncodeDraw( WGPURenderBundleEncoder e, int vertexCount, int instanceCount ) { wgpuRenderBundleEncoderDraw( e, vertexCount, instanceCount, 0, 0 ); }
+INLINE void EncodeDrawIndexed( WGPURenderPassEncoder e, int indexCount, int instanceCount )
+{ wgpuRenderPassEncoderDrawIndexed( e, indexCount, instanceCount, 0, 0, 0 ); }
+INLINE void EncodeDrawIndexed( WGPURenderBundleEncoder e, int indexCount, int instanceCount )
+{ wgpuRenderBundleEncoderDrawIndexed( e, indexCount, instanceCount, 0, 0, 0 ); }
+INLINE void EncodeDrawIndirect( WGPURenderPassEncoder e, WGPUBuffer args, bool indexed )
+{ indexed ? wgpuRenderPassEncoderDrawIndexedIndirect( e, args, 0 ) : wgpuRenderPassEncoderDrawIndirect( e, args, 0 ); }
+INLINE void EncodeDrawIndirect( WGPURenderBundleEncoder e, WGPUBuffer args, bool indexed )
+{ indexed ? wgpuRenderBundleEncoderDrawIndexedIndirect( e, args, 0 ) : wgpuRenderBundleEncoderDrawIndirect( e, args, 0 ); }
+
+// Record all draw commands for a pass (a buffer index or MainPass)
+template <typename EncoderT>
+void EncodePassDraws( EncoderT encoder, Program const* program, int pass, WGPUBindGroup bindGroup )
+{
+    if( pass != MainPass )
     {
-        // Recreate the pipeline
-        // TODO Reinit?
-        globalPipeline = CreatePipeline( *globalProgram );
-        result = true;
+        // Buffers always draw a fullscreen quad
+        EncodeSetPipeline( encoder, GetResource( program->buffers[pass].pipeline ) );
+        if( bindGroup )
+            EncodeSetBindGroup( encoder, bindGroup );
+        EncodeDraw( encoder, 4, 1 );
+        return;
     }
 
-    return result;
+    // Select which render pipeline to use
+    EncodeSetPipeline( encoder, GetResource( program->pipeline ) );
+    if( bindGroup )
+        EncodeSetBindGroup( encoder, bindGroup );
+
+    // Set all vertex buffers (both per-vertex and per-instance)
+    for( int slot = 0; slot < program->vertexBufferCount; ++slot )
+        EncodeSetVertexBuffer( encoder, slot, program->vertexBuffers[slot], program->vertexBufferSizes[slot] );
+
+    if( program->culling.enabled )
+    {
+        // The instance count comes from the culling pass. Nothing to draw until some bounds are set
+        WGPUBuffer argsBuffer = GetResource( program->culling.argsBuffer );
+        if( !argsBuffer )
+            return;
+
+        if( program->indexBuffer )
+            EncodeSetIndexBuffer( encoder, program->indexBuffer, program->indexFormat, program->indexBufferSize );
+        EncodeDrawIndirect( encoder, argsBuffer, program->indexBuffer != nullptr );
+    }
+    else if( program->vertexBufferCount )
+    {
+        if( program->indexBuffer )
+        {
+            EncodeSetIndexBuffer( encoder, program->indexBuffer, program->indexFormat, program->indexBufferSize );
+            EncodeDrawIndexed( encoder, program->indexCount, program->instanceCount );
+        }
+        else
+        {
+            // Draw all vertices once for each instance
+            EncodeDraw( encoder, program->elementCount, program->instanceCount );
+        }
+    }
+    else
+    {
+        // TODO Assume no vertex buffer means we just want a fullscreen quad
+        EncodeDraw( encoder, 4, program->instanceCount );
+    }
+}
+
+WGPUTextureView ResolveChannelView( Program const* program, ChannelInput const& channel, int pass );
+
+// Hash of every object (and count) the draws for a pass reference. Contents of buffers and textures don't matter,
+// so uniform updates and texture streaming don't invalidate anything
+u64 ComputePassBundleKey( Program const* program, int pass )
+{
+    ProgramBuffer const* buffer = pass != MainPass ? &program->buffers[pass] : nullptr;
+    ChannelInput const* channels = buffer ? buffer->channels : program->channels;
+    int channelCount = buffer ? buffer->channelCount : program->channelCount;
+
+    u64 key = HashCombine( 0, (u64)GetResource( buffer ? buffer->pipeline : program->pipeline ) );
+    key = HashCombine( key, (u64)GetResource( buffer ? buffer->bindGroupLayout : program->bindGroupLayout ) );
+    key = HashCombine( key, (u64)GetResource( program->uniformBuffer ) );
+    key = HashCombine( key, (u64)GetResource( program->sampler ) );
+    for( int i = 0; i < channelCount; ++i )
+        key = HashCombine( key, (u64)ResolveChannelView( program, channels[i], pass ) );
+
+    if( !buffer )
+    {
+        for( int slot = 0; slot < program->vertexBufferCount; ++slot )
+        {
+            key = HashCombine( key, (u64)program->vertexBuffers[slot] );
+            key = HashCombine( key, program->vertexBufferSizes[slot] );
+        }
+        key = HashCombine( key, (u64)program->indexBuffer );
+        key = HashCombine( key, program->indexBufferSize );
+        key = HashCombine( key, program->indexFormat );
+        key = HashCombine( key, program->indexCount );
+        key = HashCombine( key, program->elementCount );
+        key = HashCombine( key, program->instanceCount );
+        key = HashCombine( key, program->culling.enabled );
+        key = HashCombine( key, (u64)GetResource( program->culling.argsBuffer ) );
+        key = HashCombine( key, (u64)GetResource( program->culling.visibleBuffer ) );
+        key = HashCombine( key, (u64)GetResource( program->culling.boundsBuffer ) );
+    }
+    return key;
+}
+
+// Get the bundle for a pass in the current frame, re-recording it only if anything it references has changed
+// (hot reloads, resizes, vertex buffers growing..)
+WGPURenderBundle GetPassBundle( Program* program, int pass, WGPUTextureFormat format )
+{
+    PassBundle* bundles = pass != MainPass ? program->buffers[pass].bundles : program->bundles;
+    PassBundle& slot = bundles[program->frameIndex & 1];
+
+    u64 key = ComputePassBundleKey( program, pass );
+    if( slot.bundle && slot.key == key )
+        return slot.bundle;
+
+    // The previous bundle may still be executing
+    DeferRelease( slot.bundle );
+    DeferRelease( slot.bindGroup );
+    slot.bindGroup = CreateChannelBindGroup( program, pass );
+
+    char const* label = pass != MainPass ? program->buffers[pass].shaderPath : program->shaderPath;
+    WGPURenderBundleEncoderDescriptor encoderDesc = {};
+    encoderDesc.nextInChain                       = nullptr;
+    encoderDesc.label                             = label;
+    encoderDesc.colorFormatsCount                 = 1;
+    encoderDesc.colorFormats                      = &format;
+    encoderDesc.depthStencilFormat                = WGPUTextureFormat_Undefined;
+    encoderDesc.sampleCount                       = 1;
+    encoderDesc.depthReadOnly                     = false;
+    encoderDesc.stencilReadOnly                   = false;
+    WGPURenderBundleEncoder encoder = wgpuDeviceCreateRenderBundleEncoder( globalDevice, &encoderDesc );
+
+    EncodePassDraws( encoder, program, pass, slot.bindGroup );
+
+    WGPURenderBundleDescriptor bundleDesc = {};
+    bundleDesc.nextInChain                = nullptr;
+    bundleDesc.label                      = label;
+    slot.bundle = wgpuRenderBundleEncoderFinish( encoder, &bundleDesc );
+    slot.key = key;
+    program->bundlesRecorded++;
+#ifdef WEBGPU_BACKEND_DAWN
+    wgpuRenderBundleEncoderRelease( encoder );
+#endif
+
+    return slot.bundle;
+}
+
+void ReleasePassBundles( PassBundle* bundles )
+{
+    for( int i = 0; i < 2; ++i )
+    {
+        DeferRelease( bundles[i].bundle );
+        DeferRelease( bundles[i].bindGroup );
+        bundles[i] = {};
+    }
+}
+
+// Encode a whole pass into its own command buffer, either replaying the job's bundle or encoding its draws directly.
+// Only uses thread safe API, and only reads from the program
+void EncodePassJob( Program const* program, PassEncodeJob* job )
+{
+    WGPUCommandEncoderDescriptor encoderDesc = {};
+    encoderDesc.nextInChain                  = nullptr;
+    encoderDesc.label                        = job->label;
+    WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder( globalDevice, &encoderDesc );
+
+    WGPURenderPassColorAttachment colorAttachment = {};
+    colorAttachment.view                          = job->target;
+    colorAttachment.resolveTarget                 = nullptr;
+    colorAttachment.loadOp                        = WGPULoadOp_Clear;
+    colorAttachment.storeOp                       = WGPUStoreOp_Store;
+    colorAttachment.clearValue                    = job->clearValue;
+
+    WGPURenderPassDescriptor passDesc = {};
+    passDesc.nextInChain              = nullptr;
+    passDesc.label                    = job->label;
+    passDesc.colorAttachmentCount     = 1;
+    passDesc.colorAttachments         = &colorAttachment;
+    passDesc.depthStencilAttachment   = nullptr;
+    passDesc.timestampWriteCount      = 0;
+    passDesc.timestampWrites          = nullptr;
+
+    WGPURenderPassEncoder renderPass = wgpuCommandEncoderBeginRenderPass( encoder, &passDesc );
+    if( job->bundle )
+        wgpuRenderPassEncoderExecuteBundles( renderPass, 1, &job->bundle );
+    else
+    {
+        WGPUBindGroup bindGroup = CreateChannelBindGroup( program, job->pass );
+        EncodePassDraws( renderPass, program, job->pass, bindGroup );
+        // The pass keeps its own reference until it's done
+        if( bindGroup )
+            wgpuBindGroupRelease( bindGroup );
+    }
+    wgpuRenderPassEncoderEnd( renderPass );
+
+    WGPUCommandBufferDescriptor cmdBufferDescriptor = {};
+    cmdBufferDescriptor.nextInChain                 = nullptr;
+    cmdBufferDescriptor.label                       = job->label;
+    job->commands = wgpuCommandEncoderFinish( encoder, &cmdBufferDescriptor );
+
+#ifdef WEBGPU_BACKEND_DAWN
+    wgpuRenderPassEncoderRelease( renderPass );
+    wgpuCommandEncoderRelease( encoder );
+#endif
+}
+
+// Encode all passes of a frame, spread over up to threadCount threads (0 means one per core).
+// Command buffers come out in job order, which is the order they must be submitted in
+void EncodePassJobs( Program* program, PassEncodeJob* jobs, int jobCount, int threadCount )
+{
+    // Bundles live in the program and may need re-recording, so they're resolved up front
+    for( int i = 0; i < jobCount; ++i )
+        jobs[i].bundle = program->useRenderBundles ? GetPassBundle( program, jobs[i].pass, jobs[i].format ) : nullptr;
+
+#ifdef WEBGPU_BACKEND_DAWN
+    // Dawn's C API isn't thread safe for us (yet)
+    threadCount = 1;
+#endif
+
+    ParallelFor( (sz)jobCount, 1, [program, jobs]( sz begin, sz end )
+    {
+        for( sz i = begin; i < end; ++i )
+            EncodePassJob( program, &jobs[i] );
+    }, (sz)threadCount );
+}
+
+// Upload what the program's update left in the given slot, creating or growing buffers as needed, and catch the
+// offscreen targets up with it. Must happen before the staging belt is flushed
+void ApplyProgramFrameData( Program* program, u32 slot )
+{
+    ProgramFrameData* data = &program->frameData[slot];
+    if( !data->ready )
+        return;
+
+    program->frameIndex = data->frameIndex;
+    ResizeProgramBuffers( program, data->targetWidth, data->targetHeight );
+    ResizeProgramRayTracing( program, data->targetWidth, data->targetHeight );
+
+    if( !data->uniforms.empty() )
+        UploadUniformBuffer( program, data->uniforms.data(), data->uniforms.size() );
+    for( int s = 0; s < program->vertexBufferCount; ++s )
+    {
+        if( data->vertexCounts[s] >= 0 )
+            UploadVertexBuffer( program, s, data->vertexData[s].data(), data->vertexCounts[s] );
+    }
+    data->ready = false;
 }
 
+// Encode and submit everything for the frame, with the main pass drawing into the given view. Targets must be in
+// globalSwapChainFormat, which is what pipelines and bundles are built for.
+// The frame is whatever the program's last update for the given slot left there (see UpdateCurrentProgramTile)
+bool SubmitFrameTo( WGPUTextureView target, u32 slot = 0 )
+{
+    WGPUCommandEncoderDescriptor encoderDesc = {};
+    encoderDesc.nextInChain                  = nullptr;
+    encoderDesc.label                        = "Command encoder";
+    WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder( globalDevice, &encoderDesc );
+
+    ApplyProgramFrameData( globalProgram, slot );
+    ProgramFrameData const& data = globalProgram->frameData[slot];
+    if( globalProgram->culling.enabled )
+        WriteCullingParams( &globalProgram->culling,
+                            globalProgram->indexBuffer ? globalProgram->indexCount : globalProgram->elementCount,
+                            data.cullingPlanes );
+    if( globalProgram->rayTracing.enabled )
+        WriteRayTracingParams( &globalProgram->rayTracing, data.rayTraceParams );
 
-bool Present( WGPUSwapChain swapChain )
+    // Copy in whatever texture data fits in this frame's budget, plus all buffer writes since last frame,
+    // before anything reads from them
+    StreamTextureUploads( &globalTextureStreamer, &globalStagingBelt, encoder );
+    FlushStagingBelt( &globalStagingBelt, encoder );
+
+    // Work out visible instances and trace the scene before any pass reads them
+    if( globalProgram->culling.enabled )
+        EncodeInstanceCulling( encoder, &globalProgram->culling );
+    if( globalProgram->rayTracing.enabled )
+        EncodeRayTracing( encoder, &globalProgram->rayTracing );
+
+    WGPUCommandBufferDescriptor cmdBufferDescriptor = {};
+    cmdBufferDescriptor.nextInChain                 = nullptr;
+    cmdBufferDescriptor.label                       = "Uploads";
+    WGPUCommandBuffer uploadCommands = wgpuCommandEncoderFinish( encoder, &cmdBufferDescriptor );
+
+    // Offscreen buffers first, in declaration order, then the main pass
+    PassEncodeJob jobs[MaxProgramBuffers + 1] = {};
+    int jobCount = 0;
+
+    u32 writeIndex = globalProgram->frameIndex & 1;
+    for( int i = 0; i < globalProgram->bufferCount; ++i )
+    {
+        ProgramBuffer const& buffer = globalProgram->buffers[i];
+
+        WGPUTextureView target = GetResource( buffer.targetViews[writeIndex] );
+        // Targets may be missing if they didn't fit in the program's memory budget
+        if( !target )
+            continue;
+
+        jobs[jobCount++] = { i, target, buffer.format, WGPUColor{ 0.0, 0.0, 0.0, 0.0 }, buffer.shaderPath, nullptr, nullptr };
+    }
+    jobs[jobCount++] = { MainPass, target, globalSwapChainFormat, ClearColor, "Main pass", nullptr, nullptr };
+
+    // Each pass gets its own command buffer, so they can all be encoded in parallel
+    EncodePassJobs( globalProgram, jobs, jobCount, globalEncodeThreadCount );
+
+    // Submit everything at once, in dependency order
+    std::vector<WGPUCommandBuffer> commands;
+    commands.push_back( uploadCommands );
+    for( int i = 0; i < jobCount; ++i )
+        commands.push_back( jobs[i].commands );
+    wgpuQueueSubmit( globalQueue, commands.size(), commands.data() );
+    RecallStagingBelt( &globalStagingBelt );
+    EndResourceFrame();
+
+#ifdef WEBGPU_BACKEND_DAWN
+    wgpuCommandEncoderRelease( encoder );
+    for( WGPUCommandBuffer command : commands )
+        wgpuCommandBufferRelease( command );
+#endif
+
+    return true;
+}
+
+// Encode and submit everything for the frame into the next swap chain texture, which is then ready to present
+bool SubmitFrame( WGPUSwapChain swapChain, u32 slot = 0 )
 {
     WGPUTextureView nextTexture = wgpuSwapChainGetCurrentTextureView( swapChain );
     if( !nextTexture )
@@ -214,69 +741,291 @@ bool Present( WGPUSwapChain swapChain )
         return false;
     }
 
+    bool result = SubmitFrameTo( nextTexture, slot );
+    wgpuTextureViewRelease( nextTexture );
+    return result;
+}
+
+// Process any pending callbacks, optionally blocking until there's some queued work finished
+void PollDevice( bool wait )
+{
+#ifdef WEBGPU_BACKEND_WGPU
+    wgpuDevicePoll( globalDevice, wait, nullptr );
+#else
+    wgpuDeviceTick( globalDevice );
+#endif
+}
+
+// Block until all work submitted so far has completed on the GPU
+void WaitForGPU()
+{
+    bool done = false;
+    auto onWorkDone = []( WGPUQueueWorkDoneStatus status, void* pUserData )
+    {
+        *(bool*)pUserData = true;
+    };
+    wgpuQueueOnSubmittedWorkDone( globalQueue, onWorkDone, &done );
+
+    while( !done )
+        PollDevice( true );
+}
+
+// Copy a range of a buffer back to the CPU. Blocks until the GPU is done with everything submitted so far.
+// Offset and size must be multiples of 4, like for any buffer copy
+bool ReadbackBuffer( WGPUBuffer src, u64 offset, u64 size, void* out )
+{
+    ASSERT( (offset & 3) == 0 && (size & 3) == 0, "Buffer readbacks must be 4 byte aligned" );
+
+    WGPUBufferDescriptor bufferDesc = {};
+    bufferDesc.nextInChain          = nullptr;
+    bufferDesc.label                = "Buffer readback";
+    bufferDesc.usage                = WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst;
+    bufferDesc.size                 = size;
+    bufferDesc.mappedAtCreation     = false;
+    WGPUBuffer buffer = CreateGPUBuffer( &bufferDesc );
+    if( !buffer )
+        return false;
+
     WGPUCommandEncoderDescriptor encoderDesc = {};
     encoderDesc.nextInChain                  = nullptr;
-    encoderDesc.label                        = "Command encoder";
+    encoderDesc.label                        = "Buffer readback";
     WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder( globalDevice, &encoderDesc );
+    wgpuCommandEncoderCopyBufferToBuffer( encoder, src, offset, buffer, 0, size );
 
-    WGPURenderPassColorAttachment renderPassColorAttachment = {};
-    renderPassColorAttachment.view                          = nextTexture;
-    renderPassColorAttachment.resolveTarget                 = nullptr;
-    renderPassColorAttachment.loadOp                        = WGPULoadOp_Clear;
-    renderPassColorAttachment.storeOp                       = WGPUStoreOp_Store;
-    renderPassColorAttachment.clearValue                    = ClearColor;
-
-    WGPURenderPassDescriptor renderPassDesc = {};
-    renderPassDesc.nextInChain              = nullptr;
-    renderPassDesc.colorAttachmentCount     = 1;
-    renderPassDesc.colorAttachments         = &renderPassColorAttachment;
-    renderPassDesc.depthStencilAttachment   = nullptr;
-    renderPassDesc.timestampWriteCount      = 0;
-    renderPassDesc.timestampWrites          = nullptr;
-
-    WGPURenderPassEncoder renderPass = wgpuCommandEncoderBeginRenderPass( encoder, &renderPassDesc );
-    // Select which render pipeline to use
-    wgpuRenderPassEncoderSetPipeline( renderPass, globalPipeline );
+    WGPUCommandBufferDescriptor cmdBufferDescriptor = {};
+    cmdBufferDescriptor.nextInChain                 = nullptr;
+    cmdBufferDescriptor.label                       = "Buffer readback";
+    WGPUCommandBuffer command = wgpuCommandEncoderFinish( encoder, &cmdBufferDescriptor );
+    wgpuQueueSubmit( globalQueue, 1, &command );
+#ifdef WEBGPU_BACKEND_DAWN
+    wgpuCommandEncoderRelease( encoder );
+    wgpuCommandBufferRelease( command );
+#endif
 
-    if( globalProgram->bindGroup )
+    struct MapResult
     {
-        // Set binding group
-        wgpuRenderPassEncoderSetBindGroup( renderPass, 0, globalProgram->bindGroup, 0, nullptr );
+        bool done;
+        bool success;
+    } result = {};
+    auto onMapped = []( WGPUBufferMapAsyncStatus status, void* pUserData )
+    {
+        MapResult* result = (MapResult*)pUserData;
+        result->success = status == WGPUBufferMapAsyncStatus_Success;
+        result->done = true;
+    };
+    wgpuBufferMapAsync( buffer, WGPUMapMode_Read, 0, size, onMapped, &result );
+    while( !result.done )
+        PollDevice( true );
+
+    if( result.success )
+    {
+        COPYP( wgpuBufferGetConstMappedRange( buffer, 0, size ), out, size );
+        wgpuBufferUnmap( buffer );
     }
-    if( globalProgram->vertexBuffer )
+
+    DestroyGPUBuffer( buffer );
+    return result.success;
+}
+
+void ReleaseReadbackRing( ReadbackRing* ring )
+{
+    for( ReadbackSlot*& slot : ring->slots )
     {
-        // Set vertex buffer while encoding the render pass
-        size_t bufferSize = globalProgram->elementCount * globalProgram->vertexBufferLayout.arrayStride;
-        wgpuRenderPassEncoderSetVertexBuffer( renderPass, 0, globalProgram->vertexBuffer, 0, bufferSize );
-        // Draw 1 vertex per point in the buffer
-        wgpuRenderPassEncoderDraw( renderPass, globalProgram->elementCount, 1, 0, 0 );
+        DestroyGPUBuffer( slot->buffer );
+        DELETE( &globalAlloc, slot, ReadbackSlot );
     }
-    else
+    ring->slots.clear();
+}
+
+bool InitReadbackRing( ReadbackRing* ring, int depth, u64 bufferSize, char const* label, char const* owner )
+{
+    WGPUBufferDescriptor bufferDesc = {};
+    bufferDesc.nextInChain          = nullptr;
+    bufferDesc.label                = label;
+    bufferDesc.usage                = WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst;
+    bufferDesc.size                 = bufferSize;
+    bufferDesc.mappedAtCreation     = false;
+
+    ring->bufferSize = bufferSize;
+    ring->submitted = 0;
+    ring->retired = 0;
+
+    bool result = true;
+    for( int i = 0; i < depth; ++i )
     {
-        // TODO Assume no vertex buffer means we just want a fullscreen quad
-        wgpuRenderPassEncoderDraw( renderPass, 4, 1, 0, 0 );
+        ReadbackSlot* slot = NEW( &globalAlloc, ReadbackSlot )();
+        slot->buffer = CreateGPUBuffer( &bufferDesc, owner );
+        slot->state = ReadbackState::Free;
+        slot->index = 0;
+        slot->data = nullptr;
+        slot->mapFailed = false;
+        slot->width = 0;
+        slot->height = 0;
+        ring->slots.push_back( slot );
+        result = result && slot->buffer;
     }
 
-    wgpuRenderPassEncoderEnd( renderPass );
+    if( !result )
+        ReleaseReadbackRing( ring );
+    return result;
+}
 
-    wgpuTextureViewRelease( nextTexture );
+// For copies of up to width x height texels of an 8 bit RGBA (or BGRA) texture
+bool InitTextureReadbackRing( ReadbackRing* ring, int depth, u32 width, u32 height, char const* label, char const* owner )
+{
+    ring->bytesPerRow = AlignUp( width * 4, TextureRowPitchAlignment );
+    return InitReadbackRing( ring, depth, (u64)ring->bytesPerRow * height, label, owner );
+}
+
+// Where the next readback goes. It must be free before copying into it (see WaitForReadbackSlot)
+ReadbackSlot* NextReadbackSlot( ReadbackRing* ring )
+{
+    return ring->slots[ring->submitted % ring->slots.size()];
+}
+
+// Start mapping the next slot, once the copy into it has been submitted
+ReadbackSlot* MapNextReadbackSlot( ReadbackRing* ring )
+{
+    auto onMapped = []( WGPUBufferMapAsyncStatus status, void* pUserData )
+    {
+        ReadbackSlot* slot = (ReadbackSlot*)pUserData;
+        slot->mapFailed = status != WGPUBufferMapAsyncStatus_Success;
+        slot->state = ReadbackState::Mapped;
+    };
+
+    ReadbackSlot* slot = NextReadbackSlot( ring );
+    slot->index = ring->submitted++;
+    slot->state = ReadbackState::Mapping;
+    wgpuBufferMapAsync( slot->buffer, WGPUMapMode_Read, 0, (size_t)ring->bufferSize, onMapped, slot );
+    return slot;
+}
+
+// Copy the top left width x height texels of a texture into the next slot, and map it
+ReadbackSlot* ReadbackTextureAsync( ReadbackRing* ring, WGPUTexture texture, u32 width, u32 height, char const* label )
+{
+    ReadbackSlot* slot = NextReadbackSlot( ring );
+    slot->width = width;
+    slot->height = height;
+
+    WGPUCommandEncoderDescriptor encoderDesc = {};
+    encoderDesc.nextInChain                  = nullptr;
+    encoderDesc.label                        = label;
+    WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder( globalDevice, &encoderDesc );
+
+    WGPUImageCopyTexture src = {};
+    src.texture = texture;
+    src.mipLevel = 0;
+    src.origin = { 0, 0, 0 };
+    src.aspect = WGPUTextureAspect_All;
+
+    WGPUImageCopyBuffer dst = {};
+    dst.buffer = slot->buffer;
+    dst.layout.offset = 0;
+    dst.layout.bytesPerRow = ring->bytesPerRow;
+    dst.layout.rowsPerImage = height;
+
+    WGPUExtent3D extent = { width, height, 1 };
+    wgpuCommandEncoderCopyTextureToBuffer( encoder, &src, &dst, &extent );
 
-    std::vector<WGPUCommandBuffer> commands;
     WGPUCommandBufferDescriptor cmdBufferDescriptor = {};
     cmdBufferDescriptor.nextInChain                 = nullptr;
-    cmdBufferDescriptor.label                       = "Command buffer";
+    cmdBufferDescriptor.label                       = label;
     WGPUCommandBuffer command = wgpuCommandEncoderFinish( encoder, &cmdBufferDescriptor );
-    commands.push_back( command );
-    // Submit
-    wgpuQueueSubmit( globalQueue, commands.size(), commands.data() );
-
+    wgpuQueueSubmit( globalQueue, 1, &command );
 #ifdef WEBGPU_BACKEND_DAWN
     wgpuCommandEncoderRelease( encoder );
     wgpuCommandBufferRelease( command );
 #endif
 
-    wgpuSwapChainPresent( swapChain );
-    return true;
+    return MapNextReadbackSlot( ring );
+}
+
+// Hand mapped slots over to onMapped (oldest first, and never skipping one), and recycle the ones consumers are done with
+void RetireReadbacks( ReadbackRing* ring, ReadbackFunc* onMapped, void* userdata )
+{
+    while( ring->retired < ring->submitted )
+    {
+        ReadbackSlot* slot = ring->slots[ring->retired % ring->slots.size()];
+        if( slot->state != ReadbackState::Mapped )
+            break;
+
+        slot->data = slot->mapFailed ? nullptr
+            : (u8 const*)wgpuBufferGetConstMappedRange( slot->buffer, 0, (size_t)ring->bufferSize );
+        slot->state = ReadbackState::Busy;
+        ring->retired++;
+        onMapped( slot, userdata );
+    }
+
+    for( ReadbackSlot* slot : ring->slots )
+    {
+        if( slot->state != ReadbackState::Done )
+            continue;
+
+        if( !slot->mapFailed )
+            wgpuBufferUnmap( slot->buffer );
+        slot->data = nullptr;
+        slot->state = ReadbackState::Free;
+    }
+}
+
+// Block until the slot can be reused, retiring others meanwhile. Slots still with their consumer are waited on through
+// waitBusy. Must be called on slots in the order they were submitted
+void WaitForReadbackSlot( ReadbackRing* ring, ReadbackSlot* slot, ReadbackFunc* onMapped, ReadbackFunc* waitBusy,
+                          void* userdata )
+{
+    for( ;; )
+    {
+        RetireReadbacks( ring, onMapped, userdata );
+
+        ReadbackState state = slot->state;
+        if( state == ReadbackState::Free )
+            break;
+        else if( state == ReadbackState::Busy )
+        {
+            ASSERT( waitBusy, "Consumer never hands readbacks back" );
+            waitBusy( slot, userdata );
+        }
+        else if( state != ReadbackState::Done )
+            PollDevice( true );
+    }
+}
+
+// Wait for every readback still in flight to be consumed
+void FinishReadbacks( ReadbackRing* ring, ReadbackFunc* onMapped, ReadbackFunc* waitBusy, void* userdata )
+{
+    u64 depth = ring->slots.size();
+    for( u64 i = ring->submitted - Min( ring->submitted, depth ); i < ring->submitted; ++i )
+        WaitForReadbackSlot( ring, ring->slots[i % depth], onMapped, waitBusy, userdata );
+}
+
+// Which way round the colour channels of 8 bit texels of the given format come back. False for other formats
+bool GetReadbackSwizzle( WGPUTextureFormat format, bool* swapRedBlue )
+{
+    switch( format )
+    {
+        case WGPUTextureFormat_RGBA8Unorm:
+        case WGPUTextureFormat_RGBA8UnormSrgb:
+            *swapRedBlue = false;
+            return true;
+        case WGPUTextureFormat_BGRA8Unorm:
+        case WGPUTextureFormat_BGRA8UnormSrgb:
+            *swapRedBlue = true;
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Tightly packed RGB, dropping alpha (which has no real meaning for what ends up on screen)
+void PackRGBRow( u8 const* src, u8* dst, u32 width, bool swapRedBlue )
+{
+    int r = swapRedBlue ? 2 : 0;
+    for( u32 x = 0; x < width; ++x, src += 4, dst += 3 )
+    {
+        dst[0] = src[r];
+        dst[1] = src[1];
+        dst[2] = src[2 - r];
+    }
 }
 
 WGPUBindGroupLayoutEntry DefaultBinding()
@@ -304,58 +1053,366 @@ WGPUBindGroupLayoutEntry DefaultBinding()
     return binding;
 }
 
-// TODO Only one uniform buffer in one binding in one group supported rn
-void InitUniformBuffer( Program* program, WGPUShaderStageFlags visibility, size_t size )
+// Uniforms are always at binding 0. Any channels follow, with a shared sampler at binding 1 and each channel at 2 + index.
+// Programs culling their instances also get the visible indices and instance bounds (see culling.h)
+BindGroupLayoutHandle CreateChannelBindGroupLayout( Program* program, WGPUShaderStageFlags visibility,
+                                                    ChannelInput const* channels, int channelCount,
+                                                    InstanceCulling const* culling /*= nullptr*/ )
 {
-    WGPUBindGroupLayoutEntry bindingLayout = DefaultBinding();
-    // The binding index as used in the @binding attribute in the shader
-    bindingLayout.binding = 0;
-    // The stage that needs to access this resource
-    bindingLayout.visibility = visibility;
-    bindingLayout.buffer.type = WGPUBufferBindingType_Uniform;
-    bindingLayout.buffer.minBindingSize = size;
+    WGPUBindGroupLayoutEntry bindingLayouts[2 + MaxChannels + 2];
+    int bindingCount = 0;
+
+    if( program->uniformSize )
+    {
+        WGPUBindGroupLayoutEntry& bindingLayout = bindingLayouts[bindingCount++];
+        bindingLayout = DefaultBinding();
+        // The binding index as used in the @binding attribute in the shader
+        bindingLayout.binding = 0;
+        // The stage that needs to access this resource
+        bindingLayout.visibility = visibility;
+        bindingLayout.buffer.type = WGPUBufferBindingType_Uniform;
+        bindingLayout.buffer.minBindingSize = program->uniformSize;
+    }
+
+    if( channelCount )
+    {
+        if( !program->sampler )
+        {
+            WGPUSamplerDescriptor samplerDesc = {};
+            samplerDesc.nextInChain   = nullptr;
+            samplerDesc.label         = "Channel sampler";
+            samplerDesc.addressModeU  = WGPUAddressMode_Repeat;
+            samplerDesc.addressModeV  = WGPUAddressMode_Repeat;
+            samplerDesc.addressModeW  = WGPUAddressMode_Repeat;
+            samplerDesc.magFilter     = WGPUFilterMode_Linear;
+            samplerDesc.minFilter     = WGPUFilterMode_Linear;
+            samplerDesc.mipmapFilter  = WGPUMipmapFilterMode_Linear;
+            samplerDesc.lodMinClamp   = 0.f;
+            samplerDesc.lodMaxClamp   = 32.f;
+            samplerDesc.compare       = WGPUCompareFunction_Undefined;
+            samplerDesc.maxAnisotropy = 1;
+            program->sampler = RegisterResource( wgpuDeviceCreateSampler( globalDevice, &samplerDesc ), samplerDesc.label );
+        }
+
+        WGPUBindGroupLayoutEntry& samplerLayout = bindingLayouts[bindingCount++];
+        samplerLayout = DefaultBinding();
+        samplerLayout.binding = 1;
+        samplerLayout.visibility = visibility;
+        samplerLayout.sampler.type = WGPUSamplerBindingType_Filtering;
+
+        for( int i = 0; i < channelCount; ++i )
+        {
+            WGPUBindGroupLayoutEntry& textureLayout = bindingLayouts[bindingCount++];
+            textureLayout = DefaultBinding();
+            textureLayout.binding = 2 + i;
+            textureLayout.visibility = visibility;
+            textureLayout.texture.sampleType = WGPUTextureSampleType_Float;
+            textureLayout.texture.viewDimension = WGPUTextureViewDimension_2D;
+        }
+    }
+
+    if( culling && culling->enabled )
+    {
+        u32 cullBindings[] = { CullVisibleBinding, CullBoundsBinding };
+        for( u32 binding : cullBindings )
+        {
+            WGPUBindGroupLayoutEntry& bufferLayout = bindingLayouts[bindingCount++];
+            bufferLayout = DefaultBinding();
+            bufferLayout.binding = binding;
+            bufferLayout.visibility = WGPUShaderStage_Vertex;
+            bufferLayout.buffer.type = WGPUBufferBindingType_ReadOnlyStorage;
+        }
+    }
+
+    if( !bindingCount )
+        return {};
 
     // Create a bind group layout
     WGPUBindGroupLayoutDescriptor bindGroupLayoutDesc = {};
     bindGroupLayoutDesc.nextInChain = nullptr;
-    bindGroupLayoutDesc.entryCount = 1;
-    bindGroupLayoutDesc.entries = &bindingLayout;
-    program->bindGroupLayout = wgpuDeviceCreateBindGroupLayout( globalDevice, &bindGroupLayoutDesc );
+    bindGroupLayoutDesc.entryCount = bindingCount;
+    bindGroupLayoutDesc.entries = bindingLayouts;
+    return RegisterResource( wgpuDeviceCreateBindGroupLayout( globalDevice, &bindGroupLayoutDesc ),
+                             program->shaderPath );
 }
 
-void WriteUniformBuffer( Program* program, void* data, size_t size )
+// Work out which ping-pong target a channel should read from this frame
+WGPUTextureView ResolveChannelView( Program const* program, ChannelInput const& channel, int pass )
 {
-    // Create uniform buffer
-    WGPUBufferDescriptor uniformBufferDesc = {};
-    uniformBufferDesc.nextInChain = nullptr;
-    uniformBufferDesc.size = size;
-    // Make sure to flag the buffer as BufferUsage::Uniform
-    uniformBufferDesc.usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform;
-    uniformBufferDesc.mappedAtCreation = false;
-    program->uniformBuffer = wgpuDeviceCreateBuffer( globalDevice, &uniformBufferDesc );
-
-    wgpuQueueWriteBuffer( globalQueue, program->uniformBuffer, 0, data, size );
-
-    // Create a binding
-    WGPUBindGroupEntry binding = {};
-    binding.nextInChain = nullptr;
-    // The index of the binding (the entries in bindGroupDesc can be in any order)
-    binding.binding = 0;
-    // The buffer it is actually bound to
-    binding.buffer = program->uniformBuffer;
-    // We can specify an offset within the buffer, so that a single buffer can hold
-    // multiple uniform blocks.
-    binding.offset = 0;
-    // And we specify again the size of the buffer.
-    binding.size = uniformBufferDesc.size;
+    if( channel.type == ChannelType::Texture )
+        return channel.textureView;
+
+    ASSERT( channel.type == ChannelType::Buffer && channel.buffer < program->bufferCount, "Invalid channel" );
+    ProgramBuffer const& buffer = program->buffers[channel.buffer];
+
+    // The main pass renders after all buffers
+    int passOrder = pass == MainPass ? program->bufferCount : pass;
+    bool previousFrame = channel.previousFrame || channel.buffer >= passOrder;
+
+    u32 writeIndex = program->frameIndex & 1;
+    return GetResource( buffer.targetViews[previousFrame ? writeIndex ^ 1 : writeIndex] );
+}
+
+// Returns null if the pass has no bindings. Release after encoding
+WGPUBindGroup CreateChannelBindGroup( Program const* program, int pass )
+{
+    ProgramBuffer const* buffer = pass != MainPass ? &program->buffers[pass] : nullptr;
+    WGPUBindGroupLayout layout = GetResource( buffer ? buffer->bindGroupLayout : program->bindGroupLayout );
+    WGPUBuffer uniformBuffer = GetResource( program->uniformBuffer );
+    ChannelInput const* channels = buffer ? buffer->channels : program->channels;
+    int channelCount = buffer ? buffer->channelCount : program->channelCount;
+
+    if( !layout || (program->uniformSize && !uniformBuffer) )
+        return nullptr;
+
+    WGPUBindGroupEntry bindings[2 + MaxChannels + 2] = {};
+    int bindingCount = 0;
+
+    if( program->uniformSize )
+    {
+        WGPUBindGroupEntry& binding = bindings[bindingCount++];
+        binding.nextInChain = nullptr;
+        // The index of the binding (the entries in bindGroupDesc can be in any order)
+        binding.binding = 0;
+        // The buffer it is actually bound to
+        binding.buffer = uniformBuffer;
+        // We can specify an offset within the buffer, so that a single buffer can hold
+        // multiple uniform blocks.
+        binding.offset = 0;
+        // And we specify again the size of the buffer.
+        binding.size = program->uniformSize;
+    }
+
+    if( channelCount )
+    {
+        WGPUBindGroupEntry& samplerBinding = bindings[bindingCount++];
+        samplerBinding.binding = 1;
+        samplerBinding.sampler = GetResource( program->sampler );
+
+        for( int i = 0; i < channelCount; ++i )
+        {
+            WGPUBindGroupEntry& textureBinding = bindings[bindingCount++];
+            textureBinding.binding = 2 + i;
+            textureBinding.textureView = ResolveChannelView( program, channels[i], pass );
+        }
+    }
+
+    if( !buffer && program->culling.enabled )
+    {
+        InstanceCulling const& culling = program->culling;
+        WGPUBuffer visibleBuffer = GetResource( culling.visibleBuffer );
+        WGPUBuffer boundsBuffer = GetResource( culling.boundsBuffer );
+        if( !visibleBuffer || !boundsBuffer )
+            return nullptr;
+
+        WGPUBindGroupEntry& visibleBinding = bindings[bindingCount++];
+        visibleBinding.binding = CullVisibleBinding;
+        visibleBinding.buffer = visibleBuffer;
+        visibleBinding.size = wgpuBufferGetSize( visibleBuffer );
+
+        WGPUBindGroupEntry& boundsBinding = bindings[bindingCount++];
+        boundsBinding.binding = CullBoundsBinding;
+        boundsBinding.buffer = boundsBuffer;
+        boundsBinding.size = wgpuBufferGetSize( boundsBuffer );
+    }
 
     // A bind group contains one or multiple bindings
     WGPUBindGroupDescriptor bindGroupDesc = {};
     bindGroupDesc.nextInChain = nullptr;
-    bindGroupDesc.layout = program->bindGroupLayout;
+    bindGroupDesc.layout = layout;
     // There must be as many bindings as declared in bindGroupLayoutDesc!
-    bindGroupDesc.entryCount = 1;
-    bindGroupDesc.entries = &binding;
-    program->bindGroup = wgpuDeviceCreateBindGroup( globalDevice, &bindGroupDesc );
+    bindGroupDesc.entryCount = bindingCount;
+    bindGroupDesc.entries = bindings;
+    return wgpuDeviceCreateBindGroup( globalDevice, &bindGroupDesc );
+}
+
+// TODO Only one uniform buffer in one binding in one group supported rn
+// The same uniforms are visible to all of the program's buffers too
+void InitUniformBuffer( Program* program, WGPUShaderStageFlags visibility, size_t size )
+{
+    program->uniformVisibility = visibility;
+    program->uniformSize = size;
+}
+
+void UploadUniformBuffer( Program* program, void const* data, size_t size )
+{
+    // Create uniform buffer
+    WGPUBuffer uniformBuffer = GetResource( program->uniformBuffer );
+    if( !uniformBuffer || wgpuBufferGetSize( uniformBuffer ) != size )
+    {
+        DestroyResource( &program->uniformBuffer );
+
+        WGPUBufferDescriptor uniformBufferDesc = {};
+        uniformBufferDesc.nextInChain = nullptr;
+        uniformBufferDesc.label = "Uniforms";
+        uniformBufferDesc.size = size;
+        // Make sure to flag the buffer as BufferUsage::Uniform
+        uniformBufferDesc.usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform;
+        uniformBufferDesc.mappedAtCreation = false;
+        uniformBuffer = CreateGPUBuffer( &uniformBufferDesc, program->shaderPath );
+        if( !uniformBuffer )
+            return;
+        program->uniformBuffer = RegisterResource( uniformBuffer, program->shaderPath );
+    }
+
+    if( void* staging = StagingWrite( &globalStagingBelt, uniformBuffer, 0, size ) )
+        COPYP( data, staging, size );
+}
+
+// During an update this only keeps a copy for when the frame gets encoded
+void WriteUniformBuffer( Program* program, void* data, size_t size )
+{
+    ASSERT( size == program->uniformSize, "Uniform size doesn't match InitUniformBuffer" );
+
+    if( program->updating )
+        program->updating->uniforms.assign( (u8 const*)data, (u8 const*)data + size );
+    else
+        UploadUniformBuffer( program, data, size );
+}
+
+// Declare a new offscreen buffer pass. Returns its index, to be used as a channel source or to set its own channels
+int AddProgramBuffer( Program* program, char const* shaderPath, WGPUTextureFormat format = WGPUTextureFormat_RGBA16Float )
+{
+    ASSERT( program->bufferCount < MaxProgramBuffers, "Too many buffers" );
+
+    int index = program->bufferCount++;
+    ProgramBuffer& buffer = program->buffers[index];
+    buffer = {};
+    buffer.shaderPath = shaderPath;
+    buffer.format = format;
+    return index;
+}
+
+ChannelInput* GetPassChannel( Program* program, int pass, int channel )
+{
+    ASSERT( channel < MaxChannels, "Invalid channel index" );
+    ASSERT( pass == MainPass || pass < program->bufferCount, "Invalid pass index" );
+
+    int* channelCount = pass == MainPass ? &program->channelCount : &program->buffers[pass].channelCount;
+    *channelCount = Max( *channelCount, channel + 1 );
+    return pass == MainPass ? &program->channels[channel] : &program->buffers[pass].channels[channel];
+}
+
+// Make iChannel<channel> of the given pass (a buffer index or MainPass) read the output of buffer 'source'
+void SetChannelBuffer( Program* program, int pass, int channel, int source, bool previousFrame = false )
+{
+    *GetPassChannel( program, pass, channel ) = { ChannelType::Buffer, nullptr, source, previousFrame };
+}
+
+// Queue everything the program created for destruction. Borrowed objects (meshes, textures) are left alone
+void ReleaseProgramResources( Program* program )
+{
+    for( int i = 0; i < program->bufferCount; ++i )
+    {
+        ProgramBuffer& buffer = program->buffers[i];
+        for( int t = 0; t < 2; ++t )
+        {
+            DestroyResource( &buffer.targetViews[t] );
+            DestroyResource( &buffer.targets[t] );
+        }
+        DestroyResource( &buffer.pipeline );
+        DestroyResource( &buffer.bindGroupLayout );
+        ReleasePassBundles( buffer.bundles );
+        buffer = {};
+    }
+    program->bufferCount = 0;
+
+    for( int slot = 0; slot < MaxVertexBuffers; ++slot )
+    {
+        if( program->ownedVertexBuffers[slot] )
+        {
+            DestroyResource( &program->ownedVertexBuffers[slot] );
+            program->vertexBuffers[slot] = nullptr;
+            program->vertexBufferSizes[slot] = 0;
+        }
+    }
+
+    DestroyResource( &program->pipeline );
+    RemoveShaderDependents( program );
+    DestroyResource( &program->bindGroupLayout );
+    DestroyResource( &program->uniformBuffer );
+    DestroyResource( &program->sampler );
+    ReleasePassBundles( program->bundles );
+    ReleaseInstanceCulling( &program->culling );
+    ReleaseRayTracing( &program->rayTracing );
 }
 
+// Declare the layout of the next vertex buffer slot in the program.
+// Buffers with WGPUVertexStepMode_Instance advance once per instance instead of once per vertex.
+// Returns the slot index to pass to WriteVertexBuffer
+int AddVertexBufferLayout( Program* program, WGPUVertexAttribute const* attribs, int attribCount,
+                           size_t arrayStride, WGPUVertexStepMode stepMode )
+{
+    ASSERT( program->vertexBufferCount < MaxVertexBuffers, "Too many vertex buffers" );
+    ASSERT( attribCount <= MaxVertexAttribsPerBuffer, "Too many vertex attributes" );
+
+    int slot = program->vertexBufferCount++;
+    COPYP( attribs, program->vertexAttribs[slot], attribCount * sizeof(WGPUVertexAttribute) );
+
+    WGPUVertexBufferLayout& layout = program->vertexBufferLayouts[slot];
+    layout = {};
+    layout.attributeCount = attribCount;
+    layout.attributes = program->vertexAttribs[slot];
+    layout.arrayStride = arrayStride;
+    layout.stepMode = stepMode;
+
+    return slot;
+}
+
+void UploadVertexBuffer( Program* program, int slot, void const* data, int count )
+{
+    WGPUVertexBufferLayout const& layout = program->vertexBufferLayouts[slot];
+    // NOTE Strides are always a multiple of 4, so this is a valid size for a copy
+    size_t size = count * layout.arrayStride;
+
+    WGPUBuffer vertexBuffer = GetResource( program->ownedVertexBuffers[slot] );
+    if( !vertexBuffer || wgpuBufferGetSize( vertexBuffer ) < size )
+    {
+        // Previous frames may still be reading from the old one
+        DestroyResource( &program->ownedVertexBuffers[slot] );
+
+        WGPUBufferDescriptor vertexBufferDesc = {};
+        vertexBufferDesc.nextInChain = nullptr;
+        vertexBufferDesc.label = layout.stepMode == WGPUVertexStepMode_Instance ? "Instance data" : "Vertex data";
+        vertexBufferDesc.usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Vertex;
+        vertexBufferDesc.size = size;
+        vertexBufferDesc.mappedAtCreation = false;
+        vertexBuffer = CreateGPUBuffer( &vertexBufferDesc, program->shaderPath );
+        if( !vertexBuffer )
+        {
+            program->vertexBuffers[slot] = nullptr;
+            program->vertexBufferSizes[slot] = 0;
+            return;
+        }
+        program->ownedVertexBuffers[slot] = RegisterResource( vertexBuffer, vertexBufferDesc.label );
+    }
+    program->vertexBuffers[slot] = vertexBuffer;
+    program->vertexBufferSizes[slot] = size;
+
+    // Copy from RAM to VRAM, through the staging belt
+    if( void* staging = StagingWrite( &globalStagingBelt, vertexBuffer, 0, size ) )
+        COPYP( data, staging, size );
+
+    if( layout.stepMode == WGPUVertexStepMode_Instance )
+        program->instanceCount = count;
+    else
+        program->elementCount = count;
+}
+
+// Upload 'count' elements into the vertex buffer at the given slot, (re)creating it only when it needs to grow.
+// This also updates the program's vertex or instance count, depending on the step mode of the slot.
+// During an update this only keeps a copy for when the frame gets encoded
+void WriteVertexBuffer( Program* program, int slot, void const* data, int count )
+{
+    ASSERT( slot < program->vertexBufferCount, "Invalid vertex buffer slot" );
+
+    if( program->updating )
+    {
+        // NOTE Strides are always a multiple of 4, so this is a valid size for a copy
+        size_t size = count * program->vertexBufferLayouts[slot].arrayStride;
+        program->updating->vertexData[slot].assign( (u8 const*)data, (u8 const*)data + size );
+        program->updating->vertexCounts[slot] = count;
+    }
+    else
+        UploadVertexBuffer( program, slot, data, count );
+}